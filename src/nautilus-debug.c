@@ -36,6 +36,7 @@ static gboolean initialized = FALSE;
 static GDebugKey keys[] =
 {
     { "Application", NAUTILUS_DEBUG_APPLICATION },
+    { "AsyncJobs", NAUTILUS_DEBUG_ASYNC_JOBS },
     { "Bookmarks", NAUTILUS_DEBUG_BOOKMARKS },
     { "DBus", NAUTILUS_DEBUG_DBUS },
     { "DirectoryView", NAUTILUS_DEBUG_DIRECTORY_VIEW },
@@ -85,6 +86,11 @@ nautilus_debug_set_flags (DebugFlags new_flags)
 gboolean
 nautilus_debug_flag_is_set (DebugFlags flag)
 {
+    if (G_UNLIKELY (!initialized))
+    {
+        nautilus_debug_set_flags_from_env ();
+    }
+
     return flag & flags;
 }
 
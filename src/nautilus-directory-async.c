@@ -23,9 +23,13 @@
 
 #include "nautilus-directory-notify.h"
 #include "nautilus-directory-private.h"
+#include "nautilus-debug.h"
+#include "nautilus-directory-listing-cache.h"
 #include "nautilus-file-attributes.h"
 #include "nautilus-file-private.h"
 #include "nautilus-file-utilities.h"
+#include "nautilus-inode-set.h"
+#include "nautilus-work-queue.h"
 #include "nautilus-signaller.h"
 #include "nautilus-global-preferences.h"
 #include "nautilus-link.h"
@@ -36,6 +40,7 @@
 #include <libxml/parser.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 /* turn this on to check if async. job calls are balanced */
 #if 0
@@ -44,8 +49,75 @@
 
 #define DIRECTORY_LOAD_ITEMS_PER_CALLBACK 100
 
+/* At most this many threads work on one deep count. */
+#define DEEP_COUNT_MAX_WORKERS 8
+
+/* How often deep counts in progress are reported. */
+#define DEEP_COUNT_PROGRESS_INTERVAL 100 /* milliseconds */
+
+/* Remember the results of this many deep counts. */
+#define DEEP_COUNT_CACHE_SIZE 256
+
+/* Trees with more directories than this are not worth checking
+ * against a remembered result.
+ */
+#define DEEP_COUNT_CACHE_MAX_DIRECTORIES 10000
+
+#define DEEP_COUNT_ATTRIBUTES \
+    G_FILE_ATTRIBUTE_STANDARD_NAME "," \
+    G_FILE_ATTRIBUTE_STANDARD_TYPE "," \
+    G_FILE_ATTRIBUTE_STANDARD_SIZE "," \
+    G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN "," \
+    G_FILE_ATTRIBUTE_STANDARD_IS_BACKUP "," \
+    G_FILE_ATTRIBUTE_TIME_MODIFIED "," \
+    G_FILE_ATTRIBUTE_ID_FILESYSTEM "," \
+    G_FILE_ATTRIBUTE_UNIX_DEVICE "," \
+    G_FILE_ATTRIBUTE_UNIX_INODE "," \
+    G_FILE_ATTRIBUTE_UNIX_NLINK
+
+/* The file list is read in a thread, in batches that start at
+ * DIRECTORY_LOAD_ITEMS_PER_CALLBACK files and double, up to this
+ * size, as long as reading one takes less than the interval below.
+ */
+#define DIRECTORY_LOAD_MAX_ITEMS_PER_BATCH 4096
+#define DIRECTORY_LOAD_BATCH_INTERVAL (50 * G_TIME_SPAN_MILLISECOND)
+
+/* Don't let the loader thread get more batches than this ahead of
+ * the main loop.
+ */
+#define DIRECTORY_LOAD_MAX_PENDING_BATCHES 4
+
+/* Time spent turning file infos into files in one main loop iteration. */
+#define DEQUEUE_PENDING_TIME_SLICE (8 * G_TIME_SPAN_MILLISECOND)
+
+/* Set on file infos whose file count and MIME type were already
+ * accounted for by the loader thread.
+ */
+#define DIRECTORY_LOAD_COUNTED_KEY "nautilus-directory-load-counted"
+
+/* Set on file infos that come from the listing cache, see
+ * nautilus-directory-listing-cache.h.
+ */
+#define DIRECTORY_LOAD_CACHED_KEY "nautilus-directory-load-cached"
+
 /* Keep async. jobs down to this number for all directories. */
-#define MAX_ASYNC_JOBS 10
+#define MAX_ASYNC_JOBS 64
+
+/* Jobs are also limited per file system, so a slow share can't take
+ * all the slots. That limit adapts to the latency of the jobs, between
+ * these bounds.
+ */
+#define MIN_DOMAIN_JOBS 2
+#define INITIAL_DOMAIN_JOBS 10
+#define MAX_DOMAIN_JOBS 32
+
+/* Reconsider the limit of a file system every this many jobs. */
+#define DOMAIN_JOBS_ADAPT_INTERVAL 8
+
+/* How many files past the head of a work queue we look at for more
+ * work, per request that can be in flight for each attribute kind.
+ */
+#define WORK_QUEUE_LOOKAHEAD_FACTOR 4
 
 struct TopLeftTextReadState
 {
@@ -87,12 +159,31 @@ struct FilesystemInfoState
 
 struct DirectoryLoadState
 {
+    gint ref_count;
     NautilusDirectory *directory;
     GCancellable *cancellable;
-    GFileEnumerator *enumerator;
+    GFile *location;
     GHashTable *load_mime_list_hash;
     NautilusFile *load_directory_file;
     int load_file_count;
+
+    /* Files that only the listing cache has shown so far, and whether
+     * the enumeration that should confirm them failed.
+     */
+    GHashTable *cached_files;
+    gboolean failed;
+
+    /* Batches of file infos read by the loader thread, in directory order. */
+    GMutex mutex;
+    GCond batch_taken;
+    GQueue batches;
+    gboolean batches_ready_scheduled;
+
+    /* Only touched by the loader thread until it is done. */
+    gboolean show_hidden_files;
+    gboolean use_listing_cache;
+    GHashTable *thread_mime_list_hash;
+    int thread_file_count;
 };
 
 struct MimeListState
@@ -108,6 +199,7 @@ struct GetInfoState
 {
     NautilusDirectory *directory;
     GCancellable *cancellable;
+    NautilusFile *file;
 };
 
 struct NewFilesState
@@ -126,15 +218,39 @@ struct DirectoryCountState
     int file_count;
 };
 
+/* Deep counts visit the directories on a NautilusWorkQueue. Each
+ * worker adds up what it counts on its own.
+ */
+typedef struct
+{
+    GMutex mutex;
+
+    /* What this worker counted so far, protected by mutex. */
+    guint directory_count;
+    guint file_count;
+    guint unreadable_count;
+    goffset size;
+    GArray *stamps; /* DeepCountStamp of the directories it went through */
+} DeepCountWorker;
+
 struct DeepCountState
 {
+    gint ref_count;
     NautilusDirectory *directory;
     GCancellable *cancellable;
-    GFileEnumerator *enumerator;
-    GFile *deep_count_location;
-    GList *deep_count_subdirectories;
-    GArray *seen_deep_count_inodes;
-    char *fs_id;
+    GFile *location;
+    gboolean show_hidden_files;
+    char *fs_id; /* set while counting location, before any other directory */
+    guint64 mtime; /* same */
+
+    NautilusWorkQueue *queue;
+    DeepCountWorker *workers;
+    guint n_workers;
+
+    GMutex seen_inodes_mutex;
+    NautilusInodeSet *seen_deep_count_inodes;
+
+    guint progress_timeout_id;
 };
 
 
@@ -172,19 +288,37 @@ typedef struct
     NautilusOperationResult result;
 } InfoProviderResponse;
 
+/* All the directories on one file system (or one host, if we don't
+ * know the file system yet) share a job budget.
+ */
+struct AsyncJobDomain
+{
+    char *id;
+    int job_count;
+    int job_limit;
+    GQueue waiting_directories;
+    gboolean in_rotation;
+    guint n_directories;        /* that have this as their domain */
+
+    guint64 jobs_done;
+    gint64 short_term_latency; /* microseconds, fast moving average */
+    gint64 long_term_latency; /* microseconds, slow moving average */
+};
+
 typedef gboolean (*RequestCheck) (Request);
 typedef gboolean (*FileCheck) (NautilusFile *);
 
 /* Current number of async. jobs. */
 static int async_job_count;
-static GHashTable *waiting_directories;
+/* File system id -> AsyncJobDomain */
+static GHashTable *async_job_domains;
+/* Domains with waiting directories, woken up round robin. */
+static GQueue async_job_domain_rotation = G_QUEUE_INIT;
 #ifdef DEBUG_ASYNC_JOBS
 static GHashTable *async_jobs;
 #endif
 
 /* Forward declarations for functions that need them. */
-static void     deep_count_load (DeepCountState *state,
-                                 GFile          *location);
 static gboolean request_is_satisfied (NautilusDirectory *directory,
                                       NautilusFile      *file,
                                       Request            request);
@@ -204,6 +338,9 @@ static void     move_file_to_extension_queue (NautilusDirectory *directory,
                                               NautilusFile      *file);
 static void     nautilus_directory_invalidate_file_attributes (NautilusDirectory     *directory,
                                                                NautilusFileAttributes file_attributes);
+static void     directory_load_cancel (NautilusDirectory *directory);
+static void     directory_load_state_unref (DirectoryLoadState *state);
+static void     deep_count_state_unref (DeepCountState *state);
 
 /* Some helpers for case-insensitive strings.
  * Move to nautilus-glib-extensions?
@@ -354,6 +491,254 @@ nautilus_directory_verify_request_counts (NautilusDirectory *directory)
 }
 #endif
 
+static char *
+async_job_domain_id_for_directory (NautilusDirectory *directory)
+{
+    NautilusFile *file;
+    char *id;
+    char *host_end;
+
+    id = NULL;
+
+    file = nautilus_directory_get_existing_corresponding_file (directory);
+    if (file != NULL)
+    {
+        if (file->details->filesystem_id != NULL)
+        {
+            id = g_strdup (eel_ref_str_peek (file->details->filesystem_id));
+        }
+        nautilus_file_unref (file);
+    }
+
+    if (id == NULL)
+    {
+        /* Until we know the file system, go by scheme and host. */
+        id = g_file_get_uri (directory->details->location);
+        host_end = strstr (id, "://");
+        if (host_end != NULL)
+        {
+            host_end = strchr (host_end + 3, '/');
+            if (host_end != NULL)
+            {
+                *host_end = '\0';
+            }
+        }
+    }
+
+    return id;
+}
+
+static void
+async_job_domain_free (AsyncJobDomain *domain)
+{
+    g_queue_clear (&domain->waiting_directories);
+    g_free (domain->id);
+    g_free (domain);
+}
+
+/* Lets go of the domain of a directory that has no jobs in it, and
+ * frees the domain once no directory has it anymore.
+ */
+static void
+async_job_domain_release (NautilusDirectory *directory)
+{
+    AsyncJobDomain *domain;
+
+    domain = directory->details->async_job_domain;
+    directory->details->async_job_domain = NULL;
+    if (domain == NULL)
+    {
+        return;
+    }
+
+    g_queue_remove (&domain->waiting_directories, directory);
+    domain->n_directories--;
+    if (domain->n_directories > 0 || domain->job_count > 0)
+    {
+        return;
+    }
+
+    if (domain->in_rotation)
+    {
+        g_queue_remove (&async_job_domain_rotation, domain);
+    }
+    g_hash_table_remove (async_job_domains, domain->id);
+}
+
+static AsyncJobDomain *
+async_job_domain_for_directory (NautilusDirectory *directory)
+{
+    AsyncJobDomain *domain;
+    char *id;
+
+    domain = directory->details->async_job_domain;
+
+    /* Keep the domain while there are jobs to account for, even if
+     * we learned the file system in the meantime.
+     */
+    if (domain != NULL &&
+        (directory->details->async_job_count > 0 ||
+         g_queue_find (&domain->waiting_directories, directory) != NULL))
+    {
+        return domain;
+    }
+
+    if (async_job_domains == NULL)
+    {
+        async_job_domains = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                   NULL,
+                                                   (GDestroyNotify) async_job_domain_free);
+    }
+
+    id = async_job_domain_id_for_directory (directory);
+    domain = g_hash_table_lookup (async_job_domains, id);
+    if (domain == NULL)
+    {
+        domain = g_new0 (AsyncJobDomain, 1);
+        domain->id = id;
+        domain->job_limit = INITIAL_DOMAIN_JOBS;
+        g_queue_init (&domain->waiting_directories);
+        g_hash_table_insert (async_job_domains, domain->id, domain);
+    }
+    else
+    {
+        g_free (id);
+    }
+
+    if (domain != directory->details->async_job_domain)
+    {
+        domain->n_directories++;
+        async_job_domain_release (directory);
+        directory->details->async_job_domain = domain;
+    }
+
+    return domain;
+}
+
+static void
+async_job_domain_add_waiting (AsyncJobDomain    *domain,
+                              NautilusDirectory *directory)
+{
+    if (g_queue_find (&domain->waiting_directories, directory) == NULL)
+    {
+        g_queue_push_tail (&domain->waiting_directories, directory);
+    }
+
+    if (!domain->in_rotation)
+    {
+        g_queue_push_tail (&async_job_domain_rotation, domain);
+        domain->in_rotation = TRUE;
+    }
+}
+
+/* Adjust the job limit of a domain, in the spirit of TCP congestion
+ * control: while jobs take about as long as they usually do, allow
+ * more of them in parallel, and back off quickly when latency climbs,
+ * since that means the file system is queueing our requests.
+ */
+static void
+async_job_domain_record_latency (AsyncJobDomain *domain,
+                                 gint64          latency)
+{
+    int old_limit;
+
+    domain->jobs_done++;
+
+    if (domain->long_term_latency == 0)
+    {
+        domain->short_term_latency = latency;
+        domain->long_term_latency = latency;
+    }
+    else
+    {
+        domain->short_term_latency += (latency - domain->short_term_latency) / 4;
+        domain->long_term_latency += (latency - domain->long_term_latency) / 64;
+    }
+
+    if (domain->jobs_done % DOMAIN_JOBS_ADAPT_INTERVAL != 0)
+    {
+        return;
+    }
+
+    old_limit = domain->job_limit;
+    if (domain->short_term_latency > 2 * domain->long_term_latency)
+    {
+        domain->job_limit = MAX (MIN_DOMAIN_JOBS, domain->job_limit * 3 / 4);
+    }
+    else if (domain->short_term_latency <= domain->long_term_latency &&
+             !g_queue_is_empty (&domain->waiting_directories))
+    {
+        domain->job_limit = MIN (MAX_DOMAIN_JOBS, domain->job_limit + 1);
+    }
+
+    if (domain->job_limit != old_limit &&
+        nautilus_debug_flag_is_set (NAUTILUS_DEBUG_ASYNC_JOBS))
+    {
+        g_autofree char *stats = NULL;
+
+        stats = nautilus_directory_get_async_job_stats ();
+        nautilus_debug (NAUTILUS_DEBUG_ASYNC_JOBS,
+                        "job limit for %s changed from %d to %d (latency %" G_GINT64_FORMAT
+                        " us, usually %" G_GINT64_FORMAT " us), now:\n%s",
+                        domain->id, old_limit, domain->job_limit,
+                        domain->short_term_latency, domain->long_term_latency,
+                        stats);
+    }
+}
+
+static void
+async_job_push_start_time (NautilusDirectory *directory,
+                           const char        *job)
+{
+    GArray *start_times;
+    gint64 now;
+
+    if (directory->details->async_job_start_times == NULL)
+    {
+        directory->details->async_job_start_times =
+            g_hash_table_new_full (g_str_hash, g_str_equal,
+                                   NULL, (GDestroyNotify) g_array_unref);
+    }
+
+    start_times = g_hash_table_lookup (directory->details->async_job_start_times, job);
+    if (start_times == NULL)
+    {
+        start_times = g_array_new (FALSE, FALSE, sizeof (gint64));
+        g_hash_table_insert (directory->details->async_job_start_times,
+                             (gpointer) job, start_times);
+    }
+
+    now = g_get_monotonic_time ();
+    g_array_append_val (start_times, now);
+}
+
+/* Jobs of one kind mostly finish in the order they started, so
+ * pair the end of a job with the oldest start of its kind.
+ */
+static gint64
+async_job_pop_start_time (NautilusDirectory *directory,
+                          const char        *job)
+{
+    GArray *start_times;
+    gint64 start_time;
+
+    if (directory->details->async_job_start_times == NULL)
+    {
+        return 0;
+    }
+
+    start_times = g_hash_table_lookup (directory->details->async_job_start_times, job);
+    if (start_times == NULL || start_times->len == 0)
+    {
+        return 0;
+    }
+
+    start_time = g_array_index (start_times, gint64, 0);
+    g_array_remove_index (start_times, 0);
+
+    return start_time;
+}
+
 /* Start a job. This is really just a way of limiting the number of
  * async. requests that we issue at any given time. Without this, the
  * number of requests is unbounded.
@@ -362,6 +747,7 @@ static gboolean
 async_job_start (NautilusDirectory *directory,
                  const char        *job)
 {
+    AsyncJobDomain *domain;
 #ifdef DEBUG_ASYNC_JOBS
     char *key;
 #endif
@@ -371,16 +757,12 @@ async_job_start (NautilusDirectory *directory,
     g_assert (async_job_count >= 0);
     g_assert (async_job_count <= MAX_ASYNC_JOBS);
 
-    if (async_job_count >= MAX_ASYNC_JOBS)
-    {
-        if (waiting_directories == NULL)
-        {
-            waiting_directories = g_hash_table_new (NULL, NULL);
-        }
+    domain = async_job_domain_for_directory (directory);
 
-        g_hash_table_insert (waiting_directories,
-                             directory,
-                             directory);
+    if (async_job_count >= MAX_ASYNC_JOBS ||
+        domain->job_count >= domain->job_limit)
+    {
+        async_job_domain_add_waiting (domain, directory);
 
         return FALSE;
     }
@@ -404,7 +786,11 @@ async_job_start (NautilusDirectory *directory,
     }
 #endif
 
+    async_job_push_start_time (directory, job);
+
     async_job_count += 1;
+    domain->job_count += 1;
+    directory->details->async_job_count += 1;
     return TRUE;
 }
 
@@ -413,6 +799,8 @@ static void
 async_job_end (NautilusDirectory *directory,
                const char        *job)
 {
+    AsyncJobDomain *domain;
+    gint64 start_time;
 #ifdef DEBUG_ASYNC_JOBS
     char *key;
     gpointer table_key, value;
@@ -443,43 +831,35 @@ async_job_end (NautilusDirectory *directory,
     }
 #endif
 
-    async_job_count -= 1;
-}
+    domain = directory->details->async_job_domain;
+    g_assert (domain != NULL);
+    g_assert (domain->job_count > 0);
+    g_assert (directory->details->async_job_count > 0);
 
-/* Helper to get one value from a hash table. */
-static void
-get_one_value_callback (gpointer key,
-                        gpointer value,
-                        gpointer callback_data)
-{
-    gpointer *returned_value;
-
-    returned_value = callback_data;
-    *returned_value = value;
-}
-
-/* return a single value from a hash table. */
-static gpointer
-get_one_value (GHashTable *table)
-{
-    gpointer value;
-
-    value = NULL;
-    if (table != NULL)
+    start_time = async_job_pop_start_time (directory, job);
+    if (start_time != 0)
     {
-        g_hash_table_foreach (table, get_one_value_callback, &value);
+        async_job_domain_record_latency (domain,
+                                         g_get_monotonic_time () - start_time);
     }
-    return value;
+
+    async_job_count -= 1;
+    domain->job_count -= 1;
+    directory->details->async_job_count -= 1;
 }
 
 /* Wake up directories that are "blocked" as long as there are job
- * slots available.
+ * slots available. Each file system gets a turn in round robin order,
+ * and so does each directory within a file system, so one busy share
+ * can't starve the others.
  */
 static void
 async_job_wake_up (void)
 {
     static gboolean already_waking_up = FALSE;
-    gpointer value;
+    AsyncJobDomain *domain;
+    NautilusDirectory *directory;
+    guint stalled;
 
     g_assert (async_job_count >= 0);
     g_assert (async_job_count <= MAX_ASYNC_JOBS);
@@ -490,27 +870,154 @@ async_job_wake_up (void)
     }
 
     already_waking_up = TRUE;
-    while (async_job_count < MAX_ASYNC_JOBS)
+    stalled = 0;
+    while (async_job_count < MAX_ASYNC_JOBS &&
+           stalled < g_queue_get_length (&async_job_domain_rotation))
     {
-        value = get_one_value (waiting_directories);
-        if (value == NULL)
+        domain = g_queue_pop_head (&async_job_domain_rotation);
+
+        if (g_queue_is_empty (&domain->waiting_directories))
         {
-            break;
+            domain->in_rotation = FALSE;
+            continue;
+        }
+
+        if (domain->job_count >= domain->job_limit)
+        {
+            g_queue_push_tail (&async_job_domain_rotation, domain);
+            stalled++;
+            continue;
+        }
+
+        directory = g_queue_pop_head (&domain->waiting_directories);
+        if (g_queue_is_empty (&domain->waiting_directories))
+        {
+            domain->in_rotation = FALSE;
         }
-        g_hash_table_remove (waiting_directories, value);
-        nautilus_directory_async_state_changed
-            (NAUTILUS_DIRECTORY (value));
+        else
+        {
+            g_queue_push_tail (&async_job_domain_rotation, domain);
+        }
+        stalled = 0;
+
+        nautilus_directory_async_state_changed (directory);
     }
     already_waking_up = FALSE;
 }
 
+static void
+async_job_forget_directory (NautilusDirectory *directory)
+{
+    AsyncJobDomain *domain;
+
+    domain = directory->details->async_job_domain;
+    if (domain != NULL)
+    {
+        g_queue_remove (&domain->waiting_directories, directory);
+    }
+    if (directory->details->async_job_count == 0)
+    {
+        async_job_domain_release (directory);
+    }
+
+    g_clear_pointer (&directory->details->async_job_start_times,
+                     g_hash_table_destroy);
+}
+
+static void
+append_async_job_domain_stats (gpointer key,
+                               gpointer value,
+                               gpointer callback_data)
+{
+    AsyncJobDomain *domain;
+    GString *stats;
+
+    domain = value;
+    stats = callback_data;
+
+    g_string_append_printf (stats,
+                            "%s: %d/%d jobs, %u waiting, %" G_GUINT64_FORMAT " done, "
+                            "latency %" G_GINT64_FORMAT " us (usually %" G_GINT64_FORMAT " us)\n",
+                            domain->id,
+                            domain->job_count,
+                            domain->job_limit,
+                            g_queue_get_length (&domain->waiting_directories),
+                            domain->jobs_done,
+                            domain->short_term_latency,
+                            domain->long_term_latency);
+}
+
+char *
+nautilus_directory_get_async_job_stats (void)
+{
+    GString *stats;
+
+    stats = g_string_new (NULL);
+    g_string_append_printf (stats, "%d/%d jobs\n", async_job_count, MAX_ASYNC_JOBS);
+    if (async_job_domains != NULL)
+    {
+        g_hash_table_foreach (async_job_domains, append_async_job_domain_stats, stats);
+    }
+
+    return g_string_free (stats, FALSE);
+}
+
+static guint attribute_pipeline_depth = 1;
+
+static void
+attribute_pipeline_depth_changed_callback (gpointer callback_data)
+{
+    attribute_pipeline_depth = MAX (1, g_settings_get_int (nautilus_preferences,
+                                                           NAUTILUS_PREFERENCES_DIRECTORY_ATTRIBUTE_PIPELINE_DEPTH));
+}
+
+/* The number of requests of one kind (item count, thumbnail, ...) that
+ * can be in flight at the same time for the files of a directory.
+ */
+static guint
+get_attribute_pipeline_depth (void)
+{
+    static gboolean attribute_pipeline_depth_changed_callback_installed = FALSE;
+
+    /* Add the callback once for the life of our process */
+    if (!attribute_pipeline_depth_changed_callback_installed)
+    {
+        g_signal_connect_swapped (nautilus_preferences,
+                                  "changed::" NAUTILUS_PREFERENCES_DIRECTORY_ATTRIBUTE_PIPELINE_DEPTH,
+                                  G_CALLBACK (attribute_pipeline_depth_changed_callback),
+                                  NULL);
+
+        attribute_pipeline_depth_changed_callback_installed = TRUE;
+
+        /* Peek for the first time */
+        attribute_pipeline_depth_changed_callback (NULL);
+    }
+
+    return attribute_pipeline_depth;
+}
+
+static gboolean
+attribute_pipeline_is_full (GList *in_progress)
+{
+    return g_list_length (in_progress) >= get_attribute_pipeline_depth ();
+}
+
+static void
+directory_count_cancel_state (NautilusDirectory   *directory,
+                              DirectoryCountState *state)
+{
+    g_cancellable_cancel (state->cancellable);
+    directory->details->count_in_progress =
+        g_list_remove (directory->details->count_in_progress, state);
+}
+
 static void
 directory_count_cancel (NautilusDirectory *directory)
 {
-    if (directory->details->count_in_progress != NULL)
+    while (directory->details->count_in_progress != NULL)
     {
-        g_cancellable_cancel (directory->details->count_in_progress->cancellable);
-        directory->details->count_in_progress = NULL;
+        directory_count_cancel_state (directory,
+                                      directory->details->count_in_progress->data);
     }
 }
 
@@ -525,7 +1032,9 @@ deep_count_cancel (NautilusDirectory *directory)
 
         directory->details->deep_count_file->details->deep_counts_status = NAUTILUS_REQUEST_NOT_STARTED;
 
+        g_source_remove (directory->details->deep_count_in_progress->progress_timeout_id);
         directory->details->deep_count_in_progress->directory = NULL;
+        deep_count_state_unref (directory->details->deep_count_in_progress);
         directory->details->deep_count_in_progress = NULL;
         directory->details->deep_count_file = NULL;
 
@@ -533,12 +1042,22 @@ deep_count_cancel (NautilusDirectory *directory)
     }
 }
 
+static void
+mime_list_cancel_state (NautilusDirectory *directory,
+                        MimeListState     *state)
+{
+    g_cancellable_cancel (state->cancellable);
+    directory->details->mime_list_in_progress =
+        g_list_remove (directory->details->mime_list_in_progress, state);
+}
+
 static void
 mime_list_cancel (NautilusDirectory *directory)
 {
-    if (directory->details->mime_list_in_progress != NULL)
+    while (directory->details->mime_list_in_progress != NULL)
     {
-        g_cancellable_cancel (directory->details->mime_list_in_progress->cancellable);
+        mime_list_cancel_state (directory,
+                                directory->details->mime_list_in_progress->data);
     }
 }
 
@@ -554,15 +1073,24 @@ link_info_cancel (NautilusDirectory *directory)
     }
 }
 
+static void
+thumbnail_cancel_state (NautilusDirectory *directory,
+                        ThumbnailState    *state)
+{
+    g_cancellable_cancel (state->cancellable);
+    state->directory = NULL;
+    directory->details->thumbnail_in_progress =
+        g_list_remove (directory->details->thumbnail_in_progress, state);
+    async_job_end (directory, "thumbnail");
+}
+
 static void
 thumbnail_cancel (NautilusDirectory *directory)
 {
-    if (directory->details->thumbnail_state != NULL)
+    while (directory->details->thumbnail_in_progress != NULL)
     {
-        g_cancellable_cancel (directory->details->thumbnail_state->cancellable);
-        directory->details->thumbnail_state->directory = NULL;
-        directory->details->thumbnail_state = NULL;
-        async_job_end (directory, "thumbnail");
+        thumbnail_cancel_state (directory,
+                                directory->details->thumbnail_in_progress->data);
     }
 }
 
@@ -578,18 +1106,103 @@ mount_cancel (NautilusDirectory *directory)
     }
 }
 
+static void
+file_info_cancel_state (NautilusDirectory *directory,
+                        GetInfoState      *state)
+{
+    g_cancellable_cancel (state->cancellable);
+    state->directory = NULL;
+    state->file = NULL;
+    directory->details->get_info_in_progress =
+        g_list_remove (directory->details->get_info_in_progress, state);
+
+    async_job_end (directory, "file info");
+}
+
 static void
 file_info_cancel (NautilusDirectory *directory)
 {
-    if (directory->details->get_info_in_progress != NULL)
+    while (directory->details->get_info_in_progress != NULL)
+    {
+        file_info_cancel_state (directory,
+                                directory->details->get_info_in_progress->data);
+    }
+}
+
+static DirectoryCountState *
+find_count_state_for_file (NautilusDirectory *directory,
+                           NautilusFile      *file)
+{
+    GList *node;
+    DirectoryCountState *state;
+
+    for (node = directory->details->count_in_progress; node != NULL; node = node->next)
+    {
+        state = node->data;
+        if (state->count_file == file)
+        {
+            return state;
+        }
+    }
+
+    return NULL;
+}
+
+static MimeListState *
+find_mime_list_state_for_file (NautilusDirectory *directory,
+                               NautilusFile      *file)
+{
+    GList *node;
+    MimeListState *state;
+
+    for (node = directory->details->mime_list_in_progress; node != NULL; node = node->next)
+    {
+        state = node->data;
+        if (state->mime_list_file == file)
+        {
+            return state;
+        }
+    }
+
+    return NULL;
+}
+
+static GetInfoState *
+find_file_info_state_for_file (NautilusDirectory *directory,
+                               NautilusFile      *file)
+{
+    GList *node;
+    GetInfoState *state;
+
+    for (node = directory->details->get_info_in_progress; node != NULL; node = node->next)
     {
-        g_cancellable_cancel (directory->details->get_info_in_progress->cancellable);
-        directory->details->get_info_in_progress->directory = NULL;
-        directory->details->get_info_in_progress = NULL;
-        directory->details->get_info_file = NULL;
+        state = node->data;
+        if (state->file == file)
+        {
+            return state;
+        }
+    }
+
+    return NULL;
+}
 
-        async_job_end (directory, "file info");
+static ThumbnailState *
+find_thumbnail_state_for_file (NautilusDirectory *directory,
+                               NautilusFile      *file)
+{
+    GList *node;
+    ThumbnailState *state;
+
+    for (node = directory->details->thumbnail_in_progress; node != NULL; node = node->next)
+    {
+        state = node->data;
+        if (state->file == file)
+        {
+            return state;
+        }
     }
+
+    return NULL;
 }
 
 static void
@@ -826,49 +1439,23 @@ nautilus_directory_monitor_add_internal (NautilusDirectory         *directory,
     {
         directory->details->mime_db_monitor =
             g_signal_connect_object (nautilus_signaller_get_current (),
-                                     "mime-data-changed",
-                                     G_CALLBACK (mime_db_changed_callback), directory, 0);
-    }
-
-    /* Put the monitor file or all the files on the work queue. */
-    if (file != NULL)
-    {
-        nautilus_directory_add_file_to_work_queue (directory, file);
-    }
-    else
-    {
-        add_all_files_to_work_queue (directory);
-    }
-
-    /* Kick off I/O. */
-    nautilus_directory_async_state_changed (directory);
-    nautilus_profile_end (NULL);
-}
-
-static void
-set_file_unconfirmed (NautilusFile *file,
-                      gboolean      unconfirmed)
-{
-    NautilusDirectory *directory;
-
-    g_assert (NAUTILUS_IS_FILE (file));
-    g_assert (unconfirmed == FALSE || unconfirmed == TRUE);
-
-    if (file->details->unconfirmed == unconfirmed)
-    {
-        return;
+                                     "mime-data-changed",
+                                     G_CALLBACK (mime_db_changed_callback), directory, 0);
     }
-    file->details->unconfirmed = unconfirmed;
 
-    directory = file->details->directory;
-    if (unconfirmed)
+    /* Put the monitor file or all the files on the work queue. */
+    if (file != NULL)
     {
-        directory->details->confirmed_file_count--;
+        nautilus_directory_add_file_to_work_queue (directory, file);
     }
     else
     {
-        directory->details->confirmed_file_count++;
+        add_all_files_to_work_queue (directory);
     }
+
+    /* Kick off I/O. */
+    nautilus_directory_async_state_changed (directory);
+    nautilus_profile_end (NULL);
 }
 
 static gboolean show_hidden_files = TRUE;
@@ -880,8 +1467,7 @@ show_hidden_files_changed_callback (gpointer callback_data)
 }
 
 static gboolean
-should_skip_file (NautilusDirectory *directory,
-                  GFileInfo         *info)
+get_show_hidden_files (void)
 {
     static gboolean show_hidden_files_changed_callback_installed = FALSE;
 
@@ -899,7 +1485,15 @@ should_skip_file (NautilusDirectory *directory,
         show_hidden_files_changed_callback (NULL);
     }
 
-    if (!show_hidden_files &&
+    return show_hidden_files;
+}
+
+/* Safe to call from the loader thread. */
+static gboolean
+should_skip_file_info (GFileInfo *info,
+                       gboolean   show_hidden)
+{
+    if (!show_hidden &&
         (g_file_info_get_is_hidden (info) ||
          g_file_info_get_is_backup (info)))
     {
@@ -909,17 +1503,43 @@ should_skip_file (NautilusDirectory *directory,
     return FALSE;
 }
 
+static gboolean
+should_skip_file (NautilusDirectory *directory,
+                  GFileInfo         *info)
+{
+    return should_skip_file_info (info, get_show_hidden_files ());
+}
+
+static GList *
+directory_load_take_batch (DirectoryLoadState *state)
+{
+    GList *batch;
+
+    g_mutex_lock (&state->mutex);
+    batch = g_queue_pop_head (&state->batches);
+    if (batch != NULL)
+    {
+        g_cond_signal (&state->batch_taken);
+    }
+    g_mutex_unlock (&state->mutex);
+
+    return batch;
+}
+
 static gboolean
 dequeue_pending_idle_callback (gpointer callback_data)
 {
     NautilusDirectory *directory;
     GList *pending_file_info;
-    GList *node, *next;
+    GList *node, *gone_files;
     NautilusFile *file;
     GList *changed_files, *added_files;
+    guint i;
     GFileInfo *file_info;
     const char *mimetype, *name;
     DirectoryLoadState *dir_load_state;
+    gint64 deadline;
+    gboolean more_pending, cached;
 
     directory = NAUTILUS_DIRECTORY (callback_data);
 
@@ -945,10 +1565,34 @@ dequeue_pending_idle_callback (gpointer callback_data)
 
     dir_load_state = directory->details->directory_load_in_progress;
 
-    /* Build a list of NautilusFile objects. */
-    for (node = pending_file_info; node != NULL; node = node->next)
+    /* Build a list of NautilusFile objects. Only spend a slice of
+     * time on it, so big directories don't block the main loop; the
+     * rest is picked up in the next idle.
+     */
+    deadline = g_get_monotonic_time () + DEQUEUE_PENDING_TIME_SLICE;
+    more_pending = FALSE;
+    while (TRUE)
     {
+        if (pending_file_info == NULL && dir_load_state != NULL)
+        {
+            pending_file_info = directory_load_take_batch (dir_load_state);
+        }
+
+        if (pending_file_info == NULL)
+        {
+            break;
+        }
+
+        if (g_get_monotonic_time () > deadline)
+        {
+            more_pending = TRUE;
+            break;
+        }
+
+        node = pending_file_info;
+        pending_file_info = g_list_remove_link (pending_file_info, node);
         file_info = node->data;
+        g_list_free_1 (node);
 
         name = g_file_info_get_name (file_info);
 
@@ -960,6 +1604,7 @@ dequeue_pending_idle_callback (gpointer callback_data)
          * waiting for the idle function.
          */
         if (dir_load_state &&
+            g_object_get_data (G_OBJECT (file_info), DIRECTORY_LOAD_COUNTED_KEY) == NULL &&
             !should_skip_file (directory, file_info))
         {
             dir_load_state->load_file_count += 1;
@@ -973,13 +1618,30 @@ dequeue_pending_idle_callback (gpointer callback_data)
             }
         }
 
+        /* Only the enumeration itself can confirm that a file is
+         * still there, the listing cache may be out of date.
+         */
+        cached = g_object_get_data (G_OBJECT (file_info), DIRECTORY_LOAD_CACHED_KEY) != NULL;
+        if (cached && dir_load_state != NULL && dir_load_state->failed)
+        {
+            g_object_unref (file_info);
+            continue;
+        }
+
         /* check if the file already exists */
         file = nautilus_directory_find_file_by_name (directory, name);
         if (file != NULL)
         {
             /* file already exists in dir, check if we still need to
              *  emit file_added or if it changed */
-            set_file_unconfirmed (file, FALSE);
+            if (!cached)
+            {
+                nautilus_directory_set_file_unconfirmed (directory, file, FALSE);
+                if (dir_load_state != NULL)
+                {
+                    g_hash_table_remove (dir_load_state->cached_files, file);
+                }
+            }
             if (!file->details->is_added)
             {
                 /* We consider this newly added even if its in the list.
@@ -990,7 +1652,7 @@ dequeue_pending_idle_callback (gpointer callback_data)
                 file->details->is_added = TRUE;
                 added_files = g_list_prepend (added_files, file);
             }
-            else if (nautilus_file_update_info (file, file_info))
+            else if (!cached && nautilus_file_update_info (file, file_info))
             {
                 /* File changed, notify about the change. */
                 nautilus_file_ref (file);
@@ -1002,30 +1664,55 @@ dequeue_pending_idle_callback (gpointer callback_data)
             /* new file, create a nautilus file object and add it to the list */
             file = nautilus_file_new_from_info (directory, file_info);
             nautilus_directory_add_file (directory, file);
+            if (cached)
+            {
+                nautilus_directory_set_file_unconfirmed (directory, file, TRUE);
+                if (dir_load_state != NULL)
+                {
+                    g_hash_table_add (dir_load_state->cached_files, nautilus_file_ref (file));
+                }
+            }
             file->details->is_added = TRUE;
             added_files = g_list_prepend (added_files, file);
         }
+
+        g_object_unref (file_info);
+    }
+
+    if (more_pending)
+    {
+        /* Put the rest back in front of anything that came in
+         * meanwhile, and continue in the next idle.
+         */
+        directory->details->pending_file_info
+            = g_list_concat (directory->details->pending_file_info,
+                             g_list_reverse (pending_file_info));
+        pending_file_info = NULL;
+        nautilus_directory_schedule_dequeue_pending (directory);
     }
 
     /* If we are done loading, then we assume that any unconfirmed
      * files are gone.
      */
-    if (directory->details->directory_loaded)
+    if (directory->details->directory_loaded && !more_pending &&
+        nautilus_directory_has_unconfirmed_files (directory))
     {
-        for (node = directory->details->file_list;
-             node != NULL; node = next)
+        gone_files = NULL;
+        for (i = 0; i < directory->details->files->len; i++)
         {
-            file = NAUTILUS_FILE (node->data);
-            next = node->next;
-
-            if (file->details->unconfirmed)
+            file = g_ptr_array_index (directory->details->files, i);
+            if (nautilus_directory_is_file_unconfirmed (directory, file))
             {
-                nautilus_file_ref (file);
-                changed_files = g_list_prepend (changed_files, file);
-
-                nautilus_file_mark_gone (file);
+                gone_files = g_list_prepend (gone_files, nautilus_file_ref (file));
             }
         }
+
+        /* Marking a file gone takes it out of the table. */
+        for (node = gone_files; node != NULL; node = node->next)
+        {
+            nautilus_file_mark_gone (NAUTILUS_FILE (node->data));
+        }
+        changed_files = g_list_concat (gone_files, changed_files);
     }
 
     /* Send the changed and added signals. */
@@ -1035,11 +1722,17 @@ dequeue_pending_idle_callback (gpointer callback_data)
     nautilus_file_list_free (added_files);
 
     if (directory->details->directory_loaded &&
-        !directory->details->directory_loaded_sent_notification)
+        !directory->details->directory_loaded_sent_notification &&
+        !more_pending)
     {
-        /* Send the done_loading signal. */
+        /* Set before sending the done_loading signal, so its handlers
+         * see all the files as seen.
+         */
+        directory->details->directory_loaded_sent_notification = TRUE;
         nautilus_directory_emit_done_loading (directory);
 
+        /* The load may have been cancelled by a signal handler. */
+        dir_load_state = directory->details->directory_load_in_progress;
         if (dir_load_state)
         {
             file = dir_load_state->load_directory_file;
@@ -1055,11 +1748,11 @@ dequeue_pending_idle_callback (gpointer callback_data)
                                            (dir_load_state->load_mime_list_hash);
 
             nautilus_file_changed (file);
+
+            directory_load_cancel (directory);
         }
 
         nautilus_directory_async_state_changed (directory);
-
-        directory->details->directory_loaded_sent_notification = TRUE;
     }
 
 drain:
@@ -1130,6 +1823,7 @@ directory_load_cancel (NautilusDirectory *directory)
         g_cancellable_cancel (state->cancellable);
         state->directory = NULL;
         directory->details->directory_load_in_progress = NULL;
+        directory_load_state_unref (state);
         async_job_end (directory, "file list");
     }
 }
@@ -1156,7 +1850,9 @@ static void
 directory_load_done (NautilusDirectory *directory,
                      GError            *error)
 {
-    GList *node;
+    DirectoryLoadState *state;
+    NautilusFile *file;
+    guint i;
 
     nautilus_profile_start (NULL);
     g_object_ref (directory);
@@ -1171,24 +1867,33 @@ directory_load_done (NautilusDirectory *directory,
          * We clear the unconfirmed bit on each file here so that
          * they won't be marked "gone" later -- we don't know enough
          * about them to know whether they are really gone.
+         *
+         * That doesn't go for the files only the listing cache knew
+         * about, which may be long gone. They stay unconfirmed, so they
+         * are marked gone once the pending files are handed out, and
+         * the rest of the cached listing is dropped.
          */
-        for (node = directory->details->file_list;
-             node != NULL; node = node->next)
+        state = directory->details->directory_load_in_progress;
+        if (state != NULL)
+        {
+            state->failed = TRUE;
+        }
+        for (i = 0; i < directory->details->files->len; i++)
         {
-            set_file_unconfirmed (NAUTILUS_FILE (node->data), FALSE);
+            file = g_ptr_array_index (directory->details->files, i);
+            if (state == NULL || !g_hash_table_contains (state->cached_files, file))
+            {
+                nautilus_directory_set_file_unconfirmed (directory, file, FALSE);
+            }
         }
 
         nautilus_directory_emit_load_error (directory, error);
     }
 
-    /* Call the idle function right away. */
-    if (directory->details->dequeue_pending_idle_id != 0)
-    {
-        g_source_remove (directory->details->dequeue_pending_idle_id);
-    }
-    dequeue_pending_idle_callback (directory);
-
-    directory_load_cancel (directory);
+    /* The idle function sends done_loading and ends the load once it
+     * has gone through all the files read so far.
+     */
+    nautilus_directory_schedule_dequeue_pending (directory);
 
     g_object_unref (directory);
     nautilus_profile_end (NULL);
@@ -1652,6 +2357,10 @@ nautilus_async_destroying_file (NautilusFile *file)
     GList *node, *next;
     ReadyCallback *callback;
     Monitor *monitor;
+    DirectoryCountState *count_state;
+    MimeListState *mime_list_state;
+    GetInfoState *get_info_state;
+    ThumbnailState *thumbnail_state;
 
     directory = file->details->directory;
     changed = FALSE;
@@ -1692,10 +2401,10 @@ nautilus_async_destroying_file (NautilusFile *file)
     /* Check if it's a file that's currently being worked on.
      * If so, make that NULL so it gets canceled right away.
      */
-    if (directory->details->count_in_progress != NULL &&
-        directory->details->count_in_progress->count_file == file)
+    count_state = find_count_state_for_file (directory, file);
+    if (count_state != NULL)
     {
-        directory->details->count_in_progress->count_file = NULL;
+        count_state->count_file = NULL;
         changed = TRUE;
     }
     if (directory->details->deep_count_file == file)
@@ -1703,15 +2412,16 @@ nautilus_async_destroying_file (NautilusFile *file)
         directory->details->deep_count_file = NULL;
         changed = TRUE;
     }
-    if (directory->details->mime_list_in_progress != NULL &&
-        directory->details->mime_list_in_progress->mime_list_file == file)
+    mime_list_state = find_mime_list_state_for_file (directory, file);
+    if (mime_list_state != NULL)
     {
-        directory->details->mime_list_in_progress->mime_list_file = NULL;
+        mime_list_state->mime_list_file = NULL;
         changed = TRUE;
     }
-    if (directory->details->get_info_file == file)
+    get_info_state = find_file_info_state_for_file (directory, file);
+    if (get_info_state != NULL)
     {
-        directory->details->get_info_file = NULL;
+        get_info_state->file = NULL;
         changed = TRUE;
     }
     if (directory->details->link_info_read_state != NULL &&
@@ -1726,10 +2436,10 @@ nautilus_async_destroying_file (NautilusFile *file)
         changed = TRUE;
     }
 
-    if (directory->details->thumbnail_state != NULL &&
-        directory->details->thumbnail_state->file == file)
+    thumbnail_state = find_thumbnail_state_for_file (directory, file);
+    if (thumbnail_state != NULL)
     {
-        directory->details->thumbnail_state->file = NULL;
+        thumbnail_state->file = NULL;
         changed = TRUE;
     }
 
@@ -1860,16 +2570,16 @@ has_problem (NautilusDirectory *directory,
              NautilusFile      *file,
              FileCheck          problem)
 {
-    GList *node;
+    guint i;
 
     if (file != NULL)
     {
         return (*problem)(file);
     }
 
-    for (node = directory->details->file_list; node != NULL; node = node->next)
+    for (i = 0; i < directory->details->files->len; i++)
     {
-        if ((*problem)(node->data))
+        if ((*problem)(g_ptr_array_index (directory->details->files, i)))
         {
             return TRUE;
         }
@@ -2106,141 +2816,350 @@ nautilus_directory_is_file_list_monitored (NautilusDirectory *directory)
     return directory->details->file_list_monitored;
 }
 
-static void
-mark_all_files_unconfirmed (NautilusDirectory *directory)
+static DirectoryLoadState *
+directory_load_state_ref (DirectoryLoadState *state)
 {
-    GList *node;
-    NautilusFile *file;
-
-    for (node = directory->details->file_list; node != NULL; node = node->next)
-    {
-        file = node->data;
-        set_file_unconfirmed (file, TRUE);
-    }
+    g_atomic_int_inc (&state->ref_count);
+    return state;
 }
 
+/* The last reference is always dropped on the main thread, which
+ * takes care of the NautilusFile.
+ */
 static void
-directory_load_state_free (DirectoryLoadState *state)
+directory_load_state_unref (DirectoryLoadState *state)
 {
-    if (state->enumerator)
+    if (!g_atomic_int_dec_and_test (&state->ref_count))
     {
-        if (!g_file_enumerator_is_closed (state->enumerator))
-        {
-            g_file_enumerator_close_async (state->enumerator,
-                                           0, NULL, NULL, NULL);
-        }
-        g_object_unref (state->enumerator);
+        return;
+    }
+
+    while (!g_queue_is_empty (&state->batches))
+    {
+        g_list_free_full (g_queue_pop_head (&state->batches), g_object_unref);
     }
+    g_mutex_clear (&state->mutex);
+    g_cond_clear (&state->batch_taken);
 
     if (state->load_mime_list_hash != NULL)
     {
         istr_set_destroy (state->load_mime_list_hash);
     }
+    if (state->thread_mime_list_hash != NULL)
+    {
+        istr_set_destroy (state->thread_mime_list_hash);
+    }
+    g_hash_table_destroy (state->cached_files);
     nautilus_file_unref (state->load_directory_file);
+    g_object_unref (state->location);
     g_object_unref (state->cancellable);
     g_free (state);
 }
 
-static void
-more_files_callback (GObject      *source_object,
-                     GAsyncResult *res,
-                     gpointer      user_data)
+static gboolean
+directory_load_batches_ready (gpointer user_data)
 {
     DirectoryLoadState *state;
-    NautilusDirectory *directory;
-    GError *error;
-    GList *files, *l;
-    GFileInfo *info;
 
     state = user_data;
 
-    if (state->directory == NULL)
+    g_mutex_lock (&state->mutex);
+    state->batches_ready_scheduled = FALSE;
+    g_mutex_unlock (&state->mutex);
+
+    if (state->directory != NULL)
     {
-        /* Operation was cancelled. Bail out */
-        directory_load_state_free (state);
-        return;
+        nautilus_directory_schedule_dequeue_pending (state->directory);
     }
 
-    directory = nautilus_directory_ref (state->directory);
+    return FALSE;
+}
 
-    g_assert (directory->details->directory_load_in_progress != NULL);
-    g_assert (directory->details->directory_load_in_progress == state);
+/* Called in the loader thread. Hands a batch to the main loop,
+ * waiting first if the main loop is too far behind.
+ */
+static void
+directory_load_push_batch (DirectoryLoadState *state,
+                           GList              *batch)
+{
+    g_mutex_lock (&state->mutex);
 
-    error = NULL;
-    files = g_file_enumerator_next_files_finish (state->enumerator,
-                                                 res, &error);
+    while (g_queue_get_length (&state->batches) >= DIRECTORY_LOAD_MAX_PENDING_BATCHES &&
+           !g_cancellable_is_cancelled (state->cancellable))
+    {
+        /* Wake up now and then to notice cancellation. */
+        g_cond_wait_until (&state->batch_taken, &state->mutex,
+                           g_get_monotonic_time () + 100 * G_TIME_SPAN_MILLISECOND);
+    }
 
-    for (l = files; l != NULL; l = l->next)
+    g_queue_push_tail (&state->batches, batch);
+
+    if (!state->batches_ready_scheduled)
     {
-        info = l->data;
-        directory_load_one (directory, info);
-        g_object_unref (info);
+        state->batches_ready_scheduled = TRUE;
+        g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
+                         directory_load_batches_ready,
+                         directory_load_state_ref (state),
+                         (GDestroyNotify) directory_load_state_unref);
     }
 
-    if (files == NULL)
+    g_mutex_unlock (&state->mutex);
+}
+
+/* Called in the loader thread. Does the per-file work that doesn't
+ * need the directory, so the main loop has less to do.
+ */
+static void
+directory_load_prepare_info (DirectoryLoadState *state,
+                             GFileInfo          *info)
+{
+    const char *display_name, *mimetype;
+
+    display_name = g_file_info_get_display_name (info);
+    if (display_name != NULL)
     {
-        directory_load_done (directory, error);
-        directory_load_state_free (state);
+        g_object_set_data_full (G_OBJECT (info),
+                                NAUTILUS_FILE_INFO_COLLATION_KEY,
+                                g_utf8_collate_key_for_filename (display_name, -1),
+                                g_free);
     }
-    else
+
+    g_object_set_data (G_OBJECT (info), DIRECTORY_LOAD_COUNTED_KEY, GINT_TO_POINTER (TRUE));
+    if (should_skip_file_info (info, state->show_hidden_files))
     {
-        g_file_enumerator_next_files_async (state->enumerator,
-                                            DIRECTORY_LOAD_ITEMS_PER_CALLBACK,
-                                            G_PRIORITY_DEFAULT,
-                                            state->cancellable,
-                                            more_files_callback,
-                                            state);
+        return;
     }
 
-    nautilus_directory_unref (directory);
+    state->thread_file_count += 1;
 
-    if (error)
+    mimetype = g_file_info_get_content_type (info);
+    if (mimetype != NULL &&
+        !g_hash_table_contains (state->thread_mime_list_hash, mimetype))
     {
-        g_error_free (error);
+        istr_set_insert (state->thread_mime_list_hash, mimetype);
     }
+}
 
-    g_list_free (files);
+/* Called in the loader thread. Hands the cached listing of the
+ * directory, if there is a good one, to the main loop, and returns
+ * the info the new listing should be cached with.
+ */
+static GFileInfo *
+directory_load_push_cached_listing (DirectoryLoadState *state,
+                                    GCancellable       *cancellable)
+{
+    GFileInfo *directory_info;
+    GList *cached, *l;
+
+    directory_info = g_file_query_info (state->location,
+                                        NAUTILUS_DIRECTORY_LISTING_CACHE_ATTRIBUTES,
+                                        0,     /* flags */
+                                        cancellable,
+                                        NULL);
+    if (directory_info == NULL)
+    {
+        return NULL;
+    }
+
+    cached = nautilus_directory_listing_cache_load (state->location, directory_info);
+    for (l = cached; l != NULL; l = l->next)
+    {
+        /* The files are counted when the enumeration gets to them. */
+        g_object_set_data (l->data, DIRECTORY_LOAD_CACHED_KEY, GINT_TO_POINTER (TRUE));
+        g_object_set_data (l->data, DIRECTORY_LOAD_COUNTED_KEY, GINT_TO_POINTER (TRUE));
+    }
+
+    if (cached != NULL)
+    {
+        directory_load_push_batch (state, cached);
+    }
+
+    return directory_info;
+}
+
+/* Called in the loader thread. A listing that could not be read
+ * can't tell whether the cached one is still good.
+ */
+static void
+directory_load_forget_cached_listing (DirectoryLoadState *state,
+                                      GError             *error)
+{
+    if (state->use_listing_cache &&
+        !g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    {
+        nautilus_directory_listing_cache_remove (state->location);
+    }
 }
 
 static void
-enumerate_children_callback (GObject      *source_object,
-                             GAsyncResult *res,
-                             gpointer      user_data)
+directory_load_thread (GTask        *task,
+                       gpointer      source_object,
+                       gpointer      task_data,
+                       GCancellable *cancellable)
 {
     DirectoryLoadState *state;
     GFileEnumerator *enumerator;
+    GFileInfo *info;
+    GFileInfo *directory_info;
+    NautilusDirectoryListingCacheBuilder *cache_builder;
+    GList *batch;
+    guint batch_size, batch_length;
+    gint64 batch_start;
+    gboolean done;
+    GError *error;
+
+    state = task_data;
+
+    directory_info = NULL;
+    cache_builder = NULL;
+    if (state->use_listing_cache)
+    {
+        directory_info = directory_load_push_cached_listing (state, cancellable);
+        if (directory_info != NULL)
+        {
+            cache_builder = nautilus_directory_listing_cache_builder_new ();
+        }
+    }
+
+    error = NULL;
+    enumerator = g_file_enumerate_children (state->location,
+                                            NAUTILUS_FILE_DEFAULT_ATTRIBUTES,
+                                            0,     /* flags */
+                                            cancellable,
+                                            &error);
+    if (enumerator == NULL)
+    {
+        g_clear_object (&directory_info);
+        if (cache_builder != NULL)
+        {
+            nautilus_directory_listing_cache_builder_free (cache_builder);
+        }
+        directory_load_forget_cached_listing (state, error);
+        g_task_return_error (task, error);
+        return;
+    }
+
+    batch_size = DIRECTORY_LOAD_ITEMS_PER_CALLBACK;
+    done = FALSE;
+    while (!done)
+    {
+        batch = NULL;
+        batch_length = 0;
+        batch_start = g_get_monotonic_time ();
+
+        while (batch_length < batch_size)
+        {
+            info = g_file_enumerator_next_file (enumerator, cancellable, &error);
+            if (info == NULL)
+            {
+                done = TRUE;
+                break;
+            }
+
+            if (g_file_info_get_name (info) == NULL)
+            {
+                char *uri;
+
+                uri = g_file_get_uri (state->location);
+                g_warning ("Got GFileInfo with NULL name in %s, ignoring. This shouldn't happen unless the gvfs backend is broken.\n", uri);
+                g_free (uri);
+
+                g_object_unref (info);
+                continue;
+            }
+
+            directory_load_prepare_info (state, info);
+            if (cache_builder != NULL)
+            {
+                nautilus_directory_listing_cache_builder_add (cache_builder, info);
+            }
+            batch = g_list_prepend (batch, info);
+            batch_length++;
+        }
+
+        if (batch != NULL)
+        {
+            directory_load_push_batch (state, g_list_reverse (batch));
+        }
+
+        /* Fewer, bigger batches are cheaper, as long as the files
+         * keep showing up at a steady pace.
+         */
+        if (g_get_monotonic_time () - batch_start < DIRECTORY_LOAD_BATCH_INTERVAL)
+        {
+            batch_size = MIN (batch_size * 2, DIRECTORY_LOAD_MAX_ITEMS_PER_BATCH);
+        }
+    }
+
+    g_file_enumerator_close (enumerator, NULL, NULL);
+    g_object_unref (enumerator);
+
+    if (cache_builder != NULL)
+    {
+        if (error == NULL)
+        {
+            nautilus_directory_listing_cache_builder_save (cache_builder,
+                                                           state->location,
+                                                           directory_info);
+        }
+        nautilus_directory_listing_cache_builder_free (cache_builder);
+    }
+    g_clear_object (&directory_info);
+
+    if (error != NULL)
+    {
+        directory_load_forget_cached_listing (state, error);
+        g_task_return_error (task, error);
+    }
+    else
+    {
+        g_task_return_boolean (task, TRUE);
+    }
+}
+
+static void
+directory_load_thread_done (GObject      *source_object,
+                            GAsyncResult *res,
+                            gpointer      user_data)
+{
+    DirectoryLoadState *state;
+    NautilusDirectory *directory;
+    GHashTableIter iter;
+    gpointer mimetype;
     GError *error;
 
     state = user_data;
 
-    if (state->directory == NULL)
+    if (state->directory == NULL)
+    {
+        /* Operation was cancelled. Bail out */
+        directory_load_state_unref (state);
+        return;
+    }
+
+    directory = nautilus_directory_ref (state->directory);
+
+    g_assert (directory->details->directory_load_in_progress == state);
+
+    /* The thread is done with its counts, merge them in. */
+    state->load_file_count += state->thread_file_count;
+    g_hash_table_iter_init (&iter, state->thread_mime_list_hash);
+    while (g_hash_table_iter_next (&iter, &mimetype, NULL))
     {
-        /* Operation was cancelled. Bail out */
-        directory_load_state_free (state);
-        return;
+        istr_set_insert (state->load_mime_list_hash, mimetype);
     }
 
     error = NULL;
-    enumerator = g_file_enumerate_children_finish (G_FILE (source_object),
-                                                   res, &error);
+    g_task_propagate_boolean (G_TASK (res), &error);
+    directory_load_done (directory, error);
 
-    if (enumerator == NULL)
+    if (error)
     {
-        directory_load_done (state->directory, error);
         g_error_free (error);
-        directory_load_state_free (state);
-        return;
-    }
-    else
-    {
-        state->enumerator = enumerator;
-        g_file_enumerator_next_files_async (state->enumerator,
-                                            DIRECTORY_LOAD_ITEMS_PER_CALLBACK,
-                                            G_PRIORITY_DEFAULT,
-                                            state->cancellable,
-                                            more_files_callback,
-                                            state);
     }
+
+    nautilus_directory_unref (directory);
+    directory_load_state_unref (state);
 }
 
 
@@ -2249,12 +3168,16 @@ static void
 start_monitoring_file_list (NautilusDirectory *directory)
 {
     DirectoryLoadState *state;
+    GTask *task;
+    GList *files;
 
     if (!directory->details->file_list_monitored)
     {
         g_assert (!directory->details->directory_load_in_progress);
         directory->details->file_list_monitored = TRUE;
-        nautilus_file_list_ref (directory->details->file_list);
+        files = nautilus_directory_list_files (directory);
+        nautilus_file_list_ref (files);
+        g_list_free (files);
     }
 
     if (directory->details->directory_loaded ||
@@ -2268,13 +3191,26 @@ start_monitoring_file_list (NautilusDirectory *directory)
         return;
     }
 
-    mark_all_files_unconfirmed (directory);
+    nautilus_directory_mark_all_files_unconfirmed (directory);
 
     state = g_new0 (DirectoryLoadState, 1);
+    state->ref_count = 1;
     state->directory = directory;
     state->cancellable = g_cancellable_new ();
     state->load_mime_list_hash = istr_set_new ();
     state->load_file_count = 0;
+    state->cached_files = g_hash_table_new_full (NULL, NULL,
+                                                 (GDestroyNotify) nautilus_file_unref,
+                                                 NULL);
+    g_mutex_init (&state->mutex);
+    g_cond_init (&state->batch_taken);
+    g_queue_init (&state->batches);
+    state->show_hidden_files = get_show_hidden_files ();
+    state->use_listing_cache = g_file_is_native (directory->details->location) &&
+                               g_settings_get_boolean (nautilus_preferences,
+                                                       NAUTILUS_PREFERENCES_DIRECTORY_LISTING_CACHE);
+    state->thread_mime_list_hash = istr_set_new ();
+    state->thread_file_count = 0;
 
     g_assert (directory->details->location != NULL);
     state->load_directory_file =
@@ -2286,19 +3222,27 @@ start_monitoring_file_list (NautilusDirectory *directory)
 
     directory->details->directory_load_in_progress = state;
 
-    g_file_enumerate_children_async (directory->details->location,
-                                     NAUTILUS_FILE_DEFAULT_ATTRIBUTES,
-                                     0,     /* flags */
-                                     G_PRIORITY_DEFAULT,     /* prio */
-                                     state->cancellable,
-                                     enumerate_children_callback,
-                                     state);
+    /* Read the directory in a thread, so the main loop only has to
+     * turn the file infos into files. The callback always runs, on
+     * the main thread and after the thread is done, so its reference
+     * keeps the state alive for the thread too. The task may be
+     * finalized in the thread, so it doesn't hold a reference itself.
+     */
+    state->location = g_object_ref (directory->details->location);
+    task = g_task_new (NULL, state->cancellable,
+                       directory_load_thread_done,
+                       directory_load_state_ref (state));
+    g_task_set_task_data (task, state, NULL);
+    g_task_run_in_thread (task, directory_load_thread);
+    g_object_unref (task);
 }
 
 /* Stop monitoring the file list if it is being monitored. */
 void
 nautilus_directory_stop_monitoring_file_list (NautilusDirectory *directory)
 {
+    GList *files;
+
     if (!directory->details->file_list_monitored)
     {
         g_assert (directory->details->directory_load_in_progress == NULL);
@@ -2307,7 +3251,12 @@ nautilus_directory_stop_monitoring_file_list (NautilusDirectory *directory)
 
     directory->details->file_list_monitored = FALSE;
     file_list_cancel (directory);
-    nautilus_file_list_unref (directory->details->file_list);
+    /* Unreffing can finalize files, which takes them out of the
+     * table, so go through a copy.
+     */
+    files = nautilus_directory_list_files (directory);
+    nautilus_file_list_unref (files);
+    g_list_free (files);
     directory->details->directory_loaded = FALSE;
 }
 
@@ -2360,13 +3309,13 @@ static void
 nautilus_directory_invalidate_file_attributes (NautilusDirectory      *directory,
                                                NautilusFileAttributes  file_attributes)
 {
-    GList *node;
+    guint i;
 
     cancel_loading_attributes (directory, file_attributes);
 
-    for (node = directory->details->file_list; node != NULL; node = node->next)
+    for (i = 0; i < directory->details->files->len; i++)
     {
-        nautilus_file_invalidate_attributes_internal (NAUTILUS_FILE (node->data),
+        nautilus_file_invalidate_attributes_internal (g_ptr_array_index (directory->details->files, i),
                                                       file_attributes);
     }
 
@@ -2479,11 +3428,16 @@ is_needy (NautilusFile *file,
 static void
 directory_count_stop (NautilusDirectory *directory)
 {
+    GList *node, *next;
+    DirectoryCountState *state;
     NautilusFile *file;
 
-    if (directory->details->count_in_progress != NULL)
+    for (node = directory->details->count_in_progress; node != NULL; node = next)
     {
-        file = directory->details->count_in_progress->count_file;
+        next = node->next;
+        state = node->data;
+
+        file = state->count_file;
         if (file != NULL)
         {
             g_assert (NAUTILUS_IS_FILE (file));
@@ -2492,12 +3446,12 @@ directory_count_stop (NautilusDirectory *directory)
                           should_get_directory_count_now,
                           REQUEST_DIRECTORY_COUNT))
             {
-                return;
+                continue;
             }
         }
 
         /* The count is not wanted, so stop it. */
-        directory_count_cancel (directory);
+        directory_count_cancel_state (directory, state);
     }
 }
 
@@ -2521,10 +3475,11 @@ count_non_skipped_files (GList *list)
 }
 
 static void
-count_children_done (NautilusDirectory *directory,
-                     NautilusFile      *count_file,
-                     gboolean           succeeded,
-                     int                count)
+count_children_done (NautilusDirectory   *directory,
+                     DirectoryCountState *state,
+                     NautilusFile        *count_file,
+                     gboolean             succeeded,
+                     int                  count)
 {
     g_assert (NAUTILUS_IS_FILE (count_file));
 
@@ -2543,7 +3498,8 @@ count_children_done (NautilusDirectory *directory,
         count_file->details->got_directory_count = TRUE;
         count_file->details->directory_count = count;
     }
-    directory->details->count_in_progress = NULL;
+    directory->details->count_in_progress =
+        g_list_remove (directory->details->count_in_progress, state);
 
     /* Send file-changed even if count failed, so interested parties can
      * distinguish between unknowable and not-yet-known cases.
@@ -2597,8 +3553,7 @@ count_more_files_callback (GObject      *source_object,
         return;
     }
 
-    g_assert (directory->details->count_in_progress != NULL);
-    g_assert (directory->details->count_in_progress == state);
+    g_assert (g_list_find (directory->details->count_in_progress, state) != NULL);
 
     error = NULL;
     files = g_file_enumerator_next_files_finish (state->enumerator,
@@ -2608,7 +3563,7 @@ count_more_files_callback (GObject      *source_object,
 
     if (files == NULL)
     {
-        count_children_done (directory, state->count_file,
+        count_children_done (directory, state, state->count_file,
                              TRUE, state->file_count);
         directory_count_state_free (state);
     }
@@ -2662,6 +3617,7 @@ count_children_callback (GObject      *source_object,
     if (enumerator == NULL)
     {
         count_children_done (state->directory,
+                             state,
                              state->count_file,
                              FALSE, 0);
         g_error_free (error);
@@ -2688,7 +3644,7 @@ directory_count_start (NautilusDirectory *directory,
     DirectoryCountState *state;
     GFile *location;
 
-    if (directory->details->count_in_progress != NULL)
+    if (find_count_state_for_file (directory, file) != NULL)
     {
         *doing_io = TRUE;
         return;
@@ -2712,6 +3668,11 @@ directory_count_start (NautilusDirectory *directory,
         return;
     }
 
+    if (attribute_pipeline_is_full (directory->details->count_in_progress))
+    {
+        return;
+    }
+
     if (!async_job_start (directory, "directory count"))
     {
         return;
@@ -2723,7 +3684,8 @@ directory_count_start (NautilusDirectory *directory,
     state->directory = nautilus_directory_ref (directory);
     state->cancellable = g_cancellable_new ();
 
-    directory->details->count_in_progress = state;
+    directory->details->count_in_progress =
+        g_list_prepend (directory->details->count_in_progress, state);
 
     location = nautilus_file_get_location (file);
 
@@ -2745,278 +3707,576 @@ directory_count_start (NautilusDirectory *directory,
     g_object_unref (location);
 }
 
-static inline gboolean
-seen_inode (DeepCountState *state,
-            GFileInfo      *info)
+/* Results of finished deep counts, so asking again for the same tree
+ * only has to look at its directories. A result is only used while the
+ * mtimes of the directory and of all the directories below it are the
+ * same, and is dropped when anything below the directory is reported
+ * to change, see nautilus_directory_invalidate_deep_count_cache().
+ * Files changed in place don't change any of those mtimes, so their
+ * new sizes go unnoticed until the next change in their directory.
+ */
+typedef struct
+{
+    GFile *location;
+    guint64 mtime;
+} DeepCountStamp;
+
+typedef struct
+{
+    guint64 mtime;
+    guint directory_count;
+    guint file_count;
+    guint unreadable_count;
+    goffset size;
+    GArray *stamps; /* DeepCountStamp of all the directories below */
+} DeepCountSummary;
+
+G_LOCK_DEFINE_STATIC (deep_count_cache);
+static GHashTable *deep_count_cache; /* GFile -> DeepCountSummary */
+
+static void
+deep_count_stamp_clear (DeepCountStamp *stamp)
+{
+    g_object_unref (stamp->location);
+}
+
+static GArray *
+deep_count_stamps_new (void)
+{
+    GArray *stamps;
+
+    stamps = g_array_new (FALSE, FALSE, sizeof (DeepCountStamp));
+    g_array_set_clear_func (stamps, (GDestroyNotify) deep_count_stamp_clear);
+
+    return stamps;
+}
+
+static void
+deep_count_stamps_add (GArray  *stamps,
+                       GFile   *location,
+                       guint64  mtime)
+{
+    DeepCountStamp stamp;
+
+    stamp.location = g_object_ref (location);
+    stamp.mtime = mtime;
+    g_array_append_val (stamps, stamp);
+}
+
+static void
+deep_count_stamps_add_all (GArray       *stamps,
+                           const GArray *other)
 {
-    guint64 inode, inode2;
+    const DeepCountStamp *stamp;
     guint i;
 
-    inode = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_UNIX_INODE);
+    for (i = 0; i < other->len; i++)
+    {
+        stamp = &g_array_index (other, DeepCountStamp, i);
+        deep_count_stamps_add (stamps, stamp->location, stamp->mtime);
+    }
+}
+
+static void
+deep_count_summary_free (DeepCountSummary *summary)
+{
+    g_array_unref (summary->stamps);
+    g_free (summary);
+}
+
+/* Finds the result of an earlier count of location, if it was counted
+ * with the same mtime. The stamps of the summary are a new reference.
+ */
+static gboolean
+deep_count_cache_lookup (GFile            *location,
+                         guint64           mtime,
+                         DeepCountSummary *summary)
+{
+    DeepCountSummary *cached;
+    gboolean found;
+
+    found = FALSE;
 
-    if (inode != 0)
+    G_LOCK (deep_count_cache);
+    if (deep_count_cache != NULL && mtime != 0)
     {
-        for (i = 0; i < state->seen_deep_count_inodes->len; i++)
+        cached = g_hash_table_lookup (deep_count_cache, location);
+        if (cached != NULL && cached->mtime == mtime)
         {
-            inode2 = g_array_index (state->seen_deep_count_inodes, guint64, i);
-            if (inode == inode2)
-            {
-                return TRUE;
-            }
+            *summary = *cached;
+            g_array_ref (summary->stamps);
+            found = TRUE;
         }
     }
+    G_UNLOCK (deep_count_cache);
 
-    return FALSE;
+    return found;
 }
 
-static inline void
-mark_inode_as_seen (DeepCountState *state,
-                    GFileInfo      *info)
+/* Does blocking I/O. Checks that none of the directories below the
+ * counted one changed since.
+ */
+static gboolean
+deep_count_summary_is_current (const DeepCountSummary *summary,
+                               GCancellable           *cancellable)
 {
-    guint64 inode;
+    const DeepCountStamp *stamp;
+    GFileInfo *info;
+    gboolean current;
+    guint i;
 
-    inode = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_UNIX_INODE);
-    if (inode != 0)
+    current = TRUE;
+    for (i = 0; current && i < summary->stamps->len; i++)
     {
-        g_array_append_val (state->seen_deep_count_inodes, inode);
+        stamp = &g_array_index (summary->stamps, DeepCountStamp, i);
+        info = g_file_query_info (stamp->location,
+                                  G_FILE_ATTRIBUTE_TIME_MODIFIED,
+                                  G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                  cancellable,
+                                  NULL);
+        current = info != NULL &&
+                  g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED) == stamp->mtime;
+        g_clear_object (&info);
     }
+
+    return current;
 }
 
-static void
-deep_count_one (DeepCountState *state,
-                GFileInfo      *info)
+/* Finds a result of an earlier count of location that is still good.
+ * Does blocking I/O.
+ */
+static gboolean
+deep_count_cache_lookup_current (GFile            *location,
+                                 guint64           mtime,
+                                 GCancellable     *cancellable,
+                                 DeepCountSummary *summary)
 {
-    NautilusFile *file;
-    GFile *subdir;
-    gboolean is_seen_inode;
-    const char *fs_id;
-
-    if (should_skip_file (NULL, info))
+    if (!deep_count_cache_lookup (location, mtime, summary))
     {
-        return;
+        return FALSE;
     }
 
-    is_seen_inode = seen_inode (state, info);
-    if (!is_seen_inode)
+    if (!deep_count_summary_is_current (summary, cancellable))
     {
-        mark_inode_as_seen (state, info);
+        g_array_unref (summary->stamps);
+        return FALSE;
     }
 
-    file = state->directory->details->deep_count_file;
+    return TRUE;
+}
+
+static void
+deep_count_cache_insert (GFile                  *location,
+                         const DeepCountSummary *summary)
+{
+    GHashTableIter iter;
+    DeepCountSummary *copy;
 
-    if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY)
+    if (summary->mtime == 0 ||
+        summary->stamps->len > DEEP_COUNT_CACHE_MAX_DIRECTORIES)
     {
-        /* Count the directory. */
-        file->details->deep_directory_count += 1;
+        return;
+    }
 
-        /* Record the fact that we have to descend into this directory. */
-        fs_id = g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_ID_FILESYSTEM);
-        if (g_strcmp0 (fs_id, state->fs_id) == 0)
+    copy = g_memdup (summary, sizeof (DeepCountSummary));
+    g_array_ref (copy->stamps);
+
+    G_LOCK (deep_count_cache);
+    if (deep_count_cache == NULL)
+    {
+        deep_count_cache = g_hash_table_new_full (g_file_hash, (GEqualFunc) g_file_equal,
+                                                  g_object_unref,
+                                                  (GDestroyNotify) deep_count_summary_free);
+    }
+    else if (g_hash_table_size (deep_count_cache) >= DEEP_COUNT_CACHE_SIZE)
+    {
+        /* Make room, any entry will do. */
+        g_hash_table_iter_init (&iter, deep_count_cache);
+        if (g_hash_table_iter_next (&iter, NULL, NULL))
         {
-            /* only if it is on the same filesystem */
-            subdir = g_file_get_child (state->deep_count_location, g_file_info_get_name (info));
-            state->deep_count_subdirectories = g_list_prepend
-                                                   (state->deep_count_subdirectories, subdir);
+            g_hash_table_iter_remove (&iter);
         }
     }
-    else
+    g_hash_table_replace (deep_count_cache, g_object_ref (location), copy);
+    G_UNLOCK (deep_count_cache);
+}
+
+/* Something in or below location changed, so the counts of location
+ * and all the directories above it are out of date.
+ */
+void
+nautilus_directory_invalidate_deep_count_cache (GFile *location)
+{
+    GFile *directory, *parent;
+
+    G_LOCK (deep_count_cache);
+    if (deep_count_cache != NULL && g_hash_table_size (deep_count_cache) > 0)
     {
-        /* Even non-regular files count as files. */
-        file->details->deep_file_count += 1;
+        directory = g_object_ref (location);
+        while (directory != NULL)
+        {
+            g_hash_table_remove (deep_count_cache, directory);
+            parent = g_file_get_parent (directory);
+            g_object_unref (directory);
+            directory = parent;
+        }
     }
+    G_UNLOCK (deep_count_cache);
+}
+
+/* Forgets all the counts of location and of the directories above
+ * and below it, so the next count of it starts over.
+ */
+void
+nautilus_directory_forget_deep_counts (GFile *location)
+{
+    GHashTableIter iter;
+    gpointer key;
 
-    /* Count the size. */
-    if (!is_seen_inode && g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_STANDARD_SIZE))
+    nautilus_directory_invalidate_deep_count_cache (location);
+
+    G_LOCK (deep_count_cache);
+    if (deep_count_cache != NULL)
     {
-        file->details->deep_size += g_file_info_get_size (info);
+        g_hash_table_iter_init (&iter, deep_count_cache);
+        while (g_hash_table_iter_next (&iter, &key, NULL))
+        {
+            if (g_file_has_prefix (key, location))
+            {
+                g_hash_table_iter_remove (&iter);
+            }
+        }
     }
+    G_UNLOCK (deep_count_cache);
+}
+
+static DeepCountState *
+deep_count_state_ref (DeepCountState *state)
+{
+    g_atomic_int_inc (&state->ref_count);
+    return state;
 }
 
 static void
-deep_count_state_free (DeepCountState *state)
+deep_count_state_unref (DeepCountState *state)
 {
-    if (state->enumerator)
+    guint i;
+
+    if (!g_atomic_int_dec_and_test (&state->ref_count))
     {
-        if (!g_file_enumerator_is_closed (state->enumerator))
-        {
-            g_file_enumerator_close_async (state->enumerator,
-                                           0, NULL, NULL, NULL);
-        }
-        g_object_unref (state->enumerator);
+        return;
     }
-    g_object_unref (state->cancellable);
-    if (state->deep_count_location)
+
+    nautilus_work_queue_unref (state->queue);
+    for (i = 0; i < state->n_workers; i++)
     {
-        g_object_unref (state->deep_count_location);
+        g_mutex_clear (&state->workers[i].mutex);
+        g_array_unref (state->workers[i].stamps);
     }
-    g_list_free_full (state->deep_count_subdirectories, g_object_unref);
-    g_array_free (state->seen_deep_count_inodes, TRUE);
+    g_free (state->workers);
+    g_mutex_clear (&state->seen_inodes_mutex);
+    nautilus_inode_set_free (state->seen_deep_count_inodes);
+    g_object_unref (state->cancellable);
+    g_object_unref (state->location);
     g_free (state->fs_id);
     g_free (state);
 }
 
-static void
-deep_count_next_dir (DeepCountState *state)
+/* Returns TRUE if the file was already counted under another name.
+ * Only files with more than one link can have been, so other files
+ * aren't remembered.
+ */
+static gboolean
+check_and_mark_inode_as_seen (DeepCountState *state,
+                              GFileInfo      *info)
 {
-    GFile *location;
-    NautilusFile *file;
-    NautilusDirectory *directory;
-    gboolean done;
+    guint64 inode;
+    guint32 device;
+    gboolean added;
 
-    directory = state->directory;
+    if (g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_UNIX_NLINK) &&
+        g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_UNIX_NLINK) < 2)
+    {
+        return FALSE;
+    }
+
+    inode = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_UNIX_INODE);
+    device = g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_UNIX_DEVICE);
 
-    g_object_unref (state->deep_count_location);
-    state->deep_count_location = NULL;
+    g_mutex_lock (&state->seen_inodes_mutex);
+    added = nautilus_inode_set_add (state->seen_deep_count_inodes, device, inode);
+    g_mutex_unlock (&state->seen_inodes_mutex);
 
-    done = FALSE;
-    file = directory->details->deep_count_file;
+    return !added;
+}
+
+static void
+deep_count_directory (DeepCountState *state,
+                      guint           worker_index,
+                      GFile          *location)
+{
+    DeepCountWorker *worker;
+    GFileEnumerator *enumerator;
+    GFileInfo *info;
+    GFile *subdirectory;
+    DeepCountSummary summary;
+    GArray *stamps;
+    const char *fs_id;
+    guint64 mtime;
+    guint directory_count, file_count, unreadable_count;
+    goffset size;
 
-    if (state->deep_count_subdirectories != NULL)
+    worker = &state->workers[worker_index];
+
+    g_debug ("load_directory called to get deep file count for %p", location);
+    enumerator = g_file_enumerate_children (location,
+                                            DEEP_COUNT_ATTRIBUTES,
+                                            G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                            state->cancellable,
+                                            NULL);
+    if (enumerator == NULL)
     {
-        /* Work on a new directory. */
-        location = state->deep_count_subdirectories->data;
-        state->deep_count_subdirectories = g_list_remove
-                                               (state->deep_count_subdirectories, location);
-        deep_count_load (state, location);
-        g_object_unref (location);
+        g_mutex_lock (&worker->mutex);
+        worker->unreadable_count += 1;
+        g_mutex_unlock (&worker->mutex);
+        return;
     }
-    else
+
+    stamps = deep_count_stamps_new ();
+    directory_count = 0;
+    file_count = 0;
+    unreadable_count = 0;
+    size = 0;
+    while ((info = g_file_enumerator_next_file (enumerator, state->cancellable, NULL)) != NULL)
     {
-        file->details->deep_counts_status = NAUTILUS_REQUEST_DONE;
-        directory->details->deep_count_file = NULL;
-        directory->details->deep_count_in_progress = NULL;
-        deep_count_state_free (state);
-        done = TRUE;
-    }
+        if (should_skip_file_info (info, state->show_hidden_files))
+        {
+            g_object_unref (info);
+            continue;
+        }
 
-    nautilus_file_updated_deep_count_in_progress (file);
+        if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY)
+        {
+            /* Count the directory. */
+            directory_count += 1;
 
-    if (done)
-    {
-        nautilus_file_changed (file);
-        async_job_end (directory, "deep count");
-        nautilus_directory_async_state_changed (directory);
+            /* Record the fact that we have to descend into this directory. */
+            fs_id = g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_ID_FILESYSTEM);
+            if (g_strcmp0 (fs_id, state->fs_id) == 0)
+            {
+                /* only if it is on the same filesystem, and unless
+                 * it was counted recently. Hard links between the
+                 * cached part and the rest are counted twice then.
+                 */
+                subdirectory = g_file_get_child (location, g_file_info_get_name (info));
+                mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+                deep_count_stamps_add (stamps, subdirectory, mtime);
+                if (deep_count_cache_lookup_current (subdirectory, mtime,
+                                                     state->cancellable,
+                                                     &summary))
+                {
+                    directory_count += summary.directory_count;
+                    file_count += summary.file_count;
+                    unreadable_count += summary.unreadable_count;
+                    size += summary.size;
+                    deep_count_stamps_add_all (stamps, summary.stamps);
+                    g_array_unref (summary.stamps);
+                    g_object_unref (subdirectory);
+                }
+                else
+                {
+                    nautilus_work_queue_push (state->queue, worker_index, subdirectory);
+                }
+            }
+        }
+        else
+        {
+            /* Even non-regular files count as files. */
+            file_count += 1;
+        }
+
+        /* Count the size. */
+        if (g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_STANDARD_SIZE) &&
+            !check_and_mark_inode_as_seen (state, info))
+        {
+            size += g_file_info_get_size (info);
+        }
+
+        g_object_unref (info);
     }
+
+    g_file_enumerator_close (enumerator, NULL, NULL);
+    g_object_unref (enumerator);
+
+    g_mutex_lock (&worker->mutex);
+    worker->directory_count += directory_count;
+    worker->file_count += file_count;
+    worker->unreadable_count += unreadable_count;
+    worker->size += size;
+    deep_count_stamps_add_all (worker->stamps, stamps);
+    g_mutex_unlock (&worker->mutex);
+
+    g_array_unref (stamps);
 }
 
 static void
-deep_count_more_files_callback (GObject      *source_object,
-                                GAsyncResult *res,
-                                gpointer      user_data)
+deep_count_work (gpointer item,
+                 guint    worker,
+                 gpointer user_data)
 {
     DeepCountState *state;
-    NautilusDirectory *directory;
-    GList *files, *l;
+    DeepCountWorker *counting_worker;
+    DeepCountSummary summary;
     GFileInfo *info;
 
     state = user_data;
 
-    if (state->directory == NULL)
+    if (item == state->location)
     {
-        /* Operation was cancelled. Bail out */
-        deep_count_state_free (state);
-        return;
+        /* Only descend into directories on the same file system. The
+         * count starts with this one, so nothing else is counted
+         * before the file system is known.
+         */
+        info = g_file_query_info (state->location,
+                                  G_FILE_ATTRIBUTE_ID_FILESYSTEM ","
+                                  G_FILE_ATTRIBUTE_TIME_MODIFIED,
+                                  G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                  state->cancellable,
+                                  NULL);
+        if (info != NULL)
+        {
+            state->fs_id = g_strdup (g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_ID_FILESYSTEM));
+            state->mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+            g_object_unref (info);
+        }
+
+        if (deep_count_cache_lookup_current (state->location, state->mtime,
+                                             state->cancellable, &summary))
+        {
+            counting_worker = &state->workers[worker];
+
+            g_mutex_lock (&counting_worker->mutex);
+            counting_worker->directory_count += summary.directory_count;
+            counting_worker->file_count += summary.file_count;
+            counting_worker->unreadable_count += summary.unreadable_count;
+            counting_worker->size += summary.size;
+            deep_count_stamps_add_all (counting_worker->stamps, summary.stamps);
+            g_mutex_unlock (&counting_worker->mutex);
+
+            g_array_unref (summary.stamps);
+            return;
+        }
     }
 
-    directory = nautilus_directory_ref (state->directory);
+    deep_count_directory (state, worker, item);
+}
 
-    g_assert (directory->details->deep_count_in_progress != NULL);
-    g_assert (directory->details->deep_count_in_progress == state);
+static gboolean deep_count_done (gpointer user_data);
 
-    files = g_file_enumerator_next_files_finish (state->enumerator,
-                                                 res, NULL);
+/* Takes over the reference of the queue on the state. */
+static void
+deep_count_work_done (gpointer user_data)
+{
+    g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
+                     deep_count_done,
+                     user_data,
+                     (GDestroyNotify) deep_count_state_unref);
+}
 
-    for (l = files; l != NULL; l = l->next)
-    {
-        info = l->data;
-        deep_count_one (state, info);
-        g_object_unref (info);
-    }
+/* Combines the counts of all the workers into the file. */
+static void
+deep_count_update_file (DeepCountState *state,
+                        NautilusFile   *file)
+{
+    DeepCountWorker *worker;
+    guint i;
 
-    if (files == NULL)
-    {
-        g_file_enumerator_close_async (state->enumerator, 0, NULL, NULL, NULL);
-        g_object_unref (state->enumerator);
-        state->enumerator = NULL;
+    file->details->deep_directory_count = 0;
+    file->details->deep_file_count = 0;
+    file->details->deep_unreadable_count = 0;
+    file->details->deep_size = 0;
 
-        deep_count_next_dir (state);
-    }
-    else
+    for (i = 0; i < state->n_workers; i++)
     {
-        g_file_enumerator_next_files_async (state->enumerator,
-                                            DIRECTORY_LOAD_ITEMS_PER_CALLBACK,
-                                            G_PRIORITY_LOW,
-                                            state->cancellable,
-                                            deep_count_more_files_callback,
-                                            state);
+        worker = &state->workers[i];
+
+        g_mutex_lock (&worker->mutex);
+        file->details->deep_directory_count += worker->directory_count;
+        file->details->deep_file_count += worker->file_count;
+        file->details->deep_unreadable_count += worker->unreadable_count;
+        file->details->deep_size += worker->size;
+        g_mutex_unlock (&worker->mutex);
     }
+}
+
+static gboolean
+deep_count_progress (gpointer user_data)
+{
+    DeepCountState *state;
+    NautilusFile *file;
 
-    g_list_free (files);
+    state = user_data;
+    file = state->directory->details->deep_count_file;
 
-    nautilus_directory_unref (directory);
+    deep_count_update_file (state, file);
+    nautilus_file_updated_deep_count_in_progress (file);
+
+    return TRUE;
 }
 
-static void
-deep_count_callback (GObject      *source_object,
-                     GAsyncResult *res,
-                     gpointer      user_data)
+static gboolean
+deep_count_done (gpointer user_data)
 {
     DeepCountState *state;
-    GFileEnumerator *enumerator;
+    NautilusDirectory *directory;
     NautilusFile *file;
+    DeepCountSummary summary;
+    guint i;
 
     state = user_data;
+    directory = state->directory;
 
-    if (state->directory == NULL)
+    if (directory == NULL)
     {
         /* Operation was cancelled. Bail out */
-        deep_count_state_free (state);
-        return;
+        return FALSE;
     }
 
-    file = state->directory->details->deep_count_file;
+    g_assert (directory->details->deep_count_in_progress == state);
 
-    enumerator = g_file_enumerate_children_finish (G_FILE (source_object), res, NULL);
+    nautilus_directory_ref (directory);
 
-    if (enumerator == NULL)
-    {
-        file->details->deep_unreadable_count += 1;
+    file = directory->details->deep_count_file;
+    deep_count_update_file (state, file);
+    file->details->deep_counts_status = NAUTILUS_REQUEST_DONE;
 
-        deep_count_next_dir (state);
-    }
-    else
+    summary.mtime = state->mtime;
+    summary.directory_count = file->details->deep_directory_count;
+    summary.file_count = file->details->deep_file_count;
+    summary.unreadable_count = file->details->deep_unreadable_count;
+    summary.size = file->details->deep_size;
+    summary.stamps = deep_count_stamps_new ();
+    for (i = 0; i < state->n_workers; i++)
     {
-        state->enumerator = enumerator;
-        g_file_enumerator_next_files_async (state->enumerator,
-                                            DIRECTORY_LOAD_ITEMS_PER_CALLBACK,
-                                            G_PRIORITY_LOW,
-                                            state->cancellable,
-                                            deep_count_more_files_callback,
-                                            state);
+        deep_count_stamps_add_all (summary.stamps, state->workers[i].stamps);
     }
-}
+    deep_count_cache_insert (state->location, &summary);
+    g_array_unref (summary.stamps);
 
+    g_source_remove (state->progress_timeout_id);
+    state->directory = NULL;
+    directory->details->deep_count_file = NULL;
+    directory->details->deep_count_in_progress = NULL;
+    deep_count_state_unref (state);
 
-static void
-deep_count_load (DeepCountState *state,
-                 GFile          *location)
-{
-    state->deep_count_location = g_object_ref (location);
+    nautilus_file_updated_deep_count_in_progress (file);
+    nautilus_file_changed (file);
+    async_job_end (directory, "deep count");
+    nautilus_directory_async_state_changed (directory);
 
-    g_debug ("load_directory called to get deep file count for %p", location);
-    g_file_enumerate_children_async (state->deep_count_location,
-                                     G_FILE_ATTRIBUTE_STANDARD_NAME ","
-                                     G_FILE_ATTRIBUTE_STANDARD_TYPE ","
-                                     G_FILE_ATTRIBUTE_STANDARD_SIZE ","
-                                     G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN ","
-                                     G_FILE_ATTRIBUTE_STANDARD_IS_BACKUP ","
-                                     G_FILE_ATTRIBUTE_ID_FILESYSTEM ","
-                                     G_FILE_ATTRIBUTE_UNIX_INODE,
-                                     G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,     /* flags */
-                                     G_PRIORITY_LOW,     /* prio */
-                                     state->cancellable,
-                                     deep_count_callback,
-                                     state);
+    nautilus_directory_unref (directory);
+
+    return FALSE;
 }
 
 static void
@@ -3044,39 +4304,13 @@ deep_count_stop (NautilusDirectory *directory)
     }
 }
 
-static void
-deep_count_got_info (GObject      *source_object,
-                     GAsyncResult *res,
-                     gpointer      user_data)
-{
-    GFileInfo *info;
-    const char *id;
-    GFile *file = (GFile *) source_object;
-    DeepCountState *state = (DeepCountState *) user_data;
-
-    info = g_file_query_info_finish (file, res, NULL);
-    if (info != NULL)
-    {
-        id = g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_ID_FILESYSTEM);
-        state->fs_id = g_strdup (id);
-        g_object_unref (info);
-    }
-    deep_count_load (state, file);
-}
-
 static void
 deep_count_start (NautilusDirectory *directory,
                   NautilusFile      *file,
                   gboolean          *doing_io)
 {
-    GFile *location;
     DeepCountState *state;
-
-    if (directory->details->deep_count_in_progress != NULL)
-    {
-        *doing_io = TRUE;
-        return;
-    }
+    guint i;
 
     if (!is_needy (file,
                    lacks_deep_count,
@@ -3094,6 +4328,12 @@ deep_count_start (NautilusDirectory *directory,
         return;
     }
 
+    /* Only one of these at a time per directory. */
+    if (directory->details->deep_count_in_progress != NULL)
+    {
+        return;
+    }
+
     if (!async_job_start (directory, "deep count"))
     {
         return;
@@ -3108,32 +4348,51 @@ deep_count_start (NautilusDirectory *directory,
     directory->details->deep_count_file = file;
 
     state = g_new0 (DeepCountState, 1);
+    state->ref_count = 1;
     state->directory = directory;
     state->cancellable = g_cancellable_new ();
-    state->seen_deep_count_inodes = g_array_new (FALSE, TRUE, sizeof (guint64));
+    state->location = nautilus_file_get_location (file);
+    state->show_hidden_files = get_show_hidden_files ();
     state->fs_id = NULL;
+    g_mutex_init (&state->seen_inodes_mutex);
+    state->seen_deep_count_inodes = nautilus_inode_set_new ();
+
+    state->n_workers = CLAMP (g_get_num_processors (), 1, DEEP_COUNT_MAX_WORKERS);
+    state->workers = g_new0 (DeepCountWorker, state->n_workers);
+    for (i = 0; i < state->n_workers; i++)
+    {
+        g_mutex_init (&state->workers[i].mutex);
+        state->workers[i].stamps = deep_count_stamps_new ();
+    }
+    state->queue = nautilus_work_queue_new (state->n_workers,
+                                            deep_count_work,
+                                            g_object_unref,
+                                            state->cancellable,
+                                            deep_count_work_done,
+                                            deep_count_state_ref (state));
 
     directory->details->deep_count_in_progress = state;
+    state->progress_timeout_id = g_timeout_add (DEEP_COUNT_PROGRESS_INTERVAL,
+                                                deep_count_progress,
+                                                state);
 
-    location = nautilus_file_get_location (file);
-    g_file_query_info_async (location,
-                             G_FILE_ATTRIBUTE_ID_FILESYSTEM,
-                             G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
-                             G_PRIORITY_DEFAULT,
-                             NULL,
-                             deep_count_got_info,
-                             state);
-    g_object_unref (location);
+    nautilus_work_queue_push (state->queue, 0, g_object_ref (state->location));
+    nautilus_work_queue_start (state->queue);
 }
 
 static void
 mime_list_stop (NautilusDirectory *directory)
 {
+    GList *node, *next;
+    MimeListState *state;
     NautilusFile *file;
 
-    if (directory->details->mime_list_in_progress != NULL)
+    for (node = directory->details->mime_list_in_progress; node != NULL; node = next)
     {
-        file = directory->details->mime_list_in_progress->mime_list_file;
+        next = node->next;
+        state = node->data;
+
+        file = state->mime_list_file;
         if (file != NULL)
         {
             g_assert (NAUTILUS_IS_FILE (file));
@@ -3142,12 +4401,12 @@ mime_list_stop (NautilusDirectory *directory)
                           should_get_mime_list,
                           REQUEST_MIME_LIST))
             {
-                return;
+                continue;
             }
         }
 
         /* The count is not wanted, so stop it. */
-        mime_list_cancel (directory);
+        mime_list_cancel_state (directory, state);
     }
 }
 
@@ -3194,7 +4453,8 @@ mime_list_done (MimeListState *state,
         file->details->got_mime_list = TRUE;
         file->details->mime_list = istr_set_get_as_list (state->mime_list_hash);
     }
-    directory->details->mime_list_in_progress = NULL;
+    directory->details->mime_list_in_progress =
+        g_list_remove (directory->details->mime_list_in_progress, state);
 
     /* Send file-changed even if getting the item type list
      * failed, so interested parties can distinguish between
@@ -3243,7 +4503,8 @@ mime_list_callback (GObject      *source_object,
     if (g_cancellable_is_cancelled (state->cancellable))
     {
         /* Operation was cancelled. Bail out */
-        directory->details->mime_list_in_progress = NULL;
+        directory->details->mime_list_in_progress =
+            g_list_remove (directory->details->mime_list_in_progress, state);
 
         async_job_end (directory, "MIME list");
         nautilus_directory_async_state_changed (directory);
@@ -3253,8 +4514,7 @@ mime_list_callback (GObject      *source_object,
         return;
     }
 
-    g_assert (directory->details->mime_list_in_progress != NULL);
-    g_assert (directory->details->mime_list_in_progress == state);
+    g_assert (g_list_find (directory->details->mime_list_in_progress, state) != NULL);
 
     error = NULL;
     files = g_file_enumerator_next_files_finish (state->enumerator,
@@ -3306,7 +4566,8 @@ list_mime_enum_callback (GObject      *source_object,
     {
         /* Operation was cancelled. Bail out */
         directory = state->directory;
-        directory->details->mime_list_in_progress = NULL;
+        directory->details->mime_list_in_progress =
+            g_list_remove (directory->details->mime_list_in_progress, state);
 
         async_job_end (directory, "MIME list");
         nautilus_directory_async_state_changed (directory);
@@ -3349,7 +4610,7 @@ mime_list_start (NautilusDirectory *directory,
 
     mime_list_stop (directory);
 
-    if (directory->details->mime_list_in_progress != NULL)
+    if (find_mime_list_state_for_file (directory, file) != NULL)
     {
         *doing_io = TRUE;
         return;
@@ -3375,6 +4636,11 @@ mime_list_start (NautilusDirectory *directory,
         return;
     }
 
+    if (attribute_pipeline_is_full (directory->details->mime_list_in_progress))
+    {
+        return;
+    }
+
     if (!async_job_start (directory, "MIME list"))
     {
         return;
@@ -3387,7 +4653,8 @@ mime_list_start (NautilusDirectory *directory,
     state->cancellable = g_cancellable_new ();
     state->mime_list_hash = istr_set_new ();
 
-    directory->details->mime_list_in_progress = state;
+    directory->details->mime_list_in_progress =
+        g_list_prepend (directory->details->mime_list_in_progress, state);
 
     location = nautilus_file_get_location (file);
 
@@ -3436,11 +4703,11 @@ query_info_callback (GObject      *source_object,
 
     directory = nautilus_directory_ref (state->directory);
 
-    get_info_file = directory->details->get_info_file;
+    get_info_file = state->file;
     g_assert (NAUTILUS_IS_FILE (get_info_file));
 
-    directory->details->get_info_file = NULL;
-    directory->details->get_info_in_progress = NULL;
+    directory->details->get_info_in_progress =
+        g_list_remove (directory->details->get_info_in_progress, state);
 
     /* ref here because we might be removing the last ref when we
      * mark the file gone below, but we need to keep a ref at
@@ -3483,23 +4750,28 @@ query_info_callback (GObject      *source_object,
 static void
 file_info_stop (NautilusDirectory *directory)
 {
+    GList *node, *next;
+    GetInfoState *state;
     NautilusFile *file;
 
-    if (directory->details->get_info_in_progress != NULL)
+    for (node = directory->details->get_info_in_progress; node != NULL; node = next)
     {
-        file = directory->details->get_info_file;
+        next = node->next;
+        state = node->data;
+
+        file = state->file;
         if (file != NULL)
         {
             g_assert (NAUTILUS_IS_FILE (file));
             g_assert (file->details->directory == directory);
             if (is_needy (file, lacks_info, REQUEST_FILE_INFO))
             {
-                return;
+                continue;
             }
         }
 
         /* The info is not wanted, so stop it. */
-        file_info_cancel (directory);
+        file_info_cancel_state (directory, state);
     }
 }
 
@@ -3513,7 +4785,7 @@ file_info_start (NautilusDirectory *directory,
 
     file_info_stop (directory);
 
-    if (directory->details->get_info_in_progress != NULL)
+    if (find_file_info_state_for_file (directory, file) != NULL)
     {
         *doing_io = TRUE;
         return;
@@ -3525,12 +4797,16 @@ file_info_start (NautilusDirectory *directory,
     }
     *doing_io = TRUE;
 
+    if (attribute_pipeline_is_full (directory->details->get_info_in_progress))
+    {
+        return;
+    }
+
     if (!async_job_start (directory, "file info"))
     {
         return;
     }
 
-    directory->details->get_info_file = file;
     file->details->get_info_failed = FALSE;
     if (file->details->get_info_error)
     {
@@ -3541,8 +4817,10 @@ file_info_start (NautilusDirectory *directory,
     state = g_new (GetInfoState, 1);
     state->directory = directory;
     state->cancellable = g_cancellable_new ();
+    state->file = file;
 
-    directory->details->get_info_in_progress = state;
+    directory->details->get_info_in_progress =
+        g_list_prepend (directory->details->get_info_in_progress, state);
 
     location = nautilus_file_get_location (file);
     g_file_query_info_async (location,
@@ -3764,12 +5042,6 @@ link_info_start (NautilusDirectory *directory,
     gboolean nautilus_style_link;
     LinkInfoReadState *state;
 
-    if (directory->details->link_info_read_state != NULL)
-    {
-        *doing_io = TRUE;
-        return;
-    }
-
     if (!is_needy (file,
                    lacks_link_info,
                    REQUEST_LINK_INFO))
@@ -3778,6 +5050,12 @@ link_info_start (NautilusDirectory *directory,
     }
     *doing_io = TRUE;
 
+    /* Only one of these at a time per directory. */
+    if (directory->details->link_info_read_state != NULL)
+    {
+        return;
+    }
+
     /* Figure out if it is a link. */
     nautilus_style_link = nautilus_file_is_nautilus_link (file);
     location = nautilus_file_get_location (file);
@@ -3866,12 +5144,16 @@ thumbnail_done (NautilusDirectory *directory,
 static void
 thumbnail_stop (NautilusDirectory *directory)
 {
+    GList *node, *next;
+    ThumbnailState *state;
     NautilusFile *file;
 
-    if (directory->details->thumbnail_state != NULL)
+    for (node = directory->details->thumbnail_in_progress; node != NULL; node = next)
     {
-        file = directory->details->thumbnail_state->file;
+        next = node->next;
+        state = node->data;
 
+        file = state->file;
         if (file != NULL)
         {
             g_assert (NAUTILUS_IS_FILE (file));
@@ -3880,12 +5162,12 @@ thumbnail_stop (NautilusDirectory *directory)
                           lacks_thumbnail,
                           REQUEST_THUMBNAIL))
             {
-                return;
+                continue;
             }
         }
 
-        /* The link info is not wanted, so stop it. */
-        thumbnail_cancel (directory);
+        /* The thumbnail is not wanted, so stop it. */
+        thumbnail_cancel_state (directory, state);
     }
 }
 
@@ -4043,7 +5325,8 @@ thumbnail_read_callback (GObject      *source_object,
     }
     else
     {
-        state->directory->details->thumbnail_state = NULL;
+        state->directory->details->thumbnail_in_progress =
+            g_list_remove (state->directory->details->thumbnail_in_progress, state);
         async_job_end (state->directory, "thumbnail");
 
         thumbnail_got_pixbuf (state->directory, state->file, pixbuf, state->tried_original);
@@ -4062,7 +5345,7 @@ thumbnail_start (NautilusDirectory *directory,
     GFile *location;
     ThumbnailState *state;
 
-    if (directory->details->thumbnail_state != NULL)
+    if (find_thumbnail_state_for_file (directory, file) != NULL)
     {
         *doing_io = TRUE;
         return;
@@ -4076,6 +5359,11 @@ thumbnail_start (NautilusDirectory *directory,
     }
     *doing_io = TRUE;
 
+    if (attribute_pipeline_is_full (directory->details->thumbnail_in_progress))
+    {
+        return;
+    }
+
     if (!async_job_start (directory, "thumbnail"))
     {
         return;
@@ -4097,7 +5385,8 @@ thumbnail_start (NautilusDirectory *directory,
         location = g_file_new_for_path (file->details->thumbnail_path);
     }
 
-    directory->details->thumbnail_state = state;
+    directory->details->thumbnail_in_progress =
+        g_list_prepend (directory->details->thumbnail_in_progress, state);
 
     g_file_load_contents_async (location,
                                 state->cancellable,
@@ -4254,12 +5543,6 @@ mount_start (NautilusDirectory *directory,
     GFile *location;
     MountState *state;
 
-    if (directory->details->mount_state != NULL)
-    {
-        *doing_io = TRUE;
-        return;
-    }
-
     if (!is_needy (file,
                    lacks_mount,
                    REQUEST_MOUNT))
@@ -4268,6 +5551,12 @@ mount_start (NautilusDirectory *directory,
     }
     *doing_io = TRUE;
 
+    /* Only one of these at a time per directory. */
+    if (directory->details->mount_state != NULL)
+    {
+        return;
+    }
+
     if (!async_job_start (directory, "mount"))
     {
         return;
@@ -4434,12 +5723,6 @@ filesystem_info_start (NautilusDirectory *directory,
     GFile *location;
     FilesystemInfoState *state;
 
-    if (directory->details->filesystem_info_state != NULL)
-    {
-        *doing_io = TRUE;
-        return;
-    }
-
     if (!is_needy (file,
                    lacks_filesystem_info,
                    REQUEST_FILESYSTEM_INFO))
@@ -4448,6 +5731,12 @@ filesystem_info_start (NautilusDirectory *directory,
     }
     *doing_io = TRUE;
 
+    /* Only one of these at a time per directory. */
+    if (directory->details->filesystem_info_state != NULL)
+    {
+        return;
+    }
+
     if (!async_job_start (directory, "filesystem info"))
     {
         return;
@@ -4602,17 +5891,17 @@ extension_info_start (NautilusDirectory *directory,
     NautilusOperationHandle *handle;
     GClosure *update_complete;
 
-    if (directory->details->extension_info_in_progress != NULL)
+    if (!is_needy (file, lacks_extension_info, REQUEST_EXTENSION_INFO))
     {
-        *doing_io = TRUE;
         return;
     }
+    *doing_io = TRUE;
 
-    if (!is_needy (file, lacks_extension_info, REQUEST_EXTENSION_INFO))
+    /* Only one of these at a time per directory. */
+    if (directory->details->extension_info_in_progress != NULL)
     {
         return;
     }
-    *doing_io = TRUE;
 
     if (!async_job_start (directory, "extension info"))
     {
@@ -4649,12 +5938,116 @@ extension_info_start (NautilusDirectory *directory,
     }
 }
 
-static void
-start_or_stop_io (NautilusDirectory *directory)
+typedef gboolean (*WorkQueueStartFunc) (NautilusDirectory *directory,
+                                        NautilusFile      *file);
+typedef void (*WorkQueueAdvanceFunc) (NautilusDirectory *directory,
+                                      NautilusFile      *file);
+
+static gboolean
+high_priority_io_start (NautilusDirectory *directory,
+                        NautilusFile      *file)
+{
+    gboolean doing_io;
+
+    doing_io = FALSE;
+
+    /* Start getting attributes if possible */
+    file_info_start (directory, file, &doing_io);
+    link_info_start (directory, file, &doing_io);
+
+    return doing_io;
+}
+
+static gboolean
+low_priority_io_start (NautilusDirectory *directory,
+                       NautilusFile      *file)
+{
+    gboolean doing_io;
+
+    doing_io = FALSE;
+
+    /* Start getting attributes if possible */
+    mount_start (directory, file, &doing_io);
+    directory_count_start (directory, file, &doing_io);
+    deep_count_start (directory, file, &doing_io);
+    mime_list_start (directory, file, &doing_io);
+    thumbnail_start (directory, file, &doing_io);
+    filesystem_info_start (directory, file, &doing_io);
+
+    return doing_io;
+}
+
+static gboolean
+extension_io_start (NautilusDirectory *directory,
+                    NautilusFile      *file)
 {
-    NautilusFile *file;
     gboolean doing_io;
 
+    doing_io = FALSE;
+
+    /* Start getting attributes if possible */
+    extension_info_start (directory, file, &doing_io);
+
+    return doing_io;
+}
+
+/* Start I/O for the files at the head of a work queue. Files that
+ * need nothing more from this queue are passed on to @advance. Files
+ * with I/O in flight, or waiting for a free slot in the pipeline of
+ * their attribute kind, stay on the queue; we look past them for more
+ * work, up to a window proportional to the pipeline depth.
+ *
+ * Returns TRUE if files are still waiting on this queue, in which
+ * case lower priority queues must wait too.
+ */
+static gboolean
+work_queue_start_io (NautilusDirectory    *directory,
+                     NautilusFileQueue    *queue,
+                     WorkQueueStartFunc    start,
+                     WorkQueueAdvanceFunc  advance)
+{
+    GList *window, *node;
+    NautilusFile *file;
+    gboolean progressed;
+
+    do
+    {
+        window = nautilus_file_queue_peek (queue,
+                                           get_attribute_pipeline_depth () * WORK_QUEUE_LOOKAHEAD_FACTOR);
+        if (window == NULL)
+        {
+            return FALSE;
+        }
+
+        progressed = FALSE;
+        for (node = window; node != NULL; node = node->next)
+        {
+            file = node->data;
+
+            /* Starting I/O can have side effects on the queue. */
+            if (!nautilus_file_queue_contains (queue, file))
+            {
+                progressed = TRUE;
+                continue;
+            }
+
+            if (!(*start)(directory, file))
+            {
+                (*advance)(directory, file);
+                progressed = TRUE;
+            }
+        }
+
+        nautilus_file_list_free (window);
+    }
+    while (progressed);
+
+    return TRUE;
+}
+
+static void
+start_or_stop_io (NautilusDirectory *directory)
+{
     /* Start or stop reading files. */
     file_list_start_or_stop (directory);
 
@@ -4669,59 +6062,29 @@ start_or_stop_io (NautilusDirectory *directory)
     thumbnail_stop (directory);
     filesystem_info_stop (directory);
 
-    doing_io = FALSE;
     /* Take files that are all done off the queue. */
-    while (!nautilus_file_queue_is_empty (directory->details->high_priority_queue))
+    if (work_queue_start_io (directory,
+                             directory->details->high_priority_queue,
+                             high_priority_io_start,
+                             move_file_to_low_priority_queue))
     {
-        file = nautilus_file_queue_head (directory->details->high_priority_queue);
-
-        /* Start getting attributes if possible */
-        file_info_start (directory, file, &doing_io);
-        link_info_start (directory, file, &doing_io);
-
-        if (doing_io)
-        {
-            return;
-        }
-
-        move_file_to_low_priority_queue (directory, file);
+        return;
     }
 
     /* High priority queue must be empty */
-    while (!nautilus_file_queue_is_empty (directory->details->low_priority_queue))
+    if (work_queue_start_io (directory,
+                             directory->details->low_priority_queue,
+                             low_priority_io_start,
+                             move_file_to_extension_queue))
     {
-        file = nautilus_file_queue_head (directory->details->low_priority_queue);
-
-        /* Start getting attributes if possible */
-        mount_start (directory, file, &doing_io);
-        directory_count_start (directory, file, &doing_io);
-        deep_count_start (directory, file, &doing_io);
-        mime_list_start (directory, file, &doing_io);
-        thumbnail_start (directory, file, &doing_io);
-        filesystem_info_start (directory, file, &doing_io);
-
-        if (doing_io)
-        {
-            return;
-        }
-
-        move_file_to_extension_queue (directory, file);
+        return;
     }
 
     /* Low priority queue must be empty */
-    while (!nautilus_file_queue_is_empty (directory->details->extension_queue))
-    {
-        file = nautilus_file_queue_head (directory->details->extension_queue);
-
-        /* Start getting attributes if possible */
-        extension_info_start (directory, file, &doing_io);
-        if (doing_io)
-        {
-            return;
-        }
-
-        nautilus_directory_remove_file_from_work_queue (directory, file);
-    }
+    work_queue_start_io (directory,
+                         directory->details->extension_queue,
+                         extension_io_start,
+                         nautilus_directory_remove_file_from_work_queue);
 }
 
 /* Call this when the monitor or call when ready list changes,
@@ -4779,10 +6142,7 @@ nautilus_directory_cancel (NautilusDirectory *directory)
     filesystem_info_cancel (directory);
 
     /* We aren't waiting for anything any more. */
-    if (waiting_directories != NULL)
-    {
-        g_hash_table_remove (waiting_directories, directory);
-    }
+    async_job_forget_directory (directory);
 
     /* Check if any directories should wake up. */
     async_job_wake_up ();
@@ -4792,10 +6152,12 @@ static void
 cancel_directory_count_for_file (NautilusDirectory *directory,
                                  NautilusFile      *file)
 {
-    if (directory->details->count_in_progress != NULL &&
-        directory->details->count_in_progress->count_file == file)
+    DirectoryCountState *state;
+
+    state = find_count_state_for_file (directory, file);
+    if (state != NULL)
     {
-        directory_count_cancel (directory);
+        directory_count_cancel_state (directory, state);
     }
 }
 
@@ -4813,10 +6175,12 @@ static void
 cancel_mime_list_for_file (NautilusDirectory *directory,
                            NautilusFile      *file)
 {
-    if (directory->details->mime_list_in_progress != NULL &&
-        directory->details->mime_list_in_progress->mime_list_file == file)
+    MimeListState *state;
+
+    state = find_mime_list_state_for_file (directory, file);
+    if (state != NULL)
     {
-        mime_list_cancel (directory);
+        mime_list_cancel_state (directory, state);
     }
 }
 
@@ -4824,9 +6188,12 @@ static void
 cancel_file_info_for_file (NautilusDirectory *directory,
                            NautilusFile      *file)
 {
-    if (directory->details->get_info_file == file)
+    GetInfoState *state;
+
+    state = find_file_info_state_for_file (directory, file);
+    if (state != NULL)
     {
-        file_info_cancel (directory);
+        file_info_cancel_state (directory, state);
     }
 }
 
@@ -4834,10 +6201,12 @@ static void
 cancel_thumbnail_for_file (NautilusDirectory *directory,
                            NautilusFile      *file)
 {
-    if (directory->details->thumbnail_state != NULL &&
-        directory->details->thumbnail_state->file == file)
+    ThumbnailState *state;
+
+    state = find_thumbnail_state_for_file (directory, file);
+    if (state != NULL)
     {
-        thumbnail_cancel (directory);
+        thumbnail_cancel_state (directory, state);
     }
 }
 
@@ -4987,12 +6356,12 @@ nautilus_directory_add_file_to_work_queue (NautilusDirectory *directory,
 static void
 add_all_files_to_work_queue (NautilusDirectory *directory)
 {
-    GList *node;
     NautilusFile *file;
+    guint i;
 
-    for (node = directory->details->file_list; node != NULL; node = node->next)
+    for (i = 0; i < directory->details->files->len; i++)
     {
-        file = NAUTILUS_FILE (node->data);
+        file = g_ptr_array_index (directory->details->files, i);
 
         nautilus_directory_add_file_to_work_queue (directory, file);
     }
@@ -0,0 +1,374 @@
+/*
+ *  nautilus-directory-listing-cache.c: On-disk cache of directory listings.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 2 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* A cached listing is a header, an array of fixed size entries and a
+ * pool of NUL terminated strings the entries point into. It is written
+ * in one go with g_file_set_contents() and read back memory-mapped.
+ * The cache files are per machine, so everything is in host byte order.
+ */
+
+#include <config.h>
+#include "nautilus-directory-listing-cache.h"
+
+#include <glib/gstdio.h>
+#include <string.h>
+
+/* Reading smaller directories is quick enough on its own. */
+#define MIN_CACHED_FILES 1000
+
+#define CACHE_MAGIC "NAUTDLC1"
+#define NO_STRING G_MAXUINT32
+
+enum
+{
+    ENTRY_HAS_MODE = 1 << 0,
+    ENTRY_IS_HIDDEN = 1 << 1,
+    ENTRY_IS_BACKUP = 1 << 2,
+    ENTRY_IS_SYMLINK = 1 << 3
+};
+
+typedef struct
+{
+    char magic[8];
+    guint64 directory_device;
+    guint64 directory_inode;
+    guint64 directory_mtime;
+    guint32 directory_mtime_usec;
+    guint32 n_entries;
+} CacheHeader;
+
+typedef struct
+{
+    guint64 size;
+    guint64 mtime;
+    guint32 name;         /* offsets into the string pool */
+    guint32 display_name;
+    guint32 content_type;
+    guint32 mode;
+    guint32 type;
+    guint32 flags;
+} CacheEntry;
+
+struct NautilusDirectoryListingCacheBuilder
+{
+    GArray *entries;
+    GString *strings;
+};
+
+static char *
+get_cache_path (GFile *location)
+{
+    char *uri, *checksum, *path;
+
+    uri = g_file_get_uri (location);
+    checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA1, uri, -1);
+    path = g_build_filename (g_get_user_cache_dir (), "nautilus", "listings", checksum, NULL);
+    g_free (checksum);
+    g_free (uri);
+
+    return path;
+}
+
+static gboolean
+get_directory_stamp (GFileInfo   *directory_info,
+                     CacheHeader *header)
+{
+    if (!g_file_info_has_attribute (directory_info, G_FILE_ATTRIBUTE_TIME_MODIFIED) ||
+        !g_file_info_has_attribute (directory_info, G_FILE_ATTRIBUTE_UNIX_INODE))
+    {
+        return FALSE;
+    }
+
+    header->directory_device = g_file_info_get_attribute_uint32 (directory_info, G_FILE_ATTRIBUTE_UNIX_DEVICE);
+    header->directory_inode = g_file_info_get_attribute_uint64 (directory_info, G_FILE_ATTRIBUTE_UNIX_INODE);
+    header->directory_mtime = g_file_info_get_attribute_uint64 (directory_info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+    header->directory_mtime_usec = g_file_info_get_attribute_uint32 (directory_info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+
+    return TRUE;
+}
+
+static GFileInfo *
+file_info_from_entry (const CacheEntry *entry,
+                      const char       *strings)
+{
+    GFileInfo *info;
+
+    info = g_file_info_new ();
+    g_file_info_set_name (info, strings + entry->name);
+    g_file_info_set_display_name (info, strings + entry->display_name);
+    g_file_info_set_file_type (info, entry->type);
+    g_file_info_set_size (info, entry->size);
+    g_file_info_set_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED, entry->mtime);
+    if (entry->content_type != NO_STRING)
+    {
+        g_file_info_set_content_type (info, strings + entry->content_type);
+    }
+    if (entry->flags & ENTRY_HAS_MODE)
+    {
+        g_file_info_set_attribute_uint32 (info, G_FILE_ATTRIBUTE_UNIX_MODE, entry->mode);
+    }
+    g_file_info_set_is_hidden (info, (entry->flags & ENTRY_IS_HIDDEN) != 0);
+    g_file_info_set_attribute_boolean (info, G_FILE_ATTRIBUTE_STANDARD_IS_BACKUP,
+                                       (entry->flags & ENTRY_IS_BACKUP) != 0);
+    g_file_info_set_is_symlink (info, (entry->flags & ENTRY_IS_SYMLINK) != 0);
+
+    return info;
+}
+
+GList *
+nautilus_directory_listing_cache_load (GFile     *location,
+                                       GFileInfo *directory_info)
+{
+    CacheHeader stamp;
+    const CacheHeader *header;
+    const CacheEntry *entries;
+    const char *contents, *strings;
+    GMappedFile *mapped_file;
+    char *path;
+    gsize length, strings_length;
+    GList *infos;
+    guint i;
+
+    if (!get_directory_stamp (directory_info, &stamp))
+    {
+        return NULL;
+    }
+
+    path = get_cache_path (location);
+    mapped_file = g_mapped_file_new (path, FALSE, NULL);
+    g_free (path);
+    if (mapped_file == NULL)
+    {
+        return NULL;
+    }
+
+    infos = NULL;
+    contents = g_mapped_file_get_contents (mapped_file);
+    length = g_mapped_file_get_length (mapped_file);
+    header = (const CacheHeader *) contents;
+
+    if (length < sizeof (CacheHeader) ||
+        memcmp (header->magic, CACHE_MAGIC, sizeof (header->magic)) != 0 ||
+        header->n_entries > (length - sizeof (CacheHeader)) / sizeof (CacheEntry))
+    {
+        goto out;
+    }
+
+    /* A cached listing is only good as long as the directory
+     * wasn't touched since.
+     */
+    if (header->directory_device != stamp.directory_device ||
+        header->directory_inode != stamp.directory_inode ||
+        header->directory_mtime != stamp.directory_mtime ||
+        header->directory_mtime_usec != stamp.directory_mtime_usec)
+    {
+        goto out;
+    }
+
+    entries = (const CacheEntry *) (contents + sizeof (CacheHeader));
+    strings = (const char *) (entries + header->n_entries);
+    strings_length = length - (strings - contents);
+
+    /* With a terminated pool, any offset inside it is a valid string. */
+    if (strings_length == 0 || strings[strings_length - 1] != '\0')
+    {
+        goto out;
+    }
+
+    for (i = 0; i < header->n_entries; i++)
+    {
+        if (entries[i].name >= strings_length ||
+            entries[i].display_name >= strings_length ||
+            (entries[i].content_type != NO_STRING && entries[i].content_type >= strings_length))
+        {
+            g_list_free_full (infos, g_object_unref);
+            infos = NULL;
+            goto out;
+        }
+
+        infos = g_list_prepend (infos, file_info_from_entry (&entries[i], strings));
+    }
+    infos = g_list_reverse (infos);
+
+out:
+    g_mapped_file_unref (mapped_file);
+
+    return infos;
+}
+
+NautilusDirectoryListingCacheBuilder *
+nautilus_directory_listing_cache_builder_new (void)
+{
+    NautilusDirectoryListingCacheBuilder *builder;
+
+    builder = g_new0 (NautilusDirectoryListingCacheBuilder, 1);
+    builder->entries = g_array_new (FALSE, TRUE, sizeof (CacheEntry));
+    builder->strings = g_string_new (NULL);
+
+    return builder;
+}
+
+static guint32
+add_string (NautilusDirectoryListingCacheBuilder *builder,
+            const char                           *string)
+{
+    guint32 offset;
+
+    offset = builder->strings->len;
+    g_string_append_len (builder->strings, string, strlen (string) + 1);
+
+    return offset;
+}
+
+void
+nautilus_directory_listing_cache_builder_add (NautilusDirectoryListingCacheBuilder *builder,
+                                              GFileInfo                            *info)
+{
+    CacheEntry entry = { 0 };
+    const char *name, *display_name, *content_type;
+
+    name = g_file_info_get_name (info);
+    if (name == NULL)
+    {
+        return;
+    }
+
+    display_name = g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_STANDARD_DISPLAY_NAME);
+    content_type = g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE);
+
+    entry.name = add_string (builder, name);
+    entry.display_name = display_name != NULL ? add_string (builder, display_name) : entry.name;
+    entry.content_type = content_type != NULL ? add_string (builder, content_type) : NO_STRING;
+    entry.size = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_STANDARD_SIZE);
+    entry.mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+    entry.type = g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_STANDARD_TYPE);
+
+    if (g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_UNIX_MODE))
+    {
+        entry.mode = g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_UNIX_MODE);
+        entry.flags |= ENTRY_HAS_MODE;
+    }
+    if (g_file_info_get_attribute_boolean (info, G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN))
+    {
+        entry.flags |= ENTRY_IS_HIDDEN;
+    }
+    if (g_file_info_get_attribute_boolean (info, G_FILE_ATTRIBUTE_STANDARD_IS_BACKUP))
+    {
+        entry.flags |= ENTRY_IS_BACKUP;
+    }
+    if (g_file_info_get_attribute_boolean (info, G_FILE_ATTRIBUTE_STANDARD_IS_SYMLINK))
+    {
+        entry.flags |= ENTRY_IS_SYMLINK;
+    }
+
+    g_array_append_val (builder->entries, entry);
+}
+
+static gboolean
+cache_file_has_contents (const char *path,
+                         GByteArray *contents)
+{
+    GMappedFile *mapped_file;
+    gboolean same;
+
+    mapped_file = g_mapped_file_new (path, FALSE, NULL);
+    if (mapped_file == NULL)
+    {
+        return FALSE;
+    }
+
+    same = g_mapped_file_get_length (mapped_file) == contents->len &&
+           memcmp (g_mapped_file_get_contents (mapped_file), contents->data, contents->len) == 0;
+    g_mapped_file_unref (mapped_file);
+
+    return same;
+}
+
+void
+nautilus_directory_listing_cache_builder_save (NautilusDirectoryListingCacheBuilder *builder,
+                                               GFile                                *location,
+                                               GFileInfo                            *directory_info)
+{
+    CacheHeader header = { { 0 } };
+    GByteArray *contents;
+    char *path, *dirname;
+    GError *error;
+
+    path = get_cache_path (location);
+
+    if (builder->entries->len < MIN_CACHED_FILES ||
+        !get_directory_stamp (directory_info, &header))
+    {
+        g_unlink (path);
+        g_free (path);
+        return;
+    }
+
+    memcpy (header.magic, CACHE_MAGIC, sizeof (header.magic));
+    header.n_entries = builder->entries->len;
+
+    contents = g_byte_array_sized_new (sizeof (CacheHeader) +
+                                       builder->entries->len * sizeof (CacheEntry) +
+                                       builder->strings->len);
+    g_byte_array_append (contents, (const guint8 *) &header, sizeof (CacheHeader));
+    g_byte_array_append (contents, (const guint8 *) builder->entries->data,
+                         builder->entries->len * sizeof (CacheEntry));
+    g_byte_array_append (contents, (const guint8 *) builder->strings->str,
+                         builder->strings->len);
+
+    /* Most loads find the cache still good, and would write it again
+     * as it is.
+     */
+    if (cache_file_has_contents (path, contents))
+    {
+        g_byte_array_unref (contents);
+        g_free (path);
+        return;
+    }
+
+    dirname = g_path_get_dirname (path);
+    g_mkdir_with_parents (dirname, 0700);
+    g_free (dirname);
+
+    error = NULL;
+    if (!g_file_set_contents (path, (const char *) contents->data, contents->len, &error))
+    {
+        g_debug ("Could not save directory listing cache %s: %s", path, error->message);
+        g_error_free (error);
+    }
+
+    g_byte_array_unref (contents);
+    g_free (path);
+}
+
+void
+nautilus_directory_listing_cache_builder_free (NautilusDirectoryListingCacheBuilder *builder)
+{
+    g_array_free (builder->entries, TRUE);
+    g_string_free (builder->strings, TRUE);
+    g_free (builder);
+}
+
+void
+nautilus_directory_listing_cache_remove (GFile *location)
+{
+    char *path;
+
+    path = get_cache_path (location);
+    g_unlink (path);
+    g_free (path);
+}
@@ -0,0 +1,53 @@
+/*
+   nautilus-directory-listing-cache.h: On-disk cache of directory listings.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef NAUTILUS_DIRECTORY_LISTING_CACHE_H
+#define NAUTILUS_DIRECTORY_LISTING_CACHE_H
+
+#include <gio/gio.h>
+
+/* The attributes of a directory a cached listing is validated against. */
+#define NAUTILUS_DIRECTORY_LISTING_CACHE_ATTRIBUTES \
+	G_FILE_ATTRIBUTE_TIME_MODIFIED "," \
+	G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC "," \
+	G_FILE_ATTRIBUTE_UNIX_DEVICE "," \
+	G_FILE_ATTRIBUTE_UNIX_INODE
+
+typedef struct NautilusDirectoryListingCacheBuilder NautilusDirectoryListingCacheBuilder;
+
+/* All of these are safe to call from any thread, and do blocking I/O. */
+
+/* Returns the cached listing of the directory as a list of partial
+ * GFileInfo objects, or NULL if there is none or the directory changed
+ * since it was saved. directory_info must have the attributes above.
+ */
+GList *                               nautilus_directory_listing_cache_load          (GFile                                *location,
+										      GFileInfo                            *directory_info);
+
+NautilusDirectoryListingCacheBuilder *nautilus_directory_listing_cache_builder_new   (void);
+void                                  nautilus_directory_listing_cache_builder_add   (NautilusDirectoryListingCacheBuilder *builder,
+										      GFileInfo                            *info);
+/* Saves the listing if the directory is large enough to be worth it,
+ * otherwise removes any stale cache of it.
+ */
+void                                  nautilus_directory_listing_cache_builder_save  (NautilusDirectoryListingCacheBuilder *builder,
+										      GFile                                *location,
+										      GFileInfo                            *directory_info);
+void                                  nautilus_directory_listing_cache_builder_free  (NautilusDirectoryListingCacheBuilder *builder);
+void                                  nautilus_directory_listing_cache_remove        (GFile                                *location);
+
+#endif /* NAUTILUS_DIRECTORY_LISTING_CACHE_H */
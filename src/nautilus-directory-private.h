@@ -40,6 +40,7 @@ typedef struct MimeListState MimeListState;
 typedef struct ThumbnailState ThumbnailState;
 typedef struct MountState MountState;
 typedef struct FilesystemInfoState FilesystemInfoState;
+typedef struct AsyncJobDomain AsyncJobDomain;
 
 typedef enum {
 	REQUEST_LINK_INFO,
@@ -69,8 +70,17 @@ struct NautilusDirectoryDetails
 
 	/* The file objects. */
 	NautilusFile *as_file;
-	GList *file_list;
-	GHashTable *file_hash;
+
+	/* The file table, in no particular order. Files know their own
+	 * index in it, so they can be removed in constant time.
+	 */
+	GPtrArray *files;
+	GHashTable *file_hash; /* name -> NautilusFile */
+
+	/* Files confirmed in an older generation of the table than this
+	 * are unconfirmed, see nautilus_directory_mark_all_files_unconfirmed().
+	 */
+	guint file_generation;
 
 	/* Queues of files needing some I/O done. */
 	NautilusFileQueue *high_priority_queue;
@@ -92,6 +102,11 @@ struct NautilusDirectoryDetails
 	gboolean in_async_service_loop;
 	gboolean state_changed;
 
+	/* Async. job accounting, see async_job_start(). */
+	AsyncJobDomain *async_job_domain;
+	int async_job_count;
+	GHashTable *async_job_start_times; /* job name -> GArray of start times */
+
 	gboolean file_list_monitored;
 	gboolean directory_loaded;
 	gboolean directory_loaded_sent_notification;
@@ -103,23 +118,22 @@ struct NautilusDirectoryDetails
 
 	GList *new_files_in_progress; /* list of NewFilesState * */
 
-	DirectoryCountState *count_in_progress;
+	/* Attribute fetches that can have several requests in flight
+	 * at once, up to the attribute pipeline depth.
+	 */
+	GList *count_in_progress; /* list of DirectoryCountState * */
+	GList *mime_list_in_progress; /* list of MimeListState * */
+	GList *get_info_in_progress; /* list of GetInfoState * */
+	GList *thumbnail_in_progress; /* list of ThumbnailState * */
 
 	NautilusFile *deep_count_file;
 	DeepCountState *deep_count_in_progress;
 
-	MimeListState *mime_list_in_progress;
-
-	NautilusFile *get_info_file;
-	GetInfoState *get_info_in_progress;
-
 	NautilusFile *extension_info_file;
 	NautilusInfoProvider *extension_info_provider;
 	NautilusOperationHandle *extension_info_in_progress;
 	guint extension_info_idle;
 
-	ThumbnailState *thumbnail_state;
-
 	MountState *mount_state;
 
 	FilesystemInfoState *filesystem_info_state;
@@ -210,11 +224,21 @@ void               nautilus_directory_add_file_monitors               (NautilusD
 								       FileMonitors              *monitors);
 void               nautilus_directory_add_file                        (NautilusDirectory         *directory,
 								       NautilusFile              *file);
-GList *            nautilus_directory_begin_file_name_change          (NautilusDirectory         *directory,
+gboolean           nautilus_directory_begin_file_name_change          (NautilusDirectory         *directory,
 								       NautilusFile              *file);
 void               nautilus_directory_end_file_name_change            (NautilusDirectory         *directory,
 								       NautilusFile              *file,
-								       GList                     *node);
+								       gboolean                   was_in_directory);
+GList *            nautilus_directory_list_files                      (NautilusDirectory         *directory);
+gboolean           nautilus_directory_is_file_unconfirmed             (NautilusDirectory         *directory,
+								       NautilusFile              *file);
+void               nautilus_directory_set_file_unconfirmed            (NautilusDirectory         *directory,
+								       NautilusFile              *file,
+								       gboolean                   unconfirmed);
+void               nautilus_directory_mark_all_files_unconfirmed      (NautilusDirectory         *directory);
+void               nautilus_directory_invalidate_deep_count_cache     (GFile                     *location);
+void               nautilus_directory_forget_deep_counts              (GFile                     *location);
+gboolean           nautilus_directory_has_unconfirmed_files           (NautilusDirectory         *directory);
 void               nautilus_directory_moved                           (const char                *from_uri,
 								       const char                *to_uri);
 /* Interface to the work queue. */
@@ -227,3 +251,4 @@ void               nautilus_directory_remove_file_from_work_queue     (NautilusD
 
 /* debugging functions */
 int                nautilus_directory_number_outstanding              (void);
+char *             nautilus_directory_get_async_job_stats             (void);
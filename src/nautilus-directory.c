@@ -27,6 +27,7 @@
 #include "nautilus-file-private.h"
 #include "nautilus-file-utilities.h"
 #include "nautilus-search-directory.h"
+#include "nautilus-search-engine-index.h"
 #include "nautilus-favorite-directory.h"
 #include "nautilus-search-directory-file.h"
 #include "nautilus-vfs-file.h"
@@ -76,36 +77,41 @@ real_contains_file (NautilusDirectory *directory,
 static gboolean
 real_are_all_files_seen (NautilusDirectory *directory)
 {
-    return directory->details->directory_loaded;
+    /* The loader may be done while its files are still being handed
+     * out in batches.
+     */
+    return directory->details->directory_loaded &&
+           directory->details->directory_loaded_sent_notification;
 }
 
 static gboolean
 real_is_not_empty (NautilusDirectory *directory)
 {
-    return directory->details->file_list != NULL;
-}
-
-static gboolean
-is_tentative (NautilusFile *file,
-              gpointer      callback_data)
-{
-    g_assert (callback_data == NULL);
-
-    /* Avoid returning files with !is_added, because these
-     * will later be sent with the files_added signal, and a
-     * user doing get_file_list + files_added monitoring will
-     * then see the file twice */
-    return !file->details->got_file_info || !file->details->is_added;
+    return directory->details->files->len > 0;
 }
 
 static GList *
 real_get_file_list (NautilusDirectory *directory)
 {
-    GList *tentative_files, *non_tentative_files;
+    GList *non_tentative_files;
+    NautilusFile *file;
+    guint i;
+
+    non_tentative_files = NULL;
+    for (i = 0; i < directory->details->files->len; i++)
+    {
+        file = g_ptr_array_index (directory->details->files, i);
 
-    tentative_files = nautilus_file_list_filter (directory->details->file_list,
-                                                 &non_tentative_files, is_tentative, NULL);
-    nautilus_file_list_free (tentative_files);
+        /* Avoid returning files with !is_added, because these
+         * will later be sent with the files_added signal, and a
+         * user doing get_file_list + files_added monitoring will
+         * then see the file twice */
+        if (file->details->got_file_info && file->details->is_added)
+        {
+            non_tentative_files = g_list_prepend (non_tentative_files,
+                                                  nautilus_file_ref (file));
+        }
+    }
 
     return non_tentative_files;
 }
@@ -194,7 +200,8 @@ nautilus_directory_finalize (GObject *object)
         g_object_unref (directory->details->location);
     }
 
-    g_assert (directory->details->file_list == NULL);
+    g_assert (directory->details->files->len == 0);
+    g_ptr_array_free (directory->details->files, TRUE);
     g_hash_table_destroy (directory->details->file_hash);
 
     nautilus_file_queue_destroy (directory->details->high_priority_queue);
@@ -323,6 +330,7 @@ static void
 nautilus_directory_init (NautilusDirectory *directory)
 {
     directory->details = G_TYPE_INSTANCE_GET_PRIVATE ((directory), NAUTILUS_TYPE_DIRECTORY, NautilusDirectoryDetails);
+    directory->details->files = g_ptr_array_new ();
     directory->details->file_hash = g_hash_table_new (g_str_hash, g_str_equal);
     directory->details->high_priority_queue = nautilus_file_queue_new ();
     directory->details->low_priority_queue = nautilus_file_queue_new ();
@@ -398,7 +406,7 @@ emit_change_signals_for_all_files (NautilusDirectory *directory)
 {
     GList *files;
 
-    files = g_list_copy (directory->details->file_list);
+    files = nautilus_directory_list_files (directory);
     if (directory->details->as_file != NULL)
     {
         files = g_list_prepend (files, directory->details->as_file);
@@ -838,56 +846,49 @@ nautilus_directory_are_all_files_seen (NautilusDirectory *directory)
 
 static void
 add_to_hash_table (NautilusDirectory *directory,
-                   NautilusFile      *file,
-                   GList             *node)
+                   NautilusFile      *file)
 {
     const char *name;
 
     name = eel_ref_str_peek (file->details->name);
 
-    g_assert (node != NULL);
     g_assert (g_hash_table_lookup (directory->details->file_hash,
                                    name) == NULL);
-    g_hash_table_insert (directory->details->file_hash, (char *) name, node);
+    g_hash_table_insert (directory->details->file_hash, (char *) name, file);
 }
 
-static GList *
+static gboolean
 extract_from_hash_table (NautilusDirectory *directory,
                          NautilusFile      *file)
 {
     const char *name;
-    GList *node;
 
     name = eel_ref_str_peek (file->details->name);
     if (name == NULL)
     {
-        return NULL;
+        return FALSE;
     }
 
-    /* Find the list node in the hash table. */
-    node = g_hash_table_lookup (directory->details->file_hash, name);
-    g_hash_table_remove (directory->details->file_hash, name);
-
-    return node;
+    return g_hash_table_remove (directory->details->file_hash, name);
 }
 
 void
 nautilus_directory_add_file (NautilusDirectory *directory,
                              NautilusFile      *file)
 {
-    GList *node;
     gboolean add_to_work_queue;
 
     g_assert (NAUTILUS_IS_DIRECTORY (directory));
     g_assert (NAUTILUS_IS_FILE (file));
     g_assert (file->details->name != NULL);
 
-    /* Add to list. */
-    node = g_list_prepend (directory->details->file_list, file);
-    directory->details->file_list = node;
+    /* Add to the file table. */
+    file->details->directory_index = directory->details->files->len;
+    file->details->confirmed_generation = directory->details->file_generation;
+    g_ptr_array_add (directory->details->files, file);
 
     /* Add to hash table. */
-    add_to_hash_table (directory, file, node);
+    add_to_hash_table (directory, file);
 
     directory->details->confirmed_file_count++;
 
@@ -916,25 +917,32 @@ void
 nautilus_directory_remove_file (NautilusDirectory *directory,
                                 NautilusFile      *file)
 {
-    GList *node;
+    GPtrArray *files;
+    NautilusFile *last;
+    guint index;
+    gboolean was_in_hash_table;
 
     g_assert (NAUTILUS_IS_DIRECTORY (directory));
     g_assert (NAUTILUS_IS_FILE (file));
     g_assert (file->details->name != NULL);
 
-    /* Find the list node in the hash table. */
-    node = extract_from_hash_table (directory, file);
-    g_assert (node != NULL);
-    g_assert (node->data == file);
+    was_in_hash_table = extract_from_hash_table (directory, file);
+    g_assert (was_in_hash_table);
 
-    /* Remove the item from the list. */
-    directory->details->file_list = g_list_remove_link
-                                        (directory->details->file_list, node);
-    g_list_free_1 (node);
+    /* Move the last file of the table into the slot of this one. */
+    files = directory->details->files;
+    index = file->details->directory_index;
+    g_assert (index < files->len);
+    g_assert (g_ptr_array_index (files, index) == file);
+
+    last = g_ptr_array_index (files, files->len - 1);
+    g_ptr_array_index (files, index) = last;
+    last->details->directory_index = index;
+    g_ptr_array_set_size (files, files->len - 1);
 
     nautilus_directory_remove_file_from_work_queue (directory, file);
 
-    if (!file->details->unconfirmed)
+    if (!nautilus_directory_is_file_unconfirmed (directory, file))
     {
         directory->details->confirmed_file_count--;
     }
@@ -946,38 +954,97 @@ nautilus_directory_remove_file (NautilusDirectory *directory,
     }
 }
 
-GList *
+gboolean
 nautilus_directory_begin_file_name_change (NautilusDirectory *directory,
                                            NautilusFile      *file)
 {
-    /* Find the list node in the hash table. */
+    /* Take the file out of the hash table, it stays in the table. */
     return extract_from_hash_table (directory, file);
 }
 
 void
 nautilus_directory_end_file_name_change (NautilusDirectory *directory,
                                          NautilusFile      *file,
-                                         GList             *node)
+                                         gboolean           was_in_directory)
+{
+    /* Put the file back in the hash table under its new name. */
+    if (was_in_directory)
+    {
+        add_to_hash_table (directory, file);
+    }
+}
+
+/* Returns the files of the directory, most recently added first.
+ * The files are not reffed, free the list with g_list_free().
+ */
+GList *
+nautilus_directory_list_files (NautilusDirectory *directory)
 {
-    /* Add the list node to the hash table. */
-    if (node != NULL)
+    GList *files;
+    guint i;
+
+    files = NULL;
+    for (i = 0; i < directory->details->files->len; i++)
     {
-        add_to_hash_table (directory, file, node);
+        files = g_list_prepend (files, g_ptr_array_index (directory->details->files, i));
     }
+
+    return files;
+}
+
+gboolean
+nautilus_directory_is_file_unconfirmed (NautilusDirectory *directory,
+                                        NautilusFile      *file)
+{
+    return file->details->confirmed_generation != directory->details->file_generation;
+}
+
+void
+nautilus_directory_set_file_unconfirmed (NautilusDirectory *directory,
+                                         NautilusFile      *file,
+                                         gboolean           unconfirmed)
+{
+    if (nautilus_directory_is_file_unconfirmed (directory, file) == unconfirmed)
+    {
+        return;
+    }
+
+    if (unconfirmed)
+    {
+        file->details->confirmed_generation = directory->details->file_generation - 1;
+        directory->details->confirmed_file_count--;
+    }
+    else
+    {
+        file->details->confirmed_generation = directory->details->file_generation;
+        directory->details->confirmed_file_count++;
+    }
+}
+
+/* Starting a new generation of the file table unconfirms all the
+ * files in it at once.
+ */
+void
+nautilus_directory_mark_all_files_unconfirmed (NautilusDirectory *directory)
+{
+    directory->details->file_generation++;
+    directory->details->confirmed_file_count = 0;
+}
+
+gboolean
+nautilus_directory_has_unconfirmed_files (NautilusDirectory *directory)
+{
+    return directory->details->confirmed_file_count < (int) directory->details->files->len;
 }
 
 NautilusFile *
 nautilus_directory_find_file_by_name (NautilusDirectory *directory,
                                       const char        *name)
 {
-    GList *node;
-
     g_return_val_if_fail (NAUTILUS_IS_DIRECTORY (directory), NULL);
     g_return_val_if_fail (name != NULL, NULL);
 
-    node = g_hash_table_lookup (directory->details->file_hash,
-                                name);
-    return node == NULL ? NULL : NAUTILUS_FILE (node->data);
+    return g_hash_table_lookup (directory->details->file_hash, name);
 }
 
 void
@@ -1203,6 +1270,8 @@ nautilus_directory_notify_files_added (GList *files)
     NautilusFile *file;
     GFile *location, *parent;
 
+    nautilus_search_engine_index_files_added (files);
+
     nautilus_profile_start (NULL);
 
     /* Make a list of added files in each directory. */
@@ -1215,6 +1284,8 @@ nautilus_directory_notify_files_added (GList *files)
     {
         location = p->data;
 
+        nautilus_directory_invalidate_deep_count_cache (location);
+
         /* See if the directory is already known. */
         directory = get_parent_directory_if_exists (location);
         if (directory == NULL)
@@ -1302,6 +1373,8 @@ nautilus_directory_notify_files_changed (GList *files)
     {
         location = node->data;
 
+        nautilus_directory_invalidate_deep_count_cache (location);
+
         /* Find the file. */
         file = nautilus_file_get_existing (location);
         if (file != NULL)
@@ -1334,6 +1407,8 @@ nautilus_directory_notify_files_removed (GList *files)
     NautilusFile *file;
     GFile *location;
 
+    nautilus_search_engine_index_files_removed (files);
+
     /* Make a list of changed files in each directory. */
     changed_lists = g_hash_table_new (NULL, NULL);
 
@@ -1345,6 +1420,8 @@ nautilus_directory_notify_files_removed (GList *files)
     {
         location = p->data;
 
+        nautilus_directory_invalidate_deep_count_cache (location);
+
         /* Update file count for parent directory if anyone might care. */
         directory = get_parent_directory_if_exists (location);
         if (directory != NULL)
@@ -1490,7 +1567,7 @@ nautilus_directory_moved_internal (GFile *old_location,
             }
             affected_files = g_list_concat
                                  (affected_files,
-                                 nautilus_file_list_copy (directory->details->file_list));
+                                 nautilus_file_list_ref (nautilus_directory_list_files (directory)));
         }
 
         nautilus_directory_unref (directory);
@@ -1547,6 +1624,8 @@ nautilus_directory_notify_files_moved (GList *file_pairs)
     NautilusFileAttributes cancel_attributes;
     GFile *to_location, *from_location;
 
+    nautilus_search_engine_index_files_moved (file_pairs);
+
     /* Make a list of added and changed files in each directory. */
     new_files_list = NULL;
     added_lists = g_hash_table_new (NULL, NULL);
@@ -1564,6 +1643,9 @@ nautilus_directory_notify_files_moved (GList *file_pairs)
         from_location = pair->from;
         to_location = pair->to;
 
+        nautilus_directory_invalidate_deep_count_cache (from_location);
+        nautilus_directory_invalidate_deep_count_cache (to_location);
+
         /* Handle overwriting a file. */
         file = nautilus_file_get_existing (to_location);
         if (file != NULL)
@@ -2078,7 +2160,7 @@ nautilus_self_check_directory (void)
         gtk_main_iteration ();
     }
 
-    EEL_CHECK_BOOLEAN_RESULT (directory->details->file_list == NULL, TRUE);
+    EEL_CHECK_BOOLEAN_RESULT (directory->details->files->len == 0, TRUE);
 
     EEL_CHECK_INTEGER_RESULT (g_hash_table_size (directories), 1);
 
@@ -33,102 +33,75 @@ typedef enum
     CHANGE_POSITION_REMOVE
 } NautilusFileChangeKind;
 
-typedef struct
+typedef struct NautilusFileChange NautilusFileChange;
+
+struct NautilusFileChange
 {
+    NautilusFileChange *next;
     NautilusFileChangeKind kind;
     GFile *from;
     GFile *to;
     GdkPoint point;
     int screen;
-} NautilusFileChange;
-
-typedef struct
-{
-    GList *head;
-    GList *tail;
-    GMutex mutex;
-} NautilusFileChangesQueue;
-
-static NautilusFileChangesQueue *
-nautilus_file_changes_queue_new (void)
-{
-    NautilusFileChangesQueue *result;
-
-    result = g_new0 (NautilusFileChangesQueue, 1);
-    g_mutex_init (&result->mutex);
-
-    return result;
-}
-
-static NautilusFileChangesQueue *
-nautilus_file_changes_queue_get (void)
-{
-    static NautilusFileChangesQueue *file_changes_queue;
+};
 
-    if (file_changes_queue == NULL)
-    {
-        file_changes_queue = nautilus_file_changes_queue_new ();
-    }
+/* Changes are queued from file operation threads and consumed on the
+ * main thread. Producers push onto a lock-free stack, and the consumer
+ * takes the whole stack at once and reverses it, so nobody ever waits
+ * on anybody else.
+ */
+static NautilusFileChange *queued_changes;
 
-    return file_changes_queue;
-}
+/* How many changes went through the queue, and how many of them were
+ * folded into others before being sent off.
+ */
+static guint64 n_changes_consumed;
+static guint64 n_changes_merged;
 
 static void
-nautilus_file_changes_queue_add_common (NautilusFileChangesQueue *queue,
-                                        NautilusFileChange       *new_item)
+nautilus_file_changes_queue_add_common (NautilusFileChange *new_item)
 {
-    /* enqueue the new queue item while locking down the list */
-    g_mutex_lock (&queue->mutex);
+    NautilusFileChange *head;
 
-    queue->head = g_list_prepend (queue->head, new_item);
-    if (queue->tail == NULL)
+    do
     {
-        queue->tail = queue->head;
+        head = g_atomic_pointer_get (&queued_changes);
+        new_item->next = head;
     }
-
-    g_mutex_unlock (&queue->mutex);
+    while (!g_atomic_pointer_compare_and_exchange (&queued_changes, head, new_item));
 }
 
 void
 nautilus_file_changes_queue_file_added (GFile *location)
 {
     NautilusFileChange *new_item;
-    NautilusFileChangesQueue *queue;
-
-    queue = nautilus_file_changes_queue_get ();
 
     new_item = g_new0 (NautilusFileChange, 1);
     new_item->kind = CHANGE_FILE_ADDED;
     new_item->from = g_object_ref (location);
-    nautilus_file_changes_queue_add_common (queue, new_item);
+    nautilus_file_changes_queue_add_common (new_item);
 }
 
 void
 nautilus_file_changes_queue_file_changed (GFile *location)
 {
     NautilusFileChange *new_item;
-    NautilusFileChangesQueue *queue;
-
-    queue = nautilus_file_changes_queue_get ();
 
     new_item = g_new0 (NautilusFileChange, 1);
     new_item->kind = CHANGE_FILE_CHANGED;
     new_item->from = g_object_ref (location);
-    nautilus_file_changes_queue_add_common (queue, new_item);
+    nautilus_file_changes_queue_add_common (new_item);
 }
 
 void
 nautilus_file_changes_queue_file_removed (GFile *location)
 {
     NautilusFileChange *new_item;
-    NautilusFileChangesQueue *queue;
-
-    queue = nautilus_file_changes_queue_get ();
 
     new_item = g_new0 (NautilusFileChange, 1);
     new_item->kind = CHANGE_FILE_REMOVED;
     new_item->from = g_object_ref (location);
-    nautilus_file_changes_queue_add_common (queue, new_item);
+    nautilus_file_changes_queue_add_common (new_item);
 }
 
 void
@@ -136,15 +109,12 @@ nautilus_file_changes_queue_file_moved (GFile *from,
                                         GFile *to)
 {
     NautilusFileChange *new_item;
-    NautilusFileChangesQueue *queue;
 
-    queue = nautilus_file_changes_queue_get ();
-
-    new_item = g_new (NautilusFileChange, 1);
+    new_item = g_new0 (NautilusFileChange, 1);
     new_item->kind = CHANGE_FILE_MOVED;
     new_item->from = g_object_ref (from);
     new_item->to = g_object_ref (to);
-    nautilus_file_changes_queue_add_common (queue, new_item);
+    nautilus_file_changes_queue_add_common (new_item);
 }
 
 void
@@ -153,59 +123,47 @@ nautilus_file_changes_queue_schedule_position_set (GFile    *location,
                                                    int       screen)
 {
     NautilusFileChange *new_item;
-    NautilusFileChangesQueue *queue;
 
-    queue = nautilus_file_changes_queue_get ();
-
-    new_item = g_new (NautilusFileChange, 1);
+    new_item = g_new0 (NautilusFileChange, 1);
     new_item->kind = CHANGE_POSITION_SET;
     new_item->from = g_object_ref (location);
     new_item->point = point;
     new_item->screen = screen;
-    nautilus_file_changes_queue_add_common (queue, new_item);
+    nautilus_file_changes_queue_add_common (new_item);
 }
 
 void
 nautilus_file_changes_queue_schedule_position_remove (GFile *location)
 {
     NautilusFileChange *new_item;
-    NautilusFileChangesQueue *queue;
 
-    queue = nautilus_file_changes_queue_get ();
-
-    new_item = g_new (NautilusFileChange, 1);
+    new_item = g_new0 (NautilusFileChange, 1);
     new_item->kind = CHANGE_POSITION_REMOVE;
     new_item->from = g_object_ref (location);
-    nautilus_file_changes_queue_add_common (queue, new_item);
+    nautilus_file_changes_queue_add_common (new_item);
 }
 
+/* Takes all queued changes, oldest first. */
 static NautilusFileChange *
-nautilus_file_changes_queue_get_change (NautilusFileChangesQueue *queue)
+nautilus_file_changes_queue_take_changes (void)
 {
-    GList *new_tail;
-    NautilusFileChange *result;
+    NautilusFileChange *head, *change, *next, *result;
 
-    g_assert (queue != NULL);
-
-    /* dequeue the tail item while locking down the list */
-    g_mutex_lock (&queue->mutex);
-
-    if (queue->tail == NULL)
+    do
     {
-        result = NULL;
+        head = g_atomic_pointer_get (&queued_changes);
     }
-    else
+    while (head != NULL &&
+           !g_atomic_pointer_compare_and_exchange (&queued_changes, head, NULL));
+
+    result = NULL;
+    for (change = head; change != NULL; change = next)
     {
-        new_tail = queue->tail->prev;
-        result = queue->tail->data;
-        queue->head = g_list_remove_link (queue->head,
-                                          queue->tail);
-        g_list_free_1 (queue->tail);
-        queue->tail = new_tail;
+        next = change->next;
+        change->next = result;
+        result = change;
     }
 
-    g_mutex_unlock (&queue->mutex);
-
     return result;
 }
 
@@ -214,6 +172,84 @@ enum
     CONSUME_CHANGES_MAX_CHUNK = 20
 };
 
+static void
+change_free (NautilusFileChange *change)
+{
+    g_clear_object (&change->from);
+    g_clear_object (&change->to);
+    g_free (change);
+}
+
+/* Folds a change into an earlier pending change of the same location,
+ * if there is one:
+ *
+ *   added + changed   -> added
+ *   changed + changed -> changed
+ *   changed + removed -> removed
+ *   added + removed   -> removed (the file may have existed before,
+ *                        an overwrite also counts as added)
+ *   same kind twice   -> once
+ *
+ * Changes are only folded towards the earlier one, and never across a
+ * move of the location, so the order of changes for any one location
+ * stays the same. Returns the number of changes merged away.
+ */
+static guint
+coalesce_change (GPtrArray          *changes,
+                 GHashTable         *pending,
+                 NautilusFileChange *change)
+{
+    NautilusFileChange *previous;
+    guint index;
+
+    switch (change->kind)
+    {
+        case CHANGE_FILE_ADDED:
+        case CHANGE_FILE_CHANGED:
+        case CHANGE_FILE_REMOVED:
+        {
+            index = GPOINTER_TO_UINT (g_hash_table_lookup (pending, change->from));
+            previous = index > 0 ? g_ptr_array_index (changes, index - 1) : NULL;
+
+            if (previous != NULL &&
+                (previous->kind == change->kind ||
+                 (previous->kind == CHANGE_FILE_ADDED && change->kind == CHANGE_FILE_CHANGED)))
+            {
+                change_free (change);
+                return 1;
+            }
+
+            g_ptr_array_add (changes, change);
+            g_hash_table_replace (pending, change->from, GUINT_TO_POINTER (changes->len));
+
+            if (previous != NULL && change->kind == CHANGE_FILE_REMOVED)
+            {
+                /* The removal makes the earlier change moot. */
+                g_ptr_array_index (changes, index - 1) = NULL;
+                change_free (previous);
+                return 1;
+            }
+        }
+        break;
+
+        case CHANGE_FILE_MOVED:
+        {
+            g_hash_table_remove (pending, change->from);
+            g_hash_table_remove (pending, change->to);
+            g_ptr_array_add (changes, change);
+        }
+        break;
+
+        default:
+        {
+            g_ptr_array_add (changes, change);
+        }
+        break;
+    }
+
+    return 0;
+}
+
 static void
 pairs_list_free (GList *pairs)
 {
@@ -261,8 +297,11 @@ nautilus_file_changes_consume_changes (gboolean consume_all)
     GFilePair *pair;
     NautilusFileChangesQueuePosition *position_set;
     guint chunk_count;
-    NautilusFileChangesQueue *queue;
+    NautilusFileChange *next_change;
     gboolean flush_needed;
+    GPtrArray *pending_changes;
+    GHashTable *pending_locations;
+    guint n_merged;
 
 
     additions = NULL;
@@ -271,16 +310,46 @@ nautilus_file_changes_consume_changes (gboolean consume_all)
     moves = NULL;
     position_set_requests = NULL;
 
-    queue = nautilus_file_changes_queue_get ();
+    /* Take everything that is queued, folding changes of the same
+     * location together, so storms of changes to the same files
+     * don't turn into lots of small notifications.
+     */
+    pending_changes = g_ptr_array_new ();
+    pending_locations = g_hash_table_new (g_file_hash, (GEqualFunc) g_file_equal);
+    n_merged = 0;
+    for (change = nautilus_file_changes_queue_take_changes (); change != NULL; change = next_change)
+    {
+        next_change = change->next;
+        change->next = NULL;
+        n_changes_consumed++;
+        n_merged += coalesce_change (pending_changes, pending_locations, change);
+    }
+    g_hash_table_destroy (pending_locations);
+
+    if (n_merged > 0)
+    {
+        n_changes_merged += n_merged;
+        g_debug ("Merged %u file changes, %" G_GUINT64_FORMAT " of %" G_GUINT64_FORMAT " so far",
+                 n_merged, n_changes_merged, n_changes_consumed);
+    }
 
-    /* Consume changes from the queue, stuffing them into one of three lists,
+    /* Go through the changes, stuffing them into one of three lists,
      * keep doing it while the changes are of the same kind, then send them off.
      * This is to ensure that the changes get sent off in the same order that they
      * arrived.
      */
     for (chunk_count = 0;; chunk_count++)
     {
-        change = nautilus_file_changes_queue_get_change (queue);
+        change = NULL;
+        while (change == NULL && chunk_count < pending_changes->len)
+        {
+            change = g_ptr_array_index (pending_changes, chunk_count);
+            if (change == NULL)
+            {
+                /* Merged into a later change. */
+                chunk_count++;
+            }
+        }
 
         /* figure out if we need to flush the pending changes that we collected sofar */
 
@@ -364,6 +433,7 @@ nautilus_file_changes_consume_changes (gboolean consume_all)
         if (change == NULL)
         {
             /* we are done */
+            g_ptr_array_free (pending_changes, TRUE);
             return;
         }
 
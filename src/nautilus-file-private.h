@@ -32,6 +32,12 @@
 #define NAUTILUS_FILE_DEFAULT_ATTRIBUTES				\
 	"standard::*,access::*,mountable::*,time::*,unix::*,owner::*,selinux::*,thumbnail::*,id::filesystem,trash::orig-path,trash::deletion-date,metadata::*,recent::*"
 
+/* GFileInfo data key under which the directory loader thread stashes a
+ * precomputed display name collation key, so it doesn't have to be
+ * computed on the main thread.
+ */
+#define NAUTILUS_FILE_INFO_COLLATION_KEY "nautilus-file-info-collation-key"
+
 /* These are in the typical sort order. Known things come first, then
  * things where we can't know, finally things where we don't yet know.
  */
@@ -44,6 +50,12 @@ typedef enum {
 struct NautilusFileDetails
 {
 	NautilusDirectory *directory;
+
+	/* Slot of the file in the file table of the directory, and the
+	 * generation of that table the file was last confirmed in.
+	 */
+	guint directory_index;
+	guint confirmed_generation;
 	
 	eel_ref_str name;
 
@@ -134,7 +146,6 @@ struct NautilusFileDetails
 	/* boolean fields: bitfield to save space, since there can be
            many NautilusFile objects. */
 
-	eel_boolean_bit unconfirmed                   : 1;
 	eel_boolean_bit is_gone                       : 1;
 	/* Set when emitting files_added on the directory to make sure we
 	   add a file, and only once */
@@ -210,6 +221,16 @@ struct NautilusFileDetails
 	gdouble search_relevance;
 	gchar *fts_snippet;
 
+	/* Keys for sorting by type and by starred, worked out the first
+	 * time they are needed and forgotten when the file changes. The
+	 * type key is interned, and the starred bit is valid for the
+	 * favorites generation of the tag manager it was read in.
+	 */
+	const char *type_collation_key;
+	guint favorite_generation; /* 0 is unknown */
+	eel_boolean_bit type_collation_key_is_up_to_date : 1;
+	eel_boolean_bit is_favorite                   : 1;
+
 	guint64 free_space; /* (guint)-1 for unknown */
 	time_t free_space_read; /* The time free_space was updated, or 0 for never */
 };
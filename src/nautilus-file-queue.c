@@ -128,3 +128,27 @@ nautilus_file_queue_is_empty (NautilusFileQueue *queue)
 {
     return (queue->head == NULL);
 }
+
+gboolean
+nautilus_file_queue_contains (NautilusFileQueue *queue,
+                              NautilusFile      *file)
+{
+    return g_hash_table_lookup (queue->item_to_link_map, file) != NULL;
+}
+
+GList *
+nautilus_file_queue_peek (NautilusFileQueue *queue,
+                          guint              n_files)
+{
+    GList *result;
+    GList *node;
+
+    result = NULL;
+    for (node = queue->head; node != NULL && n_files > 0; node = node->next)
+    {
+        result = g_list_prepend (result, nautilus_file_ref (node->data));
+        n_files--;
+    }
+
+    return g_list_reverse (result);
+}
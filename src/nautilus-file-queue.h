@@ -46,4 +46,14 @@ NautilusFile *     nautilus_file_queue_head     (NautilusFileQueue *queue);
 
 gboolean           nautilus_file_queue_is_empty (NautilusFileQueue *queue);
 
+/* Check if a file is on the queue, in constant time. */
+gboolean           nautilus_file_queue_contains (NautilusFileQueue *queue,
+						 NautilusFile      *file);
+
+/* Return a list with up to n_files files from the head of the queue,
+ * in queue order. The files are reffed, free with nautilus_file_list_free().
+ */
+GList *            nautilus_file_queue_peek     (NautilusFileQueue *queue,
+						 guint              n_files);
+
 #endif /* NAUTILUS_FILE_CHANGES_QUEUE_H */
@@ -215,11 +215,12 @@ nautilus_file_constructor (GType                  type,
     return object;
 }
 
-gboolean
-nautilus_file_set_display_name (NautilusFile *file,
-                                const char   *display_name,
-                                const char   *edit_name,
-                                gboolean      custom)
+static gboolean
+set_display_name_internal (NautilusFile *file,
+                           const char   *display_name,
+                           const char   *edit_name,
+                           gboolean      custom,
+                           const char   *collation_key)
 {
     gboolean changed;
 
@@ -269,7 +270,14 @@ nautilus_file_set_display_name (NautilusFile *file,
         }
 
         g_free (file->details->display_name_collation_key);
-        file->details->display_name_collation_key = g_utf8_collate_key_for_filename (display_name, -1);
+        if (collation_key != NULL)
+        {
+            file->details->display_name_collation_key = g_strdup (collation_key);
+        }
+        else
+        {
+            file->details->display_name_collation_key = g_utf8_collate_key_for_filename (display_name, -1);
+        }
     }
 
     if (g_strcmp0 (eel_ref_str_peek (file->details->edit_name), edit_name) != 0)
@@ -291,6 +299,15 @@ nautilus_file_set_display_name (NautilusFile *file,
     return changed;
 }
 
+gboolean
+nautilus_file_set_display_name (NautilusFile *file,
+                                const char   *display_name,
+                                const char   *edit_name,
+                                gboolean      custom)
+{
+    return set_display_name_internal (file, display_name, edit_name, custom, NULL);
+}
+
 static void
 nautilus_file_clear_display_name (NautilusFile *file)
 {
@@ -2623,7 +2640,7 @@ update_info_internal (NautilusFile *file,
                       GFileInfo    *info,
                       gboolean      update_name)
 {
-    GList *node;
+    gboolean in_directory;
     gboolean changed;
     gboolean is_symlink, is_hidden, is_mountpoint;
     gboolean has_permissions;
@@ -2678,10 +2695,12 @@ update_info_internal (NautilusFile *file,
     }
     file->details->got_file_info = TRUE;
 
-    changed |= nautilus_file_set_display_name (file,
-                                               g_file_info_get_display_name (info),
-                                               g_file_info_get_edit_name (info),
-                                               FALSE);
+    changed |= set_display_name_internal (file,
+                                          g_file_info_get_display_name (info),
+                                          g_file_info_get_edit_name (info),
+                                          FALSE,
+                                          g_object_get_data (G_OBJECT (info),
+                                                             NAUTILUS_FILE_INFO_COLLATION_KEY));
 
     file_type = g_file_info_get_file_type (info);
     if (file->details->type != file_type)
@@ -3094,8 +3113,8 @@ update_info_internal (NautilusFile *file,
         {
             changed = TRUE;
 
-            node = nautilus_directory_begin_file_name_change
-                       (file->details->directory, file);
+            in_directory = nautilus_directory_begin_file_name_change
+                               (file->details->directory, file);
 
             eel_ref_str_unref (file->details->name);
             if (g_strcmp0 (eel_ref_str_peek (file->details->display_name),
@@ -3119,7 +3138,7 @@ update_info_internal (NautilusFile *file,
             }
 
             nautilus_directory_end_file_name_change
-                (file->details->directory, file, node);
+                (file->details->directory, file, in_directory);
         }
     }
 
@@ -3152,7 +3171,7 @@ update_name_internal (NautilusFile *file,
                       const char   *name,
                       gboolean      in_directory)
 {
-    GList *node;
+    gboolean was_in_directory;
 
     g_assert (name != NULL);
 
@@ -3166,11 +3185,11 @@ update_name_internal (NautilusFile *file,
         return FALSE;
     }
 
-    node = NULL;
+    was_in_directory = FALSE;
     if (in_directory)
     {
-        node = nautilus_directory_begin_file_name_change
-                   (file->details->directory, file);
+        was_in_directory = nautilus_directory_begin_file_name_change
+                               (file->details->directory, file);
     }
 
     eel_ref_str_unref (file->details->name);
@@ -3184,7 +3203,7 @@ update_name_internal (NautilusFile *file,
     if (in_directory)
     {
         nautilus_directory_end_file_name_change
-            (file->details->directory, file, node);
+            (file->details->directory, file, was_in_directory);
     }
 
     return TRUE;
@@ -3595,15 +3614,41 @@ prepend_automatic_keywords (NautilusFile *file,
     return names;
 }
 
+static const char *
+get_type_collation_key (NautilusFile *file)
+{
+    g_autofree char *type_string = NULL;
+    g_autofree char *collation_key = NULL;
+
+    if (!file->details->type_collation_key_is_up_to_date)
+    {
+        /* There are only so many types, so the keys are interned and
+         * files of the same type share theirs.
+         */
+        type_string = nautilus_file_get_type_as_string (file);
+        if (type_string != NULL)
+        {
+            collation_key = g_utf8_collate_key (type_string, -1);
+            file->details->type_collation_key = g_intern_string (collation_key);
+        }
+        else
+        {
+            file->details->type_collation_key = NULL;
+        }
+        file->details->type_collation_key_is_up_to_date = TRUE;
+    }
+
+    return file->details->type_collation_key;
+}
+
 static int
 compare_by_type (NautilusFile *file_1,
                  NautilusFile *file_2)
 {
     gboolean is_directory_1;
     gboolean is_directory_2;
-    char *type_string_1;
-    char *type_string_2;
-    int result;
+    const char *key_1;
+    const char *key_2;
 
     /* Directories go first. Then, if mime types are identical,
      * don't bother getting strings (for speed). This assumes
@@ -3636,30 +3681,37 @@ compare_by_type (NautilusFile *file_1,
         return 0;
     }
 
-    type_string_1 = nautilus_file_get_type_as_string (file_1);
-    type_string_2 = nautilus_file_get_type_as_string (file_2);
+    key_1 = get_type_collation_key (file_1);
+    key_2 = get_type_collation_key (file_2);
 
-    if (type_string_1 == NULL || type_string_2 == NULL)
+    if (key_1 == key_2)
     {
-        if (type_string_1 != NULL)
-        {
-            return -1;
-        }
-
-        if (type_string_2 != NULL)
-        {
-            return 1;
-        }
-
         return 0;
     }
 
-    result = g_utf8_collate (type_string_1, type_string_2);
+    if (key_1 == NULL || key_2 == NULL)
+    {
+        return key_1 != NULL ? -1 : 1;
+    }
 
-    g_free (type_string_1);
-    g_free (type_string_2);
+    return strcmp (key_1, key_2);
+}
 
-    return result;
+static gboolean
+get_is_favorite (NautilusFile       *file,
+                 NautilusTagManager *tag_manager,
+                 guint               generation)
+{
+    g_autofree gchar *uri = NULL;
+
+    if (file->details->favorite_generation != generation)
+    {
+        uri = nautilus_file_get_uri (file);
+        file->details->is_favorite = nautilus_tag_manager_file_is_favorite (tag_manager, uri);
+        file->details->favorite_generation = generation;
+    }
+
+    return file->details->is_favorite;
 }
 
 static int
@@ -3667,20 +3719,18 @@ compare_by_favorite (NautilusFile *file_1,
                      NautilusFile *file_2)
 {
     NautilusTagManager *tag_manager;
-    g_autofree gchar *uri_1 = NULL;
-    g_autofree gchar *uri_2 = NULL;
+    guint generation;
     gboolean file_1_is_favorite;
     gboolean file_2_is_favorite;
 
     tag_manager = nautilus_tag_manager_get ();
+    generation = nautilus_tag_manager_get_favorites_generation (tag_manager);
 
-    uri_1 = nautilus_file_get_uri (file_1);
-    uri_2 = nautilus_file_get_uri (file_2);
+    file_1_is_favorite = get_is_favorite (file_1, tag_manager, generation);
+    file_2_is_favorite = get_is_favorite (file_2, tag_manager, generation);
+
+    g_object_unref (tag_manager);
 
-    file_1_is_favorite = nautilus_tag_manager_file_is_favorite (tag_manager,
-                                                                uri_1);
-    file_2_is_favorite = nautilus_tag_manager_file_is_favorite (tag_manager,
-                                                                uri_2);
     if (!!file_1_is_favorite == !!file_2_is_favorite)
     {
         return 0;
@@ -3974,83 +4024,76 @@ nautilus_file_compare_for_sort (NautilusFile         *file_1,
     return result;
 }
 
-int
-nautilus_file_compare_for_sort_by_attribute_q   (NautilusFile *file_1,
-                                                 NautilusFile *file_2,
-                                                 GQuark        attribute,
-                                                 gboolean      directories_first,
-                                                 gboolean      reversed)
+static gboolean
+get_sort_type_for_attribute_q (GQuark                attribute,
+                               NautilusFileSortType *sort_type)
 {
-    int result;
-
-    if (file_1 == file_2)
-    {
-        return 0;
-    }
-
-    /* Convert certain attributes into NautilusFileSortTypes and use
-     * nautilus_file_compare_for_sort()
-     */
     if (attribute == 0 || attribute == attribute_name_q)
     {
-        return nautilus_file_compare_for_sort (file_1, file_2,
-                                               NAUTILUS_FILE_SORT_BY_DISPLAY_NAME,
-                                               directories_first,
-                                               reversed);
+        *sort_type = NAUTILUS_FILE_SORT_BY_DISPLAY_NAME;
     }
     else if (attribute == attribute_size_q)
     {
-        return nautilus_file_compare_for_sort (file_1, file_2,
-                                               NAUTILUS_FILE_SORT_BY_SIZE,
-                                               directories_first,
-                                               reversed);
+        *sort_type = NAUTILUS_FILE_SORT_BY_SIZE;
     }
     else if (attribute == attribute_type_q)
     {
-        return nautilus_file_compare_for_sort (file_1, file_2,
-                                               NAUTILUS_FILE_SORT_BY_TYPE,
-                                               directories_first,
-                                               reversed);
+        *sort_type = NAUTILUS_FILE_SORT_BY_TYPE;
     }
     else if (attribute == attribute_favorite_q)
     {
-        return nautilus_file_compare_for_sort (file_1, file_2,
-                                               NAUTILUS_FILE_SORT_BY_FAVORITE,
-                                               directories_first,
-                                               reversed);
+        *sort_type = NAUTILUS_FILE_SORT_BY_FAVORITE;
     }
     else if (attribute == attribute_modification_date_q || attribute == attribute_date_modified_q || attribute == attribute_date_modified_with_time_q || attribute == attribute_date_modified_full_q)
     {
-        return nautilus_file_compare_for_sort (file_1, file_2,
-                                               NAUTILUS_FILE_SORT_BY_MTIME,
-                                               directories_first,
-                                               reversed);
+        *sort_type = NAUTILUS_FILE_SORT_BY_MTIME;
     }
     else if (attribute == attribute_accessed_date_q || attribute == attribute_date_accessed_q || attribute == attribute_date_accessed_full_q)
     {
-        return nautilus_file_compare_for_sort (file_1, file_2,
-                                               NAUTILUS_FILE_SORT_BY_ATIME,
-                                               directories_first,
-                                               reversed);
+        *sort_type = NAUTILUS_FILE_SORT_BY_ATIME;
     }
     else if (attribute == attribute_trashed_on_q || attribute == attribute_trashed_on_full_q)
     {
-        return nautilus_file_compare_for_sort (file_1, file_2,
-                                               NAUTILUS_FILE_SORT_BY_TRASHED_TIME,
-                                               directories_first,
-                                               reversed);
+        *sort_type = NAUTILUS_FILE_SORT_BY_TRASHED_TIME;
     }
     else if (attribute == attribute_search_relevance_q)
     {
-        return nautilus_file_compare_for_sort (file_1, file_2,
-                                               NAUTILUS_FILE_SORT_BY_SEARCH_RELEVANCE,
-                                               directories_first,
-                                               reversed);
+        *sort_type = NAUTILUS_FILE_SORT_BY_SEARCH_RELEVANCE;
     }
     else if (attribute == attribute_recency_q)
+    {
+        *sort_type = NAUTILUS_FILE_SORT_BY_RECENCY;
+    }
+    else
+    {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+int
+nautilus_file_compare_for_sort_by_attribute_q   (NautilusFile *file_1,
+                                                 NautilusFile *file_2,
+                                                 GQuark        attribute,
+                                                 gboolean      directories_first,
+                                                 gboolean      reversed)
+{
+    NautilusFileSortType sort_type;
+    int result;
+
+    if (file_1 == file_2)
+    {
+        return 0;
+    }
+
+    /* Convert certain attributes into NautilusFileSortTypes and use
+     * nautilus_file_compare_for_sort()
+     */
+    if (get_sort_type_for_attribute_q (attribute, &sort_type))
     {
         return nautilus_file_compare_for_sort (file_1, file_2,
-                                               NAUTILUS_FILE_SORT_BY_RECENCY,
+                                               sort_type,
                                                directories_first,
                                                reversed);
     }
@@ -4086,6 +4129,79 @@ nautilus_file_compare_for_sort_by_attribute_q   (NautilusFile *file_1,
     return result;
 }
 
+/**
+ * nautilus_file_prepare_for_threaded_sort:
+ * @file: A file object
+ * @sort_type: Sort criterion
+ *
+ * Works out what comparing @file for @sort_type would otherwise work out
+ * on demand, so nautilus_file_compare_for_sort() only reads the file and
+ * can be called from other threads until the file changes. Must be
+ * called from the main thread.
+ *
+ * Return value: FALSE if sorting by @sort_type can't be done off the
+ * main thread.
+ **/
+gboolean
+nautilus_file_prepare_for_threaded_sort (NautilusFile         *file,
+                                         NautilusFileSortType  sort_type)
+{
+    NautilusTagManager *tag_manager;
+
+    switch (sort_type)
+    {
+        case NAUTILUS_FILE_SORT_BY_SIZE:
+        {
+            /* Directories sort by their item count, which is asked to
+             * the directory itself.
+             */
+            return FALSE;
+        }
+
+        case NAUTILUS_FILE_SORT_BY_TYPE:
+        {
+            get_type_collation_key (file);
+        }
+        break;
+
+        case NAUTILUS_FILE_SORT_BY_FAVORITE:
+        {
+            tag_manager = nautilus_tag_manager_get ();
+            get_is_favorite (file, tag_manager,
+                             nautilus_tag_manager_get_favorites_generation (tag_manager));
+            g_object_unref (tag_manager);
+        }
+        break;
+
+        default:
+        {
+        }
+        break;
+    }
+
+    /* Ties are broken by name, which is set on first use. */
+    nautilus_file_peek_display_name (file);
+
+    return TRUE;
+}
+
+gboolean
+nautilus_file_prepare_for_threaded_sort_by_attribute_q (NautilusFile *file,
+                                                        GQuark        attribute)
+{
+    NautilusFileSortType sort_type;
+
+    if (!get_sort_type_for_attribute_q (attribute, &sort_type))
+    {
+        /* Other attributes are compared by their strings, which are
+         * built from all over the file.
+         */
+        return FALSE;
+    }
+
+    return nautilus_file_prepare_for_threaded_sort (file, sort_type);
+}
+
 int
 nautilus_file_compare_for_sort_by_attribute     (NautilusFile *file_1,
                                                  NautilusFile *file_2,
@@ -6081,8 +6197,15 @@ nautilus_file_get_deep_counts (NautilusFile *file,
 void
 nautilus_file_recompute_deep_counts (NautilusFile *file)
 {
+    GFile *location;
+
     if (file->details->deep_counts_status != NAUTILUS_REQUEST_IN_PROGRESS)
     {
+        /* Whoever asks again doesn't trust the last count. */
+        location = nautilus_file_get_location (file);
+        nautilus_directory_forget_deep_counts (location);
+        g_object_unref (location);
+
         file->details->deep_counts_status = NAUTILUS_REQUEST_NOT_STARTED;
         if (file->details->directory != NULL)
         {
@@ -8660,6 +8783,10 @@ nautilus_file_emit_changed (NautilusFile *file)
 
     g_assert (NAUTILUS_IS_FILE (file));
 
+    /* Whatever changed may have moved the file in a sort. */
+    file->details->type_collation_key_is_up_to_date = FALSE;
+    file->details->favorite_generation = 0;
+
     /* Send out a signal. */
     g_signal_emit (file, signals[CHANGED], 0, file);
 
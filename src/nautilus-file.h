@@ -441,6 +441,10 @@ int                     nautilus_file_compare_for_sort_by_attribute_q   (Nautilu
 									 gboolean                        directories_first,
 									 gboolean                        reversed);
 gboolean                nautilus_file_is_date_sort_attribute_q          (GQuark                          attribute);
+gboolean                nautilus_file_prepare_for_threaded_sort         (NautilusFile                   *file,
+									 NautilusFileSortType            sort_type);
+gboolean                nautilus_file_prepare_for_threaded_sort_by_attribute_q (NautilusFile            *file,
+									 GQuark                          attribute);
 
 int                     nautilus_file_compare_location                  (NautilusFile                    *file_1,
                                                                          NautilusFile                    *file_2);
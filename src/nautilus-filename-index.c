@@ -0,0 +1,1434 @@
+/*
+ *  nautilus-filename-index.c: Index of the file names under a directory.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 2 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Every file is an entry in one array, pointing to the entry of its
+ * parent directory, so moving a directory moves everything under it.
+ * The names are kept twice in pools of NUL terminated strings: as they
+ * are, and prepared for matching like the query matcher prepares them.
+ *
+ * A search scans the whole pool of prepared names for the longest word
+ * of the query with memchr() and memcmp(), which go through hundreds
+ * of megabytes a second, and only looks closer at the names it finds
+ * it in. That keeps the index at about the size of the names, where a
+ * trigram index would take several times more for its posting lists.
+ *
+ * Removed entries stay in the arrays, marked as such, until the index
+ * is saved, which also drops them and the old names of renamed entries
+ * from memory. Entries under a removed directory are not marked, they
+ * are dead because one of their parents is.
+ */
+
+#include <config.h>
+#include "nautilus-filename-index.h"
+
+#include <string.h>
+
+#define INDEX_MAGIC "NAUTFNI1"
+#define NO_ENTRY G_MAXUINT32
+#define ROOT_ENTRY 0
+#define INITIAL_CHILDREN_SLOTS 64
+/* Deeper than any path can be. */
+#define MAX_DEPTH 4096
+
+enum
+{
+    ENTRY_IS_DIRECTORY = 1 << 0,
+    ENTRY_IS_HIDDEN = 1 << 1,
+    ENTRY_IS_REMOVED = 1 << 2,
+    ENTRY_IS_SEEN = 1 << 3, /* only while updating a directory */
+    ENTRY_IS_OTHER_FILE_SYSTEM = 1 << 4,
+};
+
+#define STORED_FLAGS (ENTRY_IS_DIRECTORY | ENTRY_IS_HIDDEN | ENTRY_IS_OTHER_FILE_SYSTEM)
+
+typedef struct
+{
+    guint64 mtime;          /* in microseconds, the stamp for directories */
+    guint32 parent;
+    guint32 name;           /* offsets into the pools */
+    guint32 prepared_name;
+    guint32 flags;
+    guint32 first_child;
+    guint32 next_sibling;
+} IndexEntry;
+
+/* Which entry a prepared name belongs to. */
+typedef struct
+{
+    guint32 offset;
+    guint32 entry;
+} PreparedNameOwner;
+
+typedef struct
+{
+    char magic[8];
+    guint32 n_entries;
+    guint32 root_length;
+    guint32 names_length;
+    guint32 prepared_names_length;
+} IndexHeader;
+
+typedef struct
+{
+    guint64 mtime;
+    guint32 parent;
+    guint32 name;
+    guint32 prepared_name;
+    guint32 flags;
+} StoredEntry;
+
+struct NautilusFilenameIndex
+{
+    GRWLock lock;
+    char *root;
+
+    GArray *entries;
+    GByteArray *names;
+    GByteArray *prepared_names;
+    GArray *prepared_name_owners;   /* ordered by offset */
+
+    /* Open addressing table of entries, by parent and name. */
+    guint32 *children;
+    gsize n_children_slots;         /* always a power of 2 */
+    gsize n_children;
+
+    guint n_files;
+};
+
+static inline IndexEntry *
+get_entry (NautilusFilenameIndex *index,
+           guint32                id)
+{
+    return &g_array_index (index->entries, IndexEntry, id);
+}
+
+static inline const char *
+get_name (NautilusFilenameIndex *index,
+          IndexEntry            *entry)
+{
+    return (const char *) index->names->data + entry->name;
+}
+
+static gboolean
+is_hidden_name (const char *name)
+{
+    return name[0] == '.' || g_str_has_suffix (name, "~");
+}
+
+static guint32
+append_string (GByteArray *pool,
+               const char *string)
+{
+    guint32 offset;
+
+    offset = pool->len;
+    g_byte_array_append (pool, (const guint8 *) string, strlen (string) + 1);
+
+    return offset;
+}
+
+static void
+set_prepared_name (NautilusFilenameIndex *index,
+                   guint32                id,
+                   const char            *name)
+{
+    PreparedNameOwner owner;
+    char *display_name, *normalized, *prepared;
+
+    display_name = g_filename_display_name (name);
+    normalized = g_utf8_normalize (display_name, -1, G_NORMALIZE_NFD);
+    prepared = g_utf8_strdown (normalized, -1);
+
+    owner.offset = append_string (index->prepared_names, prepared);
+    owner.entry = id;
+    g_array_append_val (index->prepared_name_owners, owner);
+    get_entry (index, id)->prepared_name = owner.offset;
+
+    g_free (prepared);
+    g_free (normalized);
+    g_free (display_name);
+}
+
+/* The table of children. */
+
+static inline gsize
+hash_child (guint32     parent,
+            const char *name)
+{
+    return g_str_hash (name) ^ (parent * 0x9e3779b9U);
+}
+
+/* Returns the slot holding the child, or the empty slot it would go in. */
+static gsize
+lookup_child_slot (NautilusFilenameIndex *index,
+                   guint32                parent,
+                   const char            *name)
+{
+    IndexEntry *entry;
+    gsize mask, i;
+
+    mask = index->n_children_slots - 1;
+    for (i = hash_child (parent, name) & mask;; i = (i + 1) & mask)
+    {
+        if (index->children[i] == NO_ENTRY)
+        {
+            return i;
+        }
+
+        entry = get_entry (index, index->children[i]);
+        if (entry->parent == parent && strcmp (get_name (index, entry), name) == 0)
+        {
+            return i;
+        }
+    }
+}
+
+static guint32
+lookup_child (NautilusFilenameIndex *index,
+              guint32                parent,
+              const char            *name)
+{
+    return index->children[lookup_child_slot (index, parent, name)];
+}
+
+static void
+insert_child (NautilusFilenameIndex *index,
+              guint32                id);
+
+static void
+grow_children (NautilusFilenameIndex *index)
+{
+    guint32 *old_children;
+    gsize old_n_slots, i;
+
+    old_children = index->children;
+    old_n_slots = index->n_children_slots;
+
+    index->n_children_slots = old_n_slots * 2;
+    index->children = g_new (guint32, index->n_children_slots);
+    memset (index->children, 0xff, index->n_children_slots * sizeof (guint32));
+    index->n_children = 0;
+
+    for (i = 0; i < old_n_slots; i++)
+    {
+        if (old_children[i] != NO_ENTRY)
+        {
+            insert_child (index, old_children[i]);
+        }
+    }
+
+    g_free (old_children);
+}
+
+static void
+insert_child (NautilusFilenameIndex *index,
+              guint32                id)
+{
+    IndexEntry *entry;
+    gsize slot;
+
+    entry = get_entry (index, id);
+    slot = lookup_child_slot (index, entry->parent, get_name (index, entry));
+    if (index->children[slot] == NO_ENTRY)
+    {
+        index->n_children++;
+    }
+    index->children[slot] = id;
+
+    if (index->n_children * 2 > index->n_children_slots)
+    {
+        grow_children (index);
+    }
+}
+
+static void
+remove_child (NautilusFilenameIndex *index,
+              guint32                id)
+{
+    IndexEntry *entry;
+    gsize mask, i, j, k;
+
+    entry = get_entry (index, id);
+    i = lookup_child_slot (index, entry->parent, get_name (index, entry));
+    if (index->children[i] != id)
+    {
+        return;
+    }
+
+    index->children[i] = NO_ENTRY;
+    index->n_children--;
+
+    /* Move later entries of the cluster back, so lookups don't stop at
+     * the hole.
+     */
+    mask = index->n_children_slots - 1;
+    for (j = (i + 1) & mask; index->children[j] != NO_ENTRY; j = (j + 1) & mask)
+    {
+        entry = get_entry (index, index->children[j]);
+        k = hash_child (entry->parent, get_name (index, entry)) & mask;
+        if ((j > i && (k <= i || k > j)) ||
+            (j < i && (k <= i && k > j)))
+        {
+            index->children[i] = index->children[j];
+            index->children[j] = NO_ENTRY;
+            i = j;
+        }
+    }
+}
+
+/* The tree. */
+
+static void
+link_entry (NautilusFilenameIndex *index,
+            guint32                id)
+{
+    IndexEntry *entry, *parent;
+
+    entry = get_entry (index, id);
+    parent = get_entry (index, entry->parent);
+    parent->flags |= ENTRY_IS_DIRECTORY;
+    entry->next_sibling = parent->first_child;
+    parent->first_child = id;
+
+    insert_child (index, id);
+}
+
+static void
+unlink_entry (NautilusFilenameIndex *index,
+              guint32                id)
+{
+    IndexEntry *entry, *parent;
+    guint32 *link;
+
+    remove_child (index, id);
+
+    entry = get_entry (index, id);
+    parent = get_entry (index, entry->parent);
+    for (link = &parent->first_child; *link != NO_ENTRY; link = &get_entry (index, *link)->next_sibling)
+    {
+        if (*link == id)
+        {
+            *link = entry->next_sibling;
+            break;
+        }
+    }
+    entry->next_sibling = NO_ENTRY;
+}
+
+static guint32
+append_entry (NautilusFilenameIndex *index,
+              guint32                parent,
+              const char            *name,
+              guint32                flags)
+{
+    IndexEntry entry = { 0 };
+    guint32 id;
+
+    id = index->entries->len;
+
+    entry.parent = parent;
+    entry.name = append_string (index->names, name);
+    entry.flags = flags | (is_hidden_name (name) ? ENTRY_IS_HIDDEN : 0);
+    entry.first_child = NO_ENTRY;
+    entry.next_sibling = NO_ENTRY;
+    g_array_append_val (index->entries, entry);
+
+    set_prepared_name (index, id, name);
+    link_entry (index, id);
+    index->n_files++;
+
+    return id;
+}
+
+/* Counts the entry and everything under it. */
+static guint
+count_entries (NautilusFilenameIndex *index,
+               guint32                id)
+{
+    IndexEntry *entry;
+    guint32 next;
+    guint n_entries;
+
+    n_entries = 1;
+    next = get_entry (index, id)->first_child;
+    while (next != NO_ENTRY)
+    {
+        n_entries++;
+        entry = get_entry (index, next);
+
+        if (entry->first_child != NO_ENTRY)
+        {
+            next = entry->first_child;
+            continue;
+        }
+
+        /* Go up until there is a sibling left to visit. */
+        while (entry->next_sibling == NO_ENTRY && entry->parent != id)
+        {
+            entry = get_entry (index, entry->parent);
+        }
+        next = entry->next_sibling;
+    }
+
+    return n_entries;
+}
+
+static void
+remove_entry (NautilusFilenameIndex *index,
+              guint32                id)
+{
+    IndexEntry *entry;
+
+    unlink_entry (index, id);
+
+    entry = get_entry (index, id);
+    entry->flags |= ENTRY_IS_REMOVED;
+    index->n_files -= count_entries (index, id);
+}
+
+static void
+remove_children (NautilusFilenameIndex *index,
+                 guint32                id)
+{
+    while (get_entry (index, id)->first_child != NO_ENTRY)
+    {
+        remove_entry (index, get_entry (index, id)->first_child);
+    }
+}
+
+/* Returns the path relative to the root, or NULL if it isn't under it. */
+static const char *
+get_relative_path (NautilusFilenameIndex *index,
+                   const char            *path)
+{
+    gsize root_length;
+
+    root_length = strlen (index->root);
+    if (strncmp (path, index->root, root_length) != 0)
+    {
+        return NULL;
+    }
+
+    path += root_length;
+    if (root_length > 0 && index->root[root_length - 1] == '/')
+    {
+        return path;
+    }
+    if (*path == '/')
+    {
+        return path + 1;
+    }
+
+    return *path == '\0' ? path : NULL;
+}
+
+static guint32
+lookup_path (NautilusFilenameIndex *index,
+             const char            *path,
+             gboolean               create)
+{
+    const char *relative_path;
+    char **components;
+    guint32 id, child;
+    guint i;
+
+    relative_path = get_relative_path (index, path);
+    if (relative_path == NULL)
+    {
+        return NO_ENTRY;
+    }
+
+    components = g_strsplit (relative_path, "/", -1);
+    id = ROOT_ENTRY;
+    for (i = 0; components[i] != NULL && id != NO_ENTRY; i++)
+    {
+        if (components[i][0] == '\0')
+        {
+            continue;
+        }
+
+        child = lookup_child (index, id, components[i]);
+        if (child == NO_ENTRY && create)
+        {
+            child = append_entry (index, id, components[i], 0);
+        }
+        id = child;
+    }
+    g_strfreev (components);
+
+    return id;
+}
+
+static char *
+build_path (NautilusFilenameIndex *index,
+            guint32                id)
+{
+    GPtrArray *names;
+    GString *path;
+    IndexEntry *entry;
+    guint i;
+
+    names = g_ptr_array_new ();
+    for (; id != ROOT_ENTRY; id = entry->parent)
+    {
+        entry = get_entry (index, id);
+        g_ptr_array_add (names, (gpointer) get_name (index, entry));
+    }
+
+    path = g_string_new (index->root);
+    for (i = names->len; i > 0; i--)
+    {
+        if (path->len == 0 || path->str[path->len - 1] != '/')
+        {
+            g_string_append_c (path, '/');
+        }
+        g_string_append (path, g_ptr_array_index (names, i - 1));
+    }
+    g_ptr_array_free (names, TRUE);
+
+    return g_string_free (path, FALSE);
+}
+
+static NautilusFilenameIndex *
+filename_index_new_empty (const char *root)
+{
+    NautilusFilenameIndex *index;
+
+    index = g_new0 (NautilusFilenameIndex, 1);
+    g_rw_lock_init (&index->lock);
+    index->root = g_strdup (root);
+    index->entries = g_array_new (FALSE, FALSE, sizeof (IndexEntry));
+    index->names = g_byte_array_new ();
+    index->prepared_names = g_byte_array_new ();
+    index->prepared_name_owners = g_array_new (FALSE, FALSE, sizeof (PreparedNameOwner));
+    index->n_children_slots = INITIAL_CHILDREN_SLOTS;
+    index->children = g_new (guint32, index->n_children_slots);
+    memset (index->children, 0xff, index->n_children_slots * sizeof (guint32));
+
+    return index;
+}
+
+NautilusFilenameIndex *
+nautilus_filename_index_new (const char *root)
+{
+    NautilusFilenameIndex *index;
+    IndexEntry entry = { 0 };
+
+    g_return_val_if_fail (root != NULL, NULL);
+
+    index = filename_index_new_empty (root);
+
+    entry.parent = NO_ENTRY;
+    entry.name = append_string (index->names, "");
+    entry.flags = ENTRY_IS_DIRECTORY;
+    entry.first_child = NO_ENTRY;
+    entry.next_sibling = NO_ENTRY;
+    g_array_append_val (index->entries, entry);
+    set_prepared_name (index, ROOT_ENTRY, "");
+
+    return index;
+}
+
+void
+nautilus_filename_index_free (NautilusFilenameIndex *index)
+{
+    if (index == NULL)
+    {
+        return;
+    }
+
+    g_rw_lock_clear (&index->lock);
+    g_free (index->root);
+    g_array_free (index->entries, TRUE);
+    g_byte_array_free (index->names, TRUE);
+    g_byte_array_free (index->prepared_names, TRUE);
+    g_array_free (index->prepared_name_owners, TRUE);
+    g_free (index->children);
+    g_free (index);
+}
+
+const char *
+nautilus_filename_index_get_root (NautilusFilenameIndex *index)
+{
+    return index->root;
+}
+
+guint
+nautilus_filename_index_get_size (NautilusFilenameIndex *index)
+{
+    guint n_files;
+
+    g_rw_lock_reader_lock (&index->lock);
+    n_files = index->n_files;
+    g_rw_lock_reader_unlock (&index->lock);
+
+    return n_files;
+}
+
+/* Sets the type, hidden flag and modification time of the entry from
+ * info, see nautilus_filename_index_update_directory().
+ */
+static void
+set_entry_info (IndexEntry *entry,
+                GFileInfo  *info)
+{
+    guint32 flags;
+
+    flags = 0;
+    if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY)
+    {
+        flags |= ENTRY_IS_DIRECTORY;
+    }
+    if (g_file_info_get_is_hidden (info) || g_file_info_get_is_backup (info))
+    {
+        flags |= ENTRY_IS_HIDDEN;
+    }
+
+    entry->flags = (entry->flags & ~(ENTRY_IS_DIRECTORY | ENTRY_IS_HIDDEN)) | flags;
+    if (!(flags & ENTRY_IS_DIRECTORY))
+    {
+        /* The stamp of a directory is only set when it is read. */
+        entry->mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED) * G_USEC_PER_SEC +
+                       g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+    }
+}
+
+void
+nautilus_filename_index_add (NautilusFilenameIndex *index,
+                             const char            *path,
+                             gboolean               is_directory)
+{
+    guint32 id;
+
+    g_rw_lock_writer_lock (&index->lock);
+
+    id = lookup_path (index, path, TRUE);
+    if (id != NO_ENTRY && is_directory)
+    {
+        get_entry (index, id)->flags |= ENTRY_IS_DIRECTORY;
+    }
+
+    g_rw_lock_writer_unlock (&index->lock);
+}
+
+void
+nautilus_filename_index_add_info (NautilusFilenameIndex *index,
+                                  const char            *path,
+                                  GFileInfo             *info)
+{
+    guint32 id;
+
+    g_rw_lock_writer_lock (&index->lock);
+
+    id = lookup_path (index, path, TRUE);
+    if (id != NO_ENTRY && id != ROOT_ENTRY)
+    {
+        set_entry_info (get_entry (index, id), info);
+    }
+
+    g_rw_lock_writer_unlock (&index->lock);
+}
+
+void
+nautilus_filename_index_remove (NautilusFilenameIndex *index,
+                                const char            *path)
+{
+    guint32 id;
+
+    g_rw_lock_writer_lock (&index->lock);
+
+    id = lookup_path (index, path, FALSE);
+    if (id != NO_ENTRY && id != ROOT_ENTRY)
+    {
+        remove_entry (index, id);
+    }
+
+    g_rw_lock_writer_unlock (&index->lock);
+}
+
+void
+nautilus_filename_index_move (NautilusFilenameIndex *index,
+                              const char            *from,
+                              const char            *to)
+{
+    IndexEntry *entry;
+    guint32 id, existing, parent;
+    char *parent_path, *name;
+
+    g_rw_lock_writer_lock (&index->lock);
+
+    id = lookup_path (index, from, FALSE);
+    if (id == ROOT_ENTRY)
+    {
+        goto out;
+    }
+
+    /* Handle overwriting a file. */
+    existing = lookup_path (index, to, FALSE);
+    if (existing != NO_ENTRY && existing != id && existing != ROOT_ENTRY)
+    {
+        remove_entry (index, existing);
+    }
+
+    parent_path = g_path_get_dirname (to);
+    parent = lookup_path (index, parent_path, TRUE);
+    g_free (parent_path);
+
+    if (id == NO_ENTRY)
+    {
+        /* Moved in from outside the root. */
+        if (parent != NO_ENTRY)
+        {
+            lookup_path (index, to, TRUE);
+        }
+        goto out;
+    }
+
+    if (parent == NO_ENTRY)
+    {
+        /* Moved out of the root. */
+        remove_entry (index, id);
+        goto out;
+    }
+
+    unlink_entry (index, id);
+
+    name = g_path_get_basename (to);
+    entry = get_entry (index, id);
+    entry->parent = parent;
+    entry->name = append_string (index->names, name);
+    entry->flags &= ~ENTRY_IS_HIDDEN;
+    entry->flags |= is_hidden_name (name) ? ENTRY_IS_HIDDEN : 0;
+    set_prepared_name (index, id, name);
+    g_free (name);
+
+    link_entry (index, id);
+
+out:
+    g_rw_lock_writer_unlock (&index->lock);
+}
+
+guint64
+nautilus_filename_index_get_directory_stamp (NautilusFilenameIndex *index,
+                                             const char            *path)
+{
+    guint32 id;
+    guint64 stamp;
+
+    g_rw_lock_reader_lock (&index->lock);
+
+    id = lookup_path (index, path, FALSE);
+    stamp = id != NO_ENTRY ? get_entry (index, id)->mtime : 0;
+
+    g_rw_lock_reader_unlock (&index->lock);
+
+    return stamp;
+}
+
+GPtrArray *
+nautilus_filename_index_list_subdirectories (NautilusFilenameIndex *index,
+                                             const char            *path)
+{
+    GPtrArray *names;
+    IndexEntry *entry;
+    guint32 id;
+
+    names = g_ptr_array_new_with_free_func (g_free);
+
+    g_rw_lock_reader_lock (&index->lock);
+
+    id = lookup_path (index, path, FALSE);
+    for (id = id != NO_ENTRY ? get_entry (index, id)->first_child : NO_ENTRY;
+         id != NO_ENTRY;
+         id = entry->next_sibling)
+    {
+        entry = get_entry (index, id);
+        if (entry->flags & ENTRY_IS_DIRECTORY)
+        {
+            g_ptr_array_add (names, g_strdup (get_name (index, entry)));
+        }
+    }
+
+    g_rw_lock_reader_unlock (&index->lock);
+
+    return names;
+}
+
+void
+nautilus_filename_index_update_directory (NautilusFilenameIndex *index,
+                                          const char            *path,
+                                          guint64                stamp,
+                                          GList                 *infos)
+{
+    IndexEntry *entry;
+    GFileInfo *info;
+    GList *l;
+    const char *name;
+    guint32 directory, id, next;
+
+    g_rw_lock_writer_lock (&index->lock);
+
+    directory = lookup_path (index, path, TRUE);
+    if (directory == NO_ENTRY)
+    {
+        goto out;
+    }
+
+    for (l = infos; l != NULL; l = l->next)
+    {
+        info = l->data;
+        name = g_file_info_get_name (info);
+
+        id = lookup_child (index, directory, name);
+        if (id == NO_ENTRY)
+        {
+            id = append_entry (index, directory, name, 0);
+        }
+
+        entry = get_entry (index, id);
+        set_entry_info (entry, info);
+        entry->flags |= ENTRY_IS_SEEN;
+    }
+
+    /* Remove what isn't there anymore. */
+    for (id = get_entry (index, directory)->first_child; id != NO_ENTRY; id = next)
+    {
+        entry = get_entry (index, id);
+        next = entry->next_sibling;
+
+        if (entry->flags & ENTRY_IS_SEEN)
+        {
+            entry->flags &= ~ENTRY_IS_SEEN;
+        }
+        else
+        {
+            remove_entry (index, id);
+        }
+    }
+
+    entry = get_entry (index, directory);
+    entry->mtime = stamp;
+    entry->flags &= ~ENTRY_IS_OTHER_FILE_SYSTEM;
+
+out:
+    g_rw_lock_writer_unlock (&index->lock);
+}
+
+void
+nautilus_filename_index_set_other_file_system (NautilusFilenameIndex *index,
+                                               const char            *path)
+{
+    IndexEntry *entry;
+    guint32 id;
+
+    g_rw_lock_writer_lock (&index->lock);
+
+    id = lookup_path (index, path, TRUE);
+    if (id != NO_ENTRY && id != ROOT_ENTRY)
+    {
+        remove_children (index, id);
+
+        entry = get_entry (index, id);
+        entry->mtime = 0;
+        entry->flags |= ENTRY_IS_DIRECTORY | ENTRY_IS_OTHER_FILE_SYSTEM;
+    }
+
+    g_rw_lock_writer_unlock (&index->lock);
+}
+
+gboolean
+nautilus_filename_index_covers (NautilusFilenameIndex *index,
+                                const char            *path)
+{
+    const char *relative_path;
+    char **components;
+    guint32 id;
+    gboolean covers;
+    guint i;
+
+    relative_path = get_relative_path (index, path);
+    if (relative_path == NULL)
+    {
+        return FALSE;
+    }
+
+    g_rw_lock_reader_lock (&index->lock);
+
+    components = g_strsplit (relative_path, "/", -1);
+    id = ROOT_ENTRY;
+    covers = TRUE;
+    for (i = 0; components[i] != NULL && id != NO_ENTRY && covers; i++)
+    {
+        if (components[i][0] == '\0')
+        {
+            continue;
+        }
+
+        id = lookup_child (index, id, components[i]);
+        covers = id == NO_ENTRY || !(get_entry (index, id)->flags & ENTRY_IS_OTHER_FILE_SYSTEM);
+    }
+    g_strfreev (components);
+
+    g_rw_lock_reader_unlock (&index->lock);
+
+    return covers;
+}
+
+GPtrArray *
+nautilus_filename_index_list_other_file_systems (NautilusFilenameIndex *index,
+                                                 const char            *path)
+{
+    GPtrArray *paths;
+    IndexEntry *entry;
+    guint32 location, id, ancestor;
+
+    paths = g_ptr_array_new_with_free_func (g_free);
+
+    g_rw_lock_reader_lock (&index->lock);
+
+    location = lookup_path (index, path, FALSE);
+    if (location == NO_ENTRY)
+    {
+        goto out;
+    }
+
+    /* There are few of them, one pass over the entries finds them
+     * quicker than walking the tree of the location.
+     */
+    for (id = 0; id < index->entries->len; id++)
+    {
+        entry = get_entry (index, id);
+        if (!(entry->flags & ENTRY_IS_OTHER_FILE_SYSTEM) || (entry->flags & ENTRY_IS_REMOVED))
+        {
+            continue;
+        }
+
+        for (ancestor = entry->parent;
+             ancestor != location && ancestor != NO_ENTRY;
+             ancestor = get_entry (index, ancestor)->parent)
+        {
+            if (get_entry (index, ancestor)->flags & ENTRY_IS_REMOVED)
+            {
+                ancestor = NO_ENTRY;
+                break;
+            }
+        }
+
+        if (ancestor == location)
+        {
+            g_ptr_array_add (paths, build_path (index, id));
+        }
+    }
+
+out:
+    g_rw_lock_reader_unlock (&index->lock);
+
+    return paths;
+}
+
+/* Searching. */
+
+/* Returns the entry the prepared name at offset belongs to, if it is
+ * still the current name of the entry.
+ */
+static guint32
+find_prepared_name_owner (NautilusFilenameIndex *index,
+                          gsize                  offset,
+                          gsize                 *name_offset)
+{
+    PreparedNameOwner *owners;
+    guint low, high, middle;
+
+    owners = (PreparedNameOwner *) index->prepared_name_owners->data;
+    low = 0;
+    high = index->prepared_name_owners->len;
+    while (high - low > 1)
+    {
+        middle = low + (high - low) / 2;
+        if (owners[middle].offset <= offset)
+        {
+            low = middle;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    *name_offset = owners[low].offset;
+    if (get_entry (index, owners[low].entry)->prepared_name != owners[low].offset)
+    {
+        return NO_ENTRY;
+    }
+
+    return owners[low].entry;
+}
+
+static void
+check_candidate (NautilusFilenameIndex     *index,
+                 guint32                    id,
+                 guint32                    location,
+                 gboolean                   recursive,
+                 gboolean                   show_hidden,
+                 NautilusQueryMatcher      *matcher,
+                 NautilusFilenameIndexFunc  func,
+                 gpointer                   user_data)
+{
+    IndexEntry *entry, *ancestor;
+    const char *name;
+    char *display_name, *path;
+    gboolean hidden;
+    guint32 ancestor_id;
+    gdouble rank;
+
+    entry = get_entry (index, id);
+    if (id == location || (entry->flags & ENTRY_IS_REMOVED))
+    {
+        return;
+    }
+
+    /* Only files in the location, that still exist. */
+    hidden = (entry->flags & ENTRY_IS_HIDDEN) != 0;
+    if (!recursive)
+    {
+        if (entry->parent != location)
+        {
+            return;
+        }
+    }
+    else
+    {
+        for (ancestor_id = entry->parent; ancestor_id != location; ancestor_id = ancestor->parent)
+        {
+            if (ancestor_id == NO_ENTRY)
+            {
+                return;
+            }
+
+            ancestor = get_entry (index, ancestor_id);
+            if (ancestor->flags & ENTRY_IS_REMOVED)
+            {
+                return;
+            }
+            hidden |= (ancestor->flags & ENTRY_IS_HIDDEN) != 0;
+        }
+    }
+
+    if (hidden && !show_hidden)
+    {
+        return;
+    }
+
+    name = get_name (index, entry);
+    display_name = NULL;
+    if (!g_utf8_validate (name, -1, NULL))
+    {
+        display_name = g_filename_display_name (name);
+    }
+
+    rank = nautilus_query_matcher_match (matcher, display_name != NULL ? display_name : name);
+    if (rank > -1)
+    {
+        path = build_path (index, id);
+        func (path, rank, entry->mtime, user_data);
+        g_free (path);
+    }
+
+    g_free (display_name);
+}
+
+void
+nautilus_filename_index_search (NautilusFilenameIndex     *index,
+                                const char                *location,
+                                gboolean                   recursive,
+                                gboolean                   show_hidden,
+                                NautilusQueryMatcher      *matcher,
+                                GCancellable              *cancellable,
+                                NautilusFilenameIndexFunc  func,
+                                gpointer                   user_data)
+{
+    const char *word, *pool, *p, *last;
+    gsize word_length, pool_length, name_offset;
+    guint32 location_id, id;
+    guint n_candidates;
+
+    word = nautilus_query_matcher_get_longest_word (matcher);
+    if (word == NULL)
+    {
+        return;
+    }
+    word_length = strlen (word);
+
+    g_rw_lock_reader_lock (&index->lock);
+
+    location_id = lookup_path (index, location, FALSE);
+    if (location_id == NO_ENTRY)
+    {
+        goto out;
+    }
+
+    if (word_length == 0)
+    {
+        for (id = 0; id < index->entries->len; id++)
+        {
+            if (id % 4096 == 0 && g_cancellable_is_cancelled (cancellable))
+            {
+                break;
+            }
+            check_candidate (index, id, location_id, recursive, show_hidden,
+                             matcher, func, user_data);
+        }
+        goto out;
+    }
+
+    pool = (const char *) index->prepared_names->data;
+    pool_length = index->prepared_names->len;
+    if (pool_length < word_length)
+    {
+        goto out;
+    }
+
+    last = pool + pool_length - word_length;
+    n_candidates = 0;
+    for (p = pool; p <= last; p++)
+    {
+        p = memchr (p, word[0], last - p + 1);
+        if (p == NULL)
+        {
+            break;
+        }
+        if (memcmp (p + 1, word + 1, word_length - 1) != 0)
+        {
+            continue;
+        }
+
+        if (++n_candidates % 1024 == 0 && g_cancellable_is_cancelled (cancellable))
+        {
+            break;
+        }
+
+        id = find_prepared_name_owner (index, p - pool, &name_offset);
+        if (id != NO_ENTRY)
+        {
+            check_candidate (index, id, location_id, recursive, show_hidden,
+                             matcher, func, user_data);
+        }
+
+        /* Go on with the next name. */
+        p = pool + name_offset + strlen (pool + name_offset);
+    }
+
+out:
+    g_rw_lock_reader_unlock (&index->lock);
+}
+
+/* Saving and loading. */
+
+/* Works out which entries are still alive, a removed entry takes
+ * everything under it along.
+ */
+static guint32 *
+map_live_entries (NautilusFilenameIndex *index,
+                  guint                 *n_live)
+{
+    guint32 *map;
+    guint32 id, ancestor, next;
+    guint8 *state;
+    guint n;
+
+    enum { UNKNOWN, LIVE, DEAD };
+
+    state = g_new0 (guint8, index->entries->len);
+    state[ROOT_ENTRY] = LIVE;
+
+    for (id = 0; id < index->entries->len; id++)
+    {
+        /* Find the closest ancestor with a known state, then mark the
+         * way there.
+         */
+        for (ancestor = id; state[ancestor] == UNKNOWN; ancestor = get_entry (index, ancestor)->parent)
+        {
+            if (get_entry (index, ancestor)->flags & ENTRY_IS_REMOVED)
+            {
+                state[ancestor] = DEAD;
+                break;
+            }
+        }
+        for (next = id; next != ancestor && state[next] == UNKNOWN; next = get_entry (index, next)->parent)
+        {
+            state[next] = state[ancestor];
+        }
+    }
+
+    map = g_new (guint32, index->entries->len);
+    n = 0;
+    for (id = 0; id < index->entries->len; id++)
+    {
+        map[id] = state[id] == LIVE ? n++ : NO_ENTRY;
+    }
+    g_free (state);
+
+    *n_live = n;
+
+    return map;
+}
+
+/* Returns NULL if contents are not a saved index of root. */
+static NautilusFilenameIndex *
+parse_index (const char *contents,
+             gsize       length,
+             const char *root)
+{
+    NautilusFilenameIndex *index;
+    const char *stored_root, *names, *prepared_names;
+    const IndexHeader *header;
+    const StoredEntry *stored;
+    IndexEntry entry;
+    PreparedNameOwner owner;
+    gsize expected_length;
+    guint32 id, parent;
+    guint depth;
+
+    index = NULL;
+    header = (const IndexHeader *) contents;
+
+    if (length < sizeof (IndexHeader) ||
+        memcmp (header->magic, INDEX_MAGIC, sizeof (header->magic)) != 0 ||
+        header->n_entries == 0 ||
+        header->n_entries > (length - sizeof (IndexHeader)) / sizeof (StoredEntry))
+    {
+        goto out;
+    }
+
+    expected_length = sizeof (IndexHeader) +
+                      (gsize) header->n_entries * sizeof (StoredEntry) +
+                      header->root_length +
+                      header->names_length +
+                      header->prepared_names_length;
+    if (length != expected_length || header->root_length == 0 ||
+        header->names_length == 0 || header->prepared_names_length == 0)
+    {
+        goto out;
+    }
+
+    stored = (const StoredEntry *) (contents + sizeof (IndexHeader));
+    stored_root = (const char *) (stored + header->n_entries);
+    names = stored_root + header->root_length;
+    prepared_names = names + header->names_length;
+
+    /* With terminated pools, any offset inside them is a valid string. */
+    if (stored_root[header->root_length - 1] != '\0' ||
+        names[header->names_length - 1] != '\0' ||
+        prepared_names[header->prepared_names_length - 1] != '\0' ||
+        strcmp (stored_root, root) != 0)
+    {
+        goto out;
+    }
+
+    for (id = 0; id < header->n_entries; id++)
+    {
+        if ((id == ROOT_ENTRY) != (stored[id].parent == NO_ENTRY) ||
+            (id != ROOT_ENTRY && stored[id].parent >= header->n_entries) ||
+            stored[id].parent == id ||
+            stored[id].name >= header->names_length ||
+            stored[id].prepared_name >= header->prepared_names_length ||
+            (id > 0 && stored[id].prepared_name <= stored[id - 1].prepared_name))
+        {
+            goto out;
+        }
+    }
+
+    /* Every entry has to lead up to the root. */
+    for (id = 1; id < header->n_entries; id++)
+    {
+        for (parent = stored[id].parent, depth = 0;
+             parent != ROOT_ENTRY && depth < MAX_DEPTH;
+             parent = stored[parent].parent, depth++)
+        {
+        }
+
+        if (depth == MAX_DEPTH)
+        {
+            goto out;
+        }
+    }
+
+    index = filename_index_new_empty (root);
+    g_byte_array_append (index->names, (const guint8 *) names, header->names_length);
+    g_byte_array_append (index->prepared_names, (const guint8 *) prepared_names,
+                         header->prepared_names_length);
+
+    for (id = 0; id < header->n_entries; id++)
+    {
+        entry.mtime = stored[id].mtime;
+        entry.parent = stored[id].parent;
+        entry.name = stored[id].name;
+        entry.prepared_name = stored[id].prepared_name;
+        entry.flags = stored[id].flags & STORED_FLAGS;
+        entry.first_child = NO_ENTRY;
+        entry.next_sibling = NO_ENTRY;
+        g_array_append_val (index->entries, entry);
+
+        owner.offset = entry.prepared_name;
+        owner.entry = id;
+        g_array_append_val (index->prepared_name_owners, owner);
+    }
+
+    for (id = 1; id < header->n_entries; id++)
+    {
+        link_entry (index, id);
+    }
+    index->n_files = header->n_entries - 1;
+
+out:
+    return index;
+}
+
+/* Exchanges everything but the lock and the root. */
+static void
+swap_contents (NautilusFilenameIndex *index,
+               NautilusFilenameIndex *other)
+{
+    NautilusFilenameIndex tmp;
+
+    tmp = *index;
+
+    index->entries = other->entries;
+    index->names = other->names;
+    index->prepared_names = other->prepared_names;
+    index->prepared_name_owners = other->prepared_name_owners;
+    index->children = other->children;
+    index->n_children_slots = other->n_children_slots;
+    index->n_children = other->n_children;
+    index->n_files = other->n_files;
+
+    other->entries = tmp.entries;
+    other->names = tmp.names;
+    other->prepared_names = tmp.prepared_names;
+    other->prepared_name_owners = tmp.prepared_name_owners;
+    other->children = tmp.children;
+    other->n_children_slots = tmp.n_children_slots;
+    other->n_children = tmp.n_children;
+    other->n_files = tmp.n_files;
+}
+
+gboolean
+nautilus_filename_index_save (NautilusFilenameIndex  *index,
+                              const char             *path,
+                              GError                **error)
+{
+    IndexHeader header = { { 0 } };
+    StoredEntry stored;
+    IndexEntry *entry;
+    GByteArray *contents, *names, *prepared_names;
+    NautilusFilenameIndex *compacted;
+    guint32 *map;
+    guint32 id;
+    guint n_live;
+    char *dirname;
+    gboolean success;
+
+    g_rw_lock_writer_lock (&index->lock);
+
+    map = map_live_entries (index, &n_live);
+
+    memcpy (header.magic, INDEX_MAGIC, sizeof (header.magic));
+    header.n_entries = n_live;
+    header.root_length = strlen (index->root) + 1;
+
+    contents = g_byte_array_sized_new (sizeof (IndexHeader) + n_live * sizeof (StoredEntry));
+    names = g_byte_array_new ();
+    prepared_names = g_byte_array_new ();
+    g_byte_array_append (contents, (const guint8 *) &header, sizeof (IndexHeader));
+
+    for (id = 0; id < index->entries->len; id++)
+    {
+        if (map[id] == NO_ENTRY)
+        {
+            continue;
+        }
+
+        entry = get_entry (index, id);
+        stored.mtime = entry->mtime;
+        stored.parent = id == ROOT_ENTRY ? NO_ENTRY : map[entry->parent];
+        stored.name = append_string (names, get_name (index, entry));
+        stored.prepared_name = append_string (prepared_names,
+                                              (const char *) index->prepared_names->data + entry->prepared_name);
+        stored.flags = entry->flags & STORED_FLAGS;
+        g_byte_array_append (contents, (const guint8 *) &stored, sizeof (StoredEntry));
+    }
+
+    g_byte_array_append (contents, (const guint8 *) index->root, header.root_length);
+
+    g_free (map);
+
+    g_byte_array_append (contents, names->data, names->len);
+    g_byte_array_append (contents, prepared_names->data, prepared_names->len);
+    header.names_length = names->len;
+    header.prepared_names_length = prepared_names->len;
+    memcpy (contents->data, &header, sizeof (IndexHeader));
+
+    /* What was saved has no removed entries and no old names, so load
+     * it back in place of the arrays, which otherwise only ever grow.
+     */
+    if (n_live < index->entries->len ||
+        names->len < index->names->len ||
+        prepared_names->len < index->prepared_names->len)
+    {
+        compacted = parse_index ((const char *) contents->data, contents->len, index->root);
+        if (compacted != NULL)
+        {
+            swap_contents (index, compacted);
+            nautilus_filename_index_free (compacted);
+        }
+    }
+
+    g_rw_lock_writer_unlock (&index->lock);
+
+    g_byte_array_free (names, TRUE);
+    g_byte_array_free (prepared_names, TRUE);
+
+    dirname = g_path_get_dirname (path);
+    g_mkdir_with_parents (dirname, 0700);
+    g_free (dirname);
+
+    success = g_file_set_contents (path, (const char *) contents->data, contents->len, error);
+    g_byte_array_unref (contents);
+
+    return success;
+}
+
+NautilusFilenameIndex *
+nautilus_filename_index_load (const char *path,
+                              const char *root)
+{
+    NautilusFilenameIndex *index;
+    GMappedFile *mapped_file;
+
+    mapped_file = g_mapped_file_new (path, FALSE, NULL);
+    if (mapped_file == NULL)
+    {
+        return NULL;
+    }
+
+    index = parse_index (g_mapped_file_get_contents (mapped_file),
+                         g_mapped_file_get_length (mapped_file),
+                         root);
+    g_mapped_file_unref (mapped_file);
+
+    return index;
+}
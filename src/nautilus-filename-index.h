@@ -0,0 +1,110 @@
+/*
+   nautilus-filename-index.h: Index of the file names under a directory.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef NAUTILUS_FILENAME_INDEX_H
+#define NAUTILUS_FILENAME_INDEX_H
+
+#include <gio/gio.h>
+
+#include "nautilus-query-matcher.h"
+
+/* The names of all the files under a root directory, to search them
+ * without going through the file system. Paths are local file system
+ * paths, and times are in microseconds. All functions are thread safe.
+ */
+typedef struct NautilusFilenameIndex NautilusFilenameIndex;
+
+typedef void (* NautilusFilenameIndexFunc) (const char *path,
+					    gdouble     rank,
+					    guint64     mtime,
+					    gpointer    user_data);
+
+NautilusFilenameIndex *nautilus_filename_index_new                (const char             *root);
+void                   nautilus_filename_index_free               (NautilusFilenameIndex  *index);
+const char *           nautilus_filename_index_get_root           (NautilusFilenameIndex  *index);
+/* The number of files, not counting the root. */
+guint                  nautilus_filename_index_get_size           (NautilusFilenameIndex  *index);
+
+/* Returns NULL if there is no saved index of root at path, or it is damaged. */
+NautilusFilenameIndex *nautilus_filename_index_load               (const char             *path,
+								   const char             *root);
+gboolean               nautilus_filename_index_save               (NautilusFilenameIndex  *index,
+								   const char             *path,
+								   GError                **error);
+
+/* Changes of single files. Paths outside the root are ignored, missing
+ * parent directories are added.
+ */
+void                   nautilus_filename_index_add                (NautilusFilenameIndex  *index,
+								   const char             *path,
+								   gboolean                is_directory);
+/* Like nautilus_filename_index_add(), with the type, hidden flag and
+ * modification time from info, which needs the attributes listed for
+ * nautilus_filename_index_update_directory().
+ */
+void                   nautilus_filename_index_add_info           (NautilusFilenameIndex  *index,
+								   const char             *path,
+								   GFileInfo              *info);
+void                   nautilus_filename_index_remove             (NautilusFilenameIndex  *index,
+								   const char             *path);
+void                   nautilus_filename_index_move               (NautilusFilenameIndex  *index,
+								   const char             *from,
+								   const char             *to);
+
+/* Every directory is stamped with its modification time when its
+ * contents were last read, 0 if they never were. Files have their
+ * modification time as of then, or 0.
+ */
+guint64                nautilus_filename_index_get_directory_stamp (NautilusFilenameIndex *index,
+								    const char            *path);
+/* Returns the names of the subdirectories of the directory. */
+GPtrArray *            nautilus_filename_index_list_subdirectories (NautilusFilenameIndex *index,
+								    const char            *path);
+/* Replaces the contents of the directory with infos, which need the
+ * name, type, modification time (with microseconds), hidden and backup
+ * attributes, and stamps it.
+ */
+void                   nautilus_filename_index_update_directory   (NautilusFilenameIndex  *index,
+								   const char             *path,
+								   guint64                 stamp,
+								   GList                  *infos);
+
+/* Directories on another file system than the root are kept without
+ * their contents, marked so until they are updated again.
+ */
+void                   nautilus_filename_index_set_other_file_system (NautilusFilenameIndex *index,
+								      const char            *path);
+/* Whether path is under the root, and not on another file system. */
+gboolean               nautilus_filename_index_covers             (NautilusFilenameIndex  *index,
+								   const char             *path);
+/* Returns the paths of the directories on other file systems under path. */
+GPtrArray *            nautilus_filename_index_list_other_file_systems (NautilusFilenameIndex *index,
+									const char            *path);
+
+/* Calls func for every file in location, or under it if recursive,
+ * that matcher matches.
+ */
+void                   nautilus_filename_index_search             (NautilusFilenameIndex  *index,
+								   const char             *location,
+								   gboolean                recursive,
+								   gboolean                show_hidden,
+								   NautilusQueryMatcher   *matcher,
+								   GCancellable           *cancellable,
+								   NautilusFilenameIndexFunc func,
+								   gpointer                user_data);
+
+#endif /* NAUTILUS_FILENAME_INDEX_H */
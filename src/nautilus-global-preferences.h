@@ -132,6 +132,9 @@ typedef enum
 #define NAUTILUS_PREFERENCES_SHOW_DIRECTORY_ITEM_COUNTS "show-directory-item-counts"
 #define NAUTILUS_PREFERENCES_SHOW_FILE_THUMBNAILS	"show-image-thumbnails"
 #define NAUTILUS_PREFERENCES_FILE_THUMBNAIL_LIMIT	"thumbnail-limit"
+#define NAUTILUS_PREFERENCES_DIRECTORY_ATTRIBUTE_PIPELINE_DEPTH "directory-attribute-pipeline-depth"
+#define NAUTILUS_PREFERENCES_DIRECTORY_LISTING_CACHE "directory-listing-cache"
+#define NAUTILUS_PREFERENCES_FILENAME_INDEX "filename-index"
 
 typedef enum
 {
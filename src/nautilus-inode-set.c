@@ -0,0 +1,180 @@
+/*
+ *  nautilus-inode-set.c: Set of (device, inode) pairs.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 2 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* An open addressing hash table with linear probing, kept at most half
+ * full. The pairs are stored inline, so a deep count of a big tree
+ * doesn't allocate per file. Inode 0 marks an empty slot.
+ */
+
+#include <config.h>
+#include "nautilus-inode-set.h"
+
+#define INITIAL_SLOTS 64
+
+typedef struct
+{
+    guint64 device;
+    guint64 inode;
+} InodeKey;
+
+struct NautilusInodeSet
+{
+    InodeKey *slots;
+    gsize n_slots; /* always a power of 2 */
+    gsize n_items;
+};
+
+static inline gsize
+hash_key (guint64 device,
+          guint64 inode)
+{
+    guint64 hash;
+
+    /* Inode numbers are mostly sequential, so mix the bits well
+     * (the splitmix64 finalizer).
+     */
+    hash = inode ^ (device * G_GUINT64_CONSTANT (0x9e3779b97f4a7c15));
+    hash = (hash ^ (hash >> 30)) * G_GUINT64_CONSTANT (0xbf58476d1ce4e5b9);
+    hash = (hash ^ (hash >> 27)) * G_GUINT64_CONSTANT (0x94d049bb133111eb);
+    hash = hash ^ (hash >> 31);
+
+    return (gsize) hash;
+}
+
+/* Returns the slot holding the key, or the empty slot it would go in. */
+static inline InodeKey *
+lookup_slot (InodeKey *slots,
+             gsize     n_slots,
+             guint64   device,
+             guint64   inode)
+{
+    gsize mask, i;
+
+    mask = n_slots - 1;
+    for (i = hash_key (device, inode) & mask;; i = (i + 1) & mask)
+    {
+        if (slots[i].inode == 0 ||
+            (slots[i].inode == inode && slots[i].device == device))
+        {
+            return &slots[i];
+        }
+    }
+}
+
+static void
+grow (NautilusInodeSet *set)
+{
+    InodeKey *old_slots, *slot;
+    gsize old_n_slots, i;
+
+    old_slots = set->slots;
+    old_n_slots = set->n_slots;
+
+    set->n_slots = old_n_slots * 2;
+    set->slots = g_new0 (InodeKey, set->n_slots);
+
+    for (i = 0; i < old_n_slots; i++)
+    {
+        if (old_slots[i].inode != 0)
+        {
+            slot = lookup_slot (set->slots, set->n_slots,
+                                old_slots[i].device, old_slots[i].inode);
+            *slot = old_slots[i];
+        }
+    }
+
+    g_free (old_slots);
+}
+
+NautilusInodeSet *
+nautilus_inode_set_new (void)
+{
+    NautilusInodeSet *set;
+
+    set = g_new0 (NautilusInodeSet, 1);
+    set->n_slots = INITIAL_SLOTS;
+    set->slots = g_new0 (InodeKey, set->n_slots);
+
+    return set;
+}
+
+void
+nautilus_inode_set_free (NautilusInodeSet *set)
+{
+    if (set == NULL)
+    {
+        return;
+    }
+
+    g_free (set->slots);
+    g_free (set);
+}
+
+gboolean
+nautilus_inode_set_add (NautilusInodeSet *set,
+                        guint64           device,
+                        guint64           inode)
+{
+    InodeKey *slot;
+
+    g_return_val_if_fail (set != NULL, FALSE);
+
+    if (inode == 0)
+    {
+        return TRUE;
+    }
+
+    slot = lookup_slot (set->slots, set->n_slots, device, inode);
+    if (slot->inode != 0)
+    {
+        return FALSE;
+    }
+
+    slot->device = device;
+    slot->inode = inode;
+    set->n_items++;
+
+    if (set->n_items * 2 > set->n_slots)
+    {
+        grow (set);
+    }
+
+    return TRUE;
+}
+
+gboolean
+nautilus_inode_set_contains (NautilusInodeSet *set,
+                             guint64           device,
+                             guint64           inode)
+{
+    g_return_val_if_fail (set != NULL, FALSE);
+
+    if (inode == 0)
+    {
+        return FALSE;
+    }
+
+    return lookup_slot (set->slots, set->n_slots, device, inode)->inode != 0;
+}
+
+guint
+nautilus_inode_set_size (NautilusInodeSet *set)
+{
+    g_return_val_if_fail (set != NULL, 0);
+
+    return set->n_items;
+}
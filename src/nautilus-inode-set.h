@@ -0,0 +1,40 @@
+/*
+   nautilus-inode-set.h: Set of (device, inode) pairs.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef NAUTILUS_INODE_SET_H
+#define NAUTILUS_INODE_SET_H
+
+#include <glib.h>
+
+/* Used by deep counts to count hard linked files only once. */
+typedef struct NautilusInodeSet NautilusInodeSet;
+
+NautilusInodeSet *nautilus_inode_set_new    (void);
+void              nautilus_inode_set_free   (NautilusInodeSet *set);
+
+/* Adds the inode to the set, returns FALSE if it was already in it.
+ * Inode 0 means unknown, it is never added.
+ */
+gboolean          nautilus_inode_set_add    (NautilusInodeSet *set,
+					     guint64           device,
+					     guint64           inode);
+gboolean          nautilus_inode_set_contains (NautilusInodeSet *set,
+					       guint64           device,
+					       guint64           inode);
+guint             nautilus_inode_set_size   (NautilusInodeSet *set);
+
+#endif /* NAUTILUS_INODE_SET_H */
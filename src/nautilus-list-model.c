@@ -33,6 +33,7 @@
 
 #include <eel/eel-graphic-effects.h>
 #include "nautilus-dnd.h"
+#include "nautilus-parallel-sort.h"
 
 enum
 {
@@ -820,19 +821,34 @@ nautilus_list_model_compare_func (NautilusListModel *model,
     return result;
 }
 
+static gint
+file_entry_compare_indirect (gconstpointer a,
+                             gconstpointer b,
+                             gpointer      user_data)
+{
+    return nautilus_list_model_file_entry_compare_func (*(FileEntry **) a,
+                                                        *(FileEntry **) b,
+                                                        user_data);
+}
+
 static void
 nautilus_list_model_sort_file_entries (NautilusListModel *model,
                                        GSequence         *files,
                                        GtkTreePath       *path)
 {
+    NautilusListModelPrivate *priv;
     GSequenceIter **old_order;
     GtkTreeIter iter;
+    g_autofree gpointer *entries = NULL;
+    GSequenceIter *ptr;
     int *new_order;
     int length;
     int i;
     FileEntry *file_entry;
     gboolean has_iter;
+    gboolean threaded;
 
+    priv = nautilus_list_model_get_instance_private (model);
     length = g_sequence_get_length (files);
 
     if (length <= 1)
@@ -842,10 +858,10 @@ nautilus_list_model_sort_file_entries (NautilusListModel *model,
 
     /* generate old order of GSequenceIter's */
     old_order = g_new (GSequenceIter *, length);
-    for (i = 0; i < length; ++i)
+    entries = g_new (gpointer, length);
+    threaded = TRUE;
+    for (i = 0, ptr = g_sequence_get_begin_iter (files); i < length; ++i, ptr = g_sequence_iter_next (ptr))
     {
-        GSequenceIter *ptr = g_sequence_get_iter_at_pos (files, i);
-
         file_entry = g_sequence_get (ptr);
         if (file_entry->files != NULL)
         {
@@ -854,11 +870,33 @@ nautilus_list_model_sort_file_entries (NautilusListModel *model,
             gtk_tree_path_up (path);
         }
 
+        if (file_entry->file != NULL && threaded)
+        {
+            threaded = nautilus_file_prepare_for_threaded_sort_by_attribute_q (file_entry->file,
+                                                                               priv->sort_attribute);
+        }
+
         old_order[i] = ptr;
+        entries[i] = file_entry;
     }
 
-    /* sort */
-    g_sequence_sort (files, nautilus_list_model_file_entry_compare_func, model);
+    /* sort, on several threads when the keys allow it, and then put the
+     * entries of the sequence in that order */
+    if (threaded)
+    {
+        nautilus_parallel_sort (entries, length,
+                                nautilus_list_model_file_entry_compare_func, model);
+    }
+    else
+    {
+        g_qsort_with_data (entries, length, sizeof (gpointer),
+                           file_entry_compare_indirect, model);
+    }
+    for (i = 0; i < length; ++i)
+    {
+        file_entry = entries[i];
+        g_sequence_move (file_entry->ptr, g_sequence_get_end_iter (files));
+    }
 
     /* generate new order */
     new_order = g_new (int, length);
@@ -980,19 +1018,21 @@ add_dummy_row (NautilusListModel *model,
     gtk_tree_path_free (path);
 }
 
-gboolean
-nautilus_list_model_add_file (NautilusListModel *model,
-                              NautilusFile      *file,
-                              NautilusDirectory *directory)
+/* Makes the entry for a file that is about to be added under directory,
+ * replacing the loading row of the directory if it has one. Returns NULL
+ * if the file is already there.
+ */
+static FileEntry *
+prepare_file_entry (NautilusListModel  *model,
+                    NautilusFile       *file,
+                    NautilusDirectory  *directory,
+                    GSequence         **files,
+                    GHashTable        **parent_hash,
+                    gboolean           *replace_dummy)
 {
     NautilusListModelPrivate *priv;
-    GtkTreeIter iter;
-    GtkTreePath *path;
     FileEntry *file_entry;
-    GSequenceIter *ptr, *parent_ptr;
-    GSequence *files;
-    gboolean replace_dummy;
-    GHashTable *parent_hash;
+    GSequenceIter *parent_ptr;
 
     priv = nautilus_list_model_get_instance_private (model);
 
@@ -1001,18 +1041,17 @@ nautilus_list_model_add_file (NautilusListModel *model,
     if (parent_ptr)
     {
         file_entry = g_sequence_get (parent_ptr);
-        ptr = g_hash_table_lookup (file_entry->reverse_map, file);
+        *parent_hash = file_entry->reverse_map;
     }
     else
     {
-        file_entry = NULL;
-        ptr = g_hash_table_lookup (priv->top_reverse_map, file);
+        *parent_hash = priv->top_reverse_map;
     }
 
-    if (ptr != NULL)
+    if (g_hash_table_contains (*parent_hash, file))
     {
         g_warning ("file already in tree (parent_ptr: %p)!!!\n", parent_ptr);
-        return FALSE;
+        return NULL;
     }
 
     file_entry = g_new0 (FileEntry, 1);
@@ -1021,10 +1060,8 @@ nautilus_list_model_add_file (NautilusListModel *model,
     file_entry->subdirectory = NULL;
     file_entry->files = NULL;
 
-    files = priv->files;
-    parent_hash = priv->top_reverse_map;
-
-    replace_dummy = FALSE;
+    *files = priv->files;
+    *replace_dummy = FALSE;
 
     if (parent_ptr != NULL)
     {
@@ -1034,11 +1071,10 @@ nautilus_list_model_add_file (NautilusListModel *model,
          * earlier, but then we replace the dummy row anyway,
          * so it doesn't matter */
         file_entry->parent->loaded = 1;
-        parent_hash = file_entry->parent->reverse_map;
-        files = file_entry->parent->files;
-        if (g_sequence_get_length (files) == 1)
+        *files = file_entry->parent->files;
+        if (g_sequence_get_length (*files) == 1)
         {
-            GSequenceIter *dummy_ptr = g_sequence_get_iter_at_pos (files, 0);
+            GSequenceIter *dummy_ptr = g_sequence_get_iter_at_pos (*files, 0);
             FileEntry *dummy_entry = g_sequence_get (dummy_ptr);
             if (dummy_entry->file == NULL)
             {
@@ -1046,16 +1082,28 @@ nautilus_list_model_add_file (NautilusListModel *model,
                 priv->stamp++;
                 g_sequence_remove (dummy_ptr);
 
-                replace_dummy = TRUE;
+                *replace_dummy = TRUE;
             }
         }
     }
 
+    return file_entry;
+}
 
-    file_entry->ptr = g_sequence_insert_sorted (files, file_entry,
-                                                nautilus_list_model_file_entry_compare_func, model);
+/* Tells the tree view about an entry that was just put at file_entry->ptr. */
+static void
+file_entry_inserted (NautilusListModel *model,
+                     FileEntry         *file_entry,
+                     GHashTable        *parent_hash,
+                     gboolean           replace_dummy)
+{
+    NautilusListModelPrivate *priv;
+    GtkTreeIter iter;
+    GtkTreePath *path;
+
+    priv = nautilus_list_model_get_instance_private (model);
 
-    g_hash_table_insert (parent_hash, file, file_entry->ptr);
+    g_hash_table_insert (parent_hash, file_entry->file, file_entry->ptr);
 
     iter.stamp = priv->stamp;
     iter.user_data = file_entry->ptr;
@@ -1070,7 +1118,7 @@ nautilus_list_model_add_file (NautilusListModel *model,
         gtk_tree_model_row_inserted (GTK_TREE_MODEL (model), path, &iter);
     }
 
-    if (nautilus_file_is_directory (file))
+    if (nautilus_file_is_directory (file_entry->file))
     {
         file_entry->files = g_sequence_new ((GDestroyNotify) file_entry_free);
 
@@ -1080,10 +1128,129 @@ nautilus_list_model_add_file (NautilusListModel *model,
                                               path, &iter);
     }
     gtk_tree_path_free (path);
+}
+
+gboolean
+nautilus_list_model_add_file (NautilusListModel *model,
+                              NautilusFile      *file,
+                              NautilusDirectory *directory)
+{
+    FileEntry *file_entry;
+    GSequence *files;
+    GHashTable *parent_hash;
+    gboolean replace_dummy;
+
+    file_entry = prepare_file_entry (model, file, directory,
+                                     &files, &parent_hash, &replace_dummy);
+    if (file_entry == NULL)
+    {
+        return FALSE;
+    }
+
+    file_entry->ptr = g_sequence_insert_sorted (files, file_entry,
+                                                nautilus_list_model_file_entry_compare_func, model);
+    file_entry_inserted (model, file_entry, parent_hash, replace_dummy);
 
     return TRUE;
 }
 
+static int
+file_entry_compare_indirect (gconstpointer a,
+                             gconstpointer b,
+                             gpointer      user_data)
+{
+    return nautilus_list_model_file_entry_compare_func (*(FileEntry **) a,
+                                                        *(FileEntry **) b,
+                                                        user_data);
+}
+
+/* Adds files that all live in directory, once each. */
+void
+nautilus_list_model_add_files (NautilusListModel *model,
+                               GList             *files,
+                               NautilusDirectory *directory)
+{
+    g_autoptr (GPtrArray) entries = NULL;
+    FileEntry *file_entry;
+    GSequence *sequence;
+    GSequenceIter *ptr;
+    GHashTable *parent_hash;
+    gboolean replace_dummy;
+    gboolean first_replace_dummy;
+    guint n_rows;
+    GList *l;
+    guint i;
+
+    entries = g_ptr_array_new ();
+    sequence = NULL;
+    parent_hash = NULL;
+    first_replace_dummy = FALSE;
+    for (l = files; l != NULL; l = l->next)
+    {
+        file_entry = prepare_file_entry (model, NAUTILUS_FILE (l->data), directory,
+                                         &sequence, &parent_hash, &replace_dummy);
+        if (file_entry == NULL)
+        {
+            continue;
+        }
+
+        /* Keeps a file listed twice in the batch from being added twice. */
+        g_hash_table_insert (parent_hash, file_entry->file, NULL);
+        first_replace_dummy |= replace_dummy;
+        g_ptr_array_add (entries, file_entry);
+    }
+
+    if (entries->len == 0)
+    {
+        return;
+    }
+
+    g_ptr_array_sort_with_data (entries, file_entry_compare_indirect, model);
+
+    /* Merge the sorted batch into the rows in one pass, unless the batch
+     * is so small next to them that searching the tree for each new row
+     * compares less.
+     */
+    n_rows = g_sequence_get_length (sequence);
+    if (entries->len * g_bit_storage (n_rows) < n_rows)
+    {
+        for (i = 0; i < entries->len; i++)
+        {
+            file_entry = g_ptr_array_index (entries, i);
+            file_entry->ptr = g_sequence_insert_sorted (sequence, file_entry,
+                                                        nautilus_list_model_file_entry_compare_func,
+                                                        model);
+        }
+    }
+    else
+    {
+        ptr = g_sequence_get_begin_iter (sequence);
+        for (i = 0; i < entries->len; i++)
+        {
+            file_entry = g_ptr_array_index (entries, i);
+            while (!g_sequence_iter_is_end (ptr) &&
+                   nautilus_list_model_file_entry_compare_func (g_sequence_get (ptr),
+                                                                file_entry,
+                                                                model) <= 0)
+            {
+                ptr = g_sequence_iter_next (ptr);
+            }
+            file_entry->ptr = g_sequence_insert_before (ptr, file_entry);
+        }
+    }
+
+    /* Announce the rows once they are all in, from the top, so the
+     * rows above each one are known to the view when it gets there.
+     * Only the first can take the place of the loading row.
+     */
+    for (i = 0; i < entries->len; i++)
+    {
+        file_entry = g_ptr_array_index (entries, i);
+        file_entry_inserted (model, file_entry, parent_hash,
+                             first_replace_dummy && i == 0);
+    }
+}
+
 void
 nautilus_list_model_file_changed (NautilusListModel *model,
                                   NautilusFile      *file,
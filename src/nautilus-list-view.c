@@ -2316,21 +2316,39 @@ nautilus_list_view_add_files (NautilusFilesView *view,
                               GList             *files)
 {
     NautilusListModel *model;
+    GHashTable *files_by_directory;
+    GHashTableIter iter;
+    gpointer directory;
+    gpointer directory_files;
     GList *l;
 
     model = NAUTILUS_LIST_VIEW (view)->details->model;
+
+    /* Files are merged into the model one directory at a time. */
+    files_by_directory = g_hash_table_new_full (NULL, NULL,
+                                                (GDestroyNotify) nautilus_directory_unref,
+                                                NULL);
     for (l = files; l != NULL; l = l->next)
     {
         NautilusFile *parent;
-        NautilusDirectory *directory;
 
         parent = nautilus_file_get_parent (NAUTILUS_FILE (l->data));
         directory = nautilus_directory_get_for_file (parent);
-        nautilus_list_model_add_file (model, NAUTILUS_FILE (l->data), directory);
-
         nautilus_file_unref (parent);
-        nautilus_directory_unref (directory);
+
+        /* Drops the extra reference when the directory is already there. */
+        directory_files = g_hash_table_lookup (files_by_directory, directory);
+        g_hash_table_insert (files_by_directory, directory,
+                             g_list_prepend (directory_files, l->data));
+    }
+
+    g_hash_table_iter_init (&iter, files_by_directory);
+    while (g_hash_table_iter_next (&iter, &directory, &directory_files))
+    {
+        nautilus_list_model_add_files (model, directory_files, directory);
+        g_list_free (directory_files);
     }
+    g_hash_table_destroy (files_by_directory);
 }
 
 static char **
@@ -0,0 +1,128 @@
+/*
+ *  nautilus-mime-filter.c: Matching of content types against a query.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 2 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* g_content_type_is_a() walks the parents and aliases of the type in
+ * the shared MIME database on every call. A search only ever sees a
+ * few hundred distinct content types, so the answer for each one is
+ * kept in a table. Lookups only take the lock for reading, and the
+ * table is seeded with the MIME types of the query.
+ */
+
+#include <config.h>
+#include "nautilus-mime-filter.h"
+
+#include <gio/gio.h>
+
+struct NautilusMimeFilter
+{
+    gint ref_count;
+    char **mime_types;
+
+    GRWLock lock;
+    GHashTable *matches;        /* content type → TRUE or FALSE */
+};
+
+NautilusMimeFilter *
+nautilus_mime_filter_new (GList *mime_types)
+{
+    NautilusMimeFilter *filter;
+    GList *l;
+    guint i;
+
+    if (mime_types == NULL)
+    {
+        return NULL;
+    }
+
+    filter = g_new0 (NautilusMimeFilter, 1);
+    filter->ref_count = 1;
+    filter->mime_types = g_new0 (char *, g_list_length (mime_types) + 1);
+    filter->matches = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    g_rw_lock_init (&filter->lock);
+
+    for (l = mime_types, i = 0; l != NULL; l = l->next, i++)
+    {
+        filter->mime_types[i] = g_strdup (l->data);
+        g_hash_table_insert (filter->matches, g_strdup (l->data), GINT_TO_POINTER (TRUE));
+    }
+
+    return filter;
+}
+
+NautilusMimeFilter *
+nautilus_mime_filter_ref (NautilusMimeFilter *filter)
+{
+    g_return_val_if_fail (filter != NULL, NULL);
+
+    g_atomic_int_inc (&filter->ref_count);
+
+    return filter;
+}
+
+void
+nautilus_mime_filter_unref (NautilusMimeFilter *filter)
+{
+    g_return_if_fail (filter != NULL);
+
+    if (!g_atomic_int_dec_and_test (&filter->ref_count))
+    {
+        return;
+    }
+
+    g_strfreev (filter->mime_types);
+    g_hash_table_destroy (filter->matches);
+    g_rw_lock_clear (&filter->lock);
+    g_free (filter);
+}
+
+gboolean
+nautilus_mime_filter_matches (NautilusMimeFilter *filter,
+                              const char         *content_type)
+{
+    gpointer value;
+    gboolean found, matches;
+    guint i;
+
+    g_return_val_if_fail (filter != NULL, FALSE);
+
+    if (content_type == NULL)
+    {
+        return FALSE;
+    }
+
+    g_rw_lock_reader_lock (&filter->lock);
+    found = g_hash_table_lookup_extended (filter->matches, content_type, NULL, &value);
+    g_rw_lock_reader_unlock (&filter->lock);
+
+    if (found)
+    {
+        return GPOINTER_TO_INT (value);
+    }
+
+    matches = FALSE;
+    for (i = 0; filter->mime_types[i] != NULL && !matches; i++)
+    {
+        matches = g_content_type_is_a (content_type, filter->mime_types[i]);
+    }
+
+    /* Another thread may have added it meanwhile, with the same answer. */
+    g_rw_lock_writer_lock (&filter->lock);
+    g_hash_table_insert (filter->matches, g_strdup (content_type), GINT_TO_POINTER (matches));
+    g_rw_lock_writer_unlock (&filter->lock);
+
+    return matches;
+}
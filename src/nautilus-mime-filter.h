@@ -0,0 +1,43 @@
+/*
+   nautilus-mime-filter.h: Matching of content types against a query.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef NAUTILUS_MIME_FILTER_H
+#define NAUTILUS_MIME_FILTER_H
+
+#include <glib.h>
+
+/* The MIME types of a query, for checking the content types of many
+ * files. Each content type is only looked up in the MIME database the
+ * first time it is seen. A filter can be used from any number of
+ * threads at once.
+ */
+typedef struct NautilusMimeFilter NautilusMimeFilter;
+
+/* Returns NULL if there are no MIME types, which means any type. */
+NautilusMimeFilter *nautilus_mime_filter_new     (GList              *mime_types);
+NautilusMimeFilter *nautilus_mime_filter_ref     (NautilusMimeFilter *filter);
+void                nautilus_mime_filter_unref   (NautilusMimeFilter *filter);
+
+/* Returns TRUE if content_type is one of the MIME types or a subtype
+ * of one. A NULL content type matches nothing.
+ */
+gboolean            nautilus_mime_filter_matches (NautilusMimeFilter *filter,
+                                                  const char         *content_type);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (NautilusMimeFilter, nautilus_mime_filter_unref)
+
+#endif /* NAUTILUS_MIME_FILTER_H */
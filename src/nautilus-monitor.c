@@ -37,6 +37,11 @@ struct NautilusMonitor
     GFile *location;
 };
 
+/* Changes are collected for this long before they are processed, so
+ * bursts of changes to the same files can be merged.
+ */
+#define CONSUME_CHANGES_WINDOW 20 /* milliseconds */
+
 static gboolean call_consume_changes_idle_id = 0;
 
 static gboolean
@@ -53,7 +58,7 @@ schedule_call_consume_changes (void)
     if (call_consume_changes_idle_id == 0)
     {
         call_consume_changes_idle_id =
-            g_idle_add (call_consume_changes_idle_cb, NULL);
+            g_timeout_add (CONSUME_CHANGES_WINDOW, call_consume_changes_idle_cb, NULL);
     }
 }
 
@@ -83,23 +88,14 @@ dir_changed (GFileMonitor      *monitor,
              GFileMonitorEvent  event_type,
              gpointer           user_data)
 {
-    char *uri, *to_uri;
-
-    uri = g_file_get_uri (child);
-    to_uri = NULL;
-    if (other_file)
-    {
-        to_uri = g_file_get_uri (other_file);
-    }
-
     switch (event_type)
     {
         default:
         case G_FILE_MONITOR_EVENT_CHANGED:
         {
-            /* ignore */
+            /* ignore, a CHANGES_DONE_HINT follows */
         }
-        break;
+        return;
 
         case G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED:
         case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
@@ -110,20 +106,32 @@ dir_changed (GFileMonitor      *monitor,
 
         case G_FILE_MONITOR_EVENT_UNMOUNTED:
         case G_FILE_MONITOR_EVENT_DELETED:
+        case G_FILE_MONITOR_EVENT_MOVED_OUT:
         {
             nautilus_file_changes_queue_file_removed (child);
         }
         break;
 
         case G_FILE_MONITOR_EVENT_CREATED:
+        case G_FILE_MONITOR_EVENT_MOVED_IN:
         {
             nautilus_file_changes_queue_file_added (child);
         }
         break;
-    }
 
-    g_free (uri);
-    g_free (to_uri);
+        case G_FILE_MONITOR_EVENT_RENAMED:
+        {
+            if (other_file != NULL)
+            {
+                nautilus_file_changes_queue_file_moved (child, other_file);
+            }
+            else
+            {
+                nautilus_file_changes_queue_file_removed (child);
+            }
+        }
+        break;
+    }
 
     schedule_call_consume_changes ();
 }
@@ -135,7 +143,10 @@ nautilus_monitor_directory (GFile *location)
     NautilusMonitor *ret;
 
     ret = g_slice_new0 (NautilusMonitor);
-    dir_monitor = g_file_monitor_directory (location, G_FILE_MONITOR_WATCH_MOUNTS, NULL, NULL);
+    dir_monitor = g_file_monitor_directory (location,
+                                            G_FILE_MONITOR_WATCH_MOUNTS |
+                                            G_FILE_MONITOR_WATCH_MOVES,
+                                            NULL, NULL);
 
     if (dir_monitor != NULL)
     {
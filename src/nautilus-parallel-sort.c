@@ -0,0 +1,210 @@
+/*
+ *  nautilus-parallel-sort.c: Sorting large arrays on several threads.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 2 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* A merge sort: the array is cut in one run per thread, the runs are
+ * sorted at the same time, and then merged pairwise, every merge of a
+ * round on its own thread, until one run is left. The threads are
+ * those of the shared work queue pool, and the calling thread.
+ */
+
+#include <config.h>
+#include "nautilus-parallel-sort.h"
+#include "nautilus-work-queue.h"
+
+#include <string.h>
+
+/* Below this, handing work to threads costs more than it saves. */
+#define MIN_PARALLEL_ITEMS 16384
+#define MAX_THREADS 8
+
+typedef struct
+{
+    GCompareDataFunc compare_func;
+    gpointer user_data;
+} CompareData;
+
+typedef struct
+{
+    gpointer *items;
+    gpointer *out;
+    guint start;
+    guint middle;
+    guint end;
+    GCompareDataFunc compare_func;
+    gpointer user_data;
+} SortTask;
+
+/* g_qsort_with_data() passes pointers to the items. */
+static gint
+compare_indirect (gconstpointer a,
+                  gconstpointer b,
+                  gpointer      user_data)
+{
+    CompareData *data = user_data;
+
+    return data->compare_func (*(gpointer *) a, *(gpointer *) b, data->user_data);
+}
+
+static void
+sort_range (gpointer         *items,
+            guint             n_items,
+            GCompareDataFunc  compare_func,
+            gpointer          user_data)
+{
+    CompareData data;
+
+    data.compare_func = compare_func;
+    data.user_data = user_data;
+    g_qsort_with_data (items, n_items, sizeof (gpointer), compare_indirect, &data);
+}
+
+static void
+sort_run (gpointer item,
+          guint    worker,
+          gpointer user_data)
+{
+    SortTask *task = item;
+
+    sort_range (task->items + task->start,
+                task->end - task->start,
+                task->compare_func,
+                task->user_data);
+}
+
+/* Merges the sorted runs [start, middle) and [middle, end) of items
+ * into the same range of out. The left run wins ties, which keeps the
+ * sort stable.
+ */
+static void
+merge_runs (gpointer item,
+            guint    worker,
+            gpointer user_data)
+{
+    SortTask *task = item;
+    guint left, right, i;
+
+    left = task->start;
+    right = task->middle;
+    i = task->start;
+
+    while (left < task->middle && right < task->end)
+    {
+        if (task->compare_func (task->items[left], task->items[right], task->user_data) <= 0)
+        {
+            task->out[i++] = task->items[left++];
+        }
+        else
+        {
+            task->out[i++] = task->items[right++];
+        }
+    }
+
+    memcpy (task->out + i, task->items + left, (task->middle - left) * sizeof (gpointer));
+    i += task->middle - left;
+    memcpy (task->out + i, task->items + right, (task->end - right) * sizeof (gpointer));
+}
+
+/* Runs every task, some on this thread, and waits for all. */
+static void
+run_tasks (SortTask              *tasks,
+           guint                  n_tasks,
+           NautilusWorkQueueFunc  func)
+{
+    NautilusWorkQueue *queue;
+    guint i;
+
+    queue = nautilus_work_queue_new (n_tasks, func, NULL, NULL, NULL, NULL);
+    for (i = 0; i < n_tasks; i++)
+    {
+        nautilus_work_queue_push (queue, 0, &tasks[i]);
+    }
+    nautilus_work_queue_run (queue);
+    nautilus_work_queue_unref (queue);
+}
+
+void
+nautilus_parallel_sort (gpointer         *items,
+                        guint             n_items,
+                        GCompareDataFunc  compare_func,
+                        gpointer          user_data)
+{
+    SortTask tasks[MAX_THREADS];
+    guint bounds[MAX_THREADS + 1];
+    g_autofree gpointer *scratch = NULL;
+    gpointer *from, *to, *swap;
+    guint n_runs, n_processors, i;
+
+    n_processors = g_get_num_processors ();
+    if (n_items < MIN_PARALLEL_ITEMS || n_processors < 2)
+    {
+        sort_range (items, n_items, compare_func, user_data);
+        return;
+    }
+
+    /* A power of two, so the runs pair up in every round. */
+    for (n_runs = 2; n_runs * 2 <= MIN (n_processors, MAX_THREADS); n_runs *= 2)
+    {
+    }
+
+    for (i = 0; i <= n_runs; i++)
+    {
+        bounds[i] = (guint) ((guint64) n_items * i / n_runs);
+    }
+
+    for (i = 0; i < n_runs; i++)
+    {
+        tasks[i].items = items;
+        tasks[i].start = bounds[i];
+        tasks[i].end = bounds[i + 1];
+        tasks[i].compare_func = compare_func;
+        tasks[i].user_data = user_data;
+    }
+    run_tasks (tasks, n_runs, sort_run);
+
+    scratch = g_new (gpointer, n_items);
+    from = items;
+    to = scratch;
+    for (; n_runs > 1; n_runs /= 2)
+    {
+        for (i = 0; i < n_runs / 2; i++)
+        {
+            tasks[i].items = from;
+            tasks[i].out = to;
+            tasks[i].start = bounds[2 * i];
+            tasks[i].middle = bounds[2 * i + 1];
+            tasks[i].end = bounds[2 * i + 2];
+            tasks[i].compare_func = compare_func;
+            tasks[i].user_data = user_data;
+        }
+        run_tasks (tasks, n_runs / 2, merge_runs);
+
+        /* The runs of the next round are the merged pairs. */
+        for (i = 0; i <= n_runs / 2; i++)
+        {
+            bounds[i] = bounds[2 * i];
+        }
+
+        swap = from;
+        from = to;
+        to = swap;
+    }
+
+    if (from != items)
+    {
+        memcpy (items, from, n_items * sizeof (gpointer));
+    }
+}
@@ -0,0 +1,35 @@
+/*
+   nautilus-parallel-sort.h: Sorting large arrays on several threads.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef NAUTILUS_PARALLEL_SORT_H
+#define NAUTILUS_PARALLEL_SORT_H
+
+#include <glib.h>
+
+/* Sorts the pointers in items, keeping the order of the ones that
+ * compare equal. compare_func gets the items themselves, as with
+ * g_list_sort_with_data(), not pointers to them. Large arrays are
+ * sorted on several threads, so compare_func is called from all of
+ * them at once and must only read what it compares. The call returns
+ * when the array is sorted.
+ */
+void nautilus_parallel_sort (gpointer         *items,
+                             guint             n_items,
+                             GCompareDataFunc  compare_func,
+                             gpointer          user_data);
+
+#endif /* NAUTILUS_PARALLEL_SORT_H */
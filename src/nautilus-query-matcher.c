@@ -0,0 +1,455 @@
+/*
+ *  nautilus-query-matcher.c: Matching of file names against search text.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 2 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Both the words and the file names are compared in NFD and lowercase.
+ * Most file names are plain ASCII, for which that is just lowering the
+ * case, so those are lowered into a buffer on the stack instead of
+ * going through g_utf8_normalize() and g_utf8_strdown(). The words are
+ * looked for with memchr() on their first byte, which the C library
+ * vectorizes, and memcmp() on the candidates.
+ *
+ * File contents are searched the same way, with one memchr() for each
+ * case of the first letter of the word.
+ */
+
+#include <config.h>
+#include "nautilus-query-matcher.h"
+
+#include <string.h>
+
+#define RANK_SCALE_FACTOR 100
+#define MIN_RANK 10.0
+#define MAX_RANK 50.0
+#define CONTENTS_RANK (MIN_RANK / 2)
+
+/* File names are at most 255 bytes on most file systems. */
+#define STACK_BUFFER_SIZE 256
+
+struct NautilusQueryMatcher
+{
+    gint ref_count;
+    gboolean matches_nothing;
+    guint n_words;
+    char **words;
+    gsize *word_lengths;
+    guint longest_word;
+    char **content_words;   /* in NFC, for file contents */
+    gsize *content_word_lengths;
+};
+
+static gchar *
+prepare_string_for_compare (const gchar *string)
+{
+    gchar *normalized, *res;
+
+    normalized = g_utf8_normalize (string, -1, G_NORMALIZE_NFD);
+    res = g_utf8_strdown (normalized, -1);
+    g_free (normalized);
+
+    return res;
+}
+
+NautilusQueryMatcher *
+nautilus_query_matcher_new (const char *text)
+{
+    NautilusQueryMatcher *matcher;
+    gchar *prepared_text;
+    guint i;
+
+    matcher = g_new0 (NautilusQueryMatcher, 1);
+    matcher->ref_count = 1;
+
+    if (text == NULL)
+    {
+        matcher->matches_nothing = TRUE;
+        return matcher;
+    }
+
+    prepared_text = prepare_string_for_compare (text);
+    matcher->words = g_strsplit (prepared_text, " ", -1);
+    g_free (prepared_text);
+
+    matcher->n_words = g_strv_length (matcher->words);
+    matcher->word_lengths = g_new (gsize, matcher->n_words);
+    matcher->content_words = g_new0 (char *, matcher->n_words + 1);
+    matcher->content_word_lengths = g_new (gsize, matcher->n_words);
+    for (i = 0; i < matcher->n_words; i++)
+    {
+        matcher->word_lengths[i] = strlen (matcher->words[i]);
+        matcher->content_words[i] = g_utf8_normalize (matcher->words[i], -1, G_NORMALIZE_NFC);
+        matcher->content_word_lengths[i] = strlen (matcher->content_words[i]);
+        if (matcher->word_lengths[i] > matcher->word_lengths[matcher->longest_word])
+        {
+            matcher->longest_word = i;
+        }
+    }
+
+    return matcher;
+}
+
+NautilusQueryMatcher *
+nautilus_query_matcher_ref (NautilusQueryMatcher *matcher)
+{
+    g_return_val_if_fail (matcher != NULL, NULL);
+
+    g_atomic_int_inc (&matcher->ref_count);
+
+    return matcher;
+}
+
+void
+nautilus_query_matcher_unref (NautilusQueryMatcher *matcher)
+{
+    g_return_if_fail (matcher != NULL);
+
+    if (!g_atomic_int_dec_and_test (&matcher->ref_count))
+    {
+        return;
+    }
+
+    g_strfreev (matcher->words);
+    g_free (matcher->word_lengths);
+    g_strfreev (matcher->content_words);
+    g_free (matcher->content_word_lengths);
+    g_free (matcher);
+}
+
+/* Lowers the case of an ASCII string into buffer. Returns FALSE if the
+ * string isn't ASCII or doesn't fit.
+ */
+static inline gboolean
+prepare_ascii_string (const char *string,
+                      char       *buffer,
+                      gsize      *length)
+{
+    gsize i;
+    guchar c;
+
+    for (i = 0; string[i] != '\0'; i++)
+    {
+        c = string[i];
+        if (c >= 0x80 || i == STACK_BUFFER_SIZE - 1)
+        {
+            return FALSE;
+        }
+        buffer[i] = (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+    }
+    buffer[i] = '\0';
+    *length = i;
+
+    return TRUE;
+}
+
+/* Returns the offset of the first occurrence of word in string, or -1. */
+static inline gssize
+find_word (const char *string,
+           gsize       length,
+           const char *word,
+           gsize       word_length)
+{
+    const char *p, *last;
+
+    if (word_length == 0)
+    {
+        return 0;
+    }
+    if (word_length > length)
+    {
+        return -1;
+    }
+
+    last = string + length - word_length;
+    for (p = string; p <= last; p++)
+    {
+        p = memchr (p, word[0], last - p + 1);
+        if (p == NULL)
+        {
+            return -1;
+        }
+        if (memcmp (p + 1, word + 1, word_length - 1) == 0)
+        {
+            return p - string;
+        }
+    }
+
+    return -1;
+}
+
+gdouble
+nautilus_query_matcher_match (NautilusQueryMatcher *matcher,
+                              const char           *string)
+{
+    char buffer[STACK_BUFFER_SIZE];
+    const char *prepared_string;
+    gchar *allocated_string;
+    gsize length;
+    gssize offset;
+    gsize nonexact_malus;
+    guint i;
+
+    if (matcher->matches_nothing)
+    {
+        return -1;
+    }
+
+    allocated_string = NULL;
+    if (prepare_ascii_string (string, buffer, &length))
+    {
+        prepared_string = buffer;
+    }
+    else
+    {
+        allocated_string = prepare_string_for_compare (string);
+        prepared_string = allocated_string;
+        length = strlen (prepared_string);
+    }
+
+    offset = 0;
+    nonexact_malus = 0;
+    for (i = 0; i < matcher->n_words; i++)
+    {
+        offset = find_word (prepared_string, length,
+                            matcher->words[i], matcher->word_lengths[i]);
+        if (offset < 0)
+        {
+            g_free (allocated_string);
+            return -1;
+        }
+
+        nonexact_malus += length - offset - matcher->word_lengths[i];
+    }
+
+    g_free (allocated_string);
+
+    /* The rank value depends on the numbers of letters before and after the match.
+     * To make the prefix matches prefered over sufix ones, the number of letters
+     * after the match is divided by a factor, so that it decreases the rank by a
+     * smaller amount.
+     */
+    return MAX (MIN_RANK, MAX_RANK - (gdouble) offset - (gdouble) nonexact_malus / RANK_SCALE_FACTOR);
+}
+
+/* Returns the offset of the word in the string, comparing ASCII letters
+ * without case, or -1.
+ */
+static gssize
+find_word_ignoring_ascii_case (const char *string,
+                               gsize       length,
+                               const char *word,
+                               gsize       word_length)
+{
+    const char *end, *lower, *upper, *p;
+    char first_lower, first_upper;
+
+    if (word_length > length)
+    {
+        return -1;
+    }
+
+    /* Where the last possible match starts, plus one. */
+    end = string + length - word_length + 1;
+
+    first_lower = g_ascii_tolower (word[0]);
+    first_upper = g_ascii_toupper (word[0]);
+    lower = memchr (string, first_lower, end - string);
+    upper = first_upper != first_lower ? memchr (string, first_upper, end - string) : NULL;
+
+    while (lower != NULL || upper != NULL)
+    {
+        if (upper == NULL || (lower != NULL && lower < upper))
+        {
+            p = lower;
+            lower = memchr (p + 1, first_lower, end - p - 1);
+        }
+        else
+        {
+            p = upper;
+            upper = memchr (p + 1, first_upper, end - p - 1);
+        }
+
+        if (g_ascii_strncasecmp (p + 1, word + 1, word_length - 1) == 0)
+        {
+            return p - string;
+        }
+    }
+
+    return -1;
+}
+
+gssize
+nautilus_query_matcher_match_contents (NautilusQueryMatcher *matcher,
+                                       const char           *contents,
+                                       gsize                 length)
+{
+    gssize offset;
+    guint i;
+
+    g_return_val_if_fail (matcher != NULL, -1);
+
+    if (matcher->matches_nothing || matcher->n_words == 0 ||
+        matcher->content_word_lengths[matcher->longest_word] == 0)
+    {
+        return -1;
+    }
+
+    /* The longest word is the least likely to be there. */
+    offset = find_word_ignoring_ascii_case (contents, length,
+                                            matcher->content_words[matcher->longest_word],
+                                            matcher->content_word_lengths[matcher->longest_word]);
+    if (offset < 0)
+    {
+        return -1;
+    }
+
+    for (i = 0; i < matcher->n_words; i++)
+    {
+        if (i != matcher->longest_word &&
+            matcher->content_word_lengths[i] > 0 &&
+            find_word_ignoring_ascii_case (contents, length,
+                                           matcher->content_words[i],
+                                           matcher->content_word_lengths[i]) < 0)
+        {
+            return -1;
+        }
+    }
+
+    return offset;
+}
+
+gboolean
+nautilus_query_matcher_match_contents_part (NautilusQueryMatcher *matcher,
+                                            const char           *contents,
+                                            gsize                 length,
+                                            gboolean             *found,
+                                            gssize               *offset)
+{
+    gssize word_offset;
+    gboolean found_all;
+    guint i;
+
+    g_return_val_if_fail (matcher != NULL, FALSE);
+
+    *offset = -1;
+
+    if (matcher->matches_nothing || matcher->n_words == 0 ||
+        matcher->content_word_lengths[matcher->longest_word] == 0)
+    {
+        return FALSE;
+    }
+
+    found_all = TRUE;
+    for (i = 0; i < matcher->n_words; i++)
+    {
+        if (!found[i])
+        {
+            word_offset = matcher->content_word_lengths[i] == 0 ? 0 :
+                          find_word_ignoring_ascii_case (contents, length,
+                                                         matcher->content_words[i],
+                                                         matcher->content_word_lengths[i]);
+            found[i] = word_offset >= 0;
+            if (i == matcher->longest_word)
+            {
+                *offset = word_offset;
+            }
+        }
+
+        found_all &= found[i];
+    }
+
+    return found_all;
+}
+
+gsize
+nautilus_query_matcher_get_contents_overlap (NautilusQueryMatcher *matcher)
+{
+    gsize overlap;
+    guint i;
+
+    g_return_val_if_fail (matcher != NULL, 0);
+
+    /* The longest word in NFD is not always the longest one in NFC. */
+    overlap = 0;
+    for (i = 0; !matcher->matches_nothing && i < matcher->n_words; i++)
+    {
+        if (matcher->content_word_lengths[i] > overlap + 1)
+        {
+            overlap = matcher->content_word_lengths[i] - 1;
+        }
+    }
+
+    return overlap;
+}
+
+guint
+nautilus_query_matcher_get_n_words (NautilusQueryMatcher *matcher)
+{
+    g_return_val_if_fail (matcher != NULL, 0);
+
+    return matcher->n_words;
+}
+
+gdouble
+nautilus_query_matcher_get_contents_rank (NautilusQueryMatcher *matcher)
+{
+    return CONTENTS_RANK;
+}
+
+const char *
+nautilus_query_matcher_get_longest_word (NautilusQueryMatcher *matcher)
+{
+    g_return_val_if_fail (matcher != NULL, NULL);
+
+    if (matcher->matches_nothing)
+    {
+        return NULL;
+    }
+
+    return matcher->n_words > 0 ? matcher->words[matcher->longest_word] : "";
+}
+
+gboolean
+nautilus_query_matcher_is_narrower (NautilusQueryMatcher *matcher,
+                                    NautilusQueryMatcher *other)
+{
+    guint i, j;
+
+    g_return_val_if_fail (matcher != NULL, FALSE);
+    g_return_val_if_fail (other != NULL, FALSE);
+
+    if (matcher->matches_nothing || other->matches_nothing)
+    {
+        return matcher->matches_nothing;
+    }
+
+    for (i = 0; i < other->n_words; i++)
+    {
+        for (j = 0; j < matcher->n_words; j++)
+        {
+            if (strstr (matcher->words[j], other->words[i]) != NULL)
+            {
+                break;
+            }
+        }
+
+        if (j == matcher->n_words)
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
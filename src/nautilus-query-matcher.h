@@ -0,0 +1,79 @@
+/*
+   nautilus-query-matcher.h: Matching of file names against search text.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef NAUTILUS_QUERY_MATCHER_H
+#define NAUTILUS_QUERY_MATCHER_H
+
+#include <glib.h>
+
+/* The words of a query, prepared once for matching many file names.
+ * A matcher never changes after it is created, so it can be used from
+ * any number of threads at once.
+ */
+typedef struct NautilusQueryMatcher NautilusQueryMatcher;
+
+/* A matcher for NULL text matches nothing. */
+NautilusQueryMatcher *nautilus_query_matcher_new   (const char           *text);
+NautilusQueryMatcher *nautilus_query_matcher_ref   (NautilusQueryMatcher *matcher);
+void                  nautilus_query_matcher_unref (NautilusQueryMatcher *matcher);
+
+/* Returns the rank of the string if it contains all the words, -1 otherwise. */
+gdouble               nautilus_query_matcher_match (NautilusQueryMatcher *matcher,
+						    const char           *string);
+
+/* Looks for all the words in the contents of a file, in NFC and
+ * ignoring the case of ASCII letters only, since normalizing whole
+ * files would cost more than searching them. Returns the offset of the
+ * longest word, or -1 if a word is missing or there are no words.
+ */
+gssize                nautilus_query_matcher_match_contents (NautilusQueryMatcher *matcher,
+                                                             const char           *contents,
+                                                             gsize                 length);
+/* The same for contents too big to look at at once, like files read in
+ * chunks. Each part has to start with the last
+ * nautilus_query_matcher_get_contents_overlap() bytes of the one
+ * before, so that no word is cut in two. found has a flag for each
+ * word, all FALSE at first, see nautilus_query_matcher_get_n_words().
+ * Sets the flags of the words found in the part, and offset to where
+ * the longest word is in it if it wasn't found before, -1 otherwise.
+ * Returns TRUE once all the words were found.
+ */
+gboolean              nautilus_query_matcher_match_contents_part  (NautilusQueryMatcher *matcher,
+                                                                   const char           *contents,
+                                                                   gsize                 length,
+                                                                   gboolean             *found,
+                                                                   gssize               *offset);
+gsize                 nautilus_query_matcher_get_contents_overlap (NautilusQueryMatcher *matcher);
+guint                 nautilus_query_matcher_get_n_words          (NautilusQueryMatcher *matcher);
+/* The rank of a file whose contents match, lower than any name gets. */
+gdouble               nautilus_query_matcher_get_contents_rank    (NautilusQueryMatcher *matcher);
+
+/* Returns the longest of the prepared words, in NFD and lowercase, or
+ * NULL if the matcher matches nothing. Any string the matcher matches
+ * contains it once prepared the same way.
+ */
+const char *          nautilus_query_matcher_get_longest_word (NautilusQueryMatcher *matcher);
+
+/* Returns TRUE if every string matcher matches is also matched by
+ * other, which is when every word of other is part of a word of matcher.
+ */
+gboolean              nautilus_query_matcher_is_narrower (NautilusQueryMatcher *matcher,
+                                                          NautilusQueryMatcher *other);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (NautilusQueryMatcher, nautilus_query_matcher_unref)
+
+#endif /* NAUTILUS_QUERY_MATCHER_H */
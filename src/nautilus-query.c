@@ -31,16 +31,13 @@
 #include "nautilus-query.h"
 #include "nautilus-enum-types.h"
 
-#define RANK_SCALE_FACTOR 100
-#define MIN_RANK 10.0
-#define MAX_RANK 50.0
-
 struct _NautilusQuery
 {
     GObject parent;
 
     char *text;
     GFile *location;
+    GList *other_locations;     /* more roots to search, besides location */
     GList *mime_types;
     gboolean show_hidden;
     GPtrArray *date_range;
@@ -50,8 +47,8 @@ struct _NautilusQuery
 
     gboolean searching;
     gboolean recursive;
-    char **prepared_words;
-    GMutex prepared_words_mutex;
+    NautilusQueryMatcher *matcher;
+    GMutex matcher_mutex;
 };
 
 static void  nautilus_query_class_init (NautilusQueryClass *class);
@@ -81,10 +78,11 @@ finalize (GObject *object)
     query = NAUTILUS_QUERY (object);
 
     g_free (query->text);
-    g_strfreev (query->prepared_words);
+    nautilus_query_matcher_unref (query->matcher);
     g_clear_object (&query->location);
+    g_list_free_full (query->other_locations, g_object_unref);
     g_clear_pointer (&query->date_range, g_ptr_array_unref);
-    g_mutex_clear (&query->prepared_words_mutex);
+    g_mutex_clear (&query->matcher_mutex);
 
     G_OBJECT_CLASS (nautilus_query_parent_class)->finalize (object);
 }
@@ -345,75 +343,36 @@ nautilus_query_init (NautilusQuery *query)
     query->search_type = g_settings_get_enum (nautilus_preferences, "search-filter-time-type");
     query->search_content = NAUTILUS_QUERY_SEARCH_CONTENT_SIMPLE;
     query->search_favorite = FALSE;
-    g_mutex_init (&query->prepared_words_mutex);
+    query->matcher = nautilus_query_matcher_new (NULL);
+    g_mutex_init (&query->matcher_mutex);
 }
 
-static gchar *
-prepare_string_for_compare (const gchar *string)
+/* Returns the matcher for the current text of the query. Searches
+ * that match many files should get it once and use it directly.
+ */
+NautilusQueryMatcher *
+nautilus_query_get_matcher (NautilusQuery *query)
 {
-    gchar *normalized, *res;
+    NautilusQueryMatcher *matcher;
+
+    g_return_val_if_fail (NAUTILUS_IS_QUERY (query), NULL);
 
-    normalized = g_utf8_normalize (string, -1, G_NORMALIZE_NFD);
-    res = g_utf8_strdown (normalized, -1);
-    g_free (normalized);
+    g_mutex_lock (&query->matcher_mutex);
+    matcher = nautilus_query_matcher_ref (query->matcher);
+    g_mutex_unlock (&query->matcher_mutex);
 
-    return res;
+    return matcher;
 }
 
 gdouble
 nautilus_query_matches_string (NautilusQuery *query,
                                const gchar   *string)
 {
-    gchar *prepared_string, *ptr;
-    gboolean found;
-    gdouble retval;
-    gint idx, nonexact_malus;
-
-    if (!query->text)
-    {
-        return -1;
-    }
+    g_autoptr (NautilusQueryMatcher) matcher = NULL;
 
-    g_mutex_lock (&query->prepared_words_mutex);
-    if (!query->prepared_words)
-    {
-        prepared_string = prepare_string_for_compare (query->text);
-        query->prepared_words = g_strsplit (prepared_string, " ", -1);
-        g_free (prepared_string);
-    }
-
-    prepared_string = prepare_string_for_compare (string);
-    found = TRUE;
-    ptr = NULL;
-    nonexact_malus = 0;
-
-    for (idx = 0; query->prepared_words[idx] != NULL; idx++)
-    {
-        if ((ptr = strstr (prepared_string, query->prepared_words[idx])) == NULL)
-        {
-            found = FALSE;
-            break;
-        }
+    matcher = nautilus_query_get_matcher (query);
 
-        nonexact_malus += strlen (ptr) - strlen (query->prepared_words[idx]);
-    }
-    g_mutex_unlock (&query->prepared_words_mutex);
-
-    if (!found)
-    {
-        g_free (prepared_string);
-        return -1;
-    }
-
-    /* The rank value depends on the numbers of letters before and after the match.
-     * To make the prefix matches prefered over sufix ones, the number of letters
-     * after the match is divided by a factor, so that it decreases the rank by a
-     * smaller amount.
-     */
-    retval = MAX (MIN_RANK, MAX_RANK - (gdouble) (ptr - prepared_string) - (gdouble) nonexact_malus / RANK_SCALE_FACTOR);
-    g_free (prepared_string);
-
-    return retval;
+    return nautilus_query_matcher_match (matcher, string);
 }
 
 NautilusQuery *
@@ -422,6 +381,40 @@ nautilus_query_new (void)
     return g_object_new (NAUTILUS_TYPE_QUERY, NULL);
 }
 
+/**
+ * nautilus_query_copy:
+ * @query: a #NautilusQuery
+ *
+ * Creates a query searching for the same files as @query does now, which
+ * doesn't change when @query does.
+ *
+ * Returns: (transfer full): a new #NautilusQuery
+ */
+NautilusQuery *
+nautilus_query_copy (NautilusQuery *query)
+{
+    NautilusQuery *copy;
+
+    g_return_val_if_fail (NAUTILUS_IS_QUERY (query), NULL);
+
+    copy = nautilus_query_new ();
+
+    copy->text = g_strdup (query->text);
+    nautilus_query_matcher_unref (copy->matcher);
+    copy->matcher = nautilus_query_get_matcher (query);
+    g_set_object (&copy->location, query->location);
+    copy->other_locations = g_list_copy_deep (query->other_locations, (GCopyFunc) g_object_ref, NULL);
+    copy->mime_types = g_list_copy_deep (query->mime_types, (GCopyFunc) g_strdup, NULL);
+    copy->show_hidden = query->show_hidden;
+    copy->date_range = nautilus_query_get_date_range (query);
+    copy->search_type = query->search_type;
+    copy->search_content = query->search_content;
+    copy->search_favorite = query->search_favorite;
+    copy->recursive = query->recursive;
+
+    return copy;
+}
+
 
 char *
 nautilus_query_get_text (NautilusQuery *query)
@@ -435,15 +428,19 @@ void
 nautilus_query_set_text (NautilusQuery *query,
                          const char    *text)
 {
+    NautilusQueryMatcher *matcher, *old_matcher;
+
     g_return_if_fail (NAUTILUS_IS_QUERY (query));
 
     g_free (query->text);
     query->text = g_strstrip (g_strdup (text));
 
-    g_mutex_lock (&query->prepared_words_mutex);
-    g_strfreev (query->prepared_words);
-    query->prepared_words = NULL;
-    g_mutex_unlock (&query->prepared_words_mutex);
+    matcher = nautilus_query_matcher_new (query->text);
+    g_mutex_lock (&query->matcher_mutex);
+    old_matcher = query->matcher;
+    query->matcher = matcher;
+    g_mutex_unlock (&query->matcher_mutex);
+    nautilus_query_matcher_unref (old_matcher);
 
     g_object_notify (G_OBJECT (query), "text");
 }
@@ -460,14 +457,62 @@ void
 nautilus_query_set_location (NautilusQuery *query,
                              GFile         *location)
 {
+    gboolean changed;
+
     g_return_if_fail (NAUTILUS_IS_QUERY (query));
 
-    if (g_set_object (&query->location, location))
+    changed = query->other_locations != NULL;
+    g_list_free_full (query->other_locations, g_object_unref);
+    query->other_locations = NULL;
+
+    if (g_set_object (&query->location, location) || changed)
     {
         g_object_notify (G_OBJECT (query), "location");
     }
 }
 
+/**
+ * nautilus_query_get_locations:
+ * @query: a #NautilusQuery
+ *
+ * Gets all the roots the query searches, its location first.
+ *
+ * Returns: (transfer full) (element-type GFile): the roots
+ */
+GList *
+nautilus_query_get_locations (NautilusQuery *query)
+{
+    GList *locations;
+
+    g_return_val_if_fail (NAUTILUS_IS_QUERY (query), NULL);
+
+    locations = g_list_copy_deep (query->other_locations, (GCopyFunc) g_object_ref, NULL);
+
+    return g_list_prepend (locations, g_object_ref (query->location));
+}
+
+/**
+ * nautilus_query_set_locations:
+ * @query: a #NautilusQuery
+ * @locations: (element-type GFile): the roots to search, not empty
+ *
+ * Makes the query search several roots. The first one becomes the
+ * location of the query, which results are ranked by.
+ */
+void
+nautilus_query_set_locations (NautilusQuery *query,
+                              GList         *locations)
+{
+    g_return_if_fail (NAUTILUS_IS_QUERY (query));
+    g_return_if_fail (locations != NULL);
+
+    g_list_free_full (query->other_locations, g_object_unref);
+    query->other_locations = g_list_copy_deep (locations->next, (GCopyFunc) g_object_ref, NULL);
+    g_set_object (&query->location, locations->data);
+
+    g_object_notify (G_OBJECT (query), "location");
+}
+
 GList *
 nautilus_query_get_mime_types (NautilusQuery *query)
 {
@@ -679,6 +724,112 @@ nautilus_query_set_recursive (NautilusQuery *query,
     }
 }
 
+static gboolean
+locations_are_equal (GList *locations,
+                     GList *other_locations)
+{
+    GList *l, *m;
+
+    for (l = locations, m = other_locations; l != NULL && m != NULL; l = l->next, m = m->next)
+    {
+        if (!g_file_equal (l->data, m->data))
+        {
+            return FALSE;
+        }
+    }
+
+    return l == NULL && m == NULL;
+}
+
+static gboolean
+mime_types_are_subset (GList *mime_types,
+                       GList *other_mime_types)
+{
+    GList *l;
+
+    for (l = mime_types; l != NULL; l = l->next)
+    {
+        if (g_list_find_custom (other_mime_types, l->data, (GCompareFunc) g_strcmp0) == NULL)
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+static gboolean
+date_range_is_within (GPtrArray *date_range,
+                      GPtrArray *other_date_range)
+{
+    if (other_date_range == NULL)
+    {
+        return TRUE;
+    }
+    if (date_range == NULL)
+    {
+        return FALSE;
+    }
+
+    return g_date_time_compare (g_ptr_array_index (date_range, 0),
+                                g_ptr_array_index (other_date_range, 0)) >= 0 &&
+           g_date_time_compare (g_ptr_array_index (date_range, 1),
+                                g_ptr_array_index (other_date_range, 1)) <= 0;
+}
+
+/**
+ * nautilus_query_is_refinement_of:
+ * @query: a #NautilusQuery
+ * @previous: the #NautilusQuery searched before
+ *
+ * Whether every file @query matches is also matched by @previous, like
+ * when more text is typed, so the results of @previous only have to be
+ * filtered instead of searching again. Full text searches are never
+ * refinements, since their results don't depend on the names alone.
+ *
+ * Returns: %TRUE if @query narrows @previous
+ */
+gboolean
+nautilus_query_is_refinement_of (NautilusQuery *query,
+                                 NautilusQuery *previous)
+{
+    g_autoptr (NautilusQueryMatcher) matcher = NULL;
+    g_autoptr (NautilusQueryMatcher) previous_matcher = NULL;
+
+    g_return_val_if_fail (NAUTILUS_IS_QUERY (query), FALSE);
+    g_return_val_if_fail (NAUTILUS_IS_QUERY (previous), FALSE);
+
+    if (query->search_content != NAUTILUS_QUERY_SEARCH_CONTENT_SIMPLE ||
+        previous->search_content != NAUTILUS_QUERY_SEARCH_CONTENT_SIMPLE ||
+        query->recursive != previous->recursive ||
+        query->show_hidden != previous->show_hidden ||
+        query->search_favorite != previous->search_favorite ||
+        !g_file_equal (query->location, previous->location) ||
+        !locations_are_equal (query->other_locations, previous->other_locations))
+    {
+        return FALSE;
+    }
+
+    if (previous->mime_types != NULL &&
+        (query->mime_types == NULL ||
+         !mime_types_are_subset (query->mime_types, previous->mime_types)))
+    {
+        return FALSE;
+    }
+
+    if (previous->date_range != NULL &&
+        (query->search_type != previous->search_type ||
+         !date_range_is_within (query->date_range, previous->date_range)))
+    {
+        return FALSE;
+    }
+
+    matcher = nautilus_query_get_matcher (query);
+    previous_matcher = nautilus_query_get_matcher (previous);
+
+    return nautilus_query_matcher_is_narrower (matcher, previous_matcher);
+}
+
 gboolean
 nautilus_query_is_empty (NautilusQuery *query)
 {
@@ -25,6 +25,8 @@
 #include <glib-object.h>
 #include <gio/gio.h>
 
+#include "nautilus-query-matcher.h"
+
 typedef enum {
         NAUTILUS_QUERY_SEARCH_TYPE_LAST_ACCESS,
         NAUTILUS_QUERY_SEARCH_TYPE_LAST_MODIFIED
@@ -40,6 +42,7 @@ typedef enum {
 G_DECLARE_FINAL_TYPE (NautilusQuery, nautilus_query, NAUTILUS, QUERY, GObject)
 
 NautilusQuery* nautilus_query_new      (void);
+NautilusQuery* nautilus_query_copy     (NautilusQuery *query);
 
 char *         nautilus_query_get_text           (NautilusQuery *query);
 void           nautilus_query_set_text           (NautilusQuery *query, const char *text);
@@ -50,6 +53,9 @@ void           nautilus_query_set_show_hidden_files (NautilusQuery *query, gbool
 GFile*         nautilus_query_get_location       (NautilusQuery *query);
 void           nautilus_query_set_location       (NautilusQuery *query,
                                                   GFile         *location);
+GList *        nautilus_query_get_locations      (NautilusQuery *query);
+void           nautilus_query_set_locations      (NautilusQuery *query,
+                                                  GList         *locations);
 
 GList *        nautilus_query_get_mime_types     (NautilusQuery *query);
 void           nautilus_query_set_mime_types     (NautilusQuery *query, GList *mime_types);
@@ -81,10 +87,14 @@ gboolean       nautilus_query_get_searching      (NautilusQuery *query);
 void           nautilus_query_set_searching      (NautilusQuery *query,
                                                   gboolean       searching);
 
+NautilusQueryMatcher *nautilus_query_get_matcher (NautilusQuery *query);
 gdouble        nautilus_query_matches_string     (NautilusQuery *query, const gchar *string);
 
 char *         nautilus_query_to_readable_string (NautilusQuery *query);
 
 gboolean       nautilus_query_is_empty           (NautilusQuery *query);
 
+gboolean       nautilus_query_is_refinement_of   (NautilusQuery *query,
+                                                  NautilusQuery *previous);
+
 #endif /* NAUTILUS_QUERY_H */
@@ -617,13 +617,10 @@ search_engine_hits_added (NautilusSearchEngine    *engine,
     for (hit_list = hits; hit_list != NULL; hit_list = hit_list->next)
     {
         NautilusSearchHit *hit = hit_list->data;
-        const char *uri;
-
-        uri = nautilus_search_hit_get_uri (hit);
 
         nautilus_search_hit_compute_scores (hit, self->query);
 
-        file = nautilus_file_get_by_uri (uri);
+        file = nautilus_file_get (nautilus_search_hit_get_location (hit));
         nautilus_file_set_search_relevance (file, nautilus_search_hit_get_relevance (hit));
         nautilus_file_set_search_fts_snippet (file, nautilus_search_hit_get_fts_snippet (hit));
 
@@ -0,0 +1,1007 @@
+/*
+ * Nautilus is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * Nautilus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; see the file COPYING.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* Searches the names of the files in the home directory with an index
+ * kept in the cache directory, for when Tracker isn't around.
+ *
+ * The index is loaded the first time it is needed, and then rescanned
+ * in the background every hour. A rescan only reads the directories
+ * whose modification time changed since they were last read. Changes
+ * nautilus knows about are put in, once the files were looked at, and
+ * saved a little later. Others are caught by a search: it answers from
+ * the index first, then checks the stamps of the directories it
+ * searched, unless another search just did, and adds what it finds new
+ * in the directories that changed. Until the
+ * index was completely scanned once, searches still crawl the file
+ * system with the simple engine, as they do for the directories on
+ * other file systems, which the index leaves out.
+ */
+
+#include <config.h>
+#include "nautilus-search-engine-index.h"
+
+#include <string.h>
+
+#include "nautilus-directory-notify.h"
+#include "nautilus-filename-index.h"
+#include "nautilus-global-preferences.h"
+#include "nautilus-search-hit.h"
+#include "nautilus-search-hit-batcher.h"
+#include "nautilus-search-provider.h"
+#include "nautilus-ui-utilities.h"
+#define DEBUG_FLAG NAUTILUS_DEBUG_SEARCH
+#include "nautilus-debug.h"
+
+#define RESCAN_INTERVAL (60 * 60) /* seconds */
+#define SAVE_DELAY 60 /* seconds */
+#define REFRESH_INTERVAL (10 * G_USEC_PER_SEC)
+
+#define DIRECTORY_STAMP_ATTRIBUTES \
+    G_FILE_ATTRIBUTE_TIME_MODIFIED "," \
+    G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC "," \
+    G_FILE_ATTRIBUTE_UNIX_DEVICE
+
+#define RESCAN_ATTRIBUTES \
+    G_FILE_ATTRIBUTE_STANDARD_NAME "," \
+    G_FILE_ATTRIBUTE_STANDARD_TYPE "," \
+    G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN "," \
+    G_FILE_ATTRIBUTE_STANDARD_IS_BACKUP "," \
+    G_FILE_ATTRIBUTE_TIME_MODIFIED "," \
+    G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC
+
+enum
+{
+    PROP_0,
+    PROP_RUNNING,
+    LAST_PROP
+};
+
+typedef struct
+{
+    NautilusSearchEngineIndex *engine;
+    GCancellable *cancellable;
+    NautilusSearchHitBatcher *batcher;
+
+    NautilusFilenameIndex *index;   /* NULL if the index can't answer the query */
+    NautilusQueryMatcher *matcher;
+    char *location;
+    gboolean recursive;
+    gboolean show_hidden;
+    GPtrArray *date_range;
+    GHashTable *hit_paths; /* of the hits sent so far */
+} SearchThreadData;
+
+struct _NautilusSearchEngineIndex
+{
+    GObject parent_instance;
+    NautilusQuery *query;
+
+    SearchThreadData *active_search;
+};
+
+/* The index of the home directory, shared by all searches. It is only
+ * set up on the main thread, and is kept for as long as nautilus runs
+ * once it is loaded.
+ */
+static NautilusFilenameIndex *shared_index;
+static gboolean shared_index_loading;
+static gboolean shared_index_complete;
+static gboolean shared_index_rescanning;
+static guint save_timeout_id;
+
+/* The last location a search checked the stamps of, and when. */
+G_LOCK_DEFINE_STATIC (refreshed);
+static char *refreshed_location;
+static gboolean refreshed_recursive;
+static gint64 refreshed_time;
+
+static void nautilus_search_provider_init (NautilusSearchProviderInterface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (NautilusSearchEngineIndex,
+                         nautilus_search_engine_index,
+                         G_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (NAUTILUS_TYPE_SEARCH_PROVIDER,
+                                                nautilus_search_provider_init))
+
+static char *
+get_index_path (void)
+{
+    return g_build_filename (g_get_user_cache_dir (), "nautilus", "filename-index", NULL);
+}
+
+static gboolean
+is_index_enabled (void)
+{
+    return g_settings_get_boolean (nautilus_preferences, NAUTILUS_PREFERENCES_FILENAME_INDEX);
+}
+
+static void
+save_index_thread (GTask        *task,
+                   gpointer      source_object,
+                   gpointer      task_data,
+                   GCancellable *cancellable)
+{
+    NautilusFilenameIndex *index;
+    char *path;
+    GError *error;
+
+    index = task_data;
+    path = get_index_path ();
+
+    error = NULL;
+    if (!nautilus_filename_index_save (index, path, &error))
+    {
+        DEBUG ("Could not save the filename index: %s", error->message);
+        g_error_free (error);
+    }
+
+    g_free (path);
+    g_task_return_boolean (task, TRUE);
+}
+
+static gboolean
+save_index_timeout (gpointer user_data)
+{
+    GTask *task;
+
+    save_timeout_id = 0;
+
+    task = g_task_new (NULL, NULL, NULL, NULL);
+    g_task_set_task_data (task, shared_index, NULL);
+    g_task_run_in_thread (task, save_index_thread);
+    g_object_unref (task);
+
+    return FALSE;
+}
+
+static void
+schedule_save (void)
+{
+    /* A rescan saves when it's done. An index that wasn't completely
+     * scanned is not worth saving, it would look complete when loaded.
+     */
+    if (save_timeout_id != 0 || shared_index_rescanning || !shared_index_complete)
+    {
+        return;
+    }
+
+    save_timeout_id = g_timeout_add_seconds (SAVE_DELAY, save_index_timeout, NULL);
+}
+
+/* Returns TRUE if what the index has of the directory changed. */
+static gboolean
+rescan_directory (NautilusFilenameIndex *index,
+                  const char            *path,
+                  guint32                root_device,
+                  GQueue                *directories)
+{
+    GFile *file;
+    GFileInfo *info;
+    GFileEnumerator *enumerator;
+    GPtrArray *subdirectories;
+    GList *infos;
+    guint64 stamp;
+    gboolean changed;
+    guint i;
+
+    file = g_file_new_for_path (path);
+    info = g_file_query_info (file, DIRECTORY_STAMP_ATTRIBUTES,
+                              G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS, NULL, NULL);
+    if (info == NULL)
+    {
+        nautilus_filename_index_remove (index, path);
+        g_object_unref (file);
+        return TRUE;
+    }
+
+    /* Stay on the file system of the home directory. */
+    if (g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_UNIX_DEVICE) != root_device)
+    {
+        nautilus_filename_index_set_other_file_system (index, path);
+        g_object_unref (info);
+        g_object_unref (file);
+        return FALSE;
+    }
+
+    stamp = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED) * G_USEC_PER_SEC +
+            g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+    g_object_unref (info);
+
+    if (stamp != 0 && stamp == nautilus_filename_index_get_directory_stamp (index, path))
+    {
+        /* Nothing was added, removed or renamed in it since it was read. */
+        subdirectories = nautilus_filename_index_list_subdirectories (index, path);
+        changed = FALSE;
+    }
+    else
+    {
+        enumerator = g_file_enumerate_children (file, RESCAN_ATTRIBUTES,
+                                                G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                                NULL, NULL);
+        if (enumerator == NULL)
+        {
+            g_object_unref (file);
+            return FALSE;
+        }
+
+        infos = NULL;
+        subdirectories = g_ptr_array_new_with_free_func (g_free);
+        while ((info = g_file_enumerator_next_file (enumerator, NULL, NULL)) != NULL)
+        {
+            if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY)
+            {
+                g_ptr_array_add (subdirectories, g_strdup (g_file_info_get_name (info)));
+            }
+            infos = g_list_prepend (infos, info);
+        }
+        g_file_enumerator_close (enumerator, NULL, NULL);
+        g_object_unref (enumerator);
+
+        nautilus_filename_index_update_directory (index, path, stamp, infos);
+        g_list_free_full (infos, g_object_unref);
+        changed = TRUE;
+    }
+
+    for (i = 0; directories != NULL && i < subdirectories->len; i++)
+    {
+        g_queue_push_tail (directories,
+                           g_build_filename (path, g_ptr_array_index (subdirectories, i), NULL));
+    }
+
+    g_ptr_array_unref (subdirectories);
+    g_object_unref (file);
+
+    return changed;
+}
+
+/* Rescans location, and what is under it if recursive. Sets changed,
+ * if not NULL, to whether any of the directories had changed.
+ */
+static gboolean
+rescan_location (NautilusFilenameIndex *index,
+                 const char            *location,
+                 gboolean               recursive,
+                 GCancellable          *cancellable,
+                 gboolean              *changed)
+{
+    GQueue directories = G_QUEUE_INIT;
+    GFile *root;
+    GFileInfo *info;
+    guint32 root_device;
+    char *path;
+
+    root = g_file_new_for_path (nautilus_filename_index_get_root (index));
+    info = g_file_query_info (root, G_FILE_ATTRIBUTE_UNIX_DEVICE,
+                              G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS, NULL, NULL);
+    g_object_unref (root);
+    if (info == NULL)
+    {
+        return FALSE;
+    }
+    root_device = g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_UNIX_DEVICE);
+    g_object_unref (info);
+
+    if (changed != NULL)
+    {
+        *changed = FALSE;
+    }
+
+    g_queue_push_tail (&directories, g_strdup (location));
+    while ((path = g_queue_pop_head (&directories)) != NULL)
+    {
+        if (!g_cancellable_is_cancelled (cancellable) &&
+            rescan_directory (index, path, root_device, recursive ? &directories : NULL) &&
+            changed != NULL)
+        {
+            *changed = TRUE;
+        }
+        g_free (path);
+    }
+
+    return !g_cancellable_is_cancelled (cancellable);
+}
+
+static void
+rescan_index_thread (GTask        *task,
+                     gpointer      source_object,
+                     gpointer      task_data,
+                     GCancellable *cancellable)
+{
+    NautilusFilenameIndex *index;
+    char *path;
+    GError *error;
+
+    index = task_data;
+
+    if (!rescan_location (index, nautilus_filename_index_get_root (index), TRUE, NULL, NULL))
+    {
+        g_task_return_boolean (task, FALSE);
+        return;
+    }
+
+    path = get_index_path ();
+    error = NULL;
+    if (!nautilus_filename_index_save (index, path, &error))
+    {
+        DEBUG ("Could not save the filename index: %s", error->message);
+        g_error_free (error);
+    }
+    g_free (path);
+
+    g_task_return_boolean (task, TRUE);
+}
+
+static void start_rescan (void);
+
+static gboolean
+rescan_timeout (gpointer user_data)
+{
+    start_rescan ();
+
+    return FALSE;
+}
+
+static void
+rescan_done (GObject      *source_object,
+             GAsyncResult *result,
+             gpointer      user_data)
+{
+    shared_index_rescanning = FALSE;
+
+    if (g_task_propagate_boolean (G_TASK (result), NULL))
+    {
+        DEBUG ("Filename index rescanned, %u files", nautilus_filename_index_get_size (shared_index));
+        shared_index_complete = TRUE;
+    }
+
+    g_timeout_add_seconds (RESCAN_INTERVAL, rescan_timeout, NULL);
+}
+
+static void
+start_rescan (void)
+{
+    GTask *task;
+
+    if (!is_index_enabled ())
+    {
+        /* Check again later, the setting may change. */
+        g_timeout_add_seconds (RESCAN_INTERVAL, rescan_timeout, NULL);
+        return;
+    }
+
+    shared_index_rescanning = TRUE;
+
+    task = g_task_new (NULL, NULL, rescan_done, NULL);
+    g_task_set_task_data (task, shared_index, NULL);
+    g_task_run_in_thread (task, rescan_index_thread);
+    g_object_unref (task);
+}
+
+static void
+load_index_thread (GTask        *task,
+                   gpointer      source_object,
+                   gpointer      task_data,
+                   GCancellable *cancellable)
+{
+    NautilusFilenameIndex *index;
+    char *path;
+
+    path = get_index_path ();
+    index = nautilus_filename_index_load (path, g_get_home_dir ());
+    g_free (path);
+
+    g_task_return_pointer (task, index, NULL);
+}
+
+static void
+load_index_done (GObject      *source_object,
+                 GAsyncResult *result,
+                 gpointer      user_data)
+{
+    NautilusFilenameIndex *index;
+
+    shared_index_loading = FALSE;
+
+    index = g_task_propagate_pointer (G_TASK (result), NULL);
+    if (index != NULL)
+    {
+        DEBUG ("Filename index loaded, %u files", nautilus_filename_index_get_size (index));
+        shared_index_complete = TRUE;
+    }
+    else
+    {
+        index = nautilus_filename_index_new (g_get_home_dir ());
+    }
+
+    shared_index = index;
+    start_rescan ();
+}
+
+static void
+ensure_shared_index (void)
+{
+    GTask *task;
+
+    if (shared_index != NULL || shared_index_loading || !is_index_enabled ())
+    {
+        return;
+    }
+
+    shared_index_loading = TRUE;
+
+    task = g_task_new (NULL, NULL, load_index_done, NULL);
+    g_task_run_in_thread (task, load_index_thread);
+    g_object_unref (task);
+}
+
+static void
+add_files_thread (GTask        *task,
+                  gpointer      source_object,
+                  gpointer      task_data,
+                  GCancellable *cancellable)
+{
+    GList *l;
+    GFileInfo *info;
+    char *path;
+
+    for (l = task_data; l != NULL; l = l->next)
+    {
+        path = g_file_get_path (l->data);
+        info = g_file_query_info (l->data, RESCAN_ATTRIBUTES,
+                                  G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS, NULL, NULL);
+
+        /* Files that are gone again are left to the removal. */
+        if (path != NULL && info != NULL)
+        {
+            nautilus_filename_index_add_info (shared_index, path, info);
+        }
+
+        g_clear_object (&info);
+        g_free (path);
+    }
+
+    g_task_return_boolean (task, TRUE);
+}
+
+static void
+add_files_done (GObject      *source_object,
+                GAsyncResult *result,
+                gpointer      user_data)
+{
+    schedule_save ();
+}
+
+static void
+free_locations (GList *locations)
+{
+    g_list_free_full (locations, g_object_unref);
+}
+
+/* Adds the files with what they are, which takes looking at them. */
+static void
+add_files (GList *locations)
+{
+    GTask *task;
+    GList *copy;
+
+    copy = g_list_copy_deep (locations, (GCopyFunc) g_object_ref, NULL);
+
+    task = g_task_new (NULL, NULL, add_files_done, NULL);
+    g_task_set_task_data (task, copy, (GDestroyNotify) free_locations);
+    g_task_run_in_thread (task, add_files_thread);
+    g_object_unref (task);
+}
+
+void
+nautilus_search_engine_index_files_added (GList *locations)
+{
+    if (shared_index == NULL || locations == NULL)
+    {
+        return;
+    }
+
+    add_files (locations);
+}
+
+void
+nautilus_search_engine_index_files_removed (GList *locations)
+{
+    GList *l;
+    char *path;
+
+    if (shared_index == NULL)
+    {
+        return;
+    }
+
+    for (l = locations; l != NULL; l = l->next)
+    {
+        path = g_file_get_path (l->data);
+        if (path != NULL)
+        {
+            nautilus_filename_index_remove (shared_index, path);
+            g_free (path);
+        }
+    }
+
+    schedule_save ();
+}
+
+void
+nautilus_search_engine_index_files_moved (GList *file_pairs)
+{
+    GList *l, *added;
+    GFilePair *pair;
+    char *from_path, *to_path;
+
+    if (shared_index == NULL)
+    {
+        return;
+    }
+
+    added = NULL;
+    for (l = file_pairs; l != NULL; l = l->next)
+    {
+        pair = l->data;
+        from_path = g_file_get_path (pair->from);
+        to_path = g_file_get_path (pair->to);
+
+        if (from_path != NULL && to_path != NULL)
+        {
+            nautilus_filename_index_move (shared_index, from_path, to_path);
+        }
+        else if (from_path != NULL)
+        {
+            nautilus_filename_index_remove (shared_index, from_path);
+        }
+        else if (to_path != NULL)
+        {
+            added = g_list_prepend (added, pair->to);
+        }
+
+        g_free (from_path);
+        g_free (to_path);
+    }
+
+    if (added != NULL)
+    {
+        add_files (added);
+        g_list_free (added);
+    }
+
+    schedule_save ();
+}
+
+gboolean
+nautilus_search_engine_index_covers_query (NautilusSearchEngineIndex *engine)
+{
+    NautilusQuery *query;
+    GFile *location;
+    GList *mime_types, *locations;
+    GPtrArray *date_range;
+    char *path;
+    gboolean covers;
+
+    g_return_val_if_fail (NAUTILUS_IS_SEARCH_ENGINE_INDEX (engine), FALSE);
+
+    query = engine->query;
+    if (query == NULL || shared_index == NULL || !shared_index_complete || !is_index_enabled ())
+    {
+        return FALSE;
+    }
+
+    /* The index only knows names and modification times. */
+    if (nautilus_query_get_search_favorite (query) ||
+        nautilus_query_get_search_content (query) == NAUTILUS_QUERY_SEARCH_CONTENT_FULL_TEXT)
+    {
+        return FALSE;
+    }
+
+    mime_types = nautilus_query_get_mime_types (query);
+    if (mime_types != NULL)
+    {
+        g_list_free_full (mime_types, g_free);
+        return FALSE;
+    }
+
+    date_range = nautilus_query_get_date_range (query);
+    if (date_range != NULL)
+    {
+        g_ptr_array_unref (date_range);
+        if (nautilus_query_get_search_type (query) == NAUTILUS_QUERY_SEARCH_TYPE_LAST_ACCESS)
+        {
+            return FALSE;
+        }
+    }
+
+    /* A search of several roots is left to the simple engine. */
+    locations = nautilus_query_get_locations (query);
+    covers = locations->next == NULL;
+    g_list_free_full (locations, g_object_unref);
+    if (!covers)
+    {
+        return FALSE;
+    }
+
+    location = nautilus_query_get_location (query);
+    path = g_file_get_path (location);
+    covers = path != NULL && nautilus_filename_index_covers (shared_index, path);
+    g_free (path);
+    g_object_unref (location);
+
+    return covers;
+}
+
+GList *
+nautilus_search_engine_index_get_uncovered_locations (NautilusSearchEngineIndex *engine)
+{
+    GFile *location;
+    GPtrArray *paths;
+    GList *locations;
+    const char *relative_path;
+    char *path;
+    gboolean show_hidden;
+    guint i;
+
+    g_return_val_if_fail (NAUTILUS_IS_SEARCH_ENGINE_INDEX (engine), NULL);
+
+    if (!nautilus_search_engine_index_covers_query (engine) ||
+        !nautilus_query_get_recursive (engine->query))
+    {
+        return NULL;
+    }
+
+    location = nautilus_query_get_location (engine->query);
+    path = g_file_get_path (location);
+    g_object_unref (location);
+
+    paths = nautilus_filename_index_list_other_file_systems (shared_index, path);
+    show_hidden = nautilus_query_get_show_hidden_files (engine->query);
+
+    locations = NULL;
+    for (i = 0; i < paths->len; i++)
+    {
+        relative_path = (const char *) g_ptr_array_index (paths, i) + strlen (path);
+        if (!show_hidden && strstr (relative_path, "/.") != NULL)
+        {
+            continue;
+        }
+
+        locations = g_list_prepend (locations, g_file_new_for_path (g_ptr_array_index (paths, i)));
+    }
+
+    g_ptr_array_unref (paths);
+    g_free (path);
+
+    return g_list_reverse (locations);
+}
+
+static void
+finalize (GObject *object)
+{
+    NautilusSearchEngineIndex *engine = NAUTILUS_SEARCH_ENGINE_INDEX (object);
+
+    g_clear_object (&engine->query);
+
+    G_OBJECT_CLASS (nautilus_search_engine_index_parent_class)->finalize (object);
+}
+
+static void search_thread_done (gpointer user_data);
+
+static SearchThreadData *
+search_thread_data_new (NautilusSearchEngineIndex *engine,
+                        NautilusQuery             *query)
+{
+    SearchThreadData *data;
+    GFile *location;
+
+    data = g_new0 (SearchThreadData, 1);
+
+    data->engine = g_object_ref (engine);
+    data->cancellable = g_cancellable_new ();
+    data->batcher = nautilus_search_hit_batcher_new (NAUTILUS_SEARCH_PROVIDER (engine),
+                                                     data->cancellable,
+                                                     search_thread_done, data);
+
+    if (nautilus_search_engine_index_covers_query (engine))
+    {
+        data->index = shared_index;
+        data->matcher = nautilus_query_get_matcher (query);
+        location = nautilus_query_get_location (query);
+        data->location = g_file_get_path (location);
+        g_object_unref (location);
+        data->recursive = nautilus_query_get_recursive (query);
+        data->show_hidden = nautilus_query_get_show_hidden_files (query);
+        data->date_range = nautilus_query_get_date_range (query);
+        data->hit_paths = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    }
+
+    return data;
+}
+
+static void
+search_thread_data_free (SearchThreadData *data)
+{
+    g_object_unref (data->cancellable);
+    g_clear_pointer (&data->matcher, nautilus_query_matcher_unref);
+    g_free (data->location);
+    g_clear_pointer (&data->date_range, g_ptr_array_unref);
+    g_clear_pointer (&data->hit_paths, g_hash_table_destroy);
+    g_object_unref (data->engine);
+
+    g_free (data);
+}
+
+static void
+search_thread_done (gpointer user_data)
+{
+    SearchThreadData *data = user_data;
+    NautilusSearchEngineIndex *engine = data->engine;
+
+    DEBUG ("Index engine finished");
+
+    engine->active_search = NULL;
+    nautilus_search_provider_finished (NAUTILUS_SEARCH_PROVIDER (engine),
+                                       NAUTILUS_SEARCH_PROVIDER_STATUS_NORMAL);
+
+    g_object_notify (G_OBJECT (engine), "running");
+
+    search_thread_data_free (data);
+}
+
+static void
+add_hit (const char *path,
+         gdouble     rank,
+         guint64     mtime,
+         gpointer    user_data)
+{
+    SearchThreadData *data = user_data;
+    NautilusSearchHit *hit;
+    GDateTime *date;
+    GFile *location;
+
+    if (data->date_range != NULL &&
+        !nautilus_file_date_in_between (mtime / G_USEC_PER_SEC,
+                                        g_ptr_array_index (data->date_range, 0),
+                                        g_ptr_array_index (data->date_range, 1)))
+    {
+        return;
+    }
+
+    /* A search after a refresh finds the earlier hits again. */
+    if (!g_hash_table_add (data->hit_paths, g_strdup (path)))
+    {
+        return;
+    }
+
+    location = g_file_new_for_path (path);
+    hit = nautilus_search_hit_new_for_location (location);
+    g_object_unref (location);
+    nautilus_search_hit_set_fts_rank (hit, rank);
+    if (mtime != 0)
+    {
+        date = g_date_time_new_from_unix_local (mtime / G_USEC_PER_SEC);
+        nautilus_search_hit_set_modification_time (hit, date);
+        g_date_time_unref (date);
+    }
+
+    nautilus_search_hit_batcher_add (data->batcher, hit);
+}
+
+/* Catches the changes nautilus wasn't told about, unless another
+ * search just did for the location. Returns TRUE if it found any.
+ */
+static gboolean
+refresh_location (SearchThreadData *data)
+{
+    GFile *location, *refreshed;
+    gint64 now;
+    gboolean fresh, changed;
+
+    now = g_get_monotonic_time ();
+    location = g_file_new_for_path (data->location);
+
+    G_LOCK (refreshed);
+    fresh = FALSE;
+    if (refreshed_location != NULL && now - refreshed_time < REFRESH_INTERVAL)
+    {
+        refreshed = g_file_new_for_path (refreshed_location);
+        fresh = (g_file_equal (location, refreshed) && (refreshed_recursive || !data->recursive)) ||
+                (refreshed_recursive && g_file_has_prefix (location, refreshed));
+        g_object_unref (refreshed);
+    }
+    G_UNLOCK (refreshed);
+
+    g_object_unref (location);
+
+    if (fresh ||
+        !rescan_location (data->index, data->location, data->recursive,
+                          data->cancellable, &changed))
+    {
+        return FALSE;
+    }
+
+    G_LOCK (refreshed);
+    g_free (refreshed_location);
+    refreshed_location = g_strdup (data->location);
+    refreshed_recursive = data->recursive;
+    refreshed_time = now;
+    G_UNLOCK (refreshed);
+
+    return changed;
+}
+
+static void
+search_index (SearchThreadData *data)
+{
+    nautilus_filename_index_search (data->index,
+                                    data->location,
+                                    data->recursive,
+                                    data->show_hidden,
+                                    data->matcher,
+                                    data->cancellable,
+                                    add_hit,
+                                    data);
+}
+
+static gpointer
+search_thread_func (gpointer user_data)
+{
+    SearchThreadData *data;
+
+    data = user_data;
+
+    /* Answer from the index right away, then look for what it missed
+     * and send that too. Hits for files that are gone since are dropped
+     * by the views, once their info can't be read.
+     */
+    search_index (data);
+    if (refresh_location (data))
+    {
+        search_index (data);
+    }
+
+    nautilus_search_hit_batcher_finish (data->batcher);
+
+    return NULL;
+}
+
+static void
+nautilus_search_engine_index_start (NautilusSearchProvider *provider)
+{
+    NautilusSearchEngineIndex *engine;
+    SearchThreadData *data;
+    GThread *thread;
+
+    engine = NAUTILUS_SEARCH_ENGINE_INDEX (provider);
+
+    if (engine->active_search != NULL)
+    {
+        return;
+    }
+
+    DEBUG ("Index engine start");
+
+    ensure_shared_index ();
+
+    data = search_thread_data_new (engine, engine->query);
+    engine->active_search = data;
+
+    if (data->index != NULL)
+    {
+        thread = g_thread_new ("nautilus-search-index", search_thread_func, data);
+        g_thread_unref (thread);
+    }
+    else
+    {
+        /* Nothing to do, the other providers take care of the query. */
+        nautilus_search_hit_batcher_finish (data->batcher);
+    }
+
+    g_object_notify (G_OBJECT (provider), "running");
+}
+
+static void
+nautilus_search_engine_index_stop (NautilusSearchProvider *provider)
+{
+    NautilusSearchEngineIndex *engine = NAUTILUS_SEARCH_ENGINE_INDEX (provider);
+
+    if (engine->active_search != NULL)
+    {
+        DEBUG ("Index engine stop");
+        g_cancellable_cancel (engine->active_search->cancellable);
+    }
+}
+
+static void
+nautilus_search_engine_index_set_query (NautilusSearchProvider *provider,
+                                        NautilusQuery          *query)
+{
+    NautilusSearchEngineIndex *engine = NAUTILUS_SEARCH_ENGINE_INDEX (provider);
+
+    g_object_ref (query);
+    g_clear_object (&engine->query);
+    engine->query = query;
+}
+
+static gboolean
+nautilus_search_engine_index_is_running (NautilusSearchProvider *provider)
+{
+    NautilusSearchEngineIndex *engine = NAUTILUS_SEARCH_ENGINE_INDEX (provider);
+
+    return engine->active_search != NULL;
+}
+
+static void
+nautilus_search_engine_index_get_property (GObject    *object,
+                                           guint       prop_id,
+                                           GValue     *value,
+                                           GParamSpec *pspec)
+{
+    NautilusSearchProvider *self = NAUTILUS_SEARCH_PROVIDER (object);
+
+    switch (prop_id)
+    {
+        case PROP_RUNNING:
+        {
+            g_value_set_boolean (value, nautilus_search_engine_index_is_running (self));
+        }
+        break;
+
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    }
+}
+
+static void
+nautilus_search_provider_init (NautilusSearchProviderInterface *iface)
+{
+    iface->set_query = nautilus_search_engine_index_set_query;
+    iface->start = nautilus_search_engine_index_start;
+    iface->stop = nautilus_search_engine_index_stop;
+    iface->is_running = nautilus_search_engine_index_is_running;
+}
+
+static void
+nautilus_search_engine_index_class_init (NautilusSearchEngineIndexClass *class)
+{
+    GObjectClass *gobject_class;
+
+    gobject_class = G_OBJECT_CLASS (class);
+    gobject_class->finalize = finalize;
+    gobject_class->get_property = nautilus_search_engine_index_get_property;
+
+    /**
+     * NautilusSearchEngine::running:
+     *
+     * Whether the search engine is running a search.
+     */
+    g_object_class_override_property (gobject_class, PROP_RUNNING, "running");
+}
+
+static void
+nautilus_search_engine_index_init (NautilusSearchEngineIndex *engine)
+{
+    /* Get the index ready before it is needed. */
+    ensure_shared_index ();
+}
+
+NautilusSearchEngineIndex *
+nautilus_search_engine_index_new (void)
+{
+    return g_object_new (NAUTILUS_TYPE_SEARCH_ENGINE_INDEX, NULL);
+}
@@ -0,0 +1,47 @@
+/*
+ * Nautilus is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * Nautilus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; see the file COPYING.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef NAUTILUS_SEARCH_ENGINE_INDEX_H
+#define NAUTILUS_SEARCH_ENGINE_INDEX_H
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+#define NAUTILUS_TYPE_SEARCH_ENGINE_INDEX (nautilus_search_engine_index_get_type ())
+
+G_DECLARE_FINAL_TYPE (NautilusSearchEngineIndex, nautilus_search_engine_index, NAUTILUS, SEARCH_ENGINE_INDEX, GObject);
+
+NautilusSearchEngineIndex* nautilus_search_engine_index_new            (void);
+
+/* Whether the index can answer the query on its own, so there is no
+ * need to crawl the file system for it.
+ */
+gboolean                   nautilus_search_engine_index_covers_query   (NautilusSearchEngineIndex *index);
+/* The directories the query searches that the index leaves out, as
+ * they are on other file systems. They still need to be crawled.
+ */
+GList *                    nautilus_search_engine_index_get_uncovered_locations (NautilusSearchEngineIndex *index);
+
+/* Keep the index up to date with changes nautilus knows about. */
+void                       nautilus_search_engine_index_files_added    (GList *locations);
+void                       nautilus_search_engine_index_files_removed  (GList *locations);
+void                       nautilus_search_engine_index_files_moved    (GList *file_pairs);
+
+G_END_DECLS
+
+#endif /* NAUTILUS_SEARCH_ENGINE_INDEX_H */
@@ -26,6 +26,7 @@
 #include "nautilus-directory.h"
 #include "nautilus-directory-private.h"
 #include "nautilus-file.h"
+#include "nautilus-mime-filter.h"
 #include "nautilus-ui-utilities.h"
 #include "nautilus-tag-manager.h"
 #define DEBUG_FLAG NAUTILUS_DEBUG_SEARCH
@@ -131,8 +132,9 @@ model_directory_ready_cb (NautilusDirectory *directory,
                           gpointer           user_data)
 {
     NautilusSearchEngineModel *model = user_data;
-    gchar *uri, *display_name;
-    GList *files, *hits, *mime_types, *l, *m;
+    gchar *uri, *display_name, *mime_type;
+    GFile *location;
+    GList *files, *hits, *mime_types, *l;
     NautilusFile *file;
     gdouble match;
     gboolean found;
@@ -141,9 +143,14 @@ model_directory_ready_cb (NautilusDirectory *directory,
     GDateTime *end_date;
     GPtrArray *date_range;
     NautilusTagManager *tag_manager;
+    NautilusQueryMatcher *matcher;
+    NautilusMimeFilter *mime_filter;
 
     files = nautilus_directory_get_file_list (directory);
+    matcher = nautilus_query_get_matcher (model->query);
     mime_types = nautilus_query_get_mime_types (model->query);
+    mime_filter = nautilus_mime_filter_new (mime_types);
+    g_list_free_full (mime_types, g_free);
     hits = NULL;
 
     for (l = files; l != NULL; l = l->next)
@@ -151,21 +158,14 @@ model_directory_ready_cb (NautilusDirectory *directory,
         file = l->data;
 
         display_name = nautilus_file_get_display_name (file);
-        match = nautilus_query_matches_string (model->query, display_name);
+        match = nautilus_query_matcher_match (matcher, display_name);
         found = (match > -1);
 
-        if (found && mime_types)
+        if (found && mime_filter != NULL)
         {
-            found = FALSE;
-
-            for (m = mime_types; m != NULL; m = m->next)
-            {
-                if (nautilus_file_is_mime_type (file, m->data))
-                {
-                    found = TRUE;
-                    break;
-                }
-            }
+            mime_type = nautilus_file_get_mime_type (file);
+            found = nautilus_mime_filter_matches (mime_filter, mime_type);
+            g_free (mime_type);
         }
 
         date_range = nautilus_query_get_date_range (model->query);
@@ -209,18 +209,19 @@ model_directory_ready_cb (NautilusDirectory *directory,
 
         if (found)
         {
-            uri = nautilus_file_get_uri (file);
-            hit = nautilus_search_hit_new (uri);
+            location = nautilus_file_get_location (file);
+            hit = nautilus_search_hit_new_for_location (location);
             nautilus_search_hit_set_fts_rank (hit, match);
             hits = g_list_prepend (hits, hit);
 
-            g_free (uri);
+            g_object_unref (location);
         }
 
         g_free (display_name);
     }
 
-    g_list_free_full (mime_types, g_free);
+    g_clear_pointer (&mime_filter, nautilus_mime_filter_unref);
+    nautilus_query_matcher_unref (matcher);
     nautilus_file_list_free (files);
     model->hits = hits;
 
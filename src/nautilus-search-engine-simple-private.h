@@ -0,0 +1,32 @@
+/*
+ * Nautilus is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * Nautilus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; see the file COPYING.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef NAUTILUS_SEARCH_ENGINE_SIMPLE_PRIVATE_H
+#define NAUTILUS_SEARCH_ENGINE_SIMPLE_PRIVATE_H
+
+#include "nautilus-search-engine-simple.h"
+
+G_BEGIN_DECLS
+
+/* The number of directory listings kept for searches running at the
+ * same time that didn't take them yet. For tests.
+ */
+guint nautilus_search_engine_simple_get_n_shared_listings (void);
+
+G_END_DECLS
+
+#endif /* NAUTILUS_SEARCH_ENGINE_SIMPLE_PRIVATE_H */
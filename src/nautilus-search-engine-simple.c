@@ -22,9 +22,12 @@
 #include <config.h>
 #include "nautilus-search-hit.h"
 #include "nautilus-search-provider.h"
-#include "nautilus-search-engine-simple.h"
+#include "nautilus-search-engine-simple-private.h"
+#include "nautilus-search-hit-batcher.h"
+#include "nautilus-mime-filter.h"
 #include "nautilus-ui-utilities.h"
 #include "nautilus-tag-manager.h"
+#include "nautilus-work-queue.h"
 #define DEBUG_FLAG NAUTILUS_DEBUG_SEARCH
 #include "nautilus-debug.h"
 
@@ -32,7 +35,14 @@
 #include <glib.h>
 #include <gio/gio.h>
 
-#define BATCH_SIZE 500
+#define MAX_SEARCH_WORKERS 8
+/* Bigger files are not searched for text. */
+#define MAX_CONTENTS_SIZE (16 * 1024 * 1024)
+/* How much of a file is looked at for NUL bytes, which text doesn't have. */
+#define BINARY_CHECK_SIZE 4096
+/* How much of a file is read at once. */
+#define CONTENTS_CHUNK_SIZE (64 * 1024)
+#define SNIPPET_CONTEXT 40
 
 enum
 {
@@ -41,24 +51,47 @@ enum
     NUM_PROPERTIES
 };
 
+typedef struct SearchThreadData SearchThreadData;
+
+/* A directory to visit, with its file ID once known. */
 typedef struct
+{
+    GFile *location;
+    char *id;
+} SearchDirectory;
+
+/* What the search did with a directory, by file ID. */
+enum
+{
+    DIRECTORY_QUEUED = 1,
+    DIRECTORY_VISITED
+};
+
+struct SearchThreadData
 {
     NautilusSearchEngineSimple *engine;
     GCancellable *cancellable;
+    NautilusSearchHitBatcher *batcher;
 
-    GList *mime_types;
-    GList *found_list;
+    NautilusMimeFilter *mime_filter;
 
-    GQueue *directories;     /* GFiles */
+    /* The directories left to visit, as with deep counts. */
+    NautilusWorkQueue *queue;
+    gsize roots_visited;
 
+    GMutex visited_mutex;
     GHashTable *visited;
 
+    GList *roots;           /* GFiles, none under another */
+    GPtrArray *root_ids;    /* in the same order, NULL if unknown */
     gboolean recursive;
-    gint n_processed_files;
-    GList *hits;
+    gboolean show_hidden;
+    gboolean full_text;
+    NautilusMimeFilter *text_filter;    /* what can be searched for text */
 
     NautilusQuery *query;
-} SearchThreadData;
+    NautilusQueryMatcher *matcher;
+};
 
 
 struct _NautilusSearchEngineSimple
@@ -88,26 +121,120 @@ finalize (GObject *object)
     G_OBJECT_CLASS (nautilus_search_engine_simple_parent_class)->finalize (object);
 }
 
+static void search_thread_done (gpointer user_data);
+static void search_work (gpointer item,
+                         guint    worker,
+                         gpointer user_data);
+static void search_work_done (gpointer user_data);
+
+/* Returns the locations of the query, without those another one
+ * already covers.
+ */
+static GList *
+get_roots (NautilusQuery *query,
+           gboolean       recursive)
+{
+    GList *locations, *roots, *l, *m;
+    gboolean covered;
+
+    locations = nautilus_query_get_locations (query);
+    roots = NULL;
+
+    for (l = locations; l != NULL; l = l->next)
+    {
+        covered = FALSE;
+        for (m = locations; m != NULL && !covered; m = m->next)
+        {
+            covered = m != l && recursive && g_file_has_prefix (l->data, m->data);
+        }
+        for (m = roots; m != NULL && !covered; m = m->next)
+        {
+            covered = g_file_equal (l->data, m->data);
+        }
+
+        if (!covered)
+        {
+            roots = g_list_prepend (roots, g_object_ref (l->data));
+        }
+    }
+    g_list_free_full (locations, g_object_unref);
+
+    return g_list_reverse (roots);
+}
+
+static SearchDirectory *
+search_directory_new (GFile      *location,
+                      const char *id)
+{
+    SearchDirectory *directory;
+
+    directory = g_new (SearchDirectory, 1);
+    directory->location = g_object_ref (location);
+    directory->id = g_strdup (id);
+
+    return directory;
+}
+
+static void
+search_directory_free (SearchDirectory *directory)
+{
+    g_object_unref (directory->location);
+    g_free (directory->id);
+    g_free (directory);
+}
+
 static SearchThreadData *
 search_thread_data_new (NautilusSearchEngineSimple *engine,
                         NautilusQuery              *query)
 {
     SearchThreadData *data;
-    GFile *location;
+    GList *mime_types;
+    guint n_workers;
 
     data = g_new0 (SearchThreadData, 1);
 
     data->engine = g_object_ref (engine);
-    data->directories = g_queue_new ();
     data->visited = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
     data->query = g_object_ref (query);
+    data->matcher = nautilus_query_get_matcher (query);
+    data->recursive = engine->recursive;
+    data->show_hidden = nautilus_query_get_show_hidden_files (query);
+    data->roots = get_roots (query, data->recursive);
+    data->root_ids = g_ptr_array_new_with_free_func (g_free);
+    data->full_text = nautilus_query_get_search_content (query) == NAUTILUS_QUERY_SEARCH_CONTENT_FULL_TEXT;
+
+    mime_types = nautilus_query_get_mime_types (query);
+    data->mime_filter = nautilus_mime_filter_new (mime_types);
+    g_list_free_full (mime_types, g_free);
+
+    if (data->full_text)
+    {
+        mime_types = g_list_prepend (NULL, "text/plain");
+        data->text_filter = nautilus_mime_filter_new (mime_types);
+        g_list_free (mime_types);
+    }
 
-    location = nautilus_query_get_location (query);
+    data->cancellable = g_cancellable_new ();
+    data->batcher = nautilus_search_hit_batcher_new (NAUTILUS_SEARCH_PROVIDER (engine),
+                                                     data->cancellable,
+                                                     search_thread_done, data);
 
-    g_queue_push_tail (data->directories, location);
-    data->mime_types = nautilus_query_get_mime_types (query);
+    /* A search that isn't recursive only visits its roots, so there is
+     * no use in more workers than there are roots.
+     */
+    n_workers = CLAMP (g_get_num_processors (), 1, MAX_SEARCH_WORKERS);
+    if (!data->recursive)
+    {
+        n_workers = CLAMP (g_list_length (data->roots), 1, n_workers);
+    }
+    data->queue = nautilus_work_queue_new (n_workers,
+                                           search_work,
+                                           (GDestroyNotify) search_directory_free,
+                                           data->cancellable,
+                                           search_work_done,
+                                           data);
 
-    data->cancellable = g_cancellable_new ();
+    g_mutex_init (&data->visited_mutex);
 
     return data;
 }
@@ -115,21 +242,23 @@ search_thread_data_new (NautilusSearchEngineSimple *engine,
 static void
 search_thread_data_free (SearchThreadData *data)
 {
-    g_queue_foreach (data->directories,
-                     (GFunc) g_object_unref, NULL);
-    g_queue_free (data->directories);
+    nautilus_work_queue_unref (data->queue);
+    g_mutex_clear (&data->visited_mutex);
     g_hash_table_destroy (data->visited);
     g_object_unref (data->cancellable);
     g_object_unref (data->query);
-    g_list_free_full (data->mime_types, g_free);
-    g_list_free_full (data->hits, g_object_unref);
+    g_list_free_full (data->roots, g_object_unref);
+    g_ptr_array_unref (data->root_ids);
+    nautilus_query_matcher_unref (data->matcher);
+    g_clear_pointer (&data->mime_filter, nautilus_mime_filter_unref);
+    g_clear_pointer (&data->text_filter, nautilus_mime_filter_unref);
     g_object_unref (data->engine);
 
     g_free (data);
 }
 
-static gboolean
-search_thread_done_idle (gpointer user_data)
+static void
+search_thread_done (gpointer user_data)
 {
     SearchThreadData *data = user_data;
     NautilusSearchEngineSimple *engine = data->engine;
@@ -149,50 +278,48 @@ search_thread_done_idle (gpointer user_data)
     g_object_notify (G_OBJECT (engine), "running");
 
     search_thread_data_free (data);
-
-    return FALSE;
 }
 
-typedef struct
-{
-    GList *hits;
-    SearchThreadData *thread_data;
-} SearchHitsData;
-
-
+/* Returns TRUE if the directory with this file ID wasn't queued yet,
+ * and marks it as queued.
+ */
 static gboolean
-search_thread_add_hits_idle (gpointer user_data)
+mark_directory_as_queued (SearchThreadData *data,
+                          const char       *id)
 {
-    SearchHitsData *data = user_data;
+    gboolean added;
 
-    if (!g_cancellable_is_cancelled (data->thread_data->cancellable))
+    g_mutex_lock (&data->visited_mutex);
+    added = !g_hash_table_contains (data->visited, id);
+    if (added)
     {
-        DEBUG ("Simple engine add hits");
-        nautilus_search_provider_hits_added (NAUTILUS_SEARCH_PROVIDER (data->thread_data->engine),
-                                             data->hits);
+        g_hash_table_insert (data->visited, g_strdup (id), GINT_TO_POINTER (DIRECTORY_QUEUED));
     }
+    g_mutex_unlock (&data->visited_mutex);
 
-    g_list_free_full (data->hits, g_object_unref);
-    g_free (data);
-
-    return FALSE;
+    return added;
 }
 
 static void
-send_batch (SearchThreadData *thread_data)
+mark_directory_as_visited (SearchThreadData *data,
+                           const char       *id)
 {
-    SearchHitsData *data;
+    g_mutex_lock (&data->visited_mutex);
+    g_hash_table_insert (data->visited, g_strdup (id), GINT_TO_POINTER (DIRECTORY_VISITED));
+    g_mutex_unlock (&data->visited_mutex);
+}
 
-    thread_data->n_processed_files = 0;
+static gboolean
+is_directory_visited (SearchThreadData *data,
+                      const char       *id)
+{
+    gboolean visited;
 
-    if (thread_data->hits)
-    {
-        data = g_new (SearchHitsData, 1);
-        data->hits = thread_data->hits;
-        data->thread_data = thread_data;
-        g_idle_add (search_thread_add_hits_idle, data);
-    }
-    thread_data->hits = NULL;
+    g_mutex_lock (&data->visited_mutex);
+    visited = GPOINTER_TO_INT (g_hash_table_lookup (data->visited, id)) == DIRECTORY_VISITED;
+    g_mutex_unlock (&data->visited_mutex);
+
+    return visited;
 }
 
 #define STD_ATTRIBUTES \
@@ -205,208 +332,728 @@ send_batch (SearchThreadData *thread_data)
     G_FILE_ATTRIBUTE_TIME_ACCESS "," \
     G_FILE_ATTRIBUTE_ID_FILE
 
+/* Also what the MIME types are checked against. */
+#define FULL_TEXT_ATTRIBUTES \
+    G_FILE_ATTRIBUTE_STANDARD_SIZE "," \
+    G_FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE
+
+/* The fast content type only comes from the name of the file, which is
+ * enough for most files and saves reading all of them. The ones it
+ * can't tell are sniffed.
+ */
+static gboolean
+match_mime_types (GFile            *file,
+                  GFileInfo        *info,
+                  SearchThreadData *data)
+{
+    GFileInfo *sniffed_info;
+    const char *content_type;
+    gboolean matches;
+
+    content_type = g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE);
+    if (content_type != NULL && !g_content_type_is_unknown (content_type))
+    {
+        return nautilus_mime_filter_matches (data->mime_filter, content_type);
+    }
+
+    sniffed_info = g_file_query_info (file, G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE,
+                                      G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                      data->cancellable, NULL);
+    if (sniffed_info == NULL)
+    {
+        return FALSE;
+    }
+
+    matches = nautilus_mime_filter_matches (data->mime_filter,
+                                            g_file_info_get_content_type (sniffed_info));
+    g_object_unref (sniffed_info);
+
+    return matches;
+}
+
+/* Returns the line around offset, at most SNIPPET_CONTEXT bytes before
+ * and twice that after it, with what isn't UTF-8 replaced.
+ */
+static char *
+get_snippet (const char *contents,
+             gsize       length,
+             gsize       offset)
+{
+    GString *snippet;
+    const char *p, *valid_end;
+    gsize start, end, remaining;
+
+    start = offset;
+    while (start > 0 && offset - start < SNIPPET_CONTEXT && contents[start - 1] != '\n')
+    {
+        start--;
+    }
+    end = offset;
+    while (end < length && end - offset < SNIPPET_CONTEXT * 2 && contents[end] != '\n')
+    {
+        end++;
+    }
+
+    /* Don't start in the middle of a character. */
+    while (start < offset && (contents[start] & 0xc0) == 0x80)
+    {
+        start++;
+    }
+
+    snippet = g_string_sized_new (end - start);
+    p = contents + start;
+    remaining = end - start;
+    while (!g_utf8_validate (p, remaining, &valid_end))
+    {
+        g_string_append_len (snippet, p, valid_end - p);
+        g_string_append (snippet, "\xef\xbf\xbd");
+        remaining -= valid_end - p + 1;
+        p = valid_end + 1;
+    }
+    g_string_append_len (snippet, p, remaining);
+
+    return g_strstrip (g_string_free (snippet, FALSE));
+}
+
+/* Returns a snippet of the contents around the words of the query, or
+ * NULL if the file isn't text or doesn't contain them. Files are read in
+ * chunks rather than mapped, as a mapped file that gets truncated while
+ * it is searched, like a build output, would crash with SIGBUS.
+ */
+static char *
+match_contents (GFile            *file,
+                GFileInfo        *info,
+                SearchThreadData *data)
+{
+    GFileInputStream *stream;
+    const char *content_type;
+    char *buffer, *snippet;
+    gboolean *found;
+    gboolean found_all;
+    goffset size;
+    gsize overlap, kept, length, total;
+    gssize n_read, offset;
+
+    if (g_file_info_get_file_type (info) != G_FILE_TYPE_REGULAR)
+    {
+        return NULL;
+    }
+
+    size = g_file_info_get_size (info);
+    if (size == 0 || size > MAX_CONTENTS_SIZE)
+    {
+        return NULL;
+    }
+
+    /* Skip what the name already tells isn't text. */
+    content_type = g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE);
+    if (content_type != NULL &&
+        !g_content_type_is_unknown (content_type) &&
+        !nautilus_mime_filter_matches (data->text_filter, content_type))
+    {
+        return NULL;
+    }
+
+    stream = g_file_read (file, data->cancellable, NULL);
+    if (stream == NULL)
+    {
+        return NULL;
+    }
+
+    /* What is kept of a chunk to go with the next one, so that a word
+     * across the two is still found.
+     */
+    overlap = nautilus_query_matcher_get_contents_overlap (data->matcher);
+    buffer = g_malloc (overlap + CONTENTS_CHUNK_SIZE);
+    found = g_new0 (gboolean, nautilus_query_matcher_get_n_words (data->matcher));
+    found_all = FALSE;
+    snippet = NULL;
+    kept = 0;
+    total = 0;
+
+    /* The file may have grown since its size was read. */
+    while (!found_all && total < MAX_CONTENTS_SIZE)
+    {
+        n_read = g_input_stream_read (G_INPUT_STREAM (stream), buffer + kept, CONTENTS_CHUNK_SIZE,
+                                      data->cancellable, NULL);
+        if (n_read <= 0)
+        {
+            break;
+        }
+
+        length = kept + n_read;
+        if (total == 0 && memchr (buffer, '\0', MIN (length, BINARY_CHECK_SIZE)) != NULL)
+        {
+            break;
+        }
+        total += n_read;
+
+        found_all = nautilus_query_matcher_match_contents_part (data->matcher, buffer, length,
+                                                                found, &offset);
+        if (offset >= 0)
+        {
+            snippet = get_snippet (buffer, length, offset);
+        }
+
+        kept = MIN (overlap, length);
+        memmove (buffer, buffer + length - kept, kept);
+    }
+
+    if (!found_all)
+    {
+        g_clear_pointer (&snippet, g_free);
+    }
+
+    g_free (found);
+    g_free (buffer);
+    g_input_stream_close (G_INPUT_STREAM (stream), NULL, NULL);
+    g_object_unref (stream);
+
+    return snippet;
+}
+
+/* Searches running at the same time over overlapping trees, like one
+ * of ~ and one of ~/src in two windows, share the listings of the
+ * directories they have in common. The first search to get to one
+ * lists it for the others that will visit it too, and each checks the
+ * files against its own query. A listing is dropped once all of them
+ * took it, or finished. Searches that already visited the directory,
+ * or that skip it as hidden, are not expected to take it.
+ */
+#define MAX_SHARED_LISTINGS 1024
+
+/* Enough for any query to be checked. */
+#define SHARED_ATTRIBUTES STD_ATTRIBUTES "," FULL_TEXT_ATTRIBUTES
+
+typedef enum
+{
+    LISTING_PENDING,
+    LISTING_DONE,
+    LISTING_FAILED
+} ListingState;
+
+typedef struct
+{
+    gint ref_count;
+    ListingState state;     /* only changes under shared_mutex */
+    GPtrArray *infos;
+    GList *expected;        /* the searches that didn't take it yet */
+} SharedListing;
+
+static GMutex shared_mutex;
+static GCond shared_listing_done;
+static GHashTable *shared_listings;     /* GFile → SharedListing */
+static GList *running_searches;         /* SearchThreadData */
+
 static void
-visit_directory (GFile            *dir,
-                 SearchThreadData *data)
+shared_listing_unref (SharedListing *listing)
+{
+    if (!g_atomic_int_dec_and_test (&listing->ref_count))
+    {
+        return;
+    }
+
+    g_clear_pointer (&listing->infos, g_ptr_array_unref);
+    g_list_free (listing->expected);
+    g_free (listing);
+}
+
+static gboolean
+is_hidden_path (const char *relative_path)
+{
+    char **names;
+    gboolean hidden;
+    guint i;
+
+    names = g_strsplit (relative_path, G_DIR_SEPARATOR_S, -1);
+    hidden = FALSE;
+    for (i = 0; names[i] != NULL && !hidden; i++)
+    {
+        hidden = names[i][0] == '.' || g_str_has_suffix (names[i], "~");
+    }
+    g_strfreev (names);
+
+    return hidden;
+}
+
+/* Whether the search is still going to visit dir, which has the file
+ * ID id, or NULL if it is unknown.
+ */
+static gboolean
+search_will_visit_directory (SearchThreadData *data,
+                             GFile            *dir,
+                             const char       *id)
+{
+    char *relative_path;
+    gboolean covered;
+    GList *l;
+
+    covered = FALSE;
+    for (l = data->roots; l != NULL && !covered; l = l->next)
+    {
+        if (g_file_equal (dir, l->data))
+        {
+            covered = TRUE;
+        }
+        else if (data->recursive && g_file_has_prefix (dir, l->data))
+        {
+            relative_path = g_file_get_relative_path (l->data, dir);
+            covered = data->show_hidden || !is_hidden_path (relative_path);
+            g_free (relative_path);
+        }
+    }
+
+    return covered && (id == NULL || !is_directory_visited (data, id));
+}
+
+static void
+register_search (SearchThreadData *data)
+{
+    g_mutex_lock (&shared_mutex);
+    if (shared_listings == NULL)
+    {
+        shared_listings = g_hash_table_new_full (g_file_hash, (GEqualFunc) g_file_equal,
+                                                 g_object_unref,
+                                                 (GDestroyNotify) shared_listing_unref);
+    }
+    running_searches = g_list_prepend (running_searches, data);
+    g_mutex_unlock (&shared_mutex);
+}
+
+/* Stops expecting the search to take the listings. */
+static void
+unregister_search (SearchThreadData *data)
+{
+    GHashTableIter iter;
+    SharedListing *listing;
+
+    g_mutex_lock (&shared_mutex);
+    running_searches = g_list_remove (running_searches, data);
+
+    g_hash_table_iter_init (&iter, shared_listings);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &listing))
+    {
+        listing->expected = g_list_remove (listing->expected, data);
+        if (listing->expected == NULL && listing->state != LISTING_PENDING)
+        {
+            g_hash_table_iter_remove (&iter);
+        }
+    }
+    g_mutex_unlock (&shared_mutex);
+}
+
+/* Returns the listing of dir shared with other searches, if there is
+ * one the search is expected to take, or one to make for others that
+ * will visit dir too, in which case is_lister is set.
+ */
+static SharedListing *
+take_shared_listing (SearchThreadData *data,
+                     SearchDirectory  *directory,
+                     gboolean         *is_lister)
+{
+    SharedListing *listing;
+    SearchThreadData *other;
+    GList *l, *expected;
+    GFile *dir;
+
+    *is_lister = FALSE;
+    dir = directory->location;
+
+    g_mutex_lock (&shared_mutex);
+
+    listing = g_hash_table_lookup (shared_listings, dir);
+    if (listing != NULL && g_list_find (listing->expected, data) != NULL)
+    {
+        g_atomic_int_inc (&listing->ref_count);
+        listing->expected = g_list_remove (listing->expected, data);
+        if (listing->expected == NULL && listing->state != LISTING_PENDING)
+        {
+            g_hash_table_remove (shared_listings, dir);
+        }
+    }
+    else if (listing == NULL && g_hash_table_size (shared_listings) < MAX_SHARED_LISTINGS)
+    {
+        expected = NULL;
+        for (l = running_searches; l != NULL; l = l->next)
+        {
+            other = l->data;
+            if (other != data &&
+                !g_cancellable_is_cancelled (other->cancellable) &&
+                search_will_visit_directory (other, dir, directory->id))
+            {
+                expected = g_list_prepend (expected, other);
+            }
+        }
+
+        if (expected != NULL)
+        {
+            listing = g_new0 (SharedListing, 1);
+            listing->ref_count = 2;
+            listing->state = LISTING_PENDING;
+            listing->expected = expected;
+            g_hash_table_insert (shared_listings, g_object_ref (dir), listing);
+            *is_lister = TRUE;
+        }
+    }
+    else
+    {
+        listing = NULL;
+    }
+
+    g_mutex_unlock (&shared_mutex);
+
+    return listing;
+}
+
+guint
+nautilus_search_engine_simple_get_n_shared_listings (void)
+{
+    guint n_listings;
+
+    g_mutex_lock (&shared_mutex);
+    n_listings = shared_listings != NULL ? g_hash_table_size (shared_listings) : 0;
+    g_mutex_unlock (&shared_mutex);
+
+    return n_listings;
+}
+
+static GPtrArray *
+list_directory (GFile        *dir,
+                GCancellable *cancellable)
 {
     GFileEnumerator *enumerator;
     GFileInfo *info;
+    GPtrArray *infos;
+    GError *error = NULL;
+
+    enumerator = g_file_enumerate_children (dir, SHARED_ATTRIBUTES,
+                                            G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                            cancellable, NULL);
+    if (enumerator == NULL)
+    {
+        return NULL;
+    }
+
+    infos = g_ptr_array_new_with_free_func (g_object_unref);
+    while ((info = g_file_enumerator_next_file (enumerator, cancellable, &error)) != NULL)
+    {
+        g_ptr_array_add (infos, info);
+    }
+    g_object_unref (enumerator);
+
+    /* Others can't use a partial listing. */
+    if (error != NULL)
+    {
+        g_error_free (error);
+        g_clear_pointer (&infos, g_ptr_array_unref);
+    }
+
+    return infos;
+}
+
+static void
+finish_shared_listing (GFile         *dir,
+                       SharedListing *listing,
+                       GPtrArray     *infos)
+{
+    g_mutex_lock (&shared_mutex);
+
+    listing->infos = infos;
+    listing->state = infos != NULL ? LISTING_DONE : LISTING_FAILED;
+    if (listing->expected == NULL || listing->state == LISTING_FAILED)
+    {
+        g_hash_table_remove (shared_listings, dir);
+    }
+    g_cond_broadcast (&shared_listing_done);
+
+    g_mutex_unlock (&shared_mutex);
+}
+
+/* Returns TRUE if the infos of the listing can be used. Stopping the
+ * search wakes it up too.
+ */
+static gboolean
+wait_for_shared_listing (SharedListing *listing,
+                         GCancellable  *cancellable)
+{
+    ListingState state;
+
+    g_mutex_lock (&shared_mutex);
+    while (listing->state == LISTING_PENDING &&
+           !g_cancellable_is_cancelled (cancellable))
+    {
+        g_cond_wait (&shared_listing_done, &shared_mutex);
+    }
+    state = listing->state;
+    g_mutex_unlock (&shared_mutex);
+
+    return state == LISTING_DONE;
+}
+
+/* Checks a file of dir against the query, and queues it if it is a
+ * directory to visit.
+ */
+static void
+visit_file (GFile            *dir,
+            GFileInfo        *info,
+            SearchThreadData *data,
+            guint             worker)
+{
     GFile *child;
-    const char *mime_type, *display_name;
+    const char *display_name;
     gdouble match;
-    gboolean is_hidden, found;
-    GList *l;
+    gboolean is_hidden, found, match_in_contents;
     const char *id;
-    gboolean visited;
     guint64 atime;
     guint64 mtime;
     GPtrArray *date_range;
     GDateTime *initial_date;
     GDateTime *end_date;
     NautilusTagManager *tag_manager;
-    gchar *uri;
-
-    enumerator = g_file_enumerate_children (dir,
-                                            data->mime_types != NULL ?
-                                            STD_ATTRIBUTES ","
-                                            G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE
-                                            :
-                                            STD_ATTRIBUTES
-                                            ,
-                                            G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
-                                            data->cancellable, NULL);
+    gchar *uri, *snippet;
 
-    if (enumerator == NULL)
+    display_name = g_file_info_get_display_name (info);
+    if (display_name == NULL)
     {
         return;
     }
 
-    while ((info = g_file_enumerator_next_file (enumerator, data->cancellable, NULL)) != NULL)
+    is_hidden = g_file_info_get_is_hidden (info) || g_file_info_get_is_backup (info);
+    if (is_hidden && !nautilus_query_get_show_hidden_files (data->query))
+    {
+        return;
+    }
+
+    child = g_file_get_child (dir, g_file_info_get_name (info));
+    match = nautilus_query_matcher_match (data->matcher, display_name);
+    found = (match > -1);
+
+    /* Look inside the file last, if nothing else rules it out. */
+    match_in_contents = !found && data->full_text;
+    found |= match_in_contents;
+    snippet = NULL;
+
+    if (found && data->mime_filter != NULL)
     {
-        display_name = g_file_info_get_display_name (info);
-        if (display_name == NULL)
+        found = match_mime_types (child, info, data);
+    }
+
+    mtime = g_file_info_get_attribute_uint64 (info, "time::modified");
+    atime = g_file_info_get_attribute_uint64 (info, "time::access");
+
+    date_range = nautilus_query_get_date_range (data->query);
+    if (found && date_range != NULL)
+    {
+        NautilusQuerySearchType type;
+        guint64 current_file_time;
+
+        initial_date = g_ptr_array_index (date_range, 0);
+        end_date = g_ptr_array_index (date_range, 1);
+        type = nautilus_query_get_search_type (data->query);
+
+        if (type == NAUTILUS_QUERY_SEARCH_TYPE_LAST_ACCESS)
         {
-            goto next;
+            current_file_time = atime;
         }
-
-        is_hidden = g_file_info_get_is_hidden (info) || g_file_info_get_is_backup (info);
-        if (is_hidden && !nautilus_query_get_show_hidden_files (data->query))
+        else
         {
-            goto next;
+            current_file_time = mtime;
         }
+        found = nautilus_file_date_in_between (current_file_time,
+                                               initial_date,
+                                               end_date);
+        g_ptr_array_unref (date_range);
+    }
 
-        child = g_file_get_child (dir, g_file_info_get_name (info));
-        match = nautilus_query_matches_string (data->query, display_name);
-        found = (match > -1);
+    if (nautilus_query_get_search_favorite (data->query))
+    {
+        tag_manager = nautilus_tag_manager_get ();
 
-        if (found && data->mime_types)
+        uri = g_file_get_uri (child);
+
+        if (!nautilus_tag_manager_file_is_favorite (tag_manager, uri))
         {
-            mime_type = g_file_info_get_content_type (info);
             found = FALSE;
-
-            for (l = data->mime_types; mime_type != NULL && l != NULL; l = l->next)
-            {
-                if (g_content_type_is_a (mime_type, l->data))
-                {
-                    found = TRUE;
-                    break;
-                }
-            }
         }
 
-        mtime = g_file_info_get_attribute_uint64 (info, "time::modified");
-        atime = g_file_info_get_attribute_uint64 (info, "time::access");
+        g_free (uri);
+    }
 
-        date_range = nautilus_query_get_date_range (data->query);
-        if (found && date_range != NULL)
-        {
-            NautilusQuerySearchType type;
-            guint64 current_file_time;
+    if (found && match_in_contents)
+    {
+        snippet = match_contents (child, info, data);
+        found = snippet != NULL;
+    }
 
-            initial_date = g_ptr_array_index (date_range, 0);
-            end_date = g_ptr_array_index (date_range, 1);
-            type = nautilus_query_get_search_type (data->query);
+    if (found)
+    {
+        NautilusSearchHit *hit;
+        GDateTime *date;
 
-            if (type == NAUTILUS_QUERY_SEARCH_TYPE_LAST_ACCESS)
-            {
-                current_file_time = atime;
-            }
-            else
-            {
-                current_file_time = mtime;
-            }
-            found = nautilus_file_date_in_between (current_file_time,
-                                                   initial_date,
-                                                   end_date);
-            g_ptr_array_unref (date_range);
+        hit = nautilus_search_hit_new_for_location (child);
+        if (snippet != NULL)
+        {
+            nautilus_search_hit_set_fts_snippet (hit, snippet);
+            nautilus_search_hit_set_fts_rank (hit, nautilus_query_matcher_get_contents_rank (data->matcher));
         }
-
-        if (nautilus_query_get_search_favorite (data->query))
+        else
         {
-            tag_manager = nautilus_tag_manager_get ();
-
-            uri = g_file_get_uri (child);
+            nautilus_search_hit_set_fts_rank (hit, match);
+        }
+        date = g_date_time_new_from_unix_local (mtime);
+        nautilus_search_hit_set_modification_time (hit, date);
+        g_date_time_unref (date);
 
-            if (!nautilus_tag_manager_file_is_favorite (tag_manager, uri))
-            {
-                found = FALSE;
-            }
+        nautilus_search_hit_batcher_add (data->batcher, hit);
+    }
+    g_free (snippet);
 
-            g_free (uri);
+    if (data->recursive && g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY)
+    {
+        id = g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_ID_FILE);
+        if (id == NULL || mark_directory_as_queued (data, id))
+        {
+            nautilus_work_queue_push (data->queue, worker, search_directory_new (child, id));
         }
+    }
 
-        if (found)
-        {
-            NautilusSearchHit *hit;
-            GDateTime *date;
+    g_object_unref (child);
+}
 
-            uri = g_file_get_uri (child);
-            hit = nautilus_search_hit_new (uri);
-            g_free (uri);
-            nautilus_search_hit_set_fts_rank (hit, match);
-            date = g_date_time_new_from_unix_local (mtime);
-            nautilus_search_hit_set_modification_time (hit, date);
-            g_date_time_unref (date);
+static void
+visit_directory (SearchDirectory  *directory,
+                 SearchThreadData *data,
+                 guint             worker)
+{
+    SharedListing *listing;
+    GFileEnumerator *enumerator;
+    GFileInfo *info;
+    GFile *dir;
+    const char *attributes;
+    gboolean is_lister;
+    guint i;
 
-            data->hits = g_list_prepend (data->hits, hit);
-        }
+    dir = directory->location;
 
-        data->n_processed_files++;
-        if (data->n_processed_files > BATCH_SIZE)
+    /* Before looking for a listing, so that one made after it doesn't
+     * expect this search.
+     */
+    if (directory->id != NULL)
+    {
+        mark_directory_as_visited (data, directory->id);
+    }
+
+    listing = take_shared_listing (data, directory, &is_lister);
+    if (listing != NULL)
+    {
+        if (is_lister)
         {
-            send_batch (data);
+            finish_shared_listing (dir, listing,
+                                   list_directory (dir, data->cancellable));
         }
 
-        if (data->engine->recursive && g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY)
+        if (wait_for_shared_listing (listing, data->cancellable))
         {
-            id = g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_ID_FILE);
-            visited = FALSE;
-            if (id)
+            for (i = 0; i < listing->infos->len && !g_cancellable_is_cancelled (data->cancellable); i++)
             {
-                if (g_hash_table_lookup_extended (data->visited,
-                                                  id, NULL, NULL))
-                {
-                    visited = TRUE;
-                }
-                else
-                {
-                    g_hash_table_insert (data->visited, g_strdup (id), NULL);
-                }
-            }
-
-            if (!visited)
-            {
-                g_queue_push_tail (data->directories, g_object_ref (child));
+                visit_file (dir, g_ptr_array_index (listing->infos, i), data, worker);
             }
+            shared_listing_unref (listing);
+            return;
         }
 
-        g_object_unref (child);
-next:
+        /* The search that was listing it was stopped. */
+        shared_listing_unref (listing);
+    }
+
+    attributes = data->full_text || data->mime_filter != NULL ?
+                 STD_ATTRIBUTES "," FULL_TEXT_ATTRIBUTES :
+                 STD_ATTRIBUTES;
+
+    enumerator = g_file_enumerate_children (dir, attributes,
+                                            G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                            data->cancellable, NULL);
+
+    if (enumerator == NULL)
+    {
+        return;
+    }
+
+    while ((info = g_file_enumerator_next_file (enumerator, data->cancellable, NULL)) != NULL)
+    {
+        visit_file (dir, info, data, worker);
         g_object_unref (info);
     }
 
     g_object_unref (enumerator);
 }
 
-
-static gpointer
-search_thread_func (gpointer user_data)
+static void
+search_work (gpointer item,
+             guint    worker,
+             gpointer user_data)
 {
     SearchThreadData *data;
-    GFile *dir;
+    SearchDirectory *directory;
     GFileInfo *info;
     const char *id;
+    GList *l;
+    guint i;
 
     data = user_data;
+    directory = item;
 
-    /* Insert id for toplevel directory into visited */
-    dir = g_queue_peek_head (data->directories);
-    info = g_file_query_info (dir, G_FILE_ATTRIBUTE_ID_FILE, 0, data->cancellable, NULL);
-    if (info)
+    /* Insert ids for the roots into visited, before any directory under
+     * them can get to one of the others.
+     */
+    if (g_once_init_enter (&data->roots_visited))
     {
-        id = g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_ID_FILE);
-        if (id)
+        for (l = data->roots; l != NULL; l = l->next)
         {
-            g_hash_table_insert (data->visited, g_strdup (id), NULL);
+            id = NULL;
+            info = g_file_query_info (l->data, G_FILE_ATTRIBUTE_ID_FILE, 0, data->cancellable, NULL);
+            if (info)
+            {
+                id = g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_ID_FILE);
+                if (id)
+                {
+                    mark_directory_as_queued (data, id);
+                }
+            }
+            g_ptr_array_add (data->root_ids, g_strdup (id));
+            g_clear_object (&info);
         }
-        g_object_unref (info);
+        g_once_init_leave (&data->roots_visited, 1);
     }
 
-    while (!g_cancellable_is_cancelled (data->cancellable) &&
-           (dir = g_queue_pop_head (data->directories)) != NULL)
+    /* The roots are queued before their ids are known. */
+    if (directory->id == NULL)
     {
-        visit_directory (dir, data);
-        g_object_unref (dir);
+        for (l = data->roots, i = 0; l != NULL; l = l->next, i++)
+        {
+            if (g_file_equal (directory->location, l->data))
+            {
+                directory->id = g_strdup (g_ptr_array_index (data->root_ids, i));
+                break;
+            }
+        }
     }
 
-    if (!g_cancellable_is_cancelled (data->cancellable))
-    {
-        send_batch (data);
-    }
+    visit_directory (directory, data, worker);
+}
+
+/* Called once the last directory was visited, after the hits of all
+ * of them.
+ */
+static void
+search_work_done (gpointer user_data)
+{
+    SearchThreadData *data;
 
-    g_idle_add (search_thread_done_idle, data);
+    data = user_data;
 
-    return NULL;
+    unregister_search (data);
+    nautilus_search_hit_batcher_finish (data->batcher);
 }
 
 static void
@@ -414,7 +1061,7 @@ nautilus_search_engine_simple_start (NautilusSearchProvider *provider)
 {
     NautilusSearchEngineSimple *simple;
     SearchThreadData *data;
-    GThread *thread;
+    GList *l;
 
     simple = NAUTILUS_SEARCH_ENGINE_SIMPLE (provider);
 
@@ -427,12 +1074,16 @@ nautilus_search_engine_simple_start (NautilusSearchProvider *provider)
 
     data = search_thread_data_new (simple, simple->query);
 
-    thread = g_thread_new ("nautilus-search-simple", search_thread_func, data);
     simple->active_search = data;
+    register_search (data);
 
-    g_object_notify (G_OBJECT (provider), "running");
+    for (l = data->roots; l != NULL; l = l->next)
+    {
+        nautilus_work_queue_push (data->queue, 0, search_directory_new (l->data, NULL));
+    }
+    nautilus_work_queue_start (data->queue);
 
-    g_thread_unref (thread);
+    g_object_notify (G_OBJECT (provider), "running");
 }
 
 static void
@@ -444,6 +1095,11 @@ nautilus_search_engine_simple_stop (NautilusSearchProvider *provider)
     {
         DEBUG ("Simple engine stop");
         g_cancellable_cancel (simple->active_search->cancellable);
+
+        /* Wake it up if it waits for a listing of another search. */
+        g_mutex_lock (&shared_mutex);
+        g_cond_broadcast (&shared_listing_done);
+        g_mutex_unlock (&shared_mutex);
     }
 }
 
@@ -41,6 +41,7 @@ struct _NautilusSearchEngineTracker
 
     gboolean query_pending;
     GQueue *hits_pending;
+    gint64 next_batch_time;
 
     gboolean recursive;
     gboolean fts_enabled;
@@ -83,7 +84,11 @@ finalize (GObject *object)
     G_OBJECT_CLASS (nautilus_search_engine_tracker_parent_class)->finalize (object);
 }
 
-#define BATCH_SIZE 100
+/* The cursor is read on the main loop, so there is no point in backing
+ * off: send the first hit at once, then whatever came in at most every
+ * HIT_LATENCY.
+ */
+#define HIT_LATENCY (100 * G_TIME_SPAN_MILLISECOND)
 
 static void
 check_pending_hits (NautilusSearchEngineTracker *tracker,
@@ -91,15 +96,19 @@ check_pending_hits (NautilusSearchEngineTracker *tracker,
 {
     GList *hits = NULL;
     NautilusSearchHit *hit;
+    gint64 now;
 
-    DEBUG ("Tracker engine add hits");
-
-    if (!force_send &&
-        g_queue_get_length (tracker->hits_pending) < BATCH_SIZE)
+    now = g_get_monotonic_time ();
+    if (g_queue_is_empty (tracker->hits_pending) ||
+        (!force_send && now < tracker->next_batch_time))
     {
         return;
     }
 
+    DEBUG ("Tracker engine add hits");
+
+    tracker->next_batch_time = now + HIT_LATENCY;
+
     while ((hit = g_queue_pop_head (tracker->hits_pending)))
     {
         hits = g_list_prepend (hits, hit);
@@ -291,9 +300,8 @@ nautilus_search_engine_tracker_start (NautilusSearchProvider *provider)
 {
     NautilusSearchEngineTracker *tracker;
     gchar *query_text, *search_text, *location_uri, *downcase;
-    GFile *location;
     GString *sparql;
-    GList *mimetypes, *l;
+    GList *mimetypes, *locations, *l;
     gint mime_count;
     gboolean recursive;
     GPtrArray *date_range;
@@ -308,6 +316,7 @@ nautilus_search_engine_tracker_start (NautilusSearchProvider *provider)
     DEBUG ("Tracker engine start");
     g_object_ref (tracker);
     tracker->query_pending = TRUE;
+    tracker->next_batch_time = 0;
 
     g_object_notify (G_OBJECT (provider), "running");
 
@@ -329,8 +338,6 @@ nautilus_search_engine_tracker_start (NautilusSearchProvider *provider)
     g_free (query_text);
     g_free (downcase);
 
-    location = nautilus_query_get_location (tracker->query);
-    location_uri = location ? g_file_get_uri (location) : NULL;
     mimetypes = nautilus_query_get_mime_types (tracker->query);
     mime_count = g_list_length (mimetypes);
 
@@ -365,14 +372,27 @@ nautilus_search_engine_tracker_start (NautilusSearchProvider *provider)
 
     g_string_append_printf (sparql, " . FILTER( ");
 
-    if (!tracker->recursive)
-    {
-        g_string_append_printf (sparql, "tracker:uri-is-parent('%s', ?url)", location_uri);
-    }
-    else
+    locations = nautilus_query_get_locations (tracker->query);
+    g_string_append (sparql, "(");
+    for (l = locations; l != NULL; l = l->next)
     {
-        g_string_append_printf (sparql, "tracker:uri-is-descendant('%s', ?url)", location_uri);
+        location_uri = g_file_get_uri (l->data);
+        if (l != locations)
+        {
+            g_string_append (sparql, " || ");
+        }
+        if (!tracker->recursive)
+        {
+            g_string_append_printf (sparql, "tracker:uri-is-parent('%s', ?url)", location_uri);
+        }
+        else
+        {
+            g_string_append_printf (sparql, "tracker:uri-is-descendant('%s', ?url)", location_uri);
+        }
+        g_free (location_uri);
     }
+    g_string_append (sparql, ")");
+    g_list_free_full (locations, g_object_unref);
 
     if (!tracker->fts_enabled)
     {
@@ -446,9 +466,7 @@ nautilus_search_engine_tracker_start (NautilusSearchProvider *provider)
     g_string_free (sparql, TRUE);
 
     g_free (search_text);
-    g_free (location_uri);
     g_list_free_full (mimetypes, g_free);
-    g_object_unref (location);
 }
 
 static void
@@ -26,17 +26,45 @@
 #include "nautilus-search-engine.h"
 #include "nautilus-search-engine-simple.h"
 #include "nautilus-search-engine-model.h"
+#include "nautilus-search-engine-index.h"
+#include "nautilus-mime-filter.h"
+#include "nautilus-ui-utilities.h"
 #define DEBUG_FLAG NAUTILUS_DEBUG_SEARCH
 #include "nautilus-debug.h"
 #include "nautilus-search-engine-tracker.h"
 
+/* The hits of a search are only filtered for a narrower query that soon,
+ * later files might have been added or changed since.
+ */
+#define MAX_REFINEMENT_AGE (30 * G_USEC_PER_SEC)
+#define REFINE_ATTRIBUTES \
+    G_FILE_ATTRIBUTE_STANDARD_DISPLAY_NAME "," \
+    G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE "," \
+    G_FILE_ATTRIBUTE_TIME_MODIFIED "," \
+    G_FILE_ATTRIBUTE_TIME_ACCESS
+
 typedef struct
 {
     NautilusSearchEngineTracker *tracker;
     NautilusSearchEngineSimple *simple;
     NautilusSearchEngineModel *model;
+    NautilusSearchEngineIndex *index;
+
+    GHashTable *locations;      /* GFiles of the hits, to drop duplicates */
+    NautilusQuery *query;
+    /* What the current search is for, and what it found so far. */
+    NautilusQuery *searched_query;
+    GPtrArray *hits;
+    /* The last search that wasn't stopped, to refine it, and when the
+     * file system was last searched for its hits. Refining doesn't look
+     * at the file system again, so it keeps the time.
+     */
+    NautilusQuery *last_query;
+    GPtrArray *last_hits;
+    gint64 last_search_time;
+    gboolean refining;
+    GCancellable *refine_cancellable;
 
-    GHashTable *uris;
     guint providers_running;
     guint providers_finished;
     guint providers_error;
@@ -73,15 +101,208 @@ nautilus_search_engine_set_query (NautilusSearchProvider *provider,
     engine = NAUTILUS_SEARCH_ENGINE (provider);
     priv = nautilus_search_engine_get_instance_private (engine);
 
+    g_set_object (&priv->query, query);
+
     nautilus_search_provider_set_query (NAUTILUS_SEARCH_PROVIDER (priv->tracker), query);
     nautilus_search_provider_set_query (NAUTILUS_SEARCH_PROVIDER (priv->model), query);
     nautilus_search_provider_set_query (NAUTILUS_SEARCH_PROVIDER (priv->simple), query);
+    nautilus_search_provider_set_query (NAUTILUS_SEARCH_PROVIDER (priv->index), query);
+}
+
+static void search_provider_hits_added (NautilusSearchProvider *provider,
+                                        GList                  *hits,
+                                        NautilusSearchEngine   *engine);
+static void check_providers_status (NautilusSearchEngine *engine);
+
+typedef struct
+{
+    NautilusQueryMatcher *matcher;
+    GPtrArray *hits;
+    NautilusMimeFilter *mime_filter;
+    GPtrArray *date_range;
+    NautilusQuerySearchType search_type;
+} RefineData;
+
+static void
+refine_data_free (RefineData *data)
+{
+    nautilus_query_matcher_unref (data->matcher);
+    g_ptr_array_unref (data->hits);
+    g_clear_pointer (&data->mime_filter, nautilus_mime_filter_unref);
+    g_clear_pointer (&data->date_range, g_ptr_array_unref);
+
+    g_free (data);
+}
+
+static gboolean
+refine_data_matches_info (RefineData *data,
+                          GFileInfo  *info)
+{
+    guint64 time;
+
+    if (data->mime_filter != NULL &&
+        !nautilus_mime_filter_matches (data->mime_filter, g_file_info_get_content_type (info)))
+    {
+        return FALSE;
+    }
+
+    if (data->date_range != NULL)
+    {
+        time = g_file_info_get_attribute_uint64 (info,
+                                                 data->search_type == NAUTILUS_QUERY_SEARCH_TYPE_LAST_ACCESS ?
+                                                 G_FILE_ATTRIBUTE_TIME_ACCESS :
+                                                 G_FILE_ATTRIBUTE_TIME_MODIFIED);
+        if (!nautilus_file_date_in_between (time,
+                                            g_ptr_array_index (data->date_range, 0),
+                                            g_ptr_array_index (data->date_range, 1)))
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+static void
+free_hits (gpointer hits)
+{
+    g_list_free_full (hits, g_object_unref);
+}
+
+/* Filters the hits of the last search for the narrower query. Names are
+ * matched first, only the hits left are looked at on disk, if the query
+ * has types or dates.
+ */
+static void
+refine_thread (GTask        *task,
+               gpointer      source_object,
+               gpointer      task_data,
+               GCancellable *cancellable)
+{
+    RefineData *data;
+    NautilusSearchHit *hit;
+    GFileInfo *info;
+    GFile *file;
+    GList *hits;
+    char *basename, *display_name;
+    gdouble rank;
+    guint i;
+
+    data = task_data;
+    hits = NULL;
+
+    for (i = 0; i < data->hits->len && !g_cancellable_is_cancelled (cancellable); i++)
+    {
+        hit = g_ptr_array_index (data->hits, i);
+        file = nautilus_search_hit_get_location (hit);
+
+        basename = g_file_get_basename (file);
+        display_name = g_filename_display_name (basename);
+        rank = nautilus_query_matcher_match (data->matcher, display_name);
+        g_free (display_name);
+        g_free (basename);
+
+        if (rank > -1 && (data->mime_filter != NULL || data->date_range != NULL))
+        {
+            info = g_file_query_info (file, REFINE_ATTRIBUTES,
+                                      G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                      cancellable, NULL);
+            if (info == NULL || !refine_data_matches_info (data, info))
+            {
+                rank = -1;
+            }
+            g_clear_object (&info);
+        }
+
+        /* The hits of the last search may still be shown, and are
+         * only read here, so the new ranks go to copies.
+         */
+        if (rank > -1)
+        {
+            hit = nautilus_search_hit_copy (hit);
+            nautilus_search_hit_set_fts_rank (hit, rank);
+            hits = g_list_prepend (hits, hit);
+        }
+    }
+
+    g_task_return_pointer (task, g_list_reverse (hits), free_hits);
+}
+
+static void
+on_refine_finished (GObject      *source_object,
+                    GAsyncResult *result,
+                    gpointer      user_data)
+{
+    NautilusSearchEngine *engine;
+    NautilusSearchEnginePrivate *priv;
+    GList *hits;
+
+    engine = NAUTILUS_SEARCH_ENGINE (source_object);
+    priv = nautilus_search_engine_get_instance_private (engine);
+
+    DEBUG ("Search engine refinement finished");
+
+    /* Stopping ignores the hits, like it does for the providers. */
+    hits = g_task_propagate_pointer (G_TASK (result), NULL);
+    if (hits != NULL)
+    {
+        search_provider_hits_added (NAUTILUS_SEARCH_PROVIDER (engine), hits, engine);
+        g_list_free_full (hits, g_object_unref);
+    }
+
+    priv->providers_finished++;
+    check_providers_status (engine);
+}
+
+/* Returns TRUE if the hits of the last search can be filtered for the
+ * current one, instead of searching again.
+ */
+static gboolean
+start_refinement (NautilusSearchEngine *engine)
+{
+    NautilusSearchEnginePrivate *priv;
+    RefineData *data;
+    GList *mime_types;
+    GTask *task;
+
+    priv = nautilus_search_engine_get_instance_private (engine);
+
+    if (priv->last_query == NULL ||
+        g_get_monotonic_time () - priv->last_search_time > MAX_REFINEMENT_AGE ||
+        !nautilus_query_is_refinement_of (priv->searched_query, priv->last_query))
+    {
+        return FALSE;
+    }
+
+    DEBUG ("Search engine refining %u hits", priv->last_hits->len);
+
+    data = g_new0 (RefineData, 1);
+    data->matcher = nautilus_query_get_matcher (priv->searched_query);
+    data->hits = g_ptr_array_ref (priv->last_hits);
+    mime_types = nautilus_query_get_mime_types (priv->searched_query);
+    data->mime_filter = nautilus_mime_filter_new (mime_types);
+    g_list_free_full (mime_types, g_free);
+    data->date_range = nautilus_query_get_date_range (priv->searched_query);
+    data->search_type = nautilus_query_get_search_type (priv->searched_query);
+
+    g_clear_object (&priv->refine_cancellable);
+    priv->refine_cancellable = g_cancellable_new ();
+
+    task = g_task_new (engine, priv->refine_cancellable, on_refine_finished, NULL);
+    g_task_set_task_data (task, data, (GDestroyNotify) refine_data_free);
+    g_task_run_in_thread (task, refine_thread);
+    g_object_unref (task);
+
+    return TRUE;
 }
 
 static void
 search_engine_start_real (NautilusSearchEngine *engine)
 {
     NautilusSearchEnginePrivate *priv;
+    NautilusQuery *simple_query;
+    GList *uncovered_locations;
+    gboolean index_covers_query;
 
     priv = nautilus_search_engine_get_instance_private (engine);
 
@@ -95,6 +316,18 @@ search_engine_start_real (NautilusSearchEngine *engine)
 
     g_object_ref (engine);
 
+    /* The query can change while it is searched for. */
+    g_clear_object (&priv->searched_query);
+    priv->searched_query = nautilus_query_copy (priv->query);
+    g_ptr_array_set_size (priv->hits, 0);
+
+    priv->refining = start_refinement (engine);
+    if (priv->refining)
+    {
+        priv->providers_running++;
+        return;
+    }
+
     priv->providers_running++;
     nautilus_search_provider_start (NAUTILUS_SEARCH_PROVIDER (priv->tracker));
 
@@ -104,8 +337,31 @@ search_engine_start_real (NautilusSearchEngine *engine)
         nautilus_search_provider_start (NAUTILUS_SEARCH_PROVIDER (priv->model));
     }
 
+    /* No need to crawl the file system where the index has it all. */
+    index_covers_query = nautilus_search_engine_index_covers_query (priv->index);
+    uncovered_locations = nautilus_search_engine_index_get_uncovered_locations (priv->index);
+
     priv->providers_running++;
-    nautilus_search_provider_start (NAUTILUS_SEARCH_PROVIDER (priv->simple));
+    nautilus_search_provider_start (NAUTILUS_SEARCH_PROVIDER (priv->index));
+
+    if (!index_covers_query)
+    {
+        nautilus_search_provider_set_query (NAUTILUS_SEARCH_PROVIDER (priv->simple), priv->query);
+        priv->providers_running++;
+        nautilus_search_provider_start (NAUTILUS_SEARCH_PROVIDER (priv->simple));
+    }
+    else if (uncovered_locations != NULL)
+    {
+        simple_query = nautilus_query_copy (priv->query);
+        nautilus_query_set_locations (simple_query, uncovered_locations);
+        nautilus_search_provider_set_query (NAUTILUS_SEARCH_PROVIDER (priv->simple), simple_query);
+        g_object_unref (simple_query);
+
+        priv->providers_running++;
+        nautilus_search_provider_start (NAUTILUS_SEARCH_PROVIDER (priv->simple));
+    }
+
+    g_list_free_full (uncovered_locations, g_object_unref);
 }
 
 static void
@@ -161,6 +417,8 @@ nautilus_search_engine_stop (NautilusSearchProvider *provider)
     nautilus_search_provider_stop (NAUTILUS_SEARCH_PROVIDER (priv->tracker));
     nautilus_search_provider_stop (NAUTILUS_SEARCH_PROVIDER (priv->model));
     nautilus_search_provider_stop (NAUTILUS_SEARCH_PROVIDER (priv->simple));
+    nautilus_search_provider_stop (NAUTILUS_SEARCH_PROVIDER (priv->index));
+    g_cancellable_cancel (priv->refine_cancellable);
 
     priv->running = FALSE;
     priv->restart = FALSE;
@@ -189,16 +447,15 @@ search_provider_hits_added (NautilusSearchProvider *provider,
     for (l = hits; l != NULL; l = l->next)
     {
         NautilusSearchHit *hit = l->data;
-        int count;
-        const char *uri;
+        GFile *location;
 
-        uri = nautilus_search_hit_get_uri (hit);
-        count = GPOINTER_TO_INT (g_hash_table_lookup (priv->uris, uri));
-        if (count == 0)
+        location = nautilus_search_hit_get_location (hit);
+        if (!g_hash_table_contains (priv->locations, location))
         {
+            g_hash_table_add (priv->locations, g_object_ref (location));
             added = g_list_prepend (added, hit);
+            g_ptr_array_add (priv->hits, g_object_ref (hit));
         }
-        g_hash_table_replace (priv->uris, g_strdup (uri), GINT_TO_POINTER (++count));
     }
     if (added != NULL)
     {
@@ -238,6 +495,24 @@ check_providers_status (NautilusSearchEngine *engine)
         {
             DEBUG ("Search engine finished");
         }
+
+        /* Keep what a search found unless it was stopped. The crawling
+         * providers don't fail, so the hits are complete even when
+         * Tracker did.
+         */
+        g_clear_object (&priv->last_query);
+        g_clear_pointer (&priv->last_hits, g_ptr_array_unref);
+        if (priv->running && !priv->restart)
+        {
+            priv->last_query = g_steal_pointer (&priv->searched_query);
+            priv->last_hits = g_steal_pointer (&priv->hits);
+            if (!priv->refining)
+            {
+                priv->last_search_time = g_get_monotonic_time ();
+            }
+            priv->hits = g_ptr_array_new_with_free_func (g_object_unref);
+        }
+
         nautilus_search_provider_finished (NAUTILUS_SEARCH_PROVIDER (engine),
                                            priv->restart ? NAUTILUS_SEARCH_PROVIDER_STATUS_RESTARTING :
                                            NAUTILUS_SEARCH_PROVIDER_STATUS_NORMAL);
@@ -246,7 +521,7 @@ check_providers_status (NautilusSearchEngine *engine)
     priv->running = FALSE;
     g_object_notify (G_OBJECT (engine), "running");
 
-    g_hash_table_remove_all (priv->uris);
+    g_hash_table_remove_all (priv->locations);
 
     if (priv->restart)
     {
@@ -331,11 +606,18 @@ nautilus_search_engine_finalize (GObject *object)
     engine = NAUTILUS_SEARCH_ENGINE (object);
     priv = nautilus_search_engine_get_instance_private (engine);
 
-    g_hash_table_destroy (priv->uris);
+    g_hash_table_destroy (priv->locations);
+    g_clear_object (&priv->query);
+    g_clear_object (&priv->searched_query);
+    g_clear_object (&priv->last_query);
+    g_ptr_array_unref (priv->hits);
+    g_clear_pointer (&priv->last_hits, g_ptr_array_unref);
+    g_clear_object (&priv->refine_cancellable);
 
     g_clear_object (&priv->tracker);
     g_clear_object (&priv->model);
     g_clear_object (&priv->simple);
+    g_clear_object (&priv->index);
 
     G_OBJECT_CLASS (nautilus_search_engine_parent_class)->finalize (object);
 }
@@ -385,7 +667,9 @@ nautilus_search_engine_init (NautilusSearchEngine *engine)
     NautilusSearchEnginePrivate *priv;
 
     priv = nautilus_search_engine_get_instance_private (engine);
-    priv->uris = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    priv->locations = g_hash_table_new_full (g_file_hash, (GEqualFunc) g_file_equal,
+                                             g_object_unref, NULL);
+    priv->hits = g_ptr_array_new_with_free_func (g_object_unref);
 
     priv->tracker = nautilus_search_engine_tracker_new ();
     connect_provider_signals (engine, NAUTILUS_SEARCH_PROVIDER (priv->tracker));
@@ -395,6 +679,9 @@ nautilus_search_engine_init (NautilusSearchEngine *engine)
 
     priv->simple = nautilus_search_engine_simple_new ();
     connect_provider_signals (engine, NAUTILUS_SEARCH_PROVIDER (priv->simple));
+
+    priv->index = nautilus_search_engine_index_new ();
+    connect_provider_signals (engine, NAUTILUS_SEARCH_PROVIDER (priv->index));
 }
 
 NautilusSearchEngine *
@@ -0,0 +1,199 @@
+/*
+ *  nautilus-search-hit-batcher.c: Delivery of search hits to the main loop.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 2 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* The batcher is a main loop source that is only ready when it has
+ * something to send. Adding the first hit of a batch sets its ready
+ * time, to now for the first batch, and to the end of the delay after
+ * the last batch otherwise. Hits added before it is dispatched go in
+ * the same batch, so a slow main loop gets bigger batches instead of
+ * more of them. It runs at idle priority, after drawing and input.
+ *
+ * Threads adding hits wait while MAX_PENDING_HITS are waiting to be
+ * sent, so a search can't get far ahead of a busy main loop.
+ */
+
+#include <config.h>
+#include "nautilus-search-hit-batcher.h"
+
+#define DEBUG_FLAG NAUTILUS_DEBUG_SEARCH
+#include "nautilus-debug.h"
+
+/* How often hits are sent, at most. */
+#define HIT_LATENCY (100 * G_TIME_SPAN_MILLISECOND)
+/* The main loop spends at most a third of its time on the hits. */
+#define HANDLING_TIME_FACTOR 2
+/* How many hits can wait to be sent before adding more blocks. */
+#define MAX_PENDING_HITS 5000
+
+struct NautilusSearchHitBatcher
+{
+    GSource source;
+
+    NautilusSearchProvider *provider;
+    GCancellable *cancellable;
+    NautilusSearchHitBatcherDoneFunc done_func;
+    gpointer user_data;
+
+    GMutex mutex;
+    GCond hits_taken;
+    GList *hits;                /* newest first */
+    guint n_hits;
+    gboolean scheduled;
+    gboolean finished;
+    gint64 next_batch_time;
+};
+
+static gboolean
+batcher_dispatch (GSource     *source,
+                  GSourceFunc  callback,
+                  gpointer     user_data)
+{
+    NautilusSearchHitBatcher *batcher;
+    GList *hits;
+    gboolean finished;
+    gint64 start, handling_time;
+
+    batcher = (NautilusSearchHitBatcher *) source;
+
+    g_mutex_lock (&batcher->mutex);
+    hits = g_list_reverse (batcher->hits);
+    batcher->hits = NULL;
+    batcher->n_hits = 0;
+    batcher->scheduled = FALSE;
+    finished = batcher->finished;
+    g_source_set_ready_time (source, -1);
+    g_cond_broadcast (&batcher->hits_taken);
+    g_mutex_unlock (&batcher->mutex);
+
+    if (hits != NULL && !g_cancellable_is_cancelled (batcher->cancellable))
+    {
+        DEBUG ("Sending %u hits", g_list_length (hits));
+
+        start = g_get_monotonic_time ();
+        nautilus_search_provider_hits_added (batcher->provider, hits);
+        handling_time = g_get_monotonic_time () - start;
+
+        g_mutex_lock (&batcher->mutex);
+        batcher->next_batch_time = g_get_monotonic_time () +
+                                   MAX (HIT_LATENCY, HANDLING_TIME_FACTOR * handling_time);
+        g_mutex_unlock (&batcher->mutex);
+    }
+    g_list_free_full (hits, g_object_unref);
+
+    if (finished)
+    {
+        batcher->done_func (batcher->user_data);
+        return G_SOURCE_REMOVE;
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+static void
+batcher_finalize (GSource *source)
+{
+    NautilusSearchHitBatcher *batcher;
+
+    batcher = (NautilusSearchHitBatcher *) source;
+
+    g_list_free_full (batcher->hits, g_object_unref);
+    g_mutex_clear (&batcher->mutex);
+    g_cond_clear (&batcher->hits_taken);
+    g_clear_object (&batcher->cancellable);
+    g_object_unref (batcher->provider);
+}
+
+static GSourceFuncs batcher_funcs =
+{
+    NULL,
+    NULL,
+    batcher_dispatch,
+    batcher_finalize
+};
+
+NautilusSearchHitBatcher *
+nautilus_search_hit_batcher_new (NautilusSearchProvider           *provider,
+                                 GCancellable                     *cancellable,
+                                 NautilusSearchHitBatcherDoneFunc  done_func,
+                                 gpointer                          user_data)
+{
+    NautilusSearchHitBatcher *batcher;
+    GSource *source;
+
+    g_return_val_if_fail (NAUTILUS_IS_SEARCH_PROVIDER (provider), NULL);
+    g_return_val_if_fail (done_func != NULL, NULL);
+
+    source = g_source_new (&batcher_funcs, sizeof (NautilusSearchHitBatcher));
+    batcher = (NautilusSearchHitBatcher *) source;
+
+    batcher->provider = g_object_ref (provider);
+    batcher->cancellable = cancellable != NULL ? g_object_ref (cancellable) : NULL;
+    batcher->done_func = done_func;
+    batcher->user_data = user_data;
+    g_mutex_init (&batcher->mutex);
+    g_cond_init (&batcher->hits_taken);
+
+    g_source_set_name (source, "[nautilus] search hits");
+    g_source_set_priority (source, G_PRIORITY_DEFAULT_IDLE);
+    g_source_attach (source, NULL);
+    /* The main context keeps it until it is done. */
+    g_source_unref (source);
+
+    return batcher;
+}
+
+void
+nautilus_search_hit_batcher_add (NautilusSearchHitBatcher *batcher,
+                                 NautilusSearchHit        *hit)
+{
+    gint64 end_time;
+
+    g_mutex_lock (&batcher->mutex);
+
+    /* Wait for the main loop to take the hits, unless this is the main
+     * loop. Cancelling doesn't wake the wait, so check every now and then.
+     */
+    while (batcher->n_hits >= MAX_PENDING_HITS &&
+           !g_cancellable_is_cancelled (batcher->cancellable) &&
+           !g_main_context_is_owner (g_source_get_context (&batcher->source)))
+    {
+        end_time = g_get_monotonic_time () + HIT_LATENCY;
+        g_cond_wait_until (&batcher->hits_taken, &batcher->mutex, end_time);
+    }
+
+    batcher->hits = g_list_prepend (batcher->hits, hit);
+    batcher->n_hits++;
+    if (!batcher->scheduled)
+    {
+        batcher->scheduled = TRUE;
+        g_source_set_ready_time (&batcher->source, batcher->next_batch_time);
+    }
+
+    g_mutex_unlock (&batcher->mutex);
+}
+
+void
+nautilus_search_hit_batcher_finish (NautilusSearchHitBatcher *batcher)
+{
+    g_mutex_lock (&batcher->mutex);
+
+    batcher->finished = TRUE;
+    batcher->scheduled = TRUE;
+    g_source_set_ready_time (&batcher->source, 0);
+
+    g_mutex_unlock (&batcher->mutex);
+}
@@ -0,0 +1,50 @@
+/*
+   nautilus-search-hit-batcher.h: Delivery of search hits to the main loop.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef NAUTILUS_SEARCH_HIT_BATCHER_H
+#define NAUTILUS_SEARCH_HIT_BATCHER_H
+
+#include <gio/gio.h>
+
+#include "nautilus-search-provider.h"
+
+/* Sends the hits a search finds to its provider in the main loop, in
+ * batches: the first hit right away, the next ones on a latency
+ * target, and less often when handling them keeps the main loop busy.
+ * A batch is never sent before the last one was handled.
+ *
+ * Hits can be added from any thread. Adding blocks while too many hits
+ * are waiting to be sent, except on the main loop. Once the search is
+ * finished, the hits left are sent, done_func is called in the main
+ * loop and the batcher frees itself. Hits are dropped once cancellable
+ * is cancelled.
+ */
+typedef struct NautilusSearchHitBatcher NautilusSearchHitBatcher;
+
+typedef void (* NautilusSearchHitBatcherDoneFunc) (gpointer user_data);
+
+NautilusSearchHitBatcher *nautilus_search_hit_batcher_new    (NautilusSearchProvider           *provider,
+                                                              GCancellable                     *cancellable,
+                                                              NautilusSearchHitBatcherDoneFunc  done_func,
+                                                              gpointer                          user_data);
+/* Takes the reference to hit. */
+void                      nautilus_search_hit_batcher_add    (NautilusSearchHitBatcher         *batcher,
+                                                              NautilusSearchHit                *hit);
+/* The batcher can't be used after this. */
+void                      nautilus_search_hit_batcher_finish (NautilusSearchHitBatcher         *batcher);
+
+#endif /* NAUTILUS_SEARCH_HIT_BATCHER_H */
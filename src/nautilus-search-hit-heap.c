@@ -0,0 +1,230 @@
+/*
+ *  nautilus-search-hit-heap.c: The most relevant hits of a search.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 2 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* A binary min-heap on relevance, so the least relevant hit kept is at
+ * the top and a new hit only has to beat it to get in. Adding a hit is
+ * O(log max_hits) and one that doesn't get in costs a comparison.
+ */
+
+#include <config.h>
+#include "nautilus-search-hit-heap.h"
+
+struct NautilusSearchHitHeap
+{
+    guint max_hits;
+    GPtrArray *hits;            /* the heap */
+    GHashTable *locations;      /* locations of the hits kept */
+};
+
+static inline gdouble
+relevance_at (NautilusSearchHitHeap *heap,
+              guint                  i)
+{
+    return nautilus_search_hit_get_relevance (g_ptr_array_index (heap->hits, i));
+}
+
+static inline void
+swap (NautilusSearchHitHeap *heap,
+      guint                  i,
+      guint                  j)
+{
+    gpointer hit;
+
+    hit = heap->hits->pdata[i];
+    heap->hits->pdata[i] = heap->hits->pdata[j];
+    heap->hits->pdata[j] = hit;
+}
+
+static void
+sift_up (NautilusSearchHitHeap *heap,
+         guint                  i)
+{
+    guint parent;
+
+    while (i > 0)
+    {
+        parent = (i - 1) / 2;
+        if (relevance_at (heap, parent) <= relevance_at (heap, i))
+        {
+            break;
+        }
+        swap (heap, i, parent);
+        i = parent;
+    }
+}
+
+static void
+sift_down (NautilusSearchHitHeap *heap,
+           guint                  i)
+{
+    guint child, smallest;
+
+    for (;;)
+    {
+        smallest = i;
+        for (child = 2 * i + 1; child <= 2 * i + 2 && child < heap->hits->len; child++)
+        {
+            if (relevance_at (heap, child) < relevance_at (heap, smallest))
+            {
+                smallest = child;
+            }
+        }
+        if (smallest == i)
+        {
+            break;
+        }
+        swap (heap, i, smallest);
+        i = smallest;
+    }
+}
+
+/* Replaces the hit at i with the last one. */
+static void
+remove_at (NautilusSearchHitHeap *heap,
+           guint                  i)
+{
+    NautilusSearchHit *hit;
+
+    hit = g_ptr_array_index (heap->hits, i);
+    g_hash_table_remove (heap->locations, nautilus_search_hit_get_location (hit));
+
+    g_ptr_array_remove_index_fast (heap->hits, i);
+    if (i < heap->hits->len)
+    {
+        sift_down (heap, i);
+        sift_up (heap, i);
+    }
+}
+
+NautilusSearchHitHeap *
+nautilus_search_hit_heap_new (guint max_hits)
+{
+    NautilusSearchHitHeap *heap;
+
+    g_return_val_if_fail (max_hits > 0, NULL);
+
+    heap = g_new0 (NautilusSearchHitHeap, 1);
+    heap->max_hits = max_hits;
+    heap->hits = g_ptr_array_new_full (max_hits, g_object_unref);
+    heap->locations = g_hash_table_new (g_file_hash, (GEqualFunc) g_file_equal);
+
+    return heap;
+}
+
+void
+nautilus_search_hit_heap_free (NautilusSearchHitHeap *heap)
+{
+    if (heap == NULL)
+    {
+        return;
+    }
+
+    /* The hits own the locations. */
+    g_hash_table_destroy (heap->locations);
+    g_ptr_array_unref (heap->hits);
+    g_free (heap);
+}
+
+void
+nautilus_search_hit_heap_add (NautilusSearchHitHeap *heap,
+                              NautilusSearchHit     *hit)
+{
+    NautilusSearchHit *kept;
+    GFile *location;
+    gdouble relevance;
+    guint i;
+
+    g_return_if_fail (heap != NULL);
+    g_return_if_fail (NAUTILUS_IS_SEARCH_HIT (hit));
+
+    relevance = nautilus_search_hit_get_relevance (hit);
+    if (heap->hits->len == heap->max_hits && relevance <= relevance_at (heap, 0))
+    {
+        return;
+    }
+
+    location = nautilus_search_hit_get_location (hit);
+    kept = g_hash_table_lookup (heap->locations, location);
+    if (kept != NULL)
+    {
+        if (nautilus_search_hit_get_relevance (kept) >= relevance)
+        {
+            return;
+        }
+
+        /* There are few hits kept, so just look for it. */
+        for (i = 0; g_ptr_array_index (heap->hits, i) != kept; i++)
+        {
+        }
+        remove_at (heap, i);
+    }
+    else if (heap->hits->len == heap->max_hits)
+    {
+        remove_at (heap, 0);
+    }
+
+    g_ptr_array_add (heap->hits, g_object_ref (hit));
+    g_hash_table_insert (heap->locations, location, hit);
+    sift_up (heap, heap->hits->len - 1);
+}
+
+guint
+nautilus_search_hit_heap_get_size (NautilusSearchHitHeap *heap)
+{
+    g_return_val_if_fail (heap != NULL, 0);
+
+    return heap->hits->len;
+}
+
+static gint
+compare_relevance (gconstpointer a,
+                   gconstpointer b)
+{
+    gdouble relevance_a, relevance_b;
+
+    relevance_a = nautilus_search_hit_get_relevance (*(NautilusSearchHit **) a);
+    relevance_b = nautilus_search_hit_get_relevance (*(NautilusSearchHit **) b);
+
+    if (relevance_a > relevance_b)
+    {
+        return -1;
+    }
+    else if (relevance_a == relevance_b)
+    {
+        return 0;
+    }
+
+    return 1;
+}
+
+GPtrArray *
+nautilus_search_hit_heap_get_sorted (NautilusSearchHitHeap *heap)
+{
+    GPtrArray *hits;
+    guint i;
+
+    g_return_val_if_fail (heap != NULL, NULL);
+
+    hits = g_ptr_array_new_full (heap->hits->len, g_object_unref);
+    for (i = 0; i < heap->hits->len; i++)
+    {
+        g_ptr_array_add (hits, g_object_ref (g_ptr_array_index (heap->hits, i)));
+    }
+    g_ptr_array_sort (hits, compare_relevance);
+
+    return hits;
+}
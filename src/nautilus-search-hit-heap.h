@@ -0,0 +1,41 @@
+/*
+   nautilus-search-hit-heap.h: The most relevant hits of a search.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef NAUTILUS_SEARCH_HIT_HEAP_H
+#define NAUTILUS_SEARCH_HIT_HEAP_H
+
+#include <glib.h>
+
+#include "nautilus-search-hit.h"
+
+/* Keeps the max_hits most relevant hits added to it, as they come, so
+ * the best results of a search are known at any time without sorting
+ * all of them. Hits must have their scores computed before they are
+ * added. Of hits with the same location, the most relevant is kept.
+ */
+typedef struct NautilusSearchHitHeap NautilusSearchHitHeap;
+
+NautilusSearchHitHeap *nautilus_search_hit_heap_new        (guint                  max_hits);
+void                   nautilus_search_hit_heap_free       (NautilusSearchHitHeap *heap);
+
+void                   nautilus_search_hit_heap_add        (NautilusSearchHitHeap *heap,
+                                                            NautilusSearchHit     *hit);
+guint                  nautilus_search_hit_heap_get_size   (NautilusSearchHitHeap *heap);
+/* Returns the hits kept, the most relevant first. */
+GPtrArray *            nautilus_search_hit_heap_get_sorted (NautilusSearchHitHeap *heap);
+
+#endif /* NAUTILUS_SEARCH_HIT_HEAP_H */
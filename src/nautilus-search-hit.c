@@ -31,7 +31,8 @@ struct _NautilusSearchHit
 {
     GObject parent_instance;
 
-    char *uri;
+    GFile *location;
+    char *uri;                  /* only built when asked for */
 
     GDateTime *modification_time;
     GDateTime *access_time;
@@ -44,6 +45,7 @@ struct _NautilusSearchHit
 enum
 {
     PROP_URI = 1,
+    PROP_LOCATION,
     PROP_RELEVANCE,
     PROP_MODIFICATION_TIME,
     PROP_ACCESS_TIME,
@@ -60,7 +62,7 @@ nautilus_search_hit_compute_scores (NautilusSearchHit *hit,
 {
     GDateTime *now;
     GFile *query_location;
-    GFile *hit_location;
+    char *relative_path, *p;
     GTimeSpan m_diff = G_MAXINT64;
     GTimeSpan a_diff = G_MAXINT64;
     GTimeSpan t_diff = G_MAXINT64;
@@ -69,30 +71,24 @@ nautilus_search_hit_compute_scores (NautilusSearchHit *hit,
     gdouble match_bonus = 0.0;
 
     query_location = nautilus_query_get_location (query);
-    hit_location = g_file_new_for_uri (hit->uri);
 
-    if (g_file_has_prefix (hit_location, query_location))
+    /* The number of directories between the hit and the query location. */
+    relative_path = g_file_get_relative_path (query_location, hit->location);
+    if (relative_path != NULL)
     {
-        GFile *parent, *location;
         guint dir_count = 0;
 
-        parent = g_file_get_parent (hit_location);
-
-        while (!g_file_equal (parent, query_location))
+        for (p = strchr (relative_path, G_DIR_SEPARATOR); p != NULL; p = strchr (p + 1, G_DIR_SEPARATOR))
         {
             dir_count++;
-            location = parent;
-            parent = g_file_get_parent (location);
-            g_object_unref (location);
         }
-        g_object_unref (parent);
+        g_free (relative_path);
 
         if (dir_count < 10)
         {
             proximity_bonus = 10000.0 - 1000.0 * dir_count;
         }
     }
-    g_object_unref (hit_location);
 
     now = g_date_time_new_now_local ();
     if (hit->modification_time != NULL)
@@ -141,8 +137,13 @@ nautilus_search_hit_compute_scores (NautilusSearchHit *hit,
     }
 
     hit->relevance = recent_bonus + proximity_bonus + match_bonus;
-    DEBUG ("Hit %s computed relevance %.2f (%.2f + %.2f + %.2f)", hit->uri, hit->relevance,
-           proximity_bonus, recent_bonus, match_bonus);
+    /* Don't build the URI of every hit just to throw it away. */
+    if (DEBUGGING)
+    {
+        DEBUG ("Hit %s computed relevance %.2f (%.2f + %.2f + %.2f)",
+               nautilus_search_hit_get_uri (hit), hit->relevance,
+               proximity_bonus, recent_bonus, match_bonus);
+    }
 
     g_date_time_unref (now);
     g_object_unref (query_location);
@@ -151,9 +152,29 @@ nautilus_search_hit_compute_scores (NautilusSearchHit *hit,
 const char *
 nautilus_search_hit_get_uri (NautilusSearchHit *hit)
 {
+    char *uri;
+
+    /* Hits are read from the refining thread too, so whoever builds
+     * the URI first gets to keep it.
+     */
+    if (g_atomic_pointer_get (&hit->uri) == NULL)
+    {
+        uri = g_file_get_uri (hit->location);
+        if (!g_atomic_pointer_compare_and_exchange (&hit->uri, NULL, uri))
+        {
+            g_free (uri);
+        }
+    }
+
     return hit->uri;
 }
 
+GFile *
+nautilus_search_hit_get_location (NautilusSearchHit *hit)
+{
+    return hit->location;
+}
+
 gdouble
 nautilus_search_hit_get_relevance (NautilusSearchHit *hit)
 {
@@ -170,8 +191,26 @@ static void
 nautilus_search_hit_set_uri (NautilusSearchHit *hit,
                              const char        *uri)
 {
-    g_free (hit->uri);
-    hit->uri = g_strdup (uri);
+    /* Construct only, and unset when the hit is made from a location. */
+    if (uri != NULL)
+    {
+        g_clear_object (&hit->location);
+        hit->location = g_file_new_for_uri (uri);
+        g_free (hit->uri);
+        hit->uri = g_strdup (uri);
+    }
+}
+
+static void
+nautilus_search_hit_set_location (NautilusSearchHit *hit,
+                                  GFile             *location)
+{
+    if (location != NULL)
+    {
+        g_clear_object (&hit->location);
+        hit->location = g_object_ref (location);
+        g_clear_pointer (&hit->uri, g_free);
+    }
 }
 
 void
@@ -256,6 +295,12 @@ nautilus_search_hit_set_property (GObject      *object,
         }
         break;
 
+        case PROP_LOCATION:
+        {
+            nautilus_search_hit_set_location (hit, g_value_get_object (value));
+        }
+        break;
+
         case PROP_MODIFICATION_TIME:
         {
             nautilus_search_hit_set_modification_time (hit, g_value_get_boxed (value));
@@ -309,7 +354,13 @@ nautilus_search_hit_get_property (GObject    *object,
 
         case PROP_URI:
         {
-            g_value_set_string (value, hit->uri);
+            g_value_set_string (value, nautilus_search_hit_get_uri (hit));
+        }
+        break;
+
+        case PROP_LOCATION:
+        {
+            g_value_set_object (value, hit->location);
         }
         break;
 
@@ -344,6 +395,7 @@ nautilus_search_hit_finalize (GObject *object)
 {
     NautilusSearchHit *hit = NAUTILUS_SEARCH_HIT (object);
 
+    g_clear_object (&hit->location);
     g_free (hit->uri);
 
     if (hit->access_time != NULL)
@@ -378,6 +430,13 @@ nautilus_search_hit_class_init (NautilusSearchHitClass *class)
                                                           "URI",
                                                           NULL,
                                                           G_PARAM_CONSTRUCT_ONLY | G_PARAM_WRITABLE | G_PARAM_READABLE));
+    g_object_class_install_property (object_class,
+                                     PROP_LOCATION,
+                                     g_param_spec_object ("location",
+                                                          "Location",
+                                                          "Location",
+                                                          G_TYPE_FILE,
+                                                          G_PARAM_CONSTRUCT_ONLY | G_PARAM_WRITABLE | G_PARAM_READABLE));
     g_object_class_install_property (object_class,
                                      PROP_MODIFICATION_TIME,
                                      g_param_spec_boxed ("modification-time",
@@ -436,3 +495,30 @@ nautilus_search_hit_new (const char *uri)
 
     return hit;
 }
+
+NautilusSearchHit *
+nautilus_search_hit_new_for_location (GFile *location)
+{
+    NautilusSearchHit *hit;
+
+    hit = g_object_new (NAUTILUS_TYPE_SEARCH_HIT,
+                        "location", location,
+                        NULL);
+
+    return hit;
+}
+
+NautilusSearchHit *
+nautilus_search_hit_copy (NautilusSearchHit *hit)
+{
+    NautilusSearchHit *copy;
+
+    g_return_val_if_fail (NAUTILUS_IS_SEARCH_HIT (hit), NULL);
+
+    copy = nautilus_search_hit_new_for_location (hit->location);
+    nautilus_search_hit_set_modification_time (copy, hit->modification_time);
+    nautilus_search_hit_set_access_time (copy, hit->access_time);
+    nautilus_search_hit_set_fts_snippet (copy, hit->fts_snippet);
+
+    return copy;
+}
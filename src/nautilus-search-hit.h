@@ -20,7 +20,7 @@
 #ifndef NAUTILUS_SEARCH_HIT_H
 #define NAUTILUS_SEARCH_HIT_H
 
-#include <glib-object.h>
+#include <gio/gio.h>
 #include "nautilus-query.h"
 
 G_BEGIN_DECLS
@@ -30,6 +30,10 @@ G_BEGIN_DECLS
 G_DECLARE_FINAL_TYPE (NautilusSearchHit, nautilus_search_hit, NAUTILUS, SEARCH_HIT, GObject);
 
 NautilusSearchHit * nautilus_search_hit_new                   (const char        *uri);
+/* Saves building and parsing the URI when the location is at hand. */
+NautilusSearchHit * nautilus_search_hit_new_for_location      (GFile             *location);
+/* Copies what the providers found, but not the rank and scores. */
+NautilusSearchHit * nautilus_search_hit_copy                  (NautilusSearchHit *hit);
 
 void                nautilus_search_hit_set_fts_rank          (NautilusSearchHit *hit,
 							       gdouble            fts_rank);
@@ -43,6 +47,7 @@ void                nautilus_search_hit_compute_scores        (NautilusSearchHit
 							       NautilusQuery     *query);
 
 const char *        nautilus_search_hit_get_uri               (NautilusSearchHit *hit);
+GFile *             nautilus_search_hit_get_location          (NautilusSearchHit *hit);
 gdouble             nautilus_search_hit_get_relevance         (NautilusSearchHit *hit);
 const gchar *       nautilus_search_hit_get_fts_snippet       (NautilusSearchHit *hit);
 
@@ -32,6 +32,7 @@
 #include "nautilus-file-utilities.h"
 #include "nautilus-search-engine.h"
 #include "nautilus-search-provider.h"
+#include "nautilus-search-hit-heap.h"
 #include "nautilus-ui-utilities.h"
 
 #include "nautilus-application.h"
@@ -39,17 +40,28 @@
 #include "nautilus-shell-search-provider-generated.h"
 #include "nautilus-shell-search-provider.h"
 
+/* The shell only shows a few results, so only the best ones are kept
+ * while the search runs, and the metadata of the first ones is fetched
+ * before it asks for it.
+ */
+#define MAX_RESULTS 20
+#define N_PREFETCHED_METAS 5
+/* When the search takes longer, the best results so far are returned
+ * and it is stopped, nobody would see what it finds later.
+ */
+#define RESULTS_DEADLINE_MS 1500
+
 typedef struct
 {
     NautilusShellSearchProvider *self;
 
-    NautilusSearchEngine *engine;
     NautilusQuery *query;
 
-    GHashTable *hits;
+    NautilusSearchHitHeap *hits;
     GDBusMethodInvocation *invocation;
 
     gint64 start_time;
+    guint deadline_id;
 } PendingSearch;
 
 struct _NautilusShellSearchProvider
@@ -58,6 +70,10 @@ struct _NautilusShellSearchProvider
 
     NautilusShellSearchProvider2 *skeleton;
 
+    /* Shared by all searches, so one that narrows the last only filters
+     * its results.
+     */
+    NautilusSearchEngine *engine;
     PendingSearch *current_search;
 
     GHashTable *metas_cache;
@@ -116,9 +132,14 @@ get_gicon (NautilusShellSearchProvider *self,
 static void
 pending_search_free (PendingSearch *search)
 {
-    g_hash_table_destroy (search->hits);
+    g_signal_handlers_disconnect_by_data (search->self->engine, search);
+    if (search->deadline_id != 0)
+    {
+        g_source_remove (search->deadline_id);
+    }
+
+    nautilus_search_hit_heap_free (search->hits);
     g_clear_object (&search->query);
-    g_clear_object (&search->engine);
     g_clear_object (&search->invocation);
 
     g_slice_free (PendingSearch, search);
@@ -145,9 +166,20 @@ pending_search_finish (PendingSearch         *search,
 static void
 cancel_current_search (NautilusShellSearchProvider *self)
 {
-    if (self->current_search != NULL)
+    PendingSearch *search = self->current_search;
+
+    if (nautilus_search_provider_is_running (NAUTILUS_SEARCH_PROVIDER (self->engine)))
     {
-        nautilus_search_provider_stop (NAUTILUS_SEARCH_PROVIDER (self->current_search->engine));
+        nautilus_search_provider_stop (NAUTILUS_SEARCH_PROVIDER (self->engine));
+    }
+
+    if (search != NULL)
+    {
+        /* The engine goes on with the next search, so don't wait for
+         * it to finish this one.
+         */
+        pending_search_finish (search, search->invocation,
+                               g_variant_new ("(as)", NULL));
     }
 }
 
@@ -159,7 +191,6 @@ search_hits_added_cb (NautilusSearchEngine *engine,
     PendingSearch *search = user_data;
     GList *l;
     NautilusSearchHit *hit;
-    const gchar *hit_uri;
 
     g_debug ("*** Search engine hits added");
 
@@ -167,76 +198,131 @@ search_hits_added_cb (NautilusSearchEngine *engine,
     {
         hit = l->data;
         nautilus_search_hit_compute_scores (hit, search->query);
-        hit_uri = nautilus_search_hit_get_uri (hit);
-        g_debug ("    %s", hit_uri);
-
-        g_hash_table_replace (search->hits, g_strdup (hit_uri), g_object_ref (hit));
+        nautilus_search_hit_heap_add (search->hits, hit);
     }
 }
 
-static gint
-search_hit_compare_relevance (gconstpointer a,
-                              gconstpointer b)
+static void cache_result_metas (NautilusShellSearchProvider *self,
+                                GList                       *file_list);
+
+static void
+prefetch_metas_ready_cb (GList    *file_list,
+                         gpointer  user_data)
 {
-    NautilusSearchHit *hit_a, *hit_b;
-    gdouble relevance_a, relevance_b;
+    NautilusShellSearchProvider *self = user_data;
 
-    hit_a = NAUTILUS_SEARCH_HIT ((gpointer) a);
-    hit_b = NAUTILUS_SEARCH_HIT ((gpointer) b);
+    cache_result_metas (self, file_list);
+    g_object_unref (self);
+}
 
-    relevance_a = nautilus_search_hit_get_relevance (hit_a);
-    relevance_b = nautilus_search_hit_get_relevance (hit_b);
+/* Gets the metadata of the first results ready while the shell goes
+ * through the results, so asking for them doesn't wait on the disk.
+ */
+static void
+prefetch_metas (NautilusShellSearchProvider *self,
+                GPtrArray                   *hits)
+{
+    NautilusSearchHit *hit;
+    GList *files;
+    guint i;
 
-    if (relevance_a > relevance_b)
+    files = NULL;
+    for (i = 0; i < hits->len && i < N_PREFETCHED_METAS; i++)
     {
-        return -1;
+        hit = g_ptr_array_index (hits, i);
+        if (!g_hash_table_contains (self->metas_cache, nautilus_search_hit_get_uri (hit)))
+        {
+            files = g_list_prepend (files, nautilus_file_get (nautilus_search_hit_get_location (hit)));
+        }
     }
-    else if (relevance_a == relevance_b)
+
+    if (files == NULL)
     {
-        return 0;
+        return;
     }
 
-    return 1;
+    nautilus_file_list_call_when_ready (files,
+                                        NAUTILUS_FILE_ATTRIBUTES_FOR_ICON,
+                                        NULL,
+                                        prefetch_metas_ready_cb,
+                                        g_object_ref (self));
+    nautilus_file_list_free (files);
 }
 
 static void
-search_finished_cb (NautilusSearchEngine         *engine,
-                    NautilusSearchProviderStatus  status,
-                    gpointer                      user_data)
+return_results (PendingSearch *search)
 {
-    PendingSearch *search = user_data;
-    GList *hits, *l;
-    NautilusSearchHit *hit;
+    GPtrArray *hits;
     GVariantBuilder builder;
     gint64 current_time;
+    guint i;
 
     current_time = g_get_monotonic_time ();
-    g_debug ("*** Search engine search finished - time elapsed %dms",
+    g_debug ("*** Returning %u results - time elapsed %dms",
+             nautilus_search_hit_heap_get_size (search->hits),
              (gint) ((current_time - search->start_time) / 1000));
 
-    hits = g_hash_table_get_values (search->hits);
-    hits = g_list_sort (hits, search_hit_compare_relevance);
+    hits = nautilus_search_hit_heap_get_sorted (search->hits);
 
     g_variant_builder_init (&builder, G_VARIANT_TYPE ("as"));
-
-    for (l = hits; l != NULL; l = l->next)
+    for (i = 0; i < hits->len; i++)
     {
-        hit = l->data;
-        g_variant_builder_add (&builder, "s", nautilus_search_hit_get_uri (hit));
+        g_variant_builder_add (&builder, "s",
+                               nautilus_search_hit_get_uri (g_ptr_array_index (hits, i)));
     }
 
-    g_list_free (hits);
+    prefetch_metas (search->self, hits);
+    g_ptr_array_unref (hits);
+
     pending_search_finish (search, search->invocation,
                            g_variant_new ("(as)", &builder));
 }
 
+static gboolean
+search_deadline_cb (gpointer user_data)
+{
+    PendingSearch *search = user_data;
+    NautilusShellSearchProvider *self = search->self;
+
+    g_debug ("*** Search deadline reached");
+
+    search->deadline_id = 0;
+    return_results (search);
+
+    /* A stopped search isn't refined, so there is no point in going on
+     * crawling for the next terms.
+     */
+    if (nautilus_search_provider_is_running (NAUTILUS_SEARCH_PROVIDER (self->engine)))
+    {
+        nautilus_search_provider_stop (NAUTILUS_SEARCH_PROVIDER (self->engine));
+    }
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+search_finished_cb (NautilusSearchEngine         *engine,
+                    NautilusSearchProviderStatus  status,
+                    gpointer                      user_data)
+{
+    PendingSearch *search = user_data;
+
+    /* The end of a cancelled search, the engine goes on with this one. */
+    if (status == NAUTILUS_SEARCH_PROVIDER_STATUS_RESTARTING)
+    {
+        return;
+    }
+
+    g_debug ("*** Search engine search finished");
+    return_results (search);
+}
+
 static void
 search_error_cb (NautilusSearchEngine *engine,
                  const gchar          *error_message,
                  gpointer              user_data)
 {
-    NautilusShellSearchProvider *self = user_data;
-    PendingSearch *search = self->current_search;
+    PendingSearch *search = user_data;
 
     g_debug ("*** Search engine search error");
     pending_search_finish (search, search->invocation,
@@ -419,7 +505,8 @@ search_add_volumes_and_bookmarks (PendingSearch *search)
             hit = nautilus_search_hit_new (candidate->uri);
             nautilus_search_hit_set_fts_rank (hit, match);
             nautilus_search_hit_compute_scores (hit, search->query);
-            g_hash_table_replace (search->hits, g_strdup (candidate->uri), hit);
+            nautilus_search_hit_heap_add (search->hits, hit);
+            g_object_unref (hit);
         }
     }
     g_list_free_full (candidates, (GDestroyNotify) search_hit_candidate_free);
@@ -456,29 +543,31 @@ execute_search (NautilusShellSearchProvider  *self,
 
     pending_search = g_slice_new0 (PendingSearch);
     pending_search->invocation = g_object_ref (invocation);
-    pending_search->hits = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_object_unref);
+    pending_search->hits = nautilus_search_hit_heap_new (MAX_RESULTS);
     pending_search->query = query;
-    pending_search->engine = nautilus_search_engine_new ();
     pending_search->start_time = g_get_monotonic_time ();
     pending_search->self = self;
 
-    g_signal_connect (pending_search->engine, "hits-added",
+    g_signal_connect (self->engine, "hits-added",
                       G_CALLBACK (search_hits_added_cb), pending_search);
-    g_signal_connect (pending_search->engine, "finished",
+    g_signal_connect (self->engine, "finished",
                       G_CALLBACK (search_finished_cb), pending_search);
-    g_signal_connect (pending_search->engine, "error",
+    g_signal_connect (self->engine, "error",
                       G_CALLBACK (search_error_cb), pending_search);
 
     self->current_search = pending_search;
     g_application_hold (g_application_get_default ());
 
     search_add_volumes_and_bookmarks (pending_search);
+    pending_search->deadline_id = g_timeout_add (RESULTS_DEADLINE_MS,
+                                                 search_deadline_cb,
+                                                 pending_search);
 
     /* start searching */
     g_debug ("*** Search engine search started");
-    nautilus_search_provider_set_query (NAUTILUS_SEARCH_PROVIDER (pending_search->engine),
+    nautilus_search_provider_set_query (NAUTILUS_SEARCH_PROVIDER (self->engine),
                                         query);
-    nautilus_search_provider_start (NAUTILUS_SEARCH_PROVIDER (pending_search->engine));
+    nautilus_search_provider_start (NAUTILUS_SEARCH_PROVIDER (self->engine));
 
     g_clear_object (&home);
     g_free (terms_joined);
@@ -507,6 +596,9 @@ handle_get_subsearch_result_set (NautilusShellSearchProvider2  *skeleton,
     NautilusShellSearchProvider *self = user_data;
 
     g_debug ("****** GetSubSearchResultSet");
+    /* The terms narrow the last search, which the engine notices and
+     * filters the hits of instead of searching again.
+     */
     execute_search (self, invocation, terms);
     return TRUE;
 }
@@ -557,10 +649,9 @@ result_metas_return_from_cache (ResultMetasData *data)
 }
 
 static void
-result_list_attributes_ready_cb (GList    *file_list,
-                                 gpointer  user_data)
+cache_result_metas (NautilusShellSearchProvider *self,
+                    GList                       *file_list)
 {
-    ResultMetasData *data = user_data;
     GVariantBuilder meta;
     NautilusFile *file;
     GFile *file_location;
@@ -581,7 +672,7 @@ result_list_attributes_ready_cb (GList    *file_list,
         g_variant_builder_init (&meta, G_VARIANT_TYPE ("a{sv}"));
 
         uri = nautilus_file_get_uri (file);
-        display_name = get_display_name (data->self, file);
+        display_name = get_display_name (self, file);
         file_location = nautilus_file_get_location (file);
         path = g_file_get_path (file_location);
         description = path ? g_path_get_dirname (path) : NULL;
@@ -607,7 +698,7 @@ result_list_attributes_ready_cb (GList    *file_list,
         }
         else
         {
-            gicon = get_gicon (data->self, file);
+            gicon = get_gicon (self, file);
         }
 
         if (gicon == NULL)
@@ -622,7 +713,7 @@ result_list_attributes_ready_cb (GList    *file_list,
         g_object_unref (gicon);
 
         meta_variant = g_variant_builder_end (&meta);
-        g_hash_table_insert (data->self->metas_cache,
+        g_hash_table_insert (self->metas_cache,
                              g_strdup (uri), g_variant_ref_sink (meta_variant));
 
         g_free (display_name);
@@ -630,7 +721,15 @@ result_list_attributes_ready_cb (GList    *file_list,
         g_free (description);
         g_free (uri);
     }
+}
+
+static void
+result_list_attributes_ready_cb (GList    *file_list,
+                                 gpointer  user_data)
+{
+    ResultMetasData *data = user_data;
 
+    cache_result_metas (data->self, file_list);
     result_metas_return_from_cache (data);
     result_metas_data_free (data);
 }
@@ -733,6 +832,7 @@ search_provider_dispose (GObject *obj)
     g_clear_object (&self->skeleton);
     g_hash_table_destroy (self->metas_cache);
     cancel_current_search (self);
+    g_clear_object (&self->engine);
 
     G_OBJECT_CLASS (nautilus_shell_search_provider_parent_class)->dispose (obj);
 }
@@ -743,6 +843,7 @@ nautilus_shell_search_provider_init (NautilusShellSearchProvider *self)
     self->metas_cache = g_hash_table_new_full (g_str_hash, g_str_equal,
                                                g_free, (GDestroyNotify) g_variant_unref);
 
+    self->engine = nautilus_search_engine_new ();
     self->skeleton = nautilus_shell_search_provider2_skeleton_new ();
 
     g_signal_connect (self->skeleton, "handle-get-initial-result-set",
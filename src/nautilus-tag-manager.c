@@ -37,6 +37,10 @@ struct _NautilusTagManager
 G_DEFINE_TYPE (NautilusTagManager, nautilus_tag_manager, G_TYPE_OBJECT);
 
 static NautilusTagManager *tag_manager = NULL;
+/* Bumped whenever the favorite files change. It outlives the tag
+ * manager so files never see the same generation twice.
+ */
+static guint favorites_generation = 1;
 
 typedef enum
 {
@@ -71,6 +75,18 @@ enum
 
 static guint signals[LAST_SIGNAL];
 
+static void
+emit_favorites_changed (NautilusTagManager *self,
+                        GList              *changed_files)
+{
+    /* 0 stands for unknown in the files that cache it. */
+    if (++favorites_generation == 0)
+    {
+        favorites_generation = 1;
+    }
+    g_signal_emit (self, signals[FAVORITES_CHANGED], 0, changed_files);
+}
+
 static const gchar*
 nautilus_tag_manager_file_with_id_changed_url (GHashTable  *hash_table,
                                                gint64       id,
@@ -282,7 +298,7 @@ on_update_callback (GObject      *object,
             g_object_unref (undo_info);
         }
 
-        g_signal_emit_by_name (data->tag_manager, "favorites-changed", nautilus_file_list_copy (data->selection));
+        emit_favorites_changed (data->tag_manager, nautilus_file_list_copy (data->selection));
 
         g_task_return_boolean (data->task, TRUE);
         g_object_unref (data->task);
@@ -384,7 +400,7 @@ on_get_favorite_files_cursor_callback (GObject      *object,
     file = nautilus_file_get_by_uri (url);
     changed_files = g_list_prepend (NULL, file);
 
-    g_signal_emit_by_name (self, "favorites-changed", changed_files);
+    emit_favorites_changed (self, changed_files);
 
     nautilus_file_list_free (changed_files);
 
@@ -473,6 +489,12 @@ nautilus_tag_manager_insert_tag (NautilusTagManager  *self,
     return query;
 }
 
+guint
+nautilus_tag_manager_get_favorites_generation (NautilusTagManager *self)
+{
+    return favorites_generation;
+}
+
 gboolean
 nautilus_tag_manager_file_is_favorite (NautilusTagManager *self,
                                        const gchar        *file_name)
@@ -731,7 +753,7 @@ on_tracker_notifier_events(TrackerNotifier *notifier,
             file = nautilus_file_get_by_uri (location_uri);
             changed_files = g_list_prepend (NULL, file);
 
-            g_signal_emit_by_name (self, "favorites-changed", changed_files);
+            emit_favorites_changed (self, changed_files);
 
             nautilus_file_list_free (changed_files);
         }
@@ -775,7 +797,7 @@ on_tracker_notifier_events(TrackerNotifier *notifier,
                 file = nautilus_file_get_by_uri (location_uri);
                 changed_files = g_list_prepend (NULL, file);
 
-                g_signal_emit_by_name (self, "favorites-changed", changed_files);
+                emit_favorites_changed (self, changed_files);
 
                 nautilus_file_list_free (changed_files);
             }
@@ -791,7 +813,7 @@ on_tracker_notifier_events(TrackerNotifier *notifier,
                 file = nautilus_file_get_by_uri (location_uri);
                 changed_files = g_list_prepend (NULL, file);
 
-                g_signal_emit_by_name (self, "favorites-changed", changed_files);
+                emit_favorites_changed (self, changed_files);
 
                 nautilus_file_list_free (changed_files);
             }
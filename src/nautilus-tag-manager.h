@@ -49,6 +49,8 @@ void                nautilus_tag_manager_unstar_files       (NautilusTagManager
                                                              GCancellable        *cancellable);
 
 
+guint               nautilus_tag_manager_get_favorites_generation (NautilusTagManager *self);
+
 gboolean            nautilus_tag_manager_file_is_favorite   (NautilusTagManager *self,
                                                              const gchar        *file_name);
 
@@ -16,11 +16,13 @@ struct _NautilusViewIconController
 
     NautilusViewIconUi *view_ui;
     NautilusViewModel *model;
-    GtkEventBox *event_box;
 
     GIcon *view_icon;
     GActionGroup *action_group;
     gint zoom_level;
+
+    /* Items of removed files, taken out of the model at once. */
+    GQueue *pending_removals;
 };
 
 G_DEFINE_TYPE (NautilusViewIconController, nautilus_view_icon_controller, NAUTILUS_TYPE_FILES_VIEW)
@@ -246,11 +248,36 @@ real_begin_loading (NautilusFilesView *files_view)
     nautilus_files_view_update_toolbar_menus (files_view);
 }
 
+/* The files view removes files one at a time, and asks for the selection
+ * right after a round of changes, so removals are held until then or
+ * until something else needs the model as it is.
+ */
+static void
+flush_pending_removals (NautilusViewIconController *self)
+{
+    GQueue *removals;
+
+    if (g_queue_is_empty (self->pending_removals))
+    {
+        return;
+    }
+
+    /* Taken out first, as the view asks for the selection again when
+     * selected items go away.
+     */
+    removals = self->pending_removals;
+    self->pending_removals = g_queue_new ();
+    nautilus_view_model_remove_items (self->model, removals);
+    g_queue_free_full (removals, g_object_unref);
+}
+
 static void
 real_clear (NautilusFilesView *files_view)
 {
     NautilusViewIconController *self = NAUTILUS_VIEW_ICON_CONTROLLER (files_view);
 
+    g_queue_foreach (self->pending_removals, (GFunc) g_object_unref, NULL);
+    g_queue_clear (self->pending_removals);
     nautilus_view_model_remove_all_items (self->model);
 }
 
@@ -267,6 +294,7 @@ real_file_changed (NautilusFilesView *files_view,
     NautilusViewItemModel *new_item_model;
 
     self = NAUTILUS_VIEW_ICON_CONTROLLER (files_view);
+    flush_pending_removals (self);
     item_model = nautilus_view_model_get_item_from_file (self->model, file);
     nautilus_view_model_remove_item (self->model, item_model);
     new_item_model = nautilus_view_item_model_new (file,
@@ -280,15 +308,16 @@ real_get_selection (NautilusFilesView *files_view)
     NautilusViewIconController *self;
     GList *selected_files = NULL;
     GList *l;
-    g_autoptr (GList) selected_items = NULL;
+    g_autoptr (GQueue) selected_items = NULL;
 
     self = NAUTILUS_VIEW_ICON_CONTROLLER (files_view);
-    selected_items = gtk_flow_box_get_selected_children (GTK_FLOW_BOX (self->view_ui));
-    for (l = selected_items; l != NULL; l = l->next)
+    flush_pending_removals (self);
+    selected_items = nautilus_view_icon_ui_get_selection (self->view_ui);
+    for (l = g_queue_peek_tail_link (selected_items); l != NULL; l = l->prev)
     {
         NautilusViewItemModel *item_model;
 
-        item_model = nautilus_view_icon_item_ui_get_model (NAUTILUS_VIEW_ICON_ITEM_UI (l->data));
+        item_model = NAUTILUS_VIEW_ITEM_MODEL (l->data);
         selected_files = g_list_prepend (selected_files,
                                          g_object_ref (nautilus_view_item_model_get_file (item_model)));
     }
@@ -301,12 +330,15 @@ real_is_empty (NautilusFilesView *files_view)
 {
     NautilusViewIconController *self = NAUTILUS_VIEW_ICON_CONTROLLER (files_view);
 
+    flush_pending_removals (self);
+
     return g_list_model_get_n_items (G_LIST_MODEL (nautilus_view_model_get_g_model (self->model))) == 0;
 }
 
 static void
 real_end_file_changes (NautilusFilesView *files_view)
 {
+    flush_pending_removals (NAUTILUS_VIEW_ICON_CONTROLLER (files_view));
 }
 
 static void
@@ -315,19 +347,12 @@ real_remove_file (NautilusFilesView *files_view,
                   NautilusDirectory *directory)
 {
     NautilusViewIconController *self = NAUTILUS_VIEW_ICON_CONTROLLER (files_view);
-    NautilusFile *current_file;
-    NautilusViewItemModel *current_item_model;
-    guint i = 0;
+    NautilusViewItemModel *item_model;
 
-    while ((current_item_model = NAUTILUS_VIEW_ITEM_MODEL (g_list_model_get_item (G_LIST_MODEL (nautilus_view_model_get_g_model (self->model)), i))))
+    item_model = nautilus_view_model_get_item_from_file (self->model, file);
+    if (item_model != NULL)
     {
-        current_file = nautilus_view_item_model_get_file (current_item_model);
-        if (current_file == file)
-        {
-            g_list_store_remove (nautilus_view_model_get_g_model (self->model), i);
-            break;
-        }
-        i++;
+        g_queue_push_tail (self->pending_removals, g_object_ref (item_model));
     }
 }
 
@@ -384,7 +409,7 @@ static void
 real_select_all (NautilusFilesView *files_view)
 {
     NautilusViewIconController *self = NAUTILUS_VIEW_ICON_CONTROLLER (files_view);
-    gtk_flow_box_select_all (GTK_FLOW_BOX (self->view_ui));
+    nautilus_view_icon_ui_select_all (self->view_ui);
 }
 
 static void
@@ -393,10 +418,6 @@ real_reveal_selection (NautilusFilesView *files_view)
     GList *selection;
     NautilusViewItemModel *item_model;
     NautilusViewIconController *self = NAUTILUS_VIEW_ICON_CONTROLLER (files_view);
-    GtkWidget *item_ui;
-    GtkAllocation allocation;
-    GtkWidget *content_widget;
-    GtkAdjustment *vadjustment;
 
     selection = nautilus_view_get_selection (NAUTILUS_VIEW (files_view));
     if (selection == NULL)
@@ -406,11 +427,10 @@ real_reveal_selection (NautilusFilesView *files_view)
 
     item_model = nautilus_view_model_get_item_from_file (self->model,
                                                          NAUTILUS_FILE (selection->data));
-    item_ui = nautilus_view_item_model_get_item_ui (item_model);
-    gtk_widget_get_allocation (item_ui, &allocation);
-    content_widget = nautilus_files_view_get_content_widget (files_view);
-    vadjustment = gtk_scrolled_window_get_vadjustment (GTK_SCROLLED_WINDOW (content_widget));
-    gtk_adjustment_set_value (vadjustment, allocation.y);
+    if (item_model != NULL)
+    {
+        nautilus_view_icon_ui_reveal_item (self->view_ui, item_model);
+    }
 
     g_list_foreach (selection, (GFunc) g_object_unref, NULL);
 }
@@ -534,8 +554,11 @@ set_icon_size (NautilusViewIconController *self,
     {
         nautilus_view_item_model_set_icon_size (current_item_model,
                                                 get_icon_size_for_zoom_level (self->zoom_level));
+        g_object_unref (current_item_model);
         i++;
     }
+
+    nautilus_view_icon_ui_set_icon_size (self->view_ui, icon_size);
 }
 
 static void
@@ -598,29 +621,20 @@ real_compute_rename_popover_pointing_to (NautilusFilesView *files_view)
 {
     NautilusViewIconController *self;
     GdkRectangle *allocation;
-    GtkAdjustment *vadjustment;
-    GtkAdjustment *hadjustment;
-    GtkWidget *parent_container;
     g_autoptr (GQueue) selection_files = NULL;
     g_autoptr (GQueue) selection_item_models = NULL;
     GList *selection;
-    GtkWidget *icon_item_ui;
 
     self = NAUTILUS_VIEW_ICON_CONTROLLER (files_view);
     allocation = g_new0 (GdkRectangle, 1);
 
-    parent_container = nautilus_files_view_get_content_widget (files_view);
-    vadjustment = gtk_scrolled_window_get_vadjustment (GTK_SCROLLED_WINDOW (parent_container));
-    hadjustment = gtk_scrolled_window_get_hadjustment (GTK_SCROLLED_WINDOW (parent_container));
     selection = nautilus_view_get_selection (NAUTILUS_VIEW (files_view));
     selection_files = convert_glist_to_queue (selection);
     selection_item_models = nautilus_view_model_get_items_from_files (self->model, selection_files);
     /* We only allow one item to be renamed with a popover */
-    icon_item_ui = nautilus_view_item_model_get_item_ui (g_queue_peek_head (selection_item_models));
-    gtk_widget_get_allocation (icon_item_ui, allocation);
-
-    allocation->x -= gtk_adjustment_get_value (hadjustment);
-    allocation->y -= gtk_adjustment_get_value (vadjustment);
+    nautilus_view_icon_ui_get_item_area (self->view_ui,
+                                         g_queue_peek_head (selection_item_models),
+                                         allocation);
 
     return allocation;
 }
@@ -637,22 +651,26 @@ on_button_press_event (GtkWidget *widget,
 {
     NautilusViewIconController *self;
     g_autoptr (GList) selection = NULL;
-    GtkWidget *child_at_pos;
+    NautilusViewItemModel *item_model;
     GdkEventButton *event_button;
 
     self = NAUTILUS_VIEW_ICON_CONTROLLER (user_data);
     event_button = (GdkEventButton *) event;
 
+    /* The view selects and activates on its own with the primary button. */
+    if (event->type != GDK_BUTTON_PRESS || event_button->button != GDK_BUTTON_SECONDARY)
+    {
+        return GDK_EVENT_PROPAGATE;
+    }
+
     /* Need to update the selection so the popup has the right actions enabled */
     selection = nautilus_view_get_selection (NAUTILUS_VIEW (self));
-    child_at_pos = GTK_WIDGET (gtk_flow_box_get_child_at_pos (GTK_FLOW_BOX (self->view_ui),
-                                                              event_button->x, event_button->y));
-    if (child_at_pos != NULL)
+    item_model = nautilus_view_icon_ui_get_item_at_pos (self->view_ui,
+                                                        event_button->x, event_button->y);
+    if (item_model != NULL)
     {
         NautilusFile *selected_file;
-        NautilusViewItemModel *item_model;
 
-        item_model = nautilus_view_icon_item_ui_get_model (NAUTILUS_VIEW_ICON_ITEM_UI (child_at_pos));
         selected_file = nautilus_view_item_model_get_file (item_model);
         if (g_list_find (selection, selected_file) == NULL)
         {
@@ -665,21 +683,14 @@ on_button_press_event (GtkWidget *widget,
         }
 
         nautilus_view_set_selection (NAUTILUS_VIEW (self), selection);
-
-        if (event_button->button == GDK_BUTTON_SECONDARY)
-        {
-            nautilus_files_view_pop_up_selection_context_menu (NAUTILUS_FILES_VIEW (self),
-                                                               event_button);
-        }
+        nautilus_files_view_pop_up_selection_context_menu (NAUTILUS_FILES_VIEW (self),
+                                                           event_button);
     }
     else
     {
         nautilus_view_set_selection (NAUTILUS_VIEW (self), NULL);
-        if (event_button->button == GDK_BUTTON_SECONDARY)
-        {
-            nautilus_files_view_pop_up_background_context_menu (NAUTILUS_FILES_VIEW (self),
-                                                                event_button);
-        }
+        nautilus_files_view_pop_up_background_context_menu (NAUTILUS_FILES_VIEW (self),
+                                                            event_button);
     }
 
     g_list_foreach (selection, (GFunc) g_object_unref, NULL);
@@ -832,6 +843,10 @@ action_zoom_to_level (GSimpleAction *action,
 static void
 finalize (GObject *object)
 {
+    NautilusViewIconController *self = NAUTILUS_VIEW_ICON_CONTROLLER (object);
+
+    g_queue_free_full (self->pending_removals, g_object_unref);
+
     G_OBJECT_CLASS (nautilus_view_icon_controller_parent_class)->finalize (object);
 }
 
@@ -854,13 +869,12 @@ constructed (GObject *object)
     gtk_widget_show (GTK_WIDGET (self->view_ui));
     self->view_icon = g_themed_icon_new ("view-grid-symbolic");
 
-    self->event_box = GTK_EVENT_BOX (gtk_event_box_new ());
-    gtk_container_add (GTK_CONTAINER (self->event_box), GTK_WIDGET (self->view_ui));
-    g_signal_connect (GTK_WIDGET (self->event_box), "button-press-event",
+    g_signal_connect (GTK_WIDGET (self->view_ui), "button-press-event",
                       (GCallback) on_button_press_event, self);
 
+    /* The view is scrollable, so it goes in the scrolled window as is. */
     content_widget = nautilus_files_view_get_content_widget (NAUTILUS_FILES_VIEW (self));
-    gtk_container_add (GTK_CONTAINER (content_widget), GTK_WIDGET (self->event_box));
+    gtk_container_add (GTK_CONTAINER (content_widget), GTK_WIDGET (self->view_ui));
 
     self->action_group = nautilus_files_view_get_action_group (NAUTILUS_FILES_VIEW (self));
     g_action_map_add_action_entries (G_ACTION_MAP (self->action_group),
@@ -876,6 +890,8 @@ constructed (GObject *object)
                                      G_N_ELEMENTS (view_icon_actions),
                                      self);
     self->zoom_level = get_default_zoom_level ();
+    nautilus_view_icon_ui_set_icon_size (self->view_ui,
+                                         get_icon_size_for_zoom_level (self->zoom_level));
     /* Keep the action synced with the actual value, so the toolbar can poll it */
     g_action_group_change_action_state (nautilus_files_view_get_action_group (NAUTILUS_FILES_VIEW (self)),
                                         "zoom-to-level", g_variant_new_int32 (self->zoom_level));
@@ -928,6 +944,7 @@ nautilus_view_icon_controller_class_init (NautilusViewIconControllerClass *klass
 static void
 nautilus_view_icon_controller_init (NautilusViewIconController *self)
 {
+    self->pending_removals = g_queue_new ();
 }
 
 NautilusViewIconController *
@@ -4,9 +4,12 @@
 #include "nautilus-file.h"
 #include "nautilus-thumbnails.h"
 
+/* Labels always take this many lines, so all items are the same size. */
+#define N_LABEL_LINES 3
+
 struct _NautilusViewIconItemUi
 {
-    GtkFlowBoxChild parent_instance;
+    GtkBin parent_instance;
 
     NautilusViewItemModel *model;
 
@@ -15,7 +18,7 @@ struct _NautilusViewIconItemUi
     GtkLabel *label;
 };
 
-G_DEFINE_TYPE (NautilusViewIconItemUi, nautilus_view_icon_item_ui, GTK_TYPE_FLOW_BOX_CHILD)
+G_DEFINE_TYPE (NautilusViewIconItemUi, nautilus_view_icon_item_ui, GTK_TYPE_BIN)
 
 enum
 {
@@ -121,6 +124,54 @@ on_view_item_size_changed (GObject    *object,
     }
 }
 
+/* Makes the label take N_LABEL_LINES lines of its font, whatever the
+ * text, so all the items are the same size.
+ */
+static void
+update_label_height (NautilusViewIconItemUi *self)
+{
+    GtkStyleContext *style_context;
+    PangoFontDescription *font;
+    PangoFontMetrics *metrics;
+    gint line_height;
+
+    if (self->label == NULL)
+    {
+        return;
+    }
+
+    /* The label has the font of the item. */
+    style_context = gtk_widget_get_style_context (GTK_WIDGET (self));
+    gtk_style_context_get (style_context,
+                           gtk_style_context_get_state (style_context),
+                           "font", &font,
+                           NULL);
+    metrics = pango_context_get_metrics (gtk_widget_get_pango_context (GTK_WIDGET (self)),
+                                         font, NULL);
+    line_height = PANGO_PIXELS (pango_font_metrics_get_ascent (metrics) +
+                                pango_font_metrics_get_descent (metrics));
+    pango_font_metrics_unref (metrics);
+    pango_font_description_free (font);
+
+    gtk_widget_set_size_request (GTK_WIDGET (self->label), -1, N_LABEL_LINES * line_height);
+}
+
+/* Shows the item of the model, once the widgets are built. */
+static void
+update_item (NautilusViewIconItemUi *self)
+{
+    NautilusFile *file;
+
+    if (self->model == NULL || self->label == NULL)
+    {
+        return;
+    }
+
+    file = nautilus_view_item_model_get_file (self->model);
+    update_icon (self);
+    gtk_label_set_text (self->label, nautilus_file_get_display_name (file));
+}
+
 static void
 constructed (GObject *object)
 {
@@ -128,28 +179,23 @@ constructed (GObject *object)
     GtkBox *container;
     GtkLabel *label;
     GtkStyleContext *style_context;
-    NautilusFile *file;
-    guint icon_size;
 
     G_OBJECT_CLASS (nautilus_view_icon_item_ui_parent_class)->constructed (object);
 
-    file = nautilus_view_item_model_get_file (self->model);
-    icon_size = nautilus_view_item_model_get_icon_size (self->model);
     container = GTK_BOX (gtk_box_new (GTK_ORIENTATION_VERTICAL, 0));
     self->item_container = nautilus_container_max_width_new ();
 
-    self->icon = create_icon (self);
-    gtk_box_pack_start (container, GTK_WIDGET (self->icon), FALSE, FALSE, 0);
-
-    label = GTK_LABEL (gtk_label_new (nautilus_file_get_display_name (file)));
+    label = GTK_LABEL (gtk_label_new (NULL));
     gtk_widget_show (GTK_WIDGET (label));
     gtk_label_set_ellipsize (label, PANGO_ELLIPSIZE_MIDDLE);
     gtk_label_set_line_wrap (label, TRUE);
     gtk_label_set_line_wrap_mode (label, PANGO_WRAP_WORD_CHAR);
-    gtk_label_set_lines (label, 3);
+    gtk_label_set_lines (label, N_LABEL_LINES);
     gtk_label_set_justify (label, GTK_JUSTIFY_CENTER);
     gtk_widget_set_valign (GTK_WIDGET (label), GTK_ALIGN_START);
     gtk_box_pack_end (container, GTK_WIDGET (label), TRUE, TRUE, 0);
+    self->label = label;
+    update_label_height (self);
 
     style_context = gtk_widget_get_style_context (GTK_WIDGET (container));
     gtk_style_context_add_class (style_context, "icon-item-background");
@@ -159,16 +205,20 @@ constructed (GObject *object)
 
     gtk_container_add (GTK_CONTAINER (self->item_container),
                        GTK_WIDGET (container));
-    nautilus_container_max_width_set_max_width (NAUTILUS_CONTAINER_MAX_WIDTH (self->item_container),
-                                                icon_size);
 
     gtk_container_add (GTK_CONTAINER (self), GTK_WIDGET (self->item_container));
     gtk_widget_show_all (GTK_WIDGET (self->item_container));
 
-    g_signal_connect (self->model, "notify::icon-size",
-                      (GCallback) on_view_item_size_changed, self);
-    g_signal_connect (self->model, "notify::file",
-                      (GCallback) on_view_item_file_changed, self);
+    update_item (self);
+}
+
+static void
+style_updated (GtkWidget *widget)
+{
+    GTK_WIDGET_CLASS (nautilus_view_icon_item_ui_parent_class)->style_updated (widget);
+
+    /* Another font takes another height. */
+    update_label_height (NAUTILUS_VIEW_ICON_ITEM_UI (widget));
 }
 
 static void
@@ -176,7 +226,11 @@ finalize (GObject *object)
 {
     NautilusViewIconItemUi *self = (NautilusViewIconItemUi *) object;
 
-    g_signal_handlers_disconnect_by_data (self->model, self);
+    if (self->model != NULL)
+    {
+        g_signal_handlers_disconnect_by_data (self->model, self);
+        g_object_unref (self->model);
+    }
     G_OBJECT_CLASS (nautilus_view_icon_item_ui_parent_class)->finalize (object);
 }
 
@@ -201,13 +255,6 @@ get_property (GObject    *object,
     }
 }
 
-static void
-set_model (NautilusViewIconItemUi *self,
-           NautilusViewItemModel  *model)
-{
-    self->model = g_object_ref (model);
-}
-
 static void
 set_property (GObject      *object,
               guint         prop_id,
@@ -220,7 +267,7 @@ set_property (GObject      *object,
     {
         case PROP_MODEL:
         {
-            set_model (self, g_value_get_object (value));
+            nautilus_view_icon_item_ui_set_model (self, g_value_get_object (value));
         }
         break;
 
@@ -233,24 +280,30 @@ static void
 nautilus_view_icon_item_ui_class_init (NautilusViewIconItemUiClass *klass)
 {
     GObjectClass *object_class = G_OBJECT_CLASS (klass);
+    GtkWidgetClass *widget_class = GTK_WIDGET_CLASS (klass);
 
     object_class->finalize = finalize;
     object_class->get_property = get_property;
     object_class->set_property = set_property;
     object_class->constructed = constructed;
 
+    widget_class->style_updated = style_updated;
+
+    gtk_widget_class_set_css_name (widget_class, "iconitem");
+
     g_object_class_install_property (object_class,
                                      PROP_MODEL,
                                      g_param_spec_object ("model",
                                                           "Item model",
                                                           "The item model that this UI reprensents",
                                                           NAUTILUS_TYPE_VIEW_ITEM_MODEL,
-                                                          G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY));
+                                                          G_PARAM_READWRITE | G_PARAM_CONSTRUCT));
 }
 
 static void
 nautilus_view_icon_item_ui_init (NautilusViewIconItemUi *self)
 {
+    gtk_widget_set_has_window (GTK_WIDGET (self), FALSE);
 }
 
 NautilusViewIconItemUi *
@@ -266,3 +319,34 @@ nautilus_view_icon_item_ui_get_model (NautilusViewIconItemUi *self)
 {
     return self->model;
 }
+
+/* Shows another item in the same widget, so the icon view can reuse the
+ * widgets of items scrolled out of sight. NULL leaves it showing nothing.
+ */
+void
+nautilus_view_icon_item_ui_set_model (NautilusViewIconItemUi *self,
+                                      NautilusViewItemModel  *model)
+{
+    if (self->model == model)
+    {
+        return;
+    }
+
+    if (self->model != NULL)
+    {
+        g_signal_handlers_disconnect_by_data (self->model, self);
+        g_clear_object (&self->model);
+    }
+
+    if (model != NULL)
+    {
+        self->model = g_object_ref (model);
+        g_signal_connect (self->model, "notify::icon-size",
+                          (GCallback) on_view_item_size_changed, self);
+        g_signal_connect (self->model, "notify::file",
+                          (GCallback) on_view_item_file_changed, self);
+        update_item (self);
+    }
+
+    g_object_notify (G_OBJECT (self), "model");
+}
@@ -27,22 +27,77 @@
 #include "nautilus-directory.h"
 #include "nautilus-global-preferences.h"
 
+/* Only the items in view, and a few rows around them, have widgets. The
+ * widgets of the items that scroll out of view are kept and reused for
+ * the ones that scroll in. All cells are the same size, measured once
+ * on a single item, so the layout of the whole grid is arithmetic.
+ */
+
+#define MARGIN 10
+#define MAX_COLUMNS 20
+/* Rows with widgets above and below the ones in view. */
+#define OVERSCAN_ROWS 2
+
 struct _NautilusViewIconUi
 {
-    GtkFlowBox parent_instance;
+    GtkContainer parent_instance;
 
     NautilusViewIconController *controller;
+    GListModel *model;
+
+    GtkAdjustment *hadjustment;
+    GtkAdjustment *vadjustment;
+    guint hscroll_policy : 1;
+    guint vscroll_policy : 1;
+
+    guint icon_size;
+    /* The size of a cell, 0 until it's measured. */
+    gint cell_width;
+    gint cell_height;
+    /* The layout for the current width, n_columns is 0 until allocated. */
+    guint n_columns;
+    gint column_width;
+
+    GHashTable *children;       /* NautilusViewItemModel → its widget */
+    GQueue recycled;            /* widgets that show no item */
+    NautilusViewIconItemUi *probe;  /* measures the cells, never mapped */
+
+    GHashTable *selection;      /* selected NautilusViewItemModel */
+    NautilusViewItemModel *anchor;  /* where ranges start */
+    NautilusViewItemModel *focus;   /* where keyboard moves start */
+
+    /* Rubberband selection, in content coordinates. */
+    gboolean rubberbanding;
+    gdouble band_start_x;
+    gdouble band_start_y;
+    gdouble band_end_x;
+    gdouble band_end_y;
+    GdkRectangle band_cells;    /* columns and rows in the band */
+    GHashTable *selection_before_band;
 };
 
-G_DEFINE_TYPE (NautilusViewIconUi, nautilus_view_icon_ui, GTK_TYPE_FLOW_BOX)
+static void nautilus_view_icon_ui_scrollable_init (GtkScrollableInterface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (NautilusViewIconUi, nautilus_view_icon_ui, GTK_TYPE_CONTAINER,
+                         G_IMPLEMENT_INTERFACE (GTK_TYPE_SCROLLABLE,
+                                                nautilus_view_icon_ui_scrollable_init))
 
 enum
 {
     PROP_0,
     PROP_CONTROLLER,
+    PROP_HADJUSTMENT,
+    PROP_VADJUSTMENT,
+    PROP_HSCROLL_POLICY,
+    PROP_VSCROLL_POLICY,
     N_PROPS
 };
 
+static void set_hadjustment (NautilusViewIconUi *self,
+                             GtkAdjustment      *adjustment);
+static void set_vadjustment (NautilusViewIconUi *self,
+                             GtkAdjustment      *adjustment);
+
 static void
 set_controller (NautilusViewIconUi         *self,
                 NautilusViewIconController *controller)
@@ -68,6 +123,30 @@ get_property (GObject    *object,
         }
         break;
 
+        case PROP_HADJUSTMENT:
+        {
+            g_value_set_object (value, self->hadjustment);
+        }
+        break;
+
+        case PROP_VADJUSTMENT:
+        {
+            g_value_set_object (value, self->vadjustment);
+        }
+        break;
+
+        case PROP_HSCROLL_POLICY:
+        {
+            g_value_set_enum (value, self->hscroll_policy);
+        }
+        break;
+
+        case PROP_VSCROLL_POLICY:
+        {
+            g_value_set_enum (value, self->vscroll_policy);
+        }
+        break;
+
         default:
         {
             G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -91,6 +170,32 @@ set_property (GObject      *object,
         }
         break;
 
+        case PROP_HADJUSTMENT:
+        {
+            set_hadjustment (self, g_value_get_object (value));
+        }
+        break;
+
+        case PROP_VADJUSTMENT:
+        {
+            set_vadjustment (self, g_value_get_object (value));
+        }
+        break;
+
+        case PROP_HSCROLL_POLICY:
+        {
+            self->hscroll_policy = g_value_get_enum (value);
+            gtk_widget_queue_resize (GTK_WIDGET (self));
+        }
+        break;
+
+        case PROP_VSCROLL_POLICY:
+        {
+            self->vscroll_policy = g_value_get_enum (value);
+            gtk_widget_queue_resize (GTK_WIDGET (self));
+        }
+        break;
+
         default:
         {
             G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -98,136 +203,1471 @@ set_property (GObject      *object,
     }
 }
 
-void
-nautilus_view_icon_ui_set_selection (NautilusViewIconUi *self,
-                                     GQueue             *selection)
+/* Layout */
+
+static guint
+get_n_items (NautilusViewIconUi *self)
 {
-    NautilusViewItemModel *item_model;
-    NautilusViewModel *model;
-    GListStore *gmodel;
-    gint i = 0;
+    return self->model != NULL ? g_list_model_get_n_items (self->model) : 0;
+}
 
-    model = nautilus_view_icon_controller_get_model (self->controller);
-    gmodel = nautilus_view_model_get_g_model (model);
-    while ((item_model = NAUTILUS_VIEW_ITEM_MODEL (g_list_model_get_item (G_LIST_MODEL (gmodel), i))))
+static void
+ensure_cell_size (NautilusViewIconUi *self)
+{
+    NautilusViewItemModel *item;
+
+    if (self->cell_width > 0 || get_n_items (self) == 0)
+    {
+        return;
+    }
+
+    /* Items only differ in their texts, and the labels take the same
+     * lines whatever the text, so any item tells the size of all.
+     */
+    item = g_list_model_get_item (self->model, 0);
+    nautilus_view_icon_item_ui_set_model (self->probe, item);
+    gtk_widget_get_preferred_width (GTK_WIDGET (self->probe), NULL, &self->cell_width);
+    gtk_widget_get_preferred_height_for_width (GTK_WIDGET (self->probe), self->cell_width,
+                                               NULL, &self->cell_height);
+    nautilus_view_icon_item_ui_set_model (self->probe, NULL);
+    g_object_unref (item);
+
+    self->cell_width = MAX (self->cell_width, 1);
+    self->cell_height = MAX (self->cell_height, 1);
+}
+
+static void
+invalidate_cell_size (NautilusViewIconUi *self)
+{
+    self->cell_width = 0;
+    self->cell_height = 0;
+    self->n_columns = 0;
+    gtk_widget_queue_resize (GTK_WIDGET (self));
+}
+
+static void
+update_layout (NautilusViewIconUi *self,
+               gint                width)
+{
+    gint available;
+
+    ensure_cell_size (self);
+    if (self->cell_width == 0)
+    {
+        self->n_columns = 0;
+        return;
+    }
+
+    available = MAX (width - 2 * MARGIN, self->cell_width);
+    self->n_columns = CLAMP (available / self->cell_width, 1, MAX_COLUMNS);
+    self->column_width = available / self->n_columns;
+}
+
+static gint
+get_content_height (NautilusViewIconUi *self)
+{
+    guint n_rows;
+
+    if (self->n_columns == 0)
+    {
+        return 2 * MARGIN;
+    }
+
+    n_rows = (get_n_items (self) + self->n_columns - 1) / self->n_columns;
+
+    return 2 * MARGIN + n_rows * self->cell_height;
+}
+
+static gdouble
+get_scroll_offset (NautilusViewIconUi *self)
+{
+    return self->vadjustment != NULL ? gtk_adjustment_get_value (self->vadjustment) : 0;
+}
+
+/* The cell of the item at position, relative to the view as scrolled. */
+static void
+get_cell_area (NautilusViewIconUi *self,
+               guint               position,
+               GdkRectangle       *area)
+{
+    area->x = MARGIN + (position % self->n_columns) * self->column_width;
+    area->y = MARGIN + (position / self->n_columns) * self->cell_height - get_scroll_offset (self);
+    area->width = self->column_width;
+    area->height = self->cell_height;
+}
+
+/* The positions of the items that get widgets: the ones in view and
+ * OVERSCAN_ROWS rows around them.
+ */
+static void
+get_bound_range (NautilusViewIconUi *self,
+                 guint              *first,
+                 guint              *last)
+{
+    gdouble offset;
+    gint height;
+    gint first_row, last_row;
+
+    *first = 0;
+    *last = 0;
+    if (self->n_columns == 0)
+    {
+        return;
+    }
+
+    offset = get_scroll_offset (self);
+    height = gtk_widget_get_allocated_height (GTK_WIDGET (self));
+    first_row = (gint) ((offset - MARGIN) / self->cell_height) - OVERSCAN_ROWS;
+    last_row = (gint) ((offset + height - MARGIN) / self->cell_height) + 1 + OVERSCAN_ROWS;
+
+    *first = MIN ((guint) MAX (first_row, 0) * self->n_columns, get_n_items (self));
+    *last = MIN ((guint) MAX (last_row, 0) * self->n_columns, get_n_items (self));
+}
+
+/* Widgets */
+
+static void
+update_child_state (NautilusViewIconUi    *self,
+                    NautilusViewItemModel *item,
+                    GtkWidget             *child)
+{
+    if (g_hash_table_contains (self->selection, item))
+    {
+        gtk_widget_set_state_flags (child, GTK_STATE_FLAG_SELECTED, FALSE);
+    }
+    else
+    {
+        gtk_widget_unset_state_flags (child, GTK_STATE_FLAG_SELECTED);
+    }
+}
+
+static void
+bind_child (NautilusViewIconUi    *self,
+            NautilusViewItemModel *item)
+{
+    NautilusViewIconItemUi *child;
+
+    child = g_queue_pop_head (&self->recycled);
+    if (child != NULL)
+    {
+        nautilus_view_icon_item_ui_set_model (child, item);
+    }
+    else
+    {
+        child = nautilus_view_icon_item_ui_new (item);
+        gtk_widget_set_parent (GTK_WIDGET (child), GTK_WIDGET (self));
+        gtk_widget_show (GTK_WIDGET (child));
+    }
+
+    gtk_widget_set_child_visible (GTK_WIDGET (child), TRUE);
+    update_child_state (self, item, GTK_WIDGET (child));
+    g_hash_table_insert (self->children, item, child);
+    nautilus_view_item_model_set_item_ui (item, GTK_WIDGET (child));
+}
+
+/* The item must already be out of the children table. */
+static void
+recycle_child (NautilusViewIconUi     *self,
+               NautilusViewItemModel  *item,
+               NautilusViewIconItemUi *child)
+{
+    nautilus_view_item_model_set_item_ui (item, NULL);
+    nautilus_view_icon_item_ui_set_model (child, NULL);
+    gtk_widget_set_child_visible (GTK_WIDGET (child), FALSE);
+    g_queue_push_tail (&self->recycled, child);
+}
+
+/* Gives widgets to the items that came near the view, taking them from
+ * the ones that went away.
+ */
+static void
+update_children (NautilusViewIconUi *self)
+{
+    g_autoptr (GHashTable) bound = NULL;
+    GHashTableIter iter;
+    gpointer item, child;
+    guint first, last, i;
+
+    get_bound_range (self, &first, &last);
+
+    bound = g_hash_table_new (NULL, NULL);
+    for (i = first; i < last; i++)
     {
-        GtkWidget *item_ui;
+        /* The model keeps its items alive. */
+        item = g_list_model_get_item (self->model, i);
+        g_object_unref (item);
+        g_hash_table_add (bound, item);
+    }
 
-        item_ui = nautilus_view_item_model_get_item_ui (item_model);
-        if (g_queue_find (selection, item_model) != NULL)
+    g_hash_table_iter_init (&iter, self->children);
+    while (g_hash_table_iter_next (&iter, &item, &child))
+    {
+        if (!g_hash_table_contains (bound, item))
         {
-            gtk_flow_box_select_child (GTK_FLOW_BOX (self),
-                                       GTK_FLOW_BOX_CHILD (item_ui));
+            g_hash_table_iter_remove (&iter);
+            recycle_child (self, item, child);
         }
-        else
+    }
+
+    g_hash_table_iter_init (&iter, bound);
+    while (g_hash_table_iter_next (&iter, &item, NULL))
+    {
+        if (!g_hash_table_contains (self->children, item))
         {
-            gtk_flow_box_unselect_child (GTK_FLOW_BOX (self),
-                                         GTK_FLOW_BOX_CHILD (item_ui));
+            bind_child (self, item);
         }
-
-        i++;
     }
 }
 
-
-static GtkWidget *
-create_widget_func (gpointer item,
-                    gpointer user_data)
+static void
+allocate_children (NautilusViewIconUi *self)
 {
-    NautilusViewItemModel *item_model = NAUTILUS_VIEW_ITEM_MODEL (item);
-    NautilusViewIconItemUi *child;
+    GtkWidget *child;
+    GdkRectangle area;
+    gpointer item;
+    guint first, last, i;
 
-    child = nautilus_view_icon_item_ui_new (item_model);
-    nautilus_view_item_model_set_item_ui (item_model, GTK_WIDGET (child));
-    gtk_widget_show (GTK_WIDGET (child));
+    get_bound_range (self, &first, &last);
+    for (i = first; i < last; i++)
+    {
+        item = g_list_model_get_item (self->model, i);
+        child = g_hash_table_lookup (self->children, item);
+        g_object_unref (item);
+        if (child == NULL)
+        {
+            continue;
+        }
 
-    return GTK_WIDGET (child);
+        get_cell_area (self, i, &area);
+        gtk_widget_get_preferred_height_for_width (child, area.width, NULL, NULL);
+        gtk_widget_size_allocate (child, &area);
+    }
 }
 
+/* Selection */
+
 static void
-on_child_activated (GtkFlowBox      *flow_box,
-                    GtkFlowBoxChild *child,
-                    gpointer         user_data)
+update_children_state (NautilusViewIconUi *self)
 {
-    NautilusViewIconUi *self = NAUTILUS_VIEW_ICON_UI (user_data);
-    NautilusViewItemModel *item_model;
-    NautilusFile *file;
-    g_autoptr (GList) list = NULL;
+    GHashTableIter iter;
+    gpointer item, child;
 
-    item_model = nautilus_view_icon_item_ui_get_model (NAUTILUS_VIEW_ICON_ITEM_UI (child));
-    file = nautilus_view_item_model_get_file (item_model);
-    list = g_list_append (list, file);
+    g_hash_table_iter_init (&iter, self->children);
+    while (g_hash_table_iter_next (&iter, &item, &child))
+    {
+        update_child_state (self, item, child);
+    }
+}
 
-    nautilus_files_view_activate_files (NAUTILUS_FILES_VIEW (self->controller), list, 0, TRUE);
+static void
+set_anchor (NautilusViewIconUi    *self,
+            NautilusViewItemModel *item)
+{
+    g_set_object (&self->anchor, item);
 }
 
 static void
-on_ui_selected_children_changed (GtkFlowBox *box,
-                                 gpointer    user_data)
+set_focus_item (NautilusViewIconUi    *self,
+                NautilusViewItemModel *item)
 {
-    NautilusViewIconUi *self;
+    if (g_set_object (&self->focus, item))
+    {
+        gtk_widget_queue_draw (GTK_WIDGET (self));
+    }
+}
 
-    self = NAUTILUS_VIEW_ICON_UI (user_data);
+static void
+notify_selection_changed (NautilusViewIconUi *self)
+{
+    update_children_state (self);
     nautilus_files_view_notify_selection_changed (NAUTILUS_FILES_VIEW (self->controller));
 }
 
 static void
-finalize (GObject *object)
+select_only (NautilusViewIconUi    *self,
+             NautilusViewItemModel *item)
 {
-    G_OBJECT_CLASS (nautilus_view_icon_ui_parent_class)->finalize (object);
+    g_hash_table_remove_all (self->selection);
+    if (item != NULL)
+    {
+        g_hash_table_add (self->selection, g_object_ref (item));
+    }
+    set_anchor (self, item);
+    set_focus_item (self, item);
 }
 
 static void
-constructed (GObject *object)
+select_range (NautilusViewIconUi *self,
+              guint               from,
+              guint               to)
+{
+    guint i;
+
+    g_hash_table_remove_all (self->selection);
+    for (i = MIN (from, to); i <= MAX (from, to); i++)
+    {
+        g_hash_table_add (self->selection, g_list_model_get_item (self->model, i));
+    }
+}
+
+static gboolean
+get_item_position (NautilusViewIconUi    *self,
+                   NautilusViewItemModel *item,
+                   guint                 *position)
 {
-    NautilusViewIconUi *self = NAUTILUS_VIEW_ICON_UI (object);
     NautilusViewModel *model;
-    GListStore *gmodel;
 
-    G_OBJECT_CLASS (nautilus_view_icon_ui_parent_class)->constructed (object);
+    model = nautilus_view_icon_controller_get_model (self->controller);
+
+    return nautilus_view_model_get_item_position (model, item, position);
+}
 
-    gtk_flow_box_set_activate_on_single_click (GTK_FLOW_BOX (self), FALSE);
-    gtk_flow_box_set_max_children_per_line (GTK_FLOW_BOX (self), 20);
-    gtk_flow_box_set_selection_mode (GTK_FLOW_BOX (self), GTK_SELECTION_MULTIPLE);
-    gtk_flow_box_set_homogeneous (GTK_FLOW_BOX (self), FALSE);
-    gtk_widget_set_valign (GTK_WIDGET (self), GTK_ALIGN_START);
-    gtk_widget_set_margin_top (GTK_WIDGET (self), 10);
-    gtk_widget_set_margin_start (GTK_WIDGET (self), 10);
-    gtk_widget_set_margin_bottom (GTK_WIDGET (self), 10);
-    gtk_widget_set_margin_end (GTK_WIDGET (self), 10);
+static gboolean
+is_in_model (NautilusViewIconUi    *self,
+             NautilusViewItemModel *item)
+{
+    NautilusViewModel *model;
+    NautilusFile *file;
 
     model = nautilus_view_icon_controller_get_model (self->controller);
-    gmodel = nautilus_view_model_get_g_model (model);
-    gtk_flow_box_bind_model (GTK_FLOW_BOX (self),
-                             G_LIST_MODEL (gmodel),
-                             create_widget_func, self, NULL);
+    file = nautilus_view_item_model_get_file (item);
 
-    g_signal_connect (self, "child-activated", (GCallback) on_child_activated, self);
-    g_signal_connect (self, "selected-children-changed", (GCallback) on_ui_selected_children_changed, self);
+    return nautilus_view_model_get_item_from_file (model, file) == item;
 }
 
-static void
-nautilus_view_icon_ui_class_init (NautilusViewIconUiClass *klass)
+/* Drops the items that left the model from items. No more of them can
+ * be gone than were removed. Returns how many were dropped.
+ */
+static guint
+prune_items (NautilusViewIconUi *self,
+             GHashTable         *items,
+             guint               removed)
 {
-    GObjectClass *object_class = G_OBJECT_CLASS (klass);
+    GHashTableIter iter;
+    gpointer item;
+    guint n_pruned;
 
-    object_class->finalize = finalize;
-    object_class->set_property = set_property;
-    object_class->get_property = get_property;
-    object_class->constructed = constructed;
+    if (get_n_items (self) == 0)
+    {
+        n_pruned = g_hash_table_size (items);
+        g_hash_table_remove_all (items);
 
-    g_object_class_install_property (object_class,
-                                     PROP_CONTROLLER,
-                                     g_param_spec_object ("controller",
-                                                          "Controller",
-                                                          "The controller of the view",
-                                                          NAUTILUS_TYPE_VIEW_ICON_CONTROLLER,
-                                                          G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY));
+        return n_pruned;
+    }
+
+    n_pruned = 0;
+    g_hash_table_iter_init (&iter, items);
+    while (n_pruned < removed && g_hash_table_iter_next (&iter, &item, NULL))
+    {
+        if (!is_in_model (self, item))
+        {
+            g_hash_table_iter_remove (&iter);
+            n_pruned++;
+        }
+    }
+
+    return n_pruned;
 }
 
-static void
-nautilus_view_icon_ui_init (NautilusViewIconUi *self)
+/* Returns TRUE if the selection lost any item. */
+static gboolean
+prune_selection (NautilusViewIconUi *self,
+                 guint               removed)
+{
+    if (self->anchor != NULL && !is_in_model (self, self->anchor))
+    {
+        g_clear_object (&self->anchor);
+    }
+    if (self->focus != NULL && !is_in_model (self, self->focus))
+    {
+        g_clear_object (&self->focus);
+    }
+    if (self->rubberbanding)
+    {
+        prune_items (self, self->selection_before_band, removed);
+    }
+
+    return g_hash_table_size (self->selection) > 0 &&
+           prune_items (self, self->selection, removed) > 0;
+}
+
+void
+nautilus_view_icon_ui_set_selection (NautilusViewIconUi *self,
+                                     GQueue             *selection)
+{
+    GList *l;
+
+    g_hash_table_remove_all (self->selection);
+    for (l = g_queue_peek_head_link (selection); l != NULL; l = l->next)
+    {
+        g_hash_table_add (self->selection, g_object_ref (l->data));
+    }
+    set_anchor (self, g_queue_peek_head (selection));
+    set_focus_item (self, g_queue_peek_head (selection));
+
+    update_children_state (self);
+}
+
+typedef struct
+{
+    guint position;
+    NautilusViewItemModel *item;
+} SelectedItem;
+
+static gint
+compare_selected_items (gconstpointer a,
+                        gconstpointer b)
+{
+    const SelectedItem *item_a = a;
+    const SelectedItem *item_b = b;
+
+    return item_a->position < item_b->position ? -1 : (item_a->position > item_b->position ? 1 : 0);
+}
+
+GQueue *
+nautilus_view_icon_ui_get_selection (NautilusViewIconUi *self)
+{
+    g_autoptr (GArray) selected = NULL;
+    SelectedItem selected_item;
+    GQueue *selection;
+    GHashTableIter iter;
+    gpointer item;
+    guint n_selected, n_items, i;
+
+    selection = g_queue_new ();
+    n_selected = g_hash_table_size (self->selection);
+    n_items = get_n_items (self);
+    if (n_selected == 0)
+    {
+        return selection;
+    }
+
+    /* Finding the position of an item searches the model, so unless only
+     * a few are selected, walking the model once is cheaper.
+     */
+    if (n_selected * g_bit_storage (n_items) >= n_items)
+    {
+        for (i = 0; i < n_items && selection->length < n_selected; i++)
+        {
+            /* The model keeps its items alive. */
+            item = g_list_model_get_item (self->model, i);
+            g_object_unref (item);
+            if (g_hash_table_contains (self->selection, item))
+            {
+                g_queue_push_tail (selection, item);
+            }
+        }
+
+        return selection;
+    }
+
+    selected = g_array_sized_new (FALSE, FALSE, sizeof (SelectedItem), n_selected);
+    g_hash_table_iter_init (&iter, self->selection);
+    while (g_hash_table_iter_next (&iter, &item, NULL))
+    {
+        if (get_item_position (self, item, &selected_item.position))
+        {
+            selected_item.item = item;
+            g_array_append_val (selected, selected_item);
+        }
+    }
+    g_array_sort (selected, compare_selected_items);
+
+    for (i = 0; i < selected->len; i++)
+    {
+        g_queue_push_tail (selection, g_array_index (selected, SelectedItem, i).item);
+    }
+
+    return selection;
+}
+
+void
+nautilus_view_icon_ui_select_all (NautilusViewIconUi *self)
+{
+    guint n_items;
+
+    n_items = get_n_items (self);
+    if (n_items == 0)
+    {
+        return;
+    }
+
+    select_range (self, 0, n_items - 1);
+    notify_selection_changed (self);
+}
+
+/* Geometry */
+
+void
+nautilus_view_icon_ui_set_icon_size (NautilusViewIconUi *self,
+                                     guint               icon_size)
 {
+    if (self->icon_size == icon_size)
+    {
+        return;
+    }
+
+    self->icon_size = icon_size;
+    invalidate_cell_size (self);
+}
+
+static gboolean
+get_position_at_pos (NautilusViewIconUi *self,
+                     gint                x,
+                     gint                y,
+                     guint              *position)
+{
+    gdouble content_y;
+    guint column, row;
+
+    if (self->n_columns == 0 || x < MARGIN)
+    {
+        return FALSE;
+    }
+
+    content_y = y + get_scroll_offset (self) - MARGIN;
+    column = (x - MARGIN) / self->column_width;
+    if (content_y < 0 || column >= self->n_columns)
+    {
+        return FALSE;
+    }
+
+    row = content_y / self->cell_height;
+    *position = row * self->n_columns + column;
+
+    return *position < get_n_items (self);
+}
+
+NautilusViewItemModel *
+nautilus_view_icon_ui_get_item_at_pos (NautilusViewIconUi *self,
+                                       gint                x,
+                                       gint                y)
+{
+    NautilusViewItemModel *item;
+    guint position;
+
+    if (!get_position_at_pos (self, x, y, &position))
+    {
+        return NULL;
+    }
+
+    /* The model keeps its items alive. */
+    item = g_list_model_get_item (self->model, position);
+    g_object_unref (item);
+
+    return item;
+}
+
+gboolean
+nautilus_view_icon_ui_get_item_area (NautilusViewIconUi    *self,
+                                     NautilusViewItemModel *item,
+                                     GdkRectangle          *area)
+{
+    guint position;
+
+    if (self->n_columns == 0 || !get_item_position (self, item, &position))
+    {
+        return FALSE;
+    }
+
+    get_cell_area (self, position, area);
+
+    return TRUE;
+}
+
+static void
+reveal_position (NautilusViewIconUi *self,
+                 guint               position)
+{
+    gdouble top, bottom;
+    gdouble value, page_size;
+
+    if (self->vadjustment == NULL || self->n_columns == 0)
+    {
+        return;
+    }
+
+    top = MARGIN + (position / self->n_columns) * self->cell_height;
+    bottom = top + self->cell_height;
+    value = gtk_adjustment_get_value (self->vadjustment);
+    page_size = gtk_adjustment_get_page_size (self->vadjustment);
+
+    if (top < value)
+    {
+        gtk_adjustment_set_value (self->vadjustment, top - MARGIN);
+    }
+    else if (bottom > value + page_size)
+    {
+        gtk_adjustment_set_value (self->vadjustment, bottom + MARGIN - page_size);
+    }
+}
+
+void
+nautilus_view_icon_ui_reveal_item (NautilusViewIconUi    *self,
+                                   NautilusViewItemModel *item)
+{
+    guint position;
+
+    if (get_item_position (self, item, &position))
+    {
+        reveal_position (self, position);
+    }
+}
+
+/* Rubberband */
+
+/* The band in view coordinates. */
+static void
+get_band_area (NautilusViewIconUi *self,
+               GdkRectangle       *area)
+{
+    gdouble offset;
+
+    offset = get_scroll_offset (self);
+    area->x = MIN (self->band_start_x, self->band_end_x);
+    area->y = MIN (self->band_start_y, self->band_end_y) - offset;
+    area->width = ABS (self->band_end_x - self->band_start_x);
+    area->height = ABS (self->band_end_y - self->band_start_y);
+}
+
+/* The columns and rows of the cells the band touches, empty if none. */
+static void
+get_band_cells (NautilusViewIconUi *self,
+                GdkRectangle       *cells)
+{
+    gdouble x1, y1, x2, y2;
+    gint last_column, last_row;
+
+    cells->x = 0;
+    cells->y = 0;
+    cells->width = 0;
+    cells->height = 0;
+
+    x1 = MIN (self->band_start_x, self->band_end_x) - MARGIN;
+    x2 = MAX (self->band_start_x, self->band_end_x) - MARGIN;
+    y1 = MIN (self->band_start_y, self->band_end_y) - MARGIN;
+    y2 = MAX (self->band_start_y, self->band_end_y) - MARGIN;
+    if (self->n_columns == 0 || x2 < 0 || y2 < 0)
+    {
+        return;
+    }
+
+    cells->x = MAX (x1, 0) / self->column_width;
+    cells->y = MAX (y1, 0) / self->cell_height;
+    last_column = MIN ((gint) (x2 / self->column_width), (gint) self->n_columns - 1);
+    last_row = y2 / self->cell_height;
+
+    cells->width = MAX (last_column - cells->x + 1, 0);
+    cells->height = MAX (last_row - cells->y + 1, 0);
+}
+
+/* Like the canvas view, the band toggles the items it touches from how
+ * they were when it started. Returns TRUE if the selection changed.
+ */
+static gboolean
+update_band_selection (NautilusViewIconUi *self)
+{
+    GdkRectangle cells;
+    GHashTableIter iter;
+    gpointer item;
+    guint n_items, position;
+    gint row, column;
+
+    get_band_cells (self, &cells);
+    if (cells.x == self->band_cells.x && cells.y == self->band_cells.y &&
+        cells.width == self->band_cells.width && cells.height == self->band_cells.height)
+    {
+        return FALSE;
+    }
+    self->band_cells = cells;
+
+    g_hash_table_remove_all (self->selection);
+    g_hash_table_iter_init (&iter, self->selection_before_band);
+    while (g_hash_table_iter_next (&iter, &item, NULL))
+    {
+        g_hash_table_add (self->selection, g_object_ref (item));
+    }
+
+    n_items = get_n_items (self);
+    for (row = cells.y; row < cells.y + cells.height; row++)
+    {
+        for (column = cells.x; column < cells.x + cells.width; column++)
+        {
+            position = row * self->n_columns + column;
+            if (position >= n_items)
+            {
+                break;
+            }
+
+            /* The model keeps its items alive. */
+            item = g_list_model_get_item (self->model, position);
+            g_object_unref (item);
+            if (!g_hash_table_remove (self->selection, item))
+            {
+                g_hash_table_add (self->selection, g_object_ref (item));
+            }
+        }
+    }
+
+    return TRUE;
+}
+
+static void
+stop_rubberbanding (NautilusViewIconUi *self)
+{
+    if (!self->rubberbanding)
+    {
+        return;
+    }
+
+    self->rubberbanding = FALSE;
+    g_hash_table_remove_all (self->selection_before_band);
+    gtk_widget_queue_draw (GTK_WIDGET (self));
+
+    nautilus_files_view_stop_batching_selection_changes (NAUTILUS_FILES_VIEW (self->controller));
+}
+
+static void
+start_rubberbanding (NautilusViewIconUi *self,
+                     gdouble             x,
+                     gdouble             y)
+{
+    GHashTableIter iter;
+    gpointer item;
+
+    stop_rubberbanding (self);
+
+    self->rubberbanding = TRUE;
+    self->band_start_x = x;
+    self->band_start_y = y + get_scroll_offset (self);
+    self->band_end_x = self->band_start_x;
+    self->band_end_y = self->band_start_y;
+    get_band_cells (self, &self->band_cells);
+
+    g_hash_table_remove_all (self->selection_before_band);
+    g_hash_table_iter_init (&iter, self->selection);
+    while (g_hash_table_iter_next (&iter, &item, NULL))
+    {
+        g_hash_table_add (self->selection_before_band, g_object_ref (item));
+    }
+
+    nautilus_files_view_start_batching_selection_changes (NAUTILUS_FILES_VIEW (self->controller));
+}
+
+/* Events */
+
+static void
+activate_item (NautilusViewIconUi    *self,
+               NautilusViewItemModel *item)
+{
+    NautilusFile *file;
+    g_autoptr (GList) list = NULL;
+
+    file = nautilus_view_item_model_get_file (item);
+    list = g_list_append (list, file);
+
+    nautilus_files_view_activate_files (NAUTILUS_FILES_VIEW (self->controller), list, 0, TRUE);
+}
+
+static gboolean
+button_press_event (GtkWidget      *widget,
+                    GdkEventButton *event)
+{
+    NautilusViewIconUi *self = NAUTILUS_VIEW_ICON_UI (widget);
+    NautilusViewItemModel *item;
+    GdkModifierType modifiers;
+    guint anchor_position;
+    guint position;
+
+    if (!gtk_widget_has_focus (widget))
+    {
+        gtk_widget_grab_focus (widget);
+    }
+
+    if (event->button != GDK_BUTTON_PRIMARY)
+    {
+        return GDK_EVENT_PROPAGATE;
+    }
+
+    item = nautilus_view_icon_ui_get_item_at_pos (self, event->x, event->y);
+
+    if (event->type == GDK_2BUTTON_PRESS)
+    {
+        if (item != NULL)
+        {
+            activate_item (self, item);
+        }
+        return GDK_EVENT_STOP;
+    }
+
+    if (event->type != GDK_BUTTON_PRESS)
+    {
+        return GDK_EVENT_PROPAGATE;
+    }
+
+    modifiers = event->state & gtk_accelerator_get_default_mod_mask ();
+    if (item == NULL)
+    {
+        if ((modifiers & (GDK_CONTROL_MASK | GDK_SHIFT_MASK)) == 0)
+        {
+            select_only (self, NULL);
+        }
+        start_rubberbanding (self, event->x, event->y);
+    }
+    else if (modifiers & GDK_CONTROL_MASK)
+    {
+        if (!g_hash_table_remove (self->selection, item))
+        {
+            g_hash_table_add (self->selection, g_object_ref (item));
+        }
+        set_anchor (self, item);
+        set_focus_item (self, item);
+    }
+    else if ((modifiers & GDK_SHIFT_MASK) && self->anchor != NULL &&
+             get_item_position (self, self->anchor, &anchor_position) &&
+             get_item_position (self, item, &position))
+    {
+        select_range (self, anchor_position, position);
+        set_focus_item (self, item);
+    }
+    else
+    {
+        select_only (self, item);
+    }
+
+    notify_selection_changed (self);
+
+    return GDK_EVENT_STOP;
+}
+
+static gboolean
+motion_notify_event (GtkWidget      *widget,
+                     GdkEventMotion *event)
+{
+    NautilusViewIconUi *self = NAUTILUS_VIEW_ICON_UI (widget);
+    gdouble value, height;
+
+    if (!self->rubberbanding)
+    {
+        return GDK_EVENT_PROPAGATE;
+    }
+
+    /* Scrolls along when dragged past the top or the bottom. */
+    height = gtk_widget_get_allocated_height (widget);
+    if (self->vadjustment != NULL && (event->y < 0 || event->y > height))
+    {
+        value = gtk_adjustment_get_value (self->vadjustment);
+        gtk_adjustment_set_value (self->vadjustment,
+                                  value + (event->y < 0 ? event->y : event->y - height));
+    }
+
+    self->band_end_x = CLAMP (event->x, 0, gtk_widget_get_allocated_width (widget));
+    self->band_end_y = CLAMP (event->y, 0, height) + get_scroll_offset (self);
+    if (update_band_selection (self))
+    {
+        notify_selection_changed (self);
+    }
+    gtk_widget_queue_draw (widget);
+
+    return GDK_EVENT_STOP;
+}
+
+static gboolean
+button_release_event (GtkWidget      *widget,
+                      GdkEventButton *event)
+{
+    NautilusViewIconUi *self = NAUTILUS_VIEW_ICON_UI (widget);
+
+    if (event->button != GDK_BUTTON_PRIMARY || !self->rubberbanding)
+    {
+        return GDK_EVENT_PROPAGATE;
+    }
+
+    stop_rubberbanding (self);
+
+    return GDK_EVENT_STOP;
+}
+
+static gboolean
+key_press_event (GtkWidget   *widget,
+                 GdkEventKey *event)
+{
+    NautilusViewIconUi *self = NAUTILUS_VIEW_ICON_UI (widget);
+    NautilusViewItemModel *item;
+    GdkModifierType modifiers;
+    guint n_items;
+    guint position;
+    guint anchor_position;
+    gint64 target;
+
+    n_items = get_n_items (self);
+    if (n_items == 0 || self->n_columns == 0)
+    {
+        return GTK_WIDGET_CLASS (nautilus_view_icon_ui_parent_class)->key_press_event (widget, event);
+    }
+
+    if (self->focus == NULL || !get_item_position (self, self->focus, &position))
+    {
+        position = 0;
+    }
+    modifiers = event->state & gtk_accelerator_get_default_mod_mask ();
+
+    switch (event->keyval)
+    {
+        case GDK_KEY_Return:
+        case GDK_KEY_KP_Enter:
+        {
+            if (self->focus != NULL)
+            {
+                activate_item (self, self->focus);
+            }
+        }
+        return GDK_EVENT_STOP;
+
+        case GDK_KEY_space:
+        {
+            if (self->focus == NULL)
+            {
+                return GDK_EVENT_STOP;
+            }
+
+            if (modifiers & GDK_CONTROL_MASK)
+            {
+                if (!g_hash_table_remove (self->selection, self->focus))
+                {
+                    g_hash_table_add (self->selection, g_object_ref (self->focus));
+                }
+                set_anchor (self, self->focus);
+                notify_selection_changed (self);
+            }
+            else
+            {
+                activate_item (self, self->focus);
+            }
+        }
+        return GDK_EVENT_STOP;
+
+        case GDK_KEY_Left:
+        case GDK_KEY_KP_Left:
+        {
+            target = (gint64) position - 1;
+        }
+        break;
+
+        case GDK_KEY_Right:
+        case GDK_KEY_KP_Right:
+        {
+            target = (gint64) position + 1;
+        }
+        break;
+
+        case GDK_KEY_Up:
+        case GDK_KEY_KP_Up:
+        {
+            target = (gint64) position - self->n_columns;
+        }
+        break;
+
+        case GDK_KEY_Down:
+        case GDK_KEY_KP_Down:
+        {
+            target = (gint64) position + self->n_columns;
+        }
+        break;
+
+        case GDK_KEY_Home:
+        case GDK_KEY_KP_Home:
+        {
+            target = 0;
+        }
+        break;
+
+        case GDK_KEY_End:
+        case GDK_KEY_KP_End:
+        {
+            target = n_items - 1;
+        }
+        break;
+
+        default:
+        {
+            return GTK_WIDGET_CLASS (nautilus_view_icon_ui_parent_class)->key_press_event (widget, event);
+        }
+    }
+
+    if (self->focus == NULL)
+    {
+        target = 0;
+    }
+    position = CLAMP (target, 0, (gint64) n_items - 1);
+
+    /* Shift selects from the anchor to there, control only moves the
+     * focus, and otherwise the selection follows the focus.
+     */
+    item = g_list_model_get_item (self->model, position);
+    if ((modifiers & GDK_SHIFT_MASK) && self->anchor != NULL &&
+        get_item_position (self, self->anchor, &anchor_position))
+    {
+        select_range (self, anchor_position, position);
+        set_focus_item (self, item);
+        notify_selection_changed (self);
+    }
+    else if (modifiers & GDK_CONTROL_MASK)
+    {
+        set_focus_item (self, item);
+    }
+    else
+    {
+        select_only (self, item);
+        notify_selection_changed (self);
+    }
+    g_object_unref (item);
+    reveal_position (self, position);
+
+    return GDK_EVENT_STOP;
+}
+
+/* Scrolling */
+
+static void
+on_adjustment_value_changed (GtkAdjustment *adjustment,
+                             gpointer       user_data)
+{
+    NautilusViewIconUi *self = NAUTILUS_VIEW_ICON_UI (user_data);
+
+    update_children (self);
+    gtk_widget_queue_allocate (GTK_WIDGET (self));
+}
+
+static void
+replace_adjustment (NautilusViewIconUi  *self,
+                    GtkAdjustment      **slot,
+                    GtkAdjustment       *adjustment)
+{
+    if (*slot == adjustment)
+    {
+        return;
+    }
+
+    if (*slot != NULL)
+    {
+        g_signal_handlers_disconnect_by_data (*slot, self);
+        g_clear_object (slot);
+    }
+
+    if (adjustment == NULL)
+    {
+        adjustment = gtk_adjustment_new (0, 0, 0, 0, 0, 0);
+    }
+    *slot = g_object_ref_sink (adjustment);
+    g_signal_connect (adjustment, "value-changed",
+                      (GCallback) on_adjustment_value_changed, self);
+
+    gtk_widget_queue_resize (GTK_WIDGET (self));
+}
+
+static void
+set_hadjustment (NautilusViewIconUi *self,
+                 GtkAdjustment      *adjustment)
+{
+    replace_adjustment (self, &self->hadjustment, adjustment);
+    g_object_notify (G_OBJECT (self), "hadjustment");
+}
+
+static void
+set_vadjustment (NautilusViewIconUi *self,
+                 GtkAdjustment      *adjustment)
+{
+    replace_adjustment (self, &self->vadjustment, adjustment);
+    g_object_notify (G_OBJECT (self), "vadjustment");
+}
+
+static void
+configure_adjustments (NautilusViewIconUi *self,
+                       gint                width,
+                       gint                height)
+{
+    gint content_height;
+
+    if (self->hadjustment != NULL)
+    {
+        /* The columns always fit, so there is nothing to scroll sideways. */
+        gtk_adjustment_configure (self->hadjustment, 0, 0, width, width * 0.1, width * 0.9, width);
+    }
+
+    if (self->vadjustment != NULL)
+    {
+        content_height = MAX (get_content_height (self), height);
+        gtk_adjustment_configure (self->vadjustment,
+                                  CLAMP (gtk_adjustment_get_value (self->vadjustment),
+                                         0, content_height - height),
+                                  0, content_height,
+                                  MAX (self->cell_height / 2, 1),
+                                  height * 0.9,
+                                  height);
+    }
+}
+
+/* Model */
+
+static void
+on_items_changed (GListModel *model,
+                  guint       position,
+                  guint       removed,
+                  guint       added,
+                  gpointer    user_data)
+{
+    NautilusViewIconUi *self = NAUTILUS_VIEW_ICON_UI (user_data);
+
+    if (removed > 0 && prune_selection (self, removed))
+    {
+        notify_selection_changed (self);
+    }
+
+    if (get_n_items (self) == 0)
+    {
+        invalidate_cell_size (self);
+    }
+
+    update_children (self);
+    gtk_widget_queue_resize (GTK_WIDGET (self));
+}
+
+/* GtkWidget */
+
+static void
+get_preferred_width (GtkWidget *widget,
+                     gint      *minimum_size,
+                     gint      *natural_size)
+{
+    NautilusViewIconUi *self = NAUTILUS_VIEW_ICON_UI (widget);
+
+    ensure_cell_size (self);
+    *minimum_size = 2 * MARGIN + self->cell_width;
+    *natural_size = *minimum_size;
+}
+
+static void
+get_preferred_height (GtkWidget *widget,
+                      gint      *minimum_size,
+                      gint      *natural_size)
+{
+    NautilusViewIconUi *self = NAUTILUS_VIEW_ICON_UI (widget);
+
+    ensure_cell_size (self);
+    *minimum_size = 2 * MARGIN + self->cell_height;
+    *natural_size = MAX (*minimum_size, get_content_height (self));
+}
+
+static void
+size_allocate (GtkWidget     *widget,
+               GtkAllocation *allocation)
+{
+    NautilusViewIconUi *self = NAUTILUS_VIEW_ICON_UI (widget);
+
+    gtk_widget_set_allocation (widget, allocation);
+    if (gtk_widget_get_realized (widget))
+    {
+        gdk_window_move_resize (gtk_widget_get_window (widget),
+                                allocation->x, allocation->y,
+                                allocation->width, allocation->height);
+    }
+
+    update_layout (self, allocation->width);
+    /* The children are placed below, not on the value-changed of the
+     * clamped scroll value.
+     */
+    if (self->vadjustment != NULL)
+    {
+        g_signal_handlers_block_by_func (self->vadjustment, on_adjustment_value_changed, self);
+    }
+    configure_adjustments (self, allocation->width, allocation->height);
+    if (self->vadjustment != NULL)
+    {
+        g_signal_handlers_unblock_by_func (self->vadjustment, on_adjustment_value_changed, self);
+    }
+    update_children (self);
+    allocate_children (self);
+}
+
+static void
+realize (GtkWidget *widget)
+{
+    GtkAllocation allocation;
+    GdkWindowAttr attributes;
+    GdkWindow *window;
+
+    gtk_widget_set_realized (widget, TRUE);
+    gtk_widget_get_allocation (widget, &allocation);
+
+    attributes.window_type = GDK_WINDOW_CHILD;
+    attributes.x = allocation.x;
+    attributes.y = allocation.y;
+    attributes.width = allocation.width;
+    attributes.height = allocation.height;
+    attributes.wclass = GDK_INPUT_OUTPUT;
+    attributes.visual = gtk_widget_get_visual (widget);
+    attributes.event_mask = gtk_widget_get_events (widget) |
+                            GDK_BUTTON_PRESS_MASK |
+                            GDK_BUTTON_RELEASE_MASK |
+                            GDK_BUTTON1_MOTION_MASK |
+                            GDK_KEY_PRESS_MASK;
+
+    window = gdk_window_new (gtk_widget_get_parent_window (widget),
+                             &attributes,
+                             GDK_WA_X | GDK_WA_Y | GDK_WA_VISUAL);
+    gtk_widget_set_window (widget, window);
+    gtk_widget_register_window (widget, window);
+}
+
+static void
+unmap (GtkWidget *widget)
+{
+    stop_rubberbanding (NAUTILUS_VIEW_ICON_UI (widget));
+
+    GTK_WIDGET_CLASS (nautilus_view_icon_ui_parent_class)->unmap (widget);
+}
+
+static gboolean
+draw (GtkWidget *widget,
+      cairo_t   *cr)
+{
+    NautilusViewIconUi *self = NAUTILUS_VIEW_ICON_UI (widget);
+    GtkStyleContext *context;
+    GdkRectangle area;
+
+    if (!gtk_cairo_should_draw_window (cr, gtk_widget_get_window (widget)))
+    {
+        return GTK_WIDGET_CLASS (nautilus_view_icon_ui_parent_class)->draw (widget, cr);
+    }
+
+    context = gtk_widget_get_style_context (widget);
+    gtk_render_background (context, cr, 0, 0,
+                           gtk_widget_get_allocated_width (widget),
+                           gtk_widget_get_allocated_height (widget));
+
+    GTK_WIDGET_CLASS (nautilus_view_icon_ui_parent_class)->draw (widget, cr);
+
+    if (self->focus != NULL && gtk_widget_has_visible_focus (widget) &&
+        nautilus_view_icon_ui_get_item_area (self, self->focus, &area))
+    {
+        gtk_render_focus (context, cr, area.x, area.y, area.width, area.height);
+    }
+
+    if (self->rubberbanding)
+    {
+        get_band_area (self, &area);
+        gtk_style_context_save (context);
+        gtk_style_context_add_class (context, GTK_STYLE_CLASS_RUBBERBAND);
+        gtk_render_background (context, cr, area.x, area.y, area.width, area.height);
+        gtk_render_frame (context, cr, area.x, area.y, area.width, area.height);
+        gtk_style_context_restore (context);
+    }
+
+    return GDK_EVENT_PROPAGATE;
+}
+
+static void
+style_updated (GtkWidget *widget)
+{
+    GTK_WIDGET_CLASS (nautilus_view_icon_ui_parent_class)->style_updated (widget);
+
+    /* Fonts change the height of the labels. */
+    invalidate_cell_size (NAUTILUS_VIEW_ICON_UI (widget));
+}
+
+/* GtkContainer */
+
+static void
+container_add (GtkContainer *container,
+               GtkWidget    *widget)
+{
+    g_warning ("The icon view makes its own children");
+}
+
+static void
+container_remove (GtkContainer *container,
+                  GtkWidget    *widget)
+{
+    NautilusViewIconUi *self = NAUTILUS_VIEW_ICON_UI (container);
+    GHashTableIter iter;
+    gpointer item, child;
+
+    if (widget == GTK_WIDGET (self->probe))
+    {
+        self->probe = NULL;
+    }
+    else if (!g_queue_remove (&self->recycled, widget))
+    {
+        g_hash_table_iter_init (&iter, self->children);
+        while (g_hash_table_iter_next (&iter, &item, &child))
+        {
+            if (child == widget)
+            {
+                nautilus_view_item_model_set_item_ui (item, NULL);
+                g_hash_table_iter_remove (&iter);
+                break;
+            }
+        }
+    }
+
+    gtk_widget_unparent (widget);
+}
+
+static void
+container_forall (GtkContainer *container,
+                  gboolean      include_internals,
+                  GtkCallback   callback,
+                  gpointer      callback_data)
+{
+    NautilusViewIconUi *self = NAUTILUS_VIEW_ICON_UI (container);
+    g_autoptr (GList) children = NULL;
+    GList *l;
+
+    /* The callback may remove children. */
+    children = g_hash_table_get_values (self->children);
+    for (l = g_queue_peek_head_link (&self->recycled); l != NULL; l = l->next)
+    {
+        children = g_list_prepend (children, l->data);
+    }
+    if (include_internals && self->probe != NULL)
+    {
+        children = g_list_prepend (children, self->probe);
+    }
+
+    for (l = children; l != NULL; l = l->next)
+    {
+        callback (l->data, callback_data);
+    }
+}
+
+/* GObject */
+
+static void
+dispose (GObject *object)
+{
+    NautilusViewIconUi *self = NAUTILUS_VIEW_ICON_UI (object);
+
+    if (self->model != NULL)
+    {
+        g_signal_handlers_disconnect_by_data (self->model, self);
+        self->model = NULL;
+    }
+
+    if (self->probe != NULL)
+    {
+        gtk_widget_unparent (GTK_WIDGET (self->probe));
+        self->probe = NULL;
+    }
+
+    /* Unparents the other children through container_remove (). */
+    G_OBJECT_CLASS (nautilus_view_icon_ui_parent_class)->dispose (object);
+
+    if (self->hadjustment != NULL)
+    {
+        g_signal_handlers_disconnect_by_data (self->hadjustment, self);
+        g_clear_object (&self->hadjustment);
+    }
+    if (self->vadjustment != NULL)
+    {
+        g_signal_handlers_disconnect_by_data (self->vadjustment, self);
+        g_clear_object (&self->vadjustment);
+    }
+    g_clear_object (&self->anchor);
+    g_clear_object (&self->focus);
+    g_hash_table_remove_all (self->selection);
+    g_hash_table_remove_all (self->selection_before_band);
+}
+
+static void
+finalize (GObject *object)
+{
+    NautilusViewIconUi *self = NAUTILUS_VIEW_ICON_UI (object);
+
+    g_hash_table_destroy (self->children);
+    g_hash_table_destroy (self->selection);
+    g_hash_table_destroy (self->selection_before_band);
+
+    G_OBJECT_CLASS (nautilus_view_icon_ui_parent_class)->finalize (object);
+}
+
+static void
+constructed (GObject *object)
+{
+    NautilusViewIconUi *self = NAUTILUS_VIEW_ICON_UI (object);
+    NautilusViewModel *model;
+
+    G_OBJECT_CLASS (nautilus_view_icon_ui_parent_class)->constructed (object);
+
+    model = nautilus_view_icon_controller_get_model (self->controller);
+    self->model = G_LIST_MODEL (nautilus_view_model_get_g_model (model));
+    g_signal_connect (self->model, "items-changed", (GCallback) on_items_changed, self);
+}
+
+static void
+nautilus_view_icon_ui_scrollable_init (GtkScrollableInterface *iface)
+{
+}
+
+static void
+nautilus_view_icon_ui_class_init (NautilusViewIconUiClass *klass)
+{
+    GObjectClass *object_class = G_OBJECT_CLASS (klass);
+    GtkWidgetClass *widget_class = GTK_WIDGET_CLASS (klass);
+    GtkContainerClass *container_class = GTK_CONTAINER_CLASS (klass);
+
+    object_class->dispose = dispose;
+    object_class->finalize = finalize;
+    object_class->set_property = set_property;
+    object_class->get_property = get_property;
+    object_class->constructed = constructed;
+
+    widget_class->get_preferred_width = get_preferred_width;
+    widget_class->get_preferred_height = get_preferred_height;
+    widget_class->size_allocate = size_allocate;
+    widget_class->realize = realize;
+    widget_class->unmap = unmap;
+    widget_class->draw = draw;
+    widget_class->style_updated = style_updated;
+    widget_class->button_press_event = button_press_event;
+    widget_class->button_release_event = button_release_event;
+    widget_class->motion_notify_event = motion_notify_event;
+    widget_class->key_press_event = key_press_event;
+
+    container_class->add = container_add;
+    container_class->remove = container_remove;
+    container_class->forall = container_forall;
+
+    g_object_class_install_property (object_class,
+                                     PROP_CONTROLLER,
+                                     g_param_spec_object ("controller",
+                                                          "Controller",
+                                                          "The controller of the view",
+                                                          NAUTILUS_TYPE_VIEW_ICON_CONTROLLER,
+                                                          G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY));
+
+    g_object_class_override_property (object_class, PROP_HADJUSTMENT, "hadjustment");
+    g_object_class_override_property (object_class, PROP_VADJUSTMENT, "vadjustment");
+    g_object_class_override_property (object_class, PROP_HSCROLL_POLICY, "hscroll-policy");
+    g_object_class_override_property (object_class, PROP_VSCROLL_POLICY, "vscroll-policy");
+}
+
+static void
+nautilus_view_icon_ui_init (NautilusViewIconUi *self)
+{
+    gtk_widget_set_has_window (GTK_WIDGET (self), TRUE);
+    gtk_widget_set_can_focus (GTK_WIDGET (self), TRUE);
+
+    self->children = g_hash_table_new (NULL, NULL);
+    g_queue_init (&self->recycled);
+    self->selection = g_hash_table_new_full (NULL, NULL, g_object_unref, NULL);
+    self->selection_before_band = g_hash_table_new_full (NULL, NULL, g_object_unref, NULL);
+
+    /* Parented so it gets the same style as the other children. */
+    self->probe = nautilus_view_icon_item_ui_new (NULL);
+    gtk_widget_set_parent (GTK_WIDGET (self->probe), GTK_WIDGET (self));
+    gtk_widget_set_child_visible (GTK_WIDGET (self->probe), FALSE);
+    gtk_widget_show (GTK_WIDGET (self->probe));
 }
 
 NautilusViewIconUi *
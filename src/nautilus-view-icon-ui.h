@@ -22,18 +22,34 @@
 #include <gtk/gtk.h>
 
 #include "nautilus-view-icon-controller.h"
+#include "nautilus-view-item-model.h"
 
 G_BEGIN_DECLS
 
 #define NAUTILUS_TYPE_VIEW_ICON_UI (nautilus_view_icon_ui_get_type())
 
-G_DECLARE_FINAL_TYPE (NautilusViewIconUi, nautilus_view_icon_ui, NAUTILUS, VIEW_ICON_UI, GtkFlowBox)
+G_DECLARE_FINAL_TYPE (NautilusViewIconUi, nautilus_view_icon_ui, NAUTILUS, VIEW_ICON_UI, GtkContainer)
 
 NautilusViewIconUi * nautilus_view_icon_ui_new (NautilusViewIconController *controller);
 /* TODO: this should become the "nautilus_view_set_selection" once we have a proper
  * MVC also in the nautilus-view level. */
 void nautilus_view_icon_ui_set_selection (NautilusViewIconUi *self,
                                           GQueue             *selection);
+/* The selected item models, in the order of the view. */
+GQueue * nautilus_view_icon_ui_get_selection (NautilusViewIconUi *self);
+void nautilus_view_icon_ui_select_all (NautilusViewIconUi *self);
+
+void nautilus_view_icon_ui_set_icon_size (NautilusViewIconUi *self,
+                                          guint               icon_size);
+/* x and y are relative to the view, as in its events. */
+NautilusViewItemModel * nautilus_view_icon_ui_get_item_at_pos (NautilusViewIconUi *self,
+                                                               gint                x,
+                                                               gint                y);
+gboolean nautilus_view_icon_ui_get_item_area (NautilusViewIconUi    *self,
+                                              NautilusViewItemModel *item,
+                                              GdkRectangle          *area);
+void nautilus_view_icon_ui_reveal_item (NautilusViewIconUi    *self,
+                                        NautilusViewItemModel *item);
 
 G_END_DECLS
 
@@ -1,6 +1,7 @@
 #include "nautilus-view-model.h"
 #include "nautilus-view-item-model.h"
 #include "nautilus-global-preferences.h"
+#include "nautilus-parallel-sort.h"
 
 struct _NautilusViewModel
 {
@@ -133,6 +134,44 @@ compare_data_func (gconstpointer a,
                                            self->sort_data->reversed);
 }
 
+static gint
+compare_data_func_indirect (gconstpointer a,
+                            gconstpointer b,
+                            gpointer      user_data)
+{
+    return compare_data_func (*(gpointer *) a, *(gpointer *) b, user_data);
+}
+
+/* Sorts items for the store, on several threads when the files of all
+ * of them can be compared off the main thread.
+ */
+static void
+sort_items (NautilusViewModel *self,
+            gpointer          *items,
+            guint              n_items)
+{
+    NautilusFile *file;
+    gboolean threaded;
+    guint i;
+
+    threaded = TRUE;
+    for (i = 0; i < n_items && threaded; i++)
+    {
+        file = nautilus_view_item_model_get_file (items[i]);
+        threaded = nautilus_file_prepare_for_threaded_sort (file, self->sort_data->sort_type);
+    }
+
+    if (threaded)
+    {
+        nautilus_parallel_sort (items, n_items, compare_data_func, self);
+    }
+    else
+    {
+        g_qsort_with_data (items, n_items, sizeof (gpointer),
+                           compare_data_func_indirect, self);
+    }
+}
+
 NautilusViewModel *
 nautilus_view_model_new ()
 {
@@ -143,6 +182,9 @@ void
 nautilus_view_model_set_sort_type (NautilusViewModel         *self,
                                    NautilusViewModelSortData *sort_data)
 {
+    g_autofree gpointer *items = NULL;
+    guint n_items, i;
+
     if (self->sort_data)
     {
         g_free (self->sort_data);
@@ -153,7 +195,23 @@ nautilus_view_model_set_sort_type (NautilusViewModel         *self,
     self->sort_data->reversed = sort_data->reversed;
     self->sort_data->directories_first = sort_data->directories_first;
 
-    g_list_store_sort (self->internal_model, compare_data_func, self);
+    /* The items are sorted apart from the store and put back with one
+     * splice, so the store is reported as changed once.
+     */
+    n_items = g_list_model_get_n_items (G_LIST_MODEL (self->internal_model));
+    items = g_new (gpointer, n_items);
+    for (i = 0; i < n_items; i++)
+    {
+        items[i] = g_list_model_get_item (G_LIST_MODEL (self->internal_model), i);
+    }
+
+    sort_items (self, items, n_items);
+    g_list_store_splice (self->internal_model, 0, n_items, items, n_items);
+
+    for (i = 0; i < n_items; i++)
+    {
+        g_object_unref (items[i]);
+    }
 }
 
 NautilusViewModelSortData *
@@ -168,6 +226,99 @@ nautilus_view_model_get_g_model (NautilusViewModel *self)
     return self->internal_model;
 }
 
+/* The store is kept sorted, so an item is found by bisecting it and
+ * looking at the items that sort the same around there. A file that
+ * changed may not be where its sort order says anymore, so that falls
+ * back to looking through all of them. Returns FALSE if the item isn't
+ * in the store.
+ */
+static gboolean
+find_item_position (NautilusViewModel     *self,
+                    NautilusViewItemModel *item,
+                    guint                 *position)
+{
+    GListModel *model;
+    gpointer current;
+    guint low, high, middle, n_items, i;
+    gint cmp;
+
+    model = G_LIST_MODEL (self->internal_model);
+    n_items = g_list_model_get_n_items (model);
+
+    if (self->sort_data != NULL)
+    {
+        low = 0;
+        high = n_items;
+        cmp = 1;
+        while (low < high)
+        {
+            middle = low + (high - low) / 2;
+            current = g_list_model_get_item (model, middle);
+            cmp = compare_data_func (current, item, self);
+            g_object_unref (current);
+
+            if (cmp < 0)
+            {
+                low = middle + 1;
+            }
+            else
+            {
+                high = middle;
+            }
+        }
+
+        /* low is the first item that doesn't sort before it. */
+        for (i = low; i < n_items; i++)
+        {
+            current = g_list_model_get_item (model, i);
+            cmp = compare_data_func (current, item, self);
+            g_object_unref (current);
+
+            if (current == item)
+            {
+                *position = i;
+                return TRUE;
+            }
+            if (cmp > 0)
+            {
+                break;
+            }
+        }
+    }
+
+    for (i = 0; i < n_items; i++)
+    {
+        current = g_list_model_get_item (model, i);
+        g_object_unref (current);
+
+        if (current == item)
+        {
+            *position = i;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+gboolean
+nautilus_view_model_get_item_position (NautilusViewModel     *self,
+                                       NautilusViewItemModel *item,
+                                       guint                 *position)
+{
+    return find_item_position (self, item, position);
+}
+
+static gint
+compare_positions (gconstpointer a,
+                   gconstpointer b)
+{
+    guint position_a = *(const guint *) a;
+    guint position_b = *(const guint *) b;
+
+    return position_a < position_b ? 1 : (position_a > position_b ? -1 : 0);
+}
+
 GQueue *
 nautilus_view_model_get_items_from_files (NautilusViewModel *self,
                                           GQueue            *files)
@@ -179,26 +330,10 @@ nautilus_view_model_get_items_from_files (NautilusViewModel *self,
     item_models = g_queue_new ();
     for (l = g_queue_peek_head_link (files); l != NULL; l = l->next)
     {
-        NautilusFile *file1;
-        gint i = 0;
-
-        file1 = NAUTILUS_FILE (l->data);
-        while ((item_model = g_list_model_get_item (G_LIST_MODEL (self->internal_model), i)))
+        item_model = g_hash_table_lookup (self->map_files_to_model, l->data);
+        if (item_model != NULL)
         {
-            NautilusFile *file2;
-            g_autofree gchar *file1_uri;
-            g_autofree gchar *file2_uri;
-
-            file2 = nautilus_view_item_model_get_file (item_model);
-            file1_uri = nautilus_file_get_uri (file1);
-            file2_uri = nautilus_file_get_uri (file2);
-            if (g_strcmp0 (file1_uri, file2_uri) == 0)
-            {
-                g_queue_push_tail (item_models, item_model);
-                break;
-            }
-
-            i++;
+            g_queue_push_tail (item_models, item_model);
         }
     }
 
@@ -216,28 +351,70 @@ void
 nautilus_view_model_remove_item (NautilusViewModel     *self,
                                  NautilusViewItemModel *item)
 {
-    NautilusViewItemModel *item_model;
-    gint i;
+    NautilusFile *file;
+    guint position;
 
-    i = 0;
-    item_model = NULL;
-    while ((item_model = g_list_model_get_item (G_LIST_MODEL (self->internal_model), i)))
+    if (item == NULL || !find_item_position (self, item, &position))
+    {
+        return;
+    }
+
+    file = nautilus_view_item_model_get_file (item);
+    g_hash_table_remove (self->map_files_to_model, file);
+    g_list_store_remove (self->internal_model, position);
+}
+
+void
+nautilus_view_model_remove_items (NautilusViewModel *self,
+                                  GQueue            *items)
+{
+    g_autoptr (GArray) positions = NULL;
+    NautilusViewItemModel *item;
+    NautilusFile *file;
+    GList *l;
+    guint position, n_positions, first, i;
+
+    positions = g_array_sized_new (FALSE, FALSE, sizeof (guint), g_queue_get_length (items));
+    for (l = g_queue_peek_head_link (items); l != NULL; l = l->next)
     {
-        if (item_model == item)
+        item = l->data;
+        file = nautilus_view_item_model_get_file (item);
+
+        /* Only the item the file is shown with, once. */
+        if (g_hash_table_lookup (self->map_files_to_model, file) == item &&
+            find_item_position (self, item, &position))
         {
-            break;
+            g_array_append_val (positions, position);
+            g_hash_table_remove (self->map_files_to_model, file);
         }
+    }
 
-        i++;
+    /* From the end, so the positions left stay right, removing runs of
+     * neighbours at once. The same position can't be removed twice.
+     */
+    g_array_sort (positions, compare_positions);
+    for (i = 1, n_positions = MIN (positions->len, 1); i < positions->len; i++)
+    {
+        if (g_array_index (positions, guint, i) != g_array_index (positions, guint, n_positions - 1))
+        {
+            g_array_index (positions, guint, n_positions++) = g_array_index (positions, guint, i);
+        }
     }
+    g_array_set_size (positions, n_positions);
 
-    if (item_model != NULL)
+    for (i = 0; i < positions->len; i = first + 1)
     {
-        NautilusFile *file;
+        for (first = i;
+             first + 1 < positions->len &&
+             g_array_index (positions, guint, first + 1) == g_array_index (positions, guint, first) - 1;
+             first++)
+        {
+        }
 
-        file = nautilus_view_item_model_get_file (item_model);
-        g_list_store_remove (self->internal_model, i);
-        g_hash_table_remove (self->map_files_to_model, file);
+        g_list_store_splice (self->internal_model,
+                             g_array_index (positions, guint, first),
+                             first - i + 1,
+                             NULL, 0);
     }
 }
 
@@ -258,17 +435,60 @@ nautilus_view_model_add_item (NautilusViewModel     *self,
     g_list_store_insert_sorted (self->internal_model, item, compare_data_func, self);
 }
 
+/* The first position, from low on, whose item sorts after item. */
+static guint
+find_insert_position (NautilusViewModel     *self,
+                      NautilusViewItemModel *item,
+                      guint                  low)
+{
+    GListModel *model;
+    gpointer current;
+    guint high, middle;
+    gint cmp;
+
+    model = G_LIST_MODEL (self->internal_model);
+    high = g_list_model_get_n_items (model);
+    while (low < high)
+    {
+        middle = low + (high - low) / 2;
+        current = g_list_model_get_item (model, middle);
+        cmp = compare_data_func (current, item, self);
+        g_object_unref (current);
+
+        if (cmp <= 0)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+/* The batch is sorted on its own and merged into the items already there,
+ * so each run of new items landing between the same two old ones goes in
+ * with a single splice, and the old items are never moved around.
+ */
 void
 nautilus_view_model_add_items (NautilusViewModel *self,
                                GQueue            *items)
 {
     g_autofree gpointer *array = NULL;
     GList *l;
-    int i = 0;
+    guint n_items, position, i, j;
 
-    array = g_malloc_n (g_queue_get_length (items),
-                        sizeof (NautilusViewItemModel *));
+    n_items = g_queue_get_length (items);
+    if (n_items == 0)
+    {
+        return;
+    }
+
+    array = g_malloc_n (n_items, sizeof (NautilusViewItemModel *));
 
+    i = 0;
     for (l = g_queue_peek_head_link (items); l != NULL; l = l->next)
     {
         array[i] = l->data;
@@ -278,11 +498,33 @@ nautilus_view_model_add_items (NautilusViewModel *self,
         i++;
     }
 
-    g_list_store_splice (self->internal_model,
-                         g_list_model_get_n_items (G_LIST_MODEL (self->internal_model)),
-                         0, array, g_queue_get_length (items));
+    sort_items (self, array, n_items);
+
+    position = 0;
+    for (i = 0; i < n_items; i = j)
+    {
+        position = find_insert_position (self, array[i], position);
+
+        /* The new items that also sort before the old one at position. */
+        j = i + 1;
+        if (position < g_list_model_get_n_items (G_LIST_MODEL (self->internal_model)))
+        {
+            g_autoptr (GObject) next = NULL;
+
+            next = g_list_model_get_item (G_LIST_MODEL (self->internal_model), position);
+            while (j < n_items && compare_data_func (array[j], next, self) < 0)
+            {
+                j++;
+            }
+        }
+        else
+        {
+            j = n_items;
+        }
 
-    g_list_store_sort (self->internal_model, compare_data_func, self);
+        g_list_store_splice (self->internal_model, position, 0, array + i, j - i);
+        position += j - i;
+    }
 }
 
 void
@@ -306,9 +548,9 @@ nautilus_view_model_set_items (NautilusViewModel *self,
         i++;
     }
 
+    sort_items (self, array, g_queue_get_length (items));
+
     g_list_store_splice (self->internal_model,
                          0, g_list_model_get_n_items (G_LIST_MODEL (self->internal_model)),
                          array, g_queue_get_length (items));
-
-    g_list_store_sort (self->internal_model, compare_data_func, self);
 }
@@ -0,0 +1,348 @@
+/*
+ *  nautilus-work-queue.c: Work shared out to a pool of threads.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 2 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Deep counts, searches and sorts share one pool of threads, so that
+ * several of them at once don't start more threads than the machine
+ * can use. A worker of a queue only holds on to a thread of the pool
+ * while there are items for it: one that finds none, not even to take
+ * from another worker, gives the thread back, and a new one is started
+ * when more work shows up. Workers still waiting for a thread when the
+ * work is done find nothing left to do once they get one, so they hold
+ * a reference on the queue.
+ */
+
+#include <config.h>
+#include "nautilus-work-queue.h"
+
+#define MIN_POOL_THREADS 4
+#define MAX_POOL_THREADS 16
+
+struct NautilusWorkQueue
+{
+    gint ref_count;
+
+    GMutex mutex;
+    GCond stopped;          /* a worker stopped */
+
+    GQueue *items;          /* one queue per worker */
+    gboolean *busy;         /* workers taken by a thread */
+    guint n_workers;
+    guint n_busy;
+    guint n_running;        /* busy, or waiting for a thread */
+    gboolean started;
+    gboolean done;
+
+    NautilusWorkQueueFunc func;
+    GDestroyNotify item_free_func;
+    GCancellable *cancellable;
+    NautilusWorkQueueDoneFunc done_func;
+    gpointer user_data;
+};
+
+static void pool_func (gpointer data,
+                       gpointer user_data);
+
+static GThreadPool *
+get_pool (void)
+{
+    static gsize pool = 0;
+
+    if (g_once_init_enter (&pool))
+    {
+        guint max_threads;
+
+        max_threads = CLAMP (g_get_num_processors () * 2, MIN_POOL_THREADS, MAX_POOL_THREADS);
+        g_once_init_leave (&pool, (gsize) g_thread_pool_new (pool_func, NULL,
+                                                              max_threads, FALSE,
+                                                              NULL));
+    }
+
+    return (GThreadPool *) pool;
+}
+
+NautilusWorkQueue *
+nautilus_work_queue_new (guint                      n_workers,
+                         NautilusWorkQueueFunc      func,
+                         GDestroyNotify             item_free_func,
+                         GCancellable              *cancellable,
+                         NautilusWorkQueueDoneFunc  done_func,
+                         gpointer                   user_data)
+{
+    NautilusWorkQueue *queue;
+    guint i;
+
+    g_return_val_if_fail (n_workers > 0, NULL);
+
+    queue = g_new0 (NautilusWorkQueue, 1);
+    queue->ref_count = 1;
+    g_mutex_init (&queue->mutex);
+    g_cond_init (&queue->stopped);
+    queue->n_workers = n_workers;
+    queue->items = g_new (GQueue, n_workers);
+    for (i = 0; i < n_workers; i++)
+    {
+        g_queue_init (&queue->items[i]);
+    }
+    queue->busy = g_new0 (gboolean, n_workers);
+    queue->func = func;
+    queue->item_free_func = item_free_func;
+    queue->cancellable = cancellable != NULL ? g_object_ref (cancellable) : NULL;
+    queue->done_func = done_func;
+    queue->user_data = user_data;
+
+    return queue;
+}
+
+NautilusWorkQueue *
+nautilus_work_queue_ref (NautilusWorkQueue *queue)
+{
+    g_atomic_int_inc (&queue->ref_count);
+
+    return queue;
+}
+
+void
+nautilus_work_queue_unref (NautilusWorkQueue *queue)
+{
+    guint i;
+
+    if (!g_atomic_int_dec_and_test (&queue->ref_count))
+    {
+        return;
+    }
+
+    for (i = 0; i < queue->n_workers; i++)
+    {
+        if (queue->item_free_func != NULL)
+        {
+            g_queue_foreach (&queue->items[i], (GFunc) queue->item_free_func, NULL);
+        }
+        g_queue_clear (&queue->items[i]);
+    }
+    g_free (queue->items);
+    g_free (queue->busy);
+    g_clear_object (&queue->cancellable);
+    g_cond_clear (&queue->stopped);
+    g_mutex_clear (&queue->mutex);
+    g_free (queue);
+}
+
+guint
+nautilus_work_queue_get_n_workers (NautilusWorkQueue *queue)
+{
+    return queue->n_workers;
+}
+
+static void
+add_worker_locked (NautilusWorkQueue *queue)
+{
+    queue->n_running++;
+    g_thread_pool_push (get_pool (), nautilus_work_queue_ref (queue), NULL);
+}
+
+void
+nautilus_work_queue_push (NautilusWorkQueue *queue,
+                          guint              worker,
+                          gpointer           item)
+{
+    g_return_if_fail (worker < queue->n_workers);
+
+    g_mutex_lock (&queue->mutex);
+
+    g_queue_push_tail (&queue->items[worker], item);
+
+    /* Another worker can take it while this one is busy. */
+    if (queue->started && queue->n_running < queue->n_workers)
+    {
+        add_worker_locked (queue);
+    }
+
+    g_mutex_unlock (&queue->mutex);
+}
+
+/* Takes the most recent item of the worker itself, or the oldest one
+ * of another worker. With a tree walked depth first, that is likely to
+ * be near the top and so to have more work under it.
+ */
+static gpointer
+take_item_locked (NautilusWorkQueue *queue,
+                  guint              worker)
+{
+    gpointer item;
+    guint i;
+
+    item = g_queue_pop_tail (&queue->items[worker]);
+    for (i = 1; item == NULL && i < queue->n_workers; i++)
+    {
+        item = g_queue_pop_head (&queue->items[(worker + i) % queue->n_workers]);
+    }
+
+    return item;
+}
+
+/* Works as a free worker until there are no items left. Called with
+ * the mutex held, which is dropped while working on an item. Returns
+ * TRUE if it was the last busy worker, and so the work is done.
+ */
+static gboolean
+work_locked (NautilusWorkQueue *queue)
+{
+    gpointer item;
+    guint worker;
+
+    /* Workers that are running are never more than the queue has. */
+    for (worker = 0; queue->busy[worker]; worker++)
+    {
+    }
+    queue->busy[worker] = TRUE;
+    queue->n_busy++;
+
+    while ((item = take_item_locked (queue, worker)) != NULL)
+    {
+        g_mutex_unlock (&queue->mutex);
+
+        /* What is left of a cancelled queue is only freed. */
+        if (!g_cancellable_is_cancelled (queue->cancellable))
+        {
+            queue->func (item, worker, queue->user_data);
+        }
+        if (queue->item_free_func != NULL)
+        {
+            queue->item_free_func (item);
+        }
+
+        g_mutex_lock (&queue->mutex);
+    }
+
+    queue->busy[worker] = FALSE;
+    queue->n_busy--;
+    queue->n_running--;
+    g_cond_broadcast (&queue->stopped);
+
+    /* Items are only pushed before the start or by busy workers, which
+     * do their own before they stop, so none can be left.
+     */
+    if (queue->n_busy == 0 && !queue->done)
+    {
+        queue->done = TRUE;
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+static void
+pool_func (gpointer data,
+           gpointer user_data)
+{
+    NautilusWorkQueue *queue;
+    NautilusWorkQueueDoneFunc done_func;
+    gboolean done;
+
+    queue = data;
+
+    g_mutex_lock (&queue->mutex);
+    done = work_locked (queue);
+    done_func = queue->done_func;
+    user_data = queue->user_data;
+    g_mutex_unlock (&queue->mutex);
+
+    if (done && done_func != NULL)
+    {
+        done_func (user_data);
+    }
+
+    nautilus_work_queue_unref (queue);
+}
+
+static guint
+count_items_locked (NautilusWorkQueue *queue)
+{
+    guint n_items, i;
+
+    n_items = 0;
+    for (i = 0; i < queue->n_workers; i++)
+    {
+        n_items += g_queue_get_length (&queue->items[i]);
+    }
+
+    return n_items;
+}
+
+void
+nautilus_work_queue_start (NautilusWorkQueue *queue)
+{
+    gboolean done;
+    guint n_items, i;
+
+    g_return_if_fail (!queue->started);
+
+    g_mutex_lock (&queue->mutex);
+
+    queue->started = TRUE;
+
+    n_items = count_items_locked (queue);
+    for (i = 0; i < MIN (n_items, queue->n_workers); i++)
+    {
+        add_worker_locked (queue);
+    }
+
+    done = n_items == 0;
+    queue->done = done;
+
+    g_mutex_unlock (&queue->mutex);
+
+    if (done && queue->done_func != NULL)
+    {
+        queue->done_func (queue->user_data);
+    }
+}
+
+void
+nautilus_work_queue_run (NautilusWorkQueue *queue)
+{
+    gboolean done;
+    guint n_items, i;
+
+    g_return_if_fail (!queue->started);
+
+    g_mutex_lock (&queue->mutex);
+
+    queue->started = TRUE;
+
+    /* One of the workers is this thread. */
+    n_items = count_items_locked (queue);
+    queue->n_running++;
+    for (i = 1; i < MIN (n_items, queue->n_workers); i++)
+    {
+        add_worker_locked (queue);
+    }
+
+    /* Workers still waiting for a thread will find nothing to do. */
+    done = work_locked (queue);
+    while (queue->n_busy > 0)
+    {
+        g_cond_wait (&queue->stopped, &queue->mutex);
+    }
+
+    g_mutex_unlock (&queue->mutex);
+
+    if (done && queue->done_func != NULL)
+    {
+        queue->done_func (queue->user_data);
+    }
+}
@@ -0,0 +1,70 @@
+/*
+   nautilus-work-queue.h: Work shared out to a pool of threads.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef NAUTILUS_WORK_QUEUE_H
+#define NAUTILUS_WORK_QUEUE_H
+
+#include <gio/gio.h>
+
+typedef struct NautilusWorkQueue NautilusWorkQueue;
+
+/* Does the work of one item, on one of the threads of the pool. worker
+ * is below the number of workers of the queue, and no other thread
+ * works as the same worker at the same time, so it can index state
+ * kept per worker. The queue frees the item afterwards.
+ */
+typedef void (*NautilusWorkQueueFunc) (gpointer item,
+                                       guint    worker,
+                                       gpointer user_data);
+typedef void (*NautilusWorkQueueDoneFunc) (gpointer user_data);
+
+/* Items are worked on by at most n_workers threads at once, taken
+ * from a pool shared by all the queues. done_func, which can be NULL,
+ * is called once there is no work left, or once the queue is
+ * cancelled and the workers stopped. It can be called from any thread,
+ * and the user data can be freed from then on.
+ */
+NautilusWorkQueue *nautilus_work_queue_new           (guint                      n_workers,
+                                                      NautilusWorkQueueFunc      func,
+                                                      GDestroyNotify             item_free_func,
+                                                      GCancellable              *cancellable,
+                                                      NautilusWorkQueueDoneFunc  done_func,
+                                                      gpointer                   user_data);
+NautilusWorkQueue *nautilus_work_queue_ref           (NautilusWorkQueue         *queue);
+void               nautilus_work_queue_unref         (NautilusWorkQueue         *queue);
+guint              nautilus_work_queue_get_n_workers (NautilusWorkQueue         *queue);
+
+/* Queues more work. From a NautilusWorkQueueFunc, worker is the one
+ * it was called as, otherwise 0. Each worker does its own items most
+ * recent first, and takes the oldest ones of the others when it has
+ * none left.
+ */
+void               nautilus_work_queue_push          (NautilusWorkQueue         *queue,
+                                                      guint                      worker,
+                                                      gpointer                   item);
+
+/* Starts working on the items pushed so far, on the threads of the
+ * pool. A queue is started once, with this or nautilus_work_queue_run().
+ */
+void               nautilus_work_queue_start         (NautilusWorkQueue         *queue);
+/* Like nautilus_work_queue_start(), but the calling thread works as
+ * one of the workers too, and the call returns once all the work is
+ * done. A busy pool then slows the work down, but can't hold it up.
+ */
+void               nautilus_work_queue_run           (NautilusWorkQueue         *queue);
+
+#endif /* NAUTILUS_WORK_QUEUE_H */
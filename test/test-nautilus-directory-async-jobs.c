@@ -0,0 +1,141 @@
+#include <gtk/gtk.h>
+#include <glib/gstdio.h>
+#include <src/nautilus-directory.h>
+#include <src/nautilus-directory-private.h>
+#include <src/nautilus-file-utilities.h>
+#include <src/nautilus-file.h>
+
+#define N_FILES 200
+
+typedef struct
+{
+    GMainLoop *loop;
+    guint n_added;
+    gboolean done;
+} LoadData;
+
+static void
+files_added (NautilusDirectory *directory,
+             GList             *added_files,
+             LoadData          *data)
+{
+    /* Not all files are seen while they are still being handed out. */
+    g_assert_false (nautilus_directory_are_all_files_seen (directory));
+    data->n_added += g_list_length (added_files);
+}
+
+static void
+done_loading (NautilusDirectory *directory,
+              LoadData          *data)
+{
+    g_assert_true (nautilus_directory_are_all_files_seen (directory));
+    g_assert_cmpuint (data->n_added, ==, N_FILES);
+    data->done = TRUE;
+    g_main_loop_quit (data->loop);
+}
+
+static char *
+create_test_directory (void)
+{
+    char *root, *path;
+    guint i;
+
+    root = g_dir_make_tmp ("test-nautilus-directory-async-jobs-XXXXXX", NULL);
+    g_assert_nonnull (root);
+
+    for (i = 0; i < N_FILES; i++)
+    {
+        path = g_strdup_printf ("%s/file-%u", root, i);
+        g_assert_true (g_file_set_contents (path, "", 0, NULL));
+        g_free (path);
+    }
+
+    return root;
+}
+
+static void
+remove_test_directory (const char *root)
+{
+    char *path;
+    guint i;
+
+    for (i = 0; i < N_FILES; i++)
+    {
+        path = g_strdup_printf ("%s/file-%u", root, i);
+        g_remove (path);
+        g_free (path);
+    }
+    g_rmdir (root);
+}
+
+static void
+test_jobs_done_after_loading ()
+{
+    NautilusDirectory *directory;
+    LoadData data = { 0 };
+    g_autofree char *root = NULL;
+    g_autofree char *stats = NULL;
+    g_auto (GStrv) lines = NULL;
+    GFile *location;
+    int client;
+    guint i;
+
+    root = create_test_directory ();
+    data.loop = g_main_loop_new (NULL, FALSE);
+
+    location = g_file_new_for_path (root);
+    directory = nautilus_directory_get (location);
+    g_object_unref (location);
+
+    g_signal_connect (directory, "files-added", G_CALLBACK (files_added), &data);
+    g_signal_connect (directory, "done-loading", G_CALLBACK (done_loading), &data);
+
+    nautilus_directory_file_monitor_add (directory, &client, TRUE,
+                                         NAUTILUS_FILE_ATTRIBUTE_INFO |
+                                         NAUTILUS_FILE_ATTRIBUTE_DIRECTORY_ITEM_COUNT,
+                                         NULL, NULL);
+    while (!data.done)
+    {
+        g_main_loop_run (data.loop);
+    }
+
+    /* Every file arrived, and every job that was started has ended. */
+    g_assert_cmpuint (data.n_added, ==, N_FILES);
+
+    stats = nautilus_directory_get_async_job_stats ();
+    lines = g_strsplit (stats, "\n", -1);
+    g_assert_true (g_str_has_prefix (lines[0], "0/"));
+    for (i = 1; lines[i] != NULL && lines[i][0] != '\0'; i++)
+    {
+        /* "<file system>: <running>/<limit> jobs, ..." */
+        g_assert_nonnull (g_strstr_len (lines[i], -1, ": 0/"));
+    }
+
+    nautilus_directory_file_monitor_remove (directory, &client);
+    g_signal_handlers_disconnect_by_data (directory, &data);
+    nautilus_directory_unref (directory);
+
+    g_main_loop_unref (data.loop);
+    remove_test_directory (root);
+}
+
+static void
+setup_test_suite ()
+{
+    g_test_add_func ("/directory-async/jobs-done-after-loading",
+                     test_jobs_done_after_loading);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+    gtk_init (&argc, &argv);
+    g_test_init (&argc, &argv, NULL);
+
+    nautilus_ensure_extension_points ();
+
+    setup_test_suite ();
+
+    return g_test_run ();
+}
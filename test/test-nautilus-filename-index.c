@@ -0,0 +1,367 @@
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "src/nautilus-filename-index.h"
+
+static void
+collect_path (const char *path,
+              gdouble     rank,
+              guint64     mtime,
+              gpointer    user_data)
+{
+    GPtrArray *paths = user_data;
+
+    g_ptr_array_add (paths, g_strdup (path));
+}
+
+/* Returns the sorted paths found, joined with spaces. */
+static char *
+search (NautilusFilenameIndex *index,
+        const char            *location,
+        gboolean               recursive,
+        gboolean               show_hidden,
+        const char            *text)
+{
+    NautilusQueryMatcher *matcher;
+    GPtrArray *paths;
+    char *result;
+
+    matcher = nautilus_query_matcher_new (text);
+    paths = g_ptr_array_new_with_free_func (g_free);
+
+    nautilus_filename_index_search (index, location, recursive, show_hidden,
+                                    matcher, NULL, collect_path, paths);
+
+    g_ptr_array_sort (paths, (GCompareFunc) g_strcmp0);
+    g_ptr_array_add (paths, NULL);
+    result = g_strjoinv (" ", (char **) paths->pdata);
+
+    g_ptr_array_unref (paths);
+    nautilus_query_matcher_unref (matcher);
+
+    return result;
+}
+
+#define assert_search(index, location, recursive, show_hidden, text, expected) \
+    G_STMT_START { \
+        char *found = search (index, location, recursive, show_hidden, text); \
+        g_assert_cmpstr (found, ==, expected); \
+        g_free (found); \
+    } G_STMT_END
+
+static NautilusFilenameIndex *
+create_test_index ()
+{
+    NautilusFilenameIndex *index;
+
+    index = nautilus_filename_index_new ("/home/user");
+    nautilus_filename_index_add (index, "/home/user/Documents/Report.odt", FALSE);
+    nautilus_filename_index_add (index, "/home/user/Documents/Old/report-2016.odt", FALSE);
+    nautilus_filename_index_add (index, "/home/user/Music/Café.ogg", FALSE);
+    nautilus_filename_index_add (index, "/home/user/.config/report.conf", FALSE);
+    nautilus_filename_index_add (index, "/tmp/report.txt", FALSE);
+
+    return index;
+}
+
+static void
+test_search ()
+{
+    NautilusFilenameIndex *index;
+
+    index = create_test_index ();
+
+    assert_search (index, "/home/user", TRUE, FALSE, "report",
+                   "/home/user/Documents/Old/report-2016.odt /home/user/Documents/Report.odt");
+    assert_search (index, "/home/user", TRUE, TRUE, "report",
+                   "/home/user/.config/report.conf /home/user/Documents/Old/report-2016.odt /home/user/Documents/Report.odt");
+    assert_search (index, "/home/user/Documents", FALSE, FALSE, "report",
+                   "/home/user/Documents/Report.odt");
+    assert_search (index, "/home/user", TRUE, FALSE, "cafe",
+                   "/home/user/Music/Café.ogg");
+    assert_search (index, "/home/user", TRUE, FALSE, "2016 old", "");
+    assert_search (index, "/home/user", TRUE, FALSE, "doc",
+                   "/home/user/Documents");
+    assert_search (index, "/tmp", TRUE, FALSE, "report", "");
+
+    g_assert_cmpuint (nautilus_filename_index_get_size (index), ==, 8);
+
+    nautilus_filename_index_free (index);
+}
+
+static void
+test_remove_and_move ()
+{
+    NautilusFilenameIndex *index;
+
+    index = create_test_index ();
+
+    nautilus_filename_index_remove (index, "/home/user/Documents/Old");
+    assert_search (index, "/home/user", TRUE, FALSE, "report",
+                   "/home/user/Documents/Report.odt");
+    g_assert_cmpuint (nautilus_filename_index_get_size (index), ==, 6);
+
+    nautilus_filename_index_move (index, "/home/user/Documents", "/home/user/Papers");
+    assert_search (index, "/home/user", TRUE, FALSE, "report",
+                   "/home/user/Papers/Report.odt");
+    assert_search (index, "/home/user", TRUE, FALSE, "documents", "");
+
+    nautilus_filename_index_move (index, "/home/user/Papers/Report.odt", "/home/user/Music/Song.ogg");
+    assert_search (index, "/home/user", TRUE, FALSE, "ogg",
+                   "/home/user/Music/Café.ogg /home/user/Music/Song.ogg");
+
+    nautilus_filename_index_move (index, "/home/user/Music/Song.ogg", "/tmp/Song.ogg");
+    assert_search (index, "/home/user", TRUE, FALSE, "song", "");
+
+    nautilus_filename_index_free (index);
+}
+
+static void
+test_update_directory ()
+{
+    NautilusFilenameIndex *index;
+    GFileInfo *info;
+    GList *infos;
+    GPtrArray *subdirectories;
+
+    index = create_test_index ();
+
+    info = g_file_info_new ();
+    g_file_info_set_name (info, "Old");
+    g_file_info_set_file_type (info, G_FILE_TYPE_DIRECTORY);
+    g_file_info_set_is_hidden (info, FALSE);
+    g_file_info_set_is_backup (info, FALSE);
+    infos = g_list_prepend (NULL, info);
+    info = g_file_info_new ();
+    g_file_info_set_name (info, "New.odt");
+    g_file_info_set_file_type (info, G_FILE_TYPE_REGULAR);
+    g_file_info_set_is_hidden (info, FALSE);
+    g_file_info_set_is_backup (info, FALSE);
+    infos = g_list_prepend (infos, info);
+
+    g_assert_cmpuint (nautilus_filename_index_get_directory_stamp (index, "/home/user/Documents"), ==, 0);
+    nautilus_filename_index_update_directory (index, "/home/user/Documents", 42, infos);
+    g_list_free_full (infos, g_object_unref);
+    g_assert_cmpuint (nautilus_filename_index_get_directory_stamp (index, "/home/user/Documents"), ==, 42);
+
+    assert_search (index, "/home/user/Documents", TRUE, FALSE, "odt",
+                   "/home/user/Documents/New.odt /home/user/Documents/Old/report-2016.odt");
+
+    subdirectories = nautilus_filename_index_list_subdirectories (index, "/home/user/Documents");
+    g_assert_cmpuint (subdirectories->len, ==, 1);
+    g_assert_cmpstr (g_ptr_array_index (subdirectories, 0), ==, "Old");
+    g_ptr_array_unref (subdirectories);
+
+    nautilus_filename_index_free (index);
+}
+
+static void
+get_mtime (const char *path,
+           gdouble     rank,
+           guint64     mtime,
+           gpointer    user_data)
+{
+    *(guint64 *) user_data = mtime;
+}
+
+static void
+test_add_info ()
+{
+    NautilusFilenameIndex *index;
+    NautilusQueryMatcher *matcher;
+    GFileInfo *info;
+    GPtrArray *subdirectories;
+    guint64 mtime;
+
+    index = create_test_index ();
+
+    info = g_file_info_new ();
+    g_file_info_set_file_type (info, G_FILE_TYPE_DIRECTORY);
+    g_file_info_set_is_hidden (info, FALSE);
+    g_file_info_set_is_backup (info, FALSE);
+    nautilus_filename_index_add_info (index, "/home/user/Documents/Letters", info);
+    g_object_unref (info);
+
+    info = g_file_info_new ();
+    g_file_info_set_file_type (info, G_FILE_TYPE_REGULAR);
+    g_file_info_set_is_hidden (info, FALSE);
+    g_file_info_set_is_backup (info, TRUE);
+    g_file_info_set_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED, 1000);
+    g_file_info_set_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC, 7);
+    nautilus_filename_index_add_info (index, "/home/user/Documents/Report.odt~", info);
+    g_object_unref (info);
+
+    /* A directory is listed as one, but not stamped as read. */
+    subdirectories = nautilus_filename_index_list_subdirectories (index, "/home/user/Documents");
+    g_assert_cmpuint (subdirectories->len, ==, 2);
+    g_ptr_array_unref (subdirectories);
+    g_assert_cmpuint (nautilus_filename_index_get_directory_stamp (index, "/home/user/Documents/Letters"), ==, 0);
+
+    /* Backup files are hidden. */
+    assert_search (index, "/home/user/Documents", FALSE, FALSE, "report",
+                   "/home/user/Documents/Report.odt");
+
+    mtime = 0;
+    matcher = nautilus_query_matcher_new ("odt~");
+    nautilus_filename_index_search (index, "/home/user/Documents", FALSE, TRUE,
+                                    matcher, NULL, get_mtime, &mtime);
+    nautilus_query_matcher_unref (matcher);
+    g_assert_cmpuint (mtime, ==, 1000 * G_USEC_PER_SEC + 7);
+
+    nautilus_filename_index_free (index);
+}
+
+static void
+test_save_and_load ()
+{
+    NautilusFilenameIndex *index;
+    char *dir, *path;
+
+    dir = g_dir_make_tmp ("test-nautilus-filename-index-XXXXXX", NULL);
+    path = g_build_filename (dir, "index", NULL);
+
+    index = create_test_index ();
+    nautilus_filename_index_remove (index, "/home/user/Documents/Old");
+    nautilus_filename_index_move (index, "/home/user/Music", "/home/user/Documents/Music");
+    g_assert_true (nautilus_filename_index_save (index, path, NULL));
+
+    /* Saving compacts the index in memory too. */
+    g_assert_cmpuint (nautilus_filename_index_get_size (index), ==, 6);
+    assert_search (index, "/home/user", TRUE, TRUE, "o",
+                   "/home/user/.config /home/user/.config/report.conf "
+                   "/home/user/Documents /home/user/Documents/Music/Café.ogg /home/user/Documents/Report.odt");
+    nautilus_filename_index_add (index, "/home/user/Documents/Music/Song.ogg", FALSE);
+    assert_search (index, "/home/user", TRUE, FALSE, "ogg",
+                   "/home/user/Documents/Music/Café.ogg /home/user/Documents/Music/Song.ogg");
+    nautilus_filename_index_remove (index, "/home/user/Documents/Music/Song.ogg");
+    nautilus_filename_index_free (index);
+
+    g_assert_null (nautilus_filename_index_load (path, "/home/other"));
+
+    index = nautilus_filename_index_load (path, "/home/user");
+    g_assert_nonnull (index);
+    g_assert_cmpuint (nautilus_filename_index_get_size (index), ==, 6);
+    assert_search (index, "/home/user", TRUE, TRUE, "o",
+                   "/home/user/.config /home/user/.config/report.conf "
+                   "/home/user/Documents /home/user/Documents/Music/Café.ogg /home/user/Documents/Report.odt");
+    nautilus_filename_index_free (index);
+
+    g_unlink (path);
+    g_rmdir (dir);
+    g_free (path);
+    g_free (dir);
+}
+
+static void
+test_other_file_systems ()
+{
+    NautilusFilenameIndex *index;
+    GPtrArray *paths;
+    char *dir, *path;
+
+    dir = g_dir_make_tmp ("test-nautilus-filename-index-XXXXXX", NULL);
+    path = g_build_filename (dir, "index", NULL);
+
+    index = create_test_index ();
+    nautilus_filename_index_set_other_file_system (index, "/home/user/Documents/Old");
+    g_assert_cmpuint (nautilus_filename_index_get_size (index), ==, 7);
+    assert_search (index, "/home/user", TRUE, FALSE, "report",
+                   "/home/user/Documents/Report.odt");
+
+    g_assert_true (nautilus_filename_index_covers (index, "/home/user/Documents"));
+    g_assert_true (nautilus_filename_index_covers (index, "/home/user/Downloads"));
+    g_assert_false (nautilus_filename_index_covers (index, "/home/user/Documents/Old"));
+    g_assert_false (nautilus_filename_index_covers (index, "/home/user/Documents/Old/Photos"));
+    g_assert_false (nautilus_filename_index_covers (index, "/tmp"));
+
+    paths = nautilus_filename_index_list_other_file_systems (index, "/home/user");
+    g_assert_cmpuint (paths->len, ==, 1);
+    g_assert_cmpstr (g_ptr_array_index (paths, 0), ==, "/home/user/Documents/Old");
+    g_ptr_array_unref (paths);
+    paths = nautilus_filename_index_list_other_file_systems (index, "/home/user/Music");
+    g_assert_cmpuint (paths->len, ==, 0);
+    g_ptr_array_unref (paths);
+
+    /* The mark is kept when saved. */
+    g_assert_true (nautilus_filename_index_save (index, path, NULL));
+    nautilus_filename_index_free (index);
+    index = nautilus_filename_index_load (path, "/home/user");
+    g_assert_nonnull (index);
+    g_assert_false (nautilus_filename_index_covers (index, "/home/user/Documents/Old"));
+
+    /* Reading the directory means it is on the same one again. */
+    nautilus_filename_index_update_directory (index, "/home/user/Documents/Old", 42, NULL);
+    g_assert_true (nautilus_filename_index_covers (index, "/home/user/Documents/Old"));
+    paths = nautilus_filename_index_list_other_file_systems (index, "/home/user");
+    g_assert_cmpuint (paths->len, ==, 0);
+    g_ptr_array_unref (paths);
+
+    nautilus_filename_index_free (index);
+
+    g_unlink (path);
+    g_rmdir (dir);
+    g_free (path);
+    g_free (dir);
+}
+
+/* Searches an index of a million files. Run with -m perf. */
+static void
+test_search_speed ()
+{
+    NautilusFilenameIndex *index;
+    GTimer *timer;
+    char *path, *found;
+    guint i;
+
+    index = nautilus_filename_index_new ("/home/user");
+    for (i = 0; i < 1000000; i++)
+    {
+        path = g_strdup_printf ("/home/user/dir%u/subdir%u/File number %u.txt", i % 100, i % 1000, i);
+        nautilus_filename_index_add (index, path, FALSE);
+        g_free (path);
+    }
+
+    timer = g_timer_new ();
+    found = search (index, "/home/user", TRUE, FALSE, "number 123456.");
+    g_test_minimized_result (g_timer_elapsed (timer, NULL),
+                             "Time to search a million file names");
+    g_assert_cmpstr (found, ==, "/home/user/dir56/subdir456/File number 123456.txt");
+
+    g_free (found);
+    g_timer_destroy (timer);
+    nautilus_filename_index_free (index);
+}
+
+static void
+setup_test_suite ()
+{
+    g_test_add_func ("/filename-index/search",
+                     test_search);
+    g_test_add_func ("/filename-index/remove-and-move",
+                     test_remove_and_move);
+    g_test_add_func ("/filename-index/update-directory",
+                     test_update_directory);
+    g_test_add_func ("/filename-index/add-info",
+                     test_add_info);
+    g_test_add_func ("/filename-index/save-and-load",
+                     test_save_and_load);
+    g_test_add_func ("/filename-index/other-file-systems",
+                     test_other_file_systems);
+
+    if (g_test_perf ())
+    {
+        g_test_add_func ("/filename-index/search-speed",
+                         test_search_speed);
+    }
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+    g_test_init (&argc, &argv, NULL);
+
+    setup_test_suite ();
+
+    return g_test_run ();
+}
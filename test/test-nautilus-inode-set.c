@@ -0,0 +1,143 @@
+#include <glib.h>
+
+#include "src/nautilus-inode-set.h"
+
+static void
+test_add_and_contains ()
+{
+    NautilusInodeSet *set;
+
+    set = nautilus_inode_set_new ();
+
+    g_assert_true (nautilus_inode_set_add (set, 1, 42));
+    g_assert_false (nautilus_inode_set_add (set, 1, 42));
+    g_assert_true (nautilus_inode_set_contains (set, 1, 42));
+    g_assert_false (nautilus_inode_set_contains (set, 1, 43));
+    g_assert_cmpuint (nautilus_inode_set_size (set), ==, 1);
+
+    nautilus_inode_set_free (set);
+}
+
+static void
+test_same_inode_on_other_device ()
+{
+    NautilusInodeSet *set;
+
+    set = nautilus_inode_set_new ();
+
+    g_assert_true (nautilus_inode_set_add (set, 1, 42));
+    g_assert_true (nautilus_inode_set_add (set, 2, 42));
+    g_assert_cmpuint (nautilus_inode_set_size (set), ==, 2);
+
+    nautilus_inode_set_free (set);
+}
+
+static void
+test_unknown_inode_is_never_added ()
+{
+    NautilusInodeSet *set;
+
+    set = nautilus_inode_set_new ();
+
+    g_assert_true (nautilus_inode_set_add (set, 1, 0));
+    g_assert_true (nautilus_inode_set_add (set, 1, 0));
+    g_assert_false (nautilus_inode_set_contains (set, 1, 0));
+    g_assert_cmpuint (nautilus_inode_set_size (set), ==, 0);
+
+    nautilus_inode_set_free (set);
+}
+
+static void
+test_many_inodes ()
+{
+    NautilusInodeSet *set;
+    guint64 inode;
+
+    set = nautilus_inode_set_new ();
+
+    for (inode = 1; inode <= 100000; inode++)
+    {
+        g_assert_true (nautilus_inode_set_add (set, 1, inode));
+    }
+    for (inode = 1; inode <= 100000; inode++)
+    {
+        g_assert_false (nautilus_inode_set_add (set, 1, inode));
+    }
+    g_assert_cmpuint (nautilus_inode_set_size (set), ==, 100000);
+
+    nautilus_inode_set_free (set);
+}
+
+/* Adding n inodes, half of them twice, should take time linear in n.
+ * Run with -m perf.
+ */
+static void
+test_scaling ()
+{
+    NautilusInodeSet *set;
+    GTimer *timer;
+    guint64 inode;
+    guint n;
+    gdouble elapsed, per_inode, first_per_inode;
+
+    timer = g_timer_new ();
+    first_per_inode = 0;
+
+    for (n = 10000; n <= 10000000; n *= 10)
+    {
+        set = nautilus_inode_set_new ();
+
+        g_timer_start (timer);
+        for (inode = 1; inode <= n; inode++)
+        {
+            nautilus_inode_set_add (set, 1, inode);
+            nautilus_inode_set_add (set, 1, inode / 2 + 1);
+        }
+        elapsed = g_timer_elapsed (timer, NULL);
+
+        per_inode = elapsed / n * 1e9;
+        g_test_message ("%u inodes: %.3f s, %.1f ns per inode", n, elapsed, per_inode);
+        if (first_per_inode == 0)
+        {
+            first_per_inode = per_inode;
+        }
+
+        g_assert_cmpuint (nautilus_inode_set_size (set), ==, n);
+        nautilus_inode_set_free (set);
+    }
+
+    g_test_maximized_result (first_per_inode / per_inode,
+                             "Relative speed per inode at 10M inodes compared to 10k inodes");
+
+    g_timer_destroy (timer);
+}
+
+static void
+setup_test_suite ()
+{
+    g_test_add_func ("/inode-set/add-and-contains",
+                     test_add_and_contains);
+    g_test_add_func ("/inode-set/same-inode-on-other-device",
+                     test_same_inode_on_other_device);
+    g_test_add_func ("/inode-set/unknown-inode-is-never-added",
+                     test_unknown_inode_is_never_added);
+    g_test_add_func ("/inode-set/many-inodes",
+                     test_many_inodes);
+
+    if (g_test_perf ())
+    {
+        g_test_add_func ("/inode-set/scaling",
+                         test_scaling);
+    }
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+    g_test_init (&argc, &argv, NULL);
+
+    setup_test_suite ();
+
+    return g_test_run ();
+}
@@ -0,0 +1,119 @@
+#include <gio/gio.h>
+
+#include "src/nautilus-mime-filter.h"
+
+static NautilusMimeFilter *
+filter_new (const char *first_type,
+            ...)
+{
+    NautilusMimeFilter *filter;
+    GList *mime_types;
+    const char *type;
+    va_list args;
+
+    mime_types = NULL;
+    va_start (args, first_type);
+    for (type = first_type; type != NULL; type = va_arg (args, const char *))
+    {
+        mime_types = g_list_append (mime_types, (gpointer) type);
+    }
+    va_end (args);
+
+    filter = nautilus_mime_filter_new (mime_types);
+    g_list_free (mime_types);
+
+    return filter;
+}
+
+static void
+test_no_types ()
+{
+    g_assert_null (nautilus_mime_filter_new (NULL));
+}
+
+static void
+test_exact_types ()
+{
+    g_autoptr (NautilusMimeFilter) filter = NULL;
+
+    filter = filter_new ("image/png", "application/pdf", NULL);
+
+    g_assert_true (nautilus_mime_filter_matches (filter, "image/png"));
+    g_assert_true (nautilus_mime_filter_matches (filter, "application/pdf"));
+    g_assert_false (nautilus_mime_filter_matches (filter, "image/jpeg"));
+    g_assert_false (nautilus_mime_filter_matches (filter, NULL));
+}
+
+static void
+test_subtypes ()
+{
+    g_autoptr (NautilusMimeFilter) filter = NULL;
+    gboolean expected;
+
+    filter = filter_new ("text/plain", NULL);
+
+    /* Twice, to go through the cached answers too. */
+    expected = g_content_type_is_a ("text/x-csrc", "text/plain");
+    g_assert_cmpint (nautilus_mime_filter_matches (filter, "text/x-csrc"), ==, expected);
+    g_assert_cmpint (nautilus_mime_filter_matches (filter, "text/x-csrc"), ==, expected);
+    g_assert_false (nautilus_mime_filter_matches (filter, "inode/directory"));
+    g_assert_false (nautilus_mime_filter_matches (filter, "inode/directory"));
+}
+
+static gpointer
+match_thread_func (gpointer user_data)
+{
+    NautilusMimeFilter *filter = user_data;
+    guint i;
+
+    for (i = 0; i < 10000; i++)
+    {
+        g_assert_true (nautilus_mime_filter_matches (filter, "image/png"));
+        g_assert_false (nautilus_mime_filter_matches (filter, "audio/mpeg"));
+    }
+
+    return NULL;
+}
+
+static void
+test_threads ()
+{
+    g_autoptr (NautilusMimeFilter) filter = NULL;
+    GThread *threads[4];
+    guint i;
+
+    filter = filter_new ("image/png", NULL);
+
+    for (i = 0; i < G_N_ELEMENTS (threads); i++)
+    {
+        threads[i] = g_thread_new ("mime-filter-test", match_thread_func, filter);
+    }
+    for (i = 0; i < G_N_ELEMENTS (threads); i++)
+    {
+        g_thread_join (threads[i]);
+    }
+}
+
+static void
+setup_test_suite ()
+{
+    g_test_add_func ("/mime-filter/no-types",
+                     test_no_types);
+    g_test_add_func ("/mime-filter/exact-types",
+                     test_exact_types);
+    g_test_add_func ("/mime-filter/subtypes",
+                     test_subtypes);
+    g_test_add_func ("/mime-filter/threads",
+                     test_threads);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+    g_test_init (&argc, &argv, NULL);
+
+    setup_test_suite ();
+
+    return g_test_run ();
+}
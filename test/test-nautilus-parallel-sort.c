@@ -0,0 +1,119 @@
+#include <glib.h>
+
+#include "src/nautilus-parallel-sort.h"
+
+typedef struct
+{
+    guint key;
+    guint index;
+} Item;
+
+static gint
+compare_items (gconstpointer a,
+               gconstpointer b,
+               gpointer      user_data)
+{
+    const Item *item_a = a;
+    const Item *item_b = b;
+
+    return item_a->key < item_b->key ? -1 : (item_a->key > item_b->key ? 1 : 0);
+}
+
+static void
+sort_and_check (guint n_items,
+                guint n_keys)
+{
+    Item *storage;
+    gpointer *items;
+    Item *previous, *current;
+    GRand *rand;
+    guint i;
+
+    rand = g_rand_new_with_seed (n_items);
+    storage = g_new (Item, n_items);
+    items = g_new (gpointer, n_items);
+    for (i = 0; i < n_items; i++)
+    {
+        storage[i].key = g_rand_int_range (rand, 0, n_keys);
+        storage[i].index = i;
+        items[i] = &storage[i];
+    }
+
+    nautilus_parallel_sort (items, n_items, compare_items, NULL);
+
+    for (i = 1; i < n_items; i++)
+    {
+        previous = items[i - 1];
+        current = items[i];
+
+        g_assert_cmpuint (previous->key, <=, current->key);
+        /* Equal items keep their order. */
+        if (previous->key == current->key)
+        {
+            g_assert_cmpuint (previous->index, <, current->index);
+        }
+    }
+
+    g_free (items);
+    g_free (storage);
+    g_rand_free (rand);
+}
+
+static void
+test_small ()
+{
+    sort_and_check (0, 10);
+    sort_and_check (1, 10);
+    sort_and_check (1000, 10);
+}
+
+static void
+test_large ()
+{
+    sort_and_check (100000, 1000);
+    sort_and_check (100003, 7);
+}
+
+static void
+test_reversed ()
+{
+    static Item storage[50000];
+    static gpointer items[50000];
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS (items); i++)
+    {
+        storage[i].key = G_N_ELEMENTS (items) - i;
+        storage[i].index = i;
+        items[i] = &storage[i];
+    }
+
+    nautilus_parallel_sort (items, G_N_ELEMENTS (items), compare_items, NULL);
+
+    for (i = 0; i < G_N_ELEMENTS (items); i++)
+    {
+        g_assert_cmpuint (((Item *) items[i])->key, ==, i + 1);
+    }
+}
+
+static void
+setup_test_suite ()
+{
+    g_test_add_func ("/parallel-sort/small",
+                     test_small);
+    g_test_add_func ("/parallel-sort/large",
+                     test_large);
+    g_test_add_func ("/parallel-sort/reversed",
+                     test_reversed);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+    g_test_init (&argc, &argv, NULL);
+
+    setup_test_suite ();
+
+    return g_test_run ();
+}
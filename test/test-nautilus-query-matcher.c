@@ -0,0 +1,326 @@
+#include <glib.h>
+#include <string.h>
+
+#include "src/nautilus-query-matcher.h"
+
+/* The matching as it was done before matchers, to compare against. */
+static gdouble
+reference_match (const char *text,
+                 const char *string)
+{
+    gchar *normalized, *prepared_text, *prepared_string, *ptr;
+    gchar **words;
+    gdouble rank;
+    gint i, nonexact_malus;
+
+    normalized = g_utf8_normalize (text, -1, G_NORMALIZE_NFD);
+    prepared_text = g_utf8_strdown (normalized, -1);
+    g_free (normalized);
+    words = g_strsplit (prepared_text, " ", -1);
+    g_free (prepared_text);
+
+    normalized = g_utf8_normalize (string, -1, G_NORMALIZE_NFD);
+    prepared_string = g_utf8_strdown (normalized, -1);
+    g_free (normalized);
+
+    rank = -1;
+    ptr = NULL;
+    nonexact_malus = 0;
+    for (i = 0; words[i] != NULL; i++)
+    {
+        if ((ptr = strstr (prepared_string, words[i])) == NULL)
+        {
+            goto out;
+        }
+        nonexact_malus += strlen (ptr) - strlen (words[i]);
+    }
+
+    rank = MAX (10.0, 50.0 - (gdouble) (ptr - prepared_string) - (gdouble) nonexact_malus / 100);
+
+out:
+    g_strfreev (words);
+    g_free (prepared_string);
+
+    return rank;
+}
+
+static const char *texts[] =
+{
+    "report",
+    "Report",
+    "rep 2017",
+    "tar.gz",
+    "é",
+    "CAFÉ",
+    "a  b",
+    "ß",
+};
+
+static const char *strings[] =
+{
+    "report.txt",
+    "Annual Report 2017.odt",
+    "REPORTS",
+    "backup.tar.gz",
+    "Café au lait.jpg",
+    "cafe\xcc\x81.png",
+    "Straße",
+    "a b",
+    "ab",
+    "",
+    "x",
+};
+
+static void
+test_same_ranks_as_before ()
+{
+    NautilusQueryMatcher *matcher;
+    guint i, j;
+
+    for (i = 0; i < G_N_ELEMENTS (texts); i++)
+    {
+        matcher = nautilus_query_matcher_new (texts[i]);
+        for (j = 0; j < G_N_ELEMENTS (strings); j++)
+        {
+            g_assert_cmpfloat (nautilus_query_matcher_match (matcher, strings[j]), ==,
+                               reference_match (texts[i], strings[j]));
+        }
+        nautilus_query_matcher_unref (matcher);
+    }
+}
+
+static void
+test_long_names ()
+{
+    NautilusQueryMatcher *matcher;
+    GString *name;
+
+    name = g_string_new (NULL);
+    while (name->len < 1000)
+    {
+        g_string_append (name, "Lorem Ipsum ");
+    }
+    g_string_append (name, "Needle");
+
+    matcher = nautilus_query_matcher_new ("needle");
+    g_assert_cmpfloat (nautilus_query_matcher_match (matcher, name->str), ==,
+                       reference_match ("needle", name->str));
+    g_assert_cmpfloat (nautilus_query_matcher_match (matcher, name->str), >, -1);
+    nautilus_query_matcher_unref (matcher);
+
+    g_string_free (name, TRUE);
+}
+
+static void
+test_no_text_matches_nothing ()
+{
+    NautilusQueryMatcher *matcher;
+
+    matcher = nautilus_query_matcher_new (NULL);
+    g_assert_cmpfloat (nautilus_query_matcher_match (matcher, "anything"), ==, -1);
+    nautilus_query_matcher_unref (matcher);
+}
+
+static gboolean
+is_narrower (const char *text,
+             const char *other_text)
+{
+    NautilusQueryMatcher *matcher, *other;
+    gboolean narrower;
+
+    matcher = nautilus_query_matcher_new (text);
+    other = nautilus_query_matcher_new (other_text);
+    narrower = nautilus_query_matcher_is_narrower (matcher, other);
+    nautilus_query_matcher_unref (other);
+    nautilus_query_matcher_unref (matcher);
+
+    return narrower;
+}
+
+static void
+test_is_narrower ()
+{
+    g_assert_true (is_narrower ("photo", "photo"));
+    g_assert_true (is_narrower ("photos", "photo"));
+    g_assert_true (is_narrower ("photo 2017", "photo"));
+    g_assert_true (is_narrower ("Holiday Photo", "day PHO"));
+    g_assert_true (is_narrower ("café", "cafe"));
+    g_assert_true (is_narrower ("photo", ""));
+    g_assert_true (is_narrower (NULL, "photo"));
+    g_assert_false (is_narrower ("photo", "photos"));
+    g_assert_false (is_narrower ("photo", "photo 2017"));
+    g_assert_false (is_narrower ("pho", "photo"));
+    g_assert_false (is_narrower ("photo", NULL));
+}
+
+static gssize
+match_contents (const char *text,
+                const char *contents)
+{
+    NautilusQueryMatcher *matcher;
+    gssize offset;
+
+    matcher = nautilus_query_matcher_new (text);
+    offset = nautilus_query_matcher_match_contents (matcher, contents, strlen (contents));
+    nautilus_query_matcher_unref (matcher);
+
+    return offset;
+}
+
+static void
+test_match_contents ()
+{
+    const char *contents = "int\nmain (void)\n{\n    return EXIT_SUCCESS;\n}\n";
+
+    g_assert_cmpint (match_contents ("main", contents), ==, 4);
+    g_assert_cmpint (match_contents ("MAIN", contents), ==, 4);
+    g_assert_cmpint (match_contents ("exit_success", contents), ==, 29);
+    g_assert_cmpint (match_contents ("return main", contents), ==, 22);
+    g_assert_cmpint (match_contents ("}", contents), ==, 43);
+    g_assert_cmpint (match_contents ("main exit_failure", contents), ==, -1);
+    g_assert_cmpint (match_contents ("success;\n}\nx", contents), ==, -1);
+    g_assert_cmpint (match_contents ("", contents), ==, -1);
+    g_assert_cmpint (match_contents (NULL, contents), ==, -1);
+    /* The words are compared in NFC, like most text is written. */
+    g_assert_cmpint (match_contents ("café", "un caf\xc3\xa9 noir"), ==, 3);
+}
+
+/* Matches the contents in parts of part_length new bytes, the way a
+ * file is read. Returns the offset of the longest word, or -1.
+ */
+static gssize
+match_contents_in_parts (const char *text,
+                         const char *contents,
+                         gsize       part_length)
+{
+    NautilusQueryMatcher *matcher;
+    gboolean *found;
+    gboolean found_all;
+    gsize length, start, end, overlap;
+    gssize offset, result;
+
+    matcher = nautilus_query_matcher_new (text);
+    found = g_new0 (gboolean, nautilus_query_matcher_get_n_words (matcher));
+    overlap = nautilus_query_matcher_get_contents_overlap (matcher);
+    length = strlen (contents);
+
+    found_all = FALSE;
+    result = -1;
+    end = 0;
+    while (!found_all && end < length)
+    {
+        end = MIN (end + part_length, length);
+        start = end > part_length + overlap ? end - part_length - overlap : 0;
+        found_all = nautilus_query_matcher_match_contents_part (matcher, contents + start, end - start,
+                                                                found, &offset);
+        if (offset >= 0)
+        {
+            g_assert_cmpint (result, ==, -1);
+            result = start + offset;
+        }
+    }
+
+    g_free (found);
+    nautilus_query_matcher_unref (matcher);
+
+    return found_all ? result : -1;
+}
+
+static void
+test_match_contents_in_parts ()
+{
+    const char *contents = "int\nmain (void)\n{\n    return EXIT_SUCCESS;\n}\n";
+    gsize part_length;
+
+    for (part_length = 1; part_length <= strlen (contents); part_length++)
+    {
+        g_assert_cmpint (match_contents_in_parts ("main", contents, part_length), ==, 4);
+        g_assert_cmpint (match_contents_in_parts ("exit_success", contents, part_length), ==, 29);
+        g_assert_cmpint (match_contents_in_parts ("return main", contents, part_length), ==, 22);
+        g_assert_cmpint (match_contents_in_parts ("main exit_failure", contents, part_length), ==, -1);
+        g_assert_cmpint (match_contents_in_parts ("", contents, part_length), ==, -1);
+        g_assert_cmpint (match_contents_in_parts (NULL, contents, part_length), ==, -1);
+    }
+}
+
+/* Matches a query against many file names, the way a search does,
+ * with the matcher and the old way. Run with -m perf.
+ */
+static void
+test_benchmark ()
+{
+    NautilusQueryMatcher *matcher;
+    GPtrArray *names;
+    GTimer *timer;
+    gdouble reference_time, matcher_time;
+    guint i, n_matches;
+
+    names = g_ptr_array_new_with_free_func (g_free);
+    for (i = 0; i < 200000; i++)
+    {
+        g_ptr_array_add (names, g_strdup_printf ("IMG_%05u Holiday Photo %u.jpg", i, i % 97));
+    }
+
+    timer = g_timer_new ();
+
+    n_matches = 0;
+    g_timer_start (timer);
+    for (i = 0; i < names->len; i++)
+    {
+        n_matches += reference_match ("photo 42", g_ptr_array_index (names, i)) > -1;
+    }
+    reference_time = g_timer_elapsed (timer, NULL);
+
+    matcher = nautilus_query_matcher_new ("photo 42");
+    g_timer_start (timer);
+    for (i = 0; i < names->len; i++)
+    {
+        n_matches -= nautilus_query_matcher_match (matcher, g_ptr_array_index (names, i)) > -1;
+    }
+    matcher_time = g_timer_elapsed (timer, NULL);
+    nautilus_query_matcher_unref (matcher);
+
+    g_assert_cmpuint (n_matches, ==, 0);
+
+    g_test_message ("%u names: %.3f s before, %.3f s with a matcher",
+                    names->len, reference_time, matcher_time);
+    g_test_maximized_result (reference_time / matcher_time,
+                             "Speedup of the matcher over preparing the query for every name");
+
+    g_timer_destroy (timer);
+    g_ptr_array_unref (names);
+}
+
+static void
+setup_test_suite ()
+{
+    g_test_add_func ("/query-matcher/same-ranks-as-before",
+                     test_same_ranks_as_before);
+    g_test_add_func ("/query-matcher/long-names",
+                     test_long_names);
+    g_test_add_func ("/query-matcher/no-text-matches-nothing",
+                     test_no_text_matches_nothing);
+    g_test_add_func ("/query-matcher/is-narrower",
+                     test_is_narrower);
+    g_test_add_func ("/query-matcher/match-contents",
+                     test_match_contents);
+    g_test_add_func ("/query-matcher/match-contents-in-parts",
+                     test_match_contents_in_parts);
+
+    if (g_test_perf ())
+    {
+        g_test_add_func ("/query-matcher/benchmark",
+                         test_benchmark);
+    }
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+    g_test_init (&argc, &argv, NULL);
+
+    setup_test_suite ();
+
+    return g_test_run ();
+}
@@ -1,6 +1,9 @@
 #include <src/nautilus-file-utilities.h>
 #include <src/nautilus-search-provider.h>
 #include <src/nautilus-search-engine.h>
+#include <src/nautilus-search-engine-simple-private.h>
+#include <src/nautilus-search-hit.h>
+#include <glib/gstdio.h>
 #include <gtk/gtk.h>
 
 static void
@@ -23,19 +26,100 @@ finished_cb (NautilusSearchEngine         *engine,
     gtk_main_quit ();
 }
 
-int
-main (int   argc,
-      char *argv[])
+/* Searches of the simple engine running at the same time, which share
+ * the listings of the directories they have in common.
+ */
+
+#define N_DIRECTORIES 50
+
+typedef struct
+{
+    NautilusSearchEngineSimple *engine;
+    GPtrArray *paths;
+    gboolean finished;
+    GMainLoop *loop;
+} SimpleSearch;
+
+static const char *test_files[] =
+{
+    "report-top.txt",
+    "a/report-a.txt",
+    "a/b/report-b.txt",
+    "a/.hidden/report-hidden.txt",
+    "a/b/notes.txt",
+};
+
+static void
+create_test_file (const char *path)
+{
+    char *parent;
+
+    parent = g_path_get_dirname (path);
+    g_assert_cmpint (g_mkdir_with_parents (parent, 0700), ==, 0);
+    g_assert_true (g_file_set_contents (path, "", 0, NULL));
+    g_free (parent);
+}
+
+static char *
+create_test_tree (void)
+{
+    char *root, *path;
+    guint i;
+
+    root = g_dir_make_tmp ("test-nautilus-search-engine-XXXXXX", NULL);
+    g_assert_nonnull (root);
+
+    for (i = 0; i < G_N_ELEMENTS (test_files); i++)
+    {
+        path = g_build_filename (root, test_files[i], NULL);
+        create_test_file (path);
+        g_free (path);
+    }
+
+    /* Enough directories for the searches to meet in some of them. */
+    for (i = 0; i < N_DIRECTORIES; i++)
+    {
+        path = g_strdup_printf ("%s/d%u/report-%u.txt", root, i, i);
+        create_test_file (path);
+        g_free (path);
+    }
+
+    return root;
+}
+
+static void
+remove_test_tree (const char *path)
+{
+    GDir *dir;
+    const char *name;
+    char *child;
+
+    dir = g_dir_open (path, 0, NULL);
+    if (dir != NULL)
+    {
+        while ((name = g_dir_read_name (dir)) != NULL)
+        {
+            child = g_build_filename (path, name, NULL);
+            remove_test_tree (child);
+            g_free (child);
+        }
+        g_dir_close (dir);
+    }
+
+    g_remove (path);
+}
+
+static void
+test_start_and_stop ()
 {
     NautilusSearchEngine *engine;
     NautilusSearchEngineModel *model;
     NautilusDirectory *directory;
     NautilusQuery *query;
     GFile *location;
+    char *root;
 
-    gtk_init (&argc, &argv);
-
-    nautilus_ensure_extension_points ();
+    root = create_test_tree ();
 
     engine = nautilus_search_engine_new ();
     g_signal_connect (engine, "hits-added",
@@ -43,12 +127,14 @@ main (int   argc,
     g_signal_connect (engine, "finished",
                       G_CALLBACK (finished_cb), NULL);
 
+    location = g_file_new_for_path (root);
+
     query = nautilus_query_new ();
     nautilus_query_set_text (query, "richard hult");
+    nautilus_query_set_location (query, location);
     nautilus_search_provider_set_query (NAUTILUS_SEARCH_PROVIDER (engine), query);
     g_object_unref (query);
 
-    location = g_file_new_for_path (g_get_home_dir ());
     directory = nautilus_directory_get (location);
     g_object_unref (location);
 
@@ -61,5 +147,246 @@ main (int   argc,
     g_object_unref (engine);
 
     gtk_main ();
-    return 0;
+
+    remove_test_tree (root);
+    g_free (root);
+}
+
+static void
+simple_hits_added_cb (NautilusSearchProvider *provider,
+                      GList                  *hits,
+                      SimpleSearch           *search)
+{
+    GList *l;
+
+    for (l = hits; l != NULL; l = l->next)
+    {
+        g_ptr_array_add (search->paths,
+                         g_file_get_path (nautilus_search_hit_get_location (l->data)));
+    }
+}
+
+static void
+simple_finished_cb (NautilusSearchProvider       *provider,
+                    NautilusSearchProviderStatus  status,
+                    SimpleSearch                 *search)
+{
+    search->finished = TRUE;
+    g_main_loop_quit (search->loop);
+}
+
+static void
+simple_search_init (SimpleSearch *search,
+                    GMainLoop    *loop,
+                    const char   *root,
+                    const char   *location,
+                    const char   *second_location,
+                    gboolean      show_hidden)
+{
+    NautilusQuery *query;
+    GList *locations;
+    char *path;
+
+    search->engine = nautilus_search_engine_simple_new ();
+    g_object_set (search->engine, "recursive", TRUE, NULL);
+    search->paths = g_ptr_array_new_with_free_func (g_free);
+    search->finished = FALSE;
+    search->loop = loop;
+
+    g_signal_connect (search->engine, "hits-added",
+                      G_CALLBACK (simple_hits_added_cb), search);
+    g_signal_connect (search->engine, "finished",
+                      G_CALLBACK (simple_finished_cb), search);
+
+    query = nautilus_query_new ();
+    nautilus_query_set_text (query, "report");
+    nautilus_query_set_show_hidden_files (query, show_hidden);
+
+    locations = NULL;
+    if (second_location != NULL)
+    {
+        path = g_build_filename (root, second_location, NULL);
+        locations = g_list_prepend (locations, g_file_new_for_path (path));
+        g_free (path);
+    }
+    path = g_build_filename (root, location, NULL);
+    locations = g_list_prepend (locations, g_file_new_for_path (path));
+    g_free (path);
+    nautilus_query_set_locations (query, locations);
+    g_list_free_full (locations, g_object_unref);
+
+    nautilus_search_provider_set_query (NAUTILUS_SEARCH_PROVIDER (search->engine), query);
+    g_object_unref (query);
+}
+
+static void
+simple_search_clear (SimpleSearch *search)
+{
+    g_object_unref (search->engine);
+    g_ptr_array_unref (search->paths);
+}
+
+static void
+wait_for_searches (SimpleSearch *searches,
+                   guint         n_searches)
+{
+    guint i;
+
+    for (i = 0; i < n_searches; i++)
+    {
+        while (!searches[i].finished)
+        {
+            g_main_loop_run (searches[i].loop);
+        }
+    }
+}
+
+/* Returns the number of paths found under the root that start with
+ * prefix, once each.
+ */
+static guint
+count_found (SimpleSearch *search,
+             const char   *root,
+             const char   *prefix)
+{
+    GHashTable *seen;
+    char *full_prefix;
+    const char *path;
+    guint i, n_found;
+
+    seen = g_hash_table_new (g_str_hash, g_str_equal);
+    full_prefix = g_build_filename (root, prefix, NULL);
+
+    n_found = 0;
+    for (i = 0; i < search->paths->len; i++)
+    {
+        path = g_ptr_array_index (search->paths, i);
+        g_assert_true (g_hash_table_add (seen, (gpointer) path));
+        n_found += g_str_has_prefix (path, full_prefix);
+    }
+
+    g_free (full_prefix);
+    g_hash_table_destroy (seen);
+
+    return n_found;
+}
+
+static void
+test_simple_overlapping_searches ()
+{
+    SimpleSearch searches[2];
+    GMainLoop *loop;
+    char *root;
+
+    root = create_test_tree ();
+    loop = g_main_loop_new (NULL, FALSE);
+
+    simple_search_init (&searches[0], loop, root, "", NULL, FALSE);
+    simple_search_init (&searches[1], loop, root, "a", NULL, TRUE);
+
+    nautilus_search_provider_start (NAUTILUS_SEARCH_PROVIDER (searches[0].engine));
+    nautilus_search_provider_start (NAUTILUS_SEARCH_PROVIDER (searches[1].engine));
+    wait_for_searches (searches, 2);
+
+    /* Each gets what it searches for, whoever listed the directories. */
+    g_assert_cmpuint (searches[0].paths->len, ==, 3 + N_DIRECTORIES);
+    g_assert_cmpuint (count_found (&searches[0], root, "a/"), ==, 2);
+    g_assert_cmpuint (count_found (&searches[0], root, "a/.hidden"), ==, 0);
+    g_assert_cmpuint (searches[1].paths->len, ==, 3);
+    g_assert_cmpuint (count_found (&searches[1], root, "a/.hidden"), ==, 1);
+
+    /* Nothing is kept once they are done. */
+    g_assert_cmpuint (nautilus_search_engine_simple_get_n_shared_listings (), ==, 0);
+
+    simple_search_clear (&searches[0]);
+    simple_search_clear (&searches[1]);
+    g_main_loop_unref (loop);
+    remove_test_tree (root);
+    g_free (root);
+}
+
+static void
+test_simple_several_locations ()
+{
+    SimpleSearch search;
+    GMainLoop *loop;
+    char *root;
+
+    root = create_test_tree ();
+    loop = g_main_loop_new (NULL, FALSE);
+
+    /* Two roots that don't overlap, each searched once. */
+    simple_search_init (&search, loop, root, "a", "d7", FALSE);
+    nautilus_search_provider_start (NAUTILUS_SEARCH_PROVIDER (search.engine));
+    wait_for_searches (&search, 1);
+
+    g_assert_cmpuint (search.paths->len, ==, 3);
+    g_assert_cmpuint (count_found (&search, root, "a/"), ==, 2);
+    g_assert_cmpuint (count_found (&search, root, "d7/"), ==, 1);
+
+    simple_search_clear (&search);
+    g_main_loop_unref (loop);
+    remove_test_tree (root);
+    g_free (root);
+}
+
+static void
+test_simple_stop_while_sharing ()
+{
+    SimpleSearch searches[2];
+    GMainLoop *loop;
+    char *root;
+    guint i;
+
+    root = create_test_tree ();
+    loop = g_main_loop_new (NULL, FALSE);
+
+    /* Either of them may be waiting for a listing of the other. */
+    for (i = 0; i < 20; i++)
+    {
+        simple_search_init (&searches[0], loop, root, "", NULL, TRUE);
+        simple_search_init (&searches[1], loop, root, "", NULL, TRUE);
+
+        nautilus_search_provider_start (NAUTILUS_SEARCH_PROVIDER (searches[0].engine));
+        nautilus_search_provider_start (NAUTILUS_SEARCH_PROVIDER (searches[1].engine));
+        nautilus_search_provider_stop (NAUTILUS_SEARCH_PROVIDER (searches[i % 2].engine));
+        wait_for_searches (searches, 2);
+
+        g_assert_cmpuint (searches[(i + 1) % 2].paths->len, ==, 4 + N_DIRECTORIES);
+        g_assert_cmpuint (nautilus_search_engine_simple_get_n_shared_listings (), ==, 0);
+
+        simple_search_clear (&searches[0]);
+        simple_search_clear (&searches[1]);
+    }
+
+    g_main_loop_unref (loop);
+    remove_test_tree (root);
+    g_free (root);
+}
+
+static void
+setup_test_suite ()
+{
+    g_test_add_func ("/search-engine/start-and-stop",
+                     test_start_and_stop);
+    g_test_add_func ("/search-engine/simple/overlapping-searches",
+                     test_simple_overlapping_searches);
+    g_test_add_func ("/search-engine/simple/several-locations",
+                     test_simple_several_locations);
+    g_test_add_func ("/search-engine/simple/stop-while-sharing",
+                     test_simple_stop_while_sharing);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+    gtk_init (&argc, &argv);
+    g_test_init (&argc, &argv, NULL);
+
+    nautilus_ensure_extension_points ();
+
+    setup_test_suite ();
+
+    return g_test_run ();
 }
@@ -0,0 +1,147 @@
+#include <gio/gio.h>
+
+#include "src/nautilus-search-hit-heap.h"
+
+static NautilusSearchHit *
+hit_new (const char *path,
+         gdouble     relevance)
+{
+    NautilusSearchHit *hit;
+    GFile *location;
+
+    location = g_file_new_for_path (path);
+    hit = nautilus_search_hit_new_for_location (location);
+    g_object_set (hit, "relevance", relevance, NULL);
+    g_object_unref (location);
+
+    return hit;
+}
+
+static void
+add_hit (NautilusSearchHitHeap *heap,
+         const char            *path,
+         gdouble                relevance)
+{
+    NautilusSearchHit *hit;
+
+    hit = hit_new (path, relevance);
+    nautilus_search_hit_heap_add (heap, hit);
+    g_object_unref (hit);
+}
+
+static void
+assert_hits (NautilusSearchHitHeap *heap,
+             const char            *first_path,
+             ...)
+{
+    GPtrArray *hits;
+    const char *path;
+    char *hit_path;
+    va_list args;
+    guint i;
+
+    hits = nautilus_search_hit_heap_get_sorted (heap);
+
+    va_start (args, first_path);
+    for (path = first_path, i = 0; path != NULL; path = va_arg (args, const char *), i++)
+    {
+        g_assert_cmpuint (i, <, hits->len);
+        hit_path = g_file_get_path (nautilus_search_hit_get_location (g_ptr_array_index (hits, i)));
+        g_assert_cmpstr (hit_path, ==, path);
+        g_free (hit_path);
+    }
+    va_end (args);
+
+    g_assert_cmpuint (i, ==, hits->len);
+    g_ptr_array_unref (hits);
+}
+
+static void
+test_keeps_most_relevant ()
+{
+    NautilusSearchHitHeap *heap;
+
+    heap = nautilus_search_hit_heap_new (3);
+
+    add_hit (heap, "/a", 10);
+    add_hit (heap, "/b", 50);
+    assert_hits (heap, "/b", "/a", NULL);
+
+    add_hit (heap, "/c", 30);
+    add_hit (heap, "/d", 5);
+    add_hit (heap, "/e", 40);
+    add_hit (heap, "/f", 20);
+    assert_hits (heap, "/b", "/e", "/c", NULL);
+    g_assert_cmpuint (nautilus_search_hit_heap_get_size (heap), ==, 3);
+
+    nautilus_search_hit_heap_free (heap);
+}
+
+static void
+test_same_location ()
+{
+    NautilusSearchHitHeap *heap;
+
+    heap = nautilus_search_hit_heap_new (3);
+
+    add_hit (heap, "/a", 10);
+    add_hit (heap, "/b", 20);
+    add_hit (heap, "/a", 5);
+    assert_hits (heap, "/b", "/a", NULL);
+
+    add_hit (heap, "/a", 30);
+    assert_hits (heap, "/a", "/b", NULL);
+
+    nautilus_search_hit_heap_free (heap);
+}
+
+static void
+test_many_hits ()
+{
+    NautilusSearchHitHeap *heap;
+    GPtrArray *hits;
+    char path[32];
+    guint i;
+
+    heap = nautilus_search_hit_heap_new (10);
+
+    /* In an order that isn't sorted either way. */
+    for (i = 0; i < 1000; i++)
+    {
+        g_snprintf (path, sizeof (path), "/%u", (i * 7919) % 1000);
+        add_hit (heap, path, (i * 7919) % 1000);
+    }
+
+    hits = nautilus_search_hit_heap_get_sorted (heap);
+    g_assert_cmpuint (hits->len, ==, 10);
+    for (i = 0; i < hits->len; i++)
+    {
+        g_assert_cmpfloat (nautilus_search_hit_get_relevance (g_ptr_array_index (hits, i)),
+                           ==, 999 - i);
+    }
+    g_ptr_array_unref (hits);
+
+    nautilus_search_hit_heap_free (heap);
+}
+
+static void
+setup_test_suite ()
+{
+    g_test_add_func ("/search-hit-heap/keeps-most-relevant",
+                     test_keeps_most_relevant);
+    g_test_add_func ("/search-hit-heap/same-location",
+                     test_same_location);
+    g_test_add_func ("/search-hit-heap/many-hits",
+                     test_many_hits);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+    g_test_init (&argc, &argv, NULL);
+
+    setup_test_suite ();
+
+    return g_test_run ();
+}